@@ -16,7 +16,8 @@
 
 /*
  * copydb_start_blob_process starts an auxilliary process that copies the large
- * objects (blobs) from the source database into the target database.
+ * objects (blobs) from the source database into the target database. When
+ * using --blob-jobs, that process then starts as many worker processes.
  */
 bool
 copydb_start_blob_process(CopyDataSpec *specs)
@@ -26,7 +27,15 @@ copydb_start_blob_process(CopyDataSpec *specs)
 		return true;
 	}
 
-	log_info("STEP 5: copy Large Objects (BLOBs) in 1 sub-process");
+	if (specs->blobJobs > 1)
+	{
+		log_info("STEP 5: copy Large Objects (BLOBs) in %d sub-processes",
+				 specs->blobJobs);
+	}
+	else
+	{
+		log_info("STEP 5: copy Large Objects (BLOBs) in 1 sub-process");
+	}
 
 	/*
 	 * Flush stdio channels just before fork, to avoid double-output problems.
@@ -79,71 +88,379 @@ copydb_copy_blobs(CopyDataSpec *specs)
 
 	INSTR_TIME_SET_CURRENT(startTime);
 
-	log_notice("Started BLOB worker %d [%d]", getpid(), getppid());
+	uint32_t count = 0;
 
-	PGSQL *src = NULL;
-	PGSQL pgsql = { 0 };
-	PGSQL dst = { 0 };
+	if (specs->blobJobs > 1)
+	{
+		if (!copydb_copy_blobs_with_workers(specs, &count))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+	else
+	{
+		log_notice("Started BLOB worker %d [%d]", getpid(), getppid());
+
+		if (!copydb_copy_blobs_range(specs, NULL, &count))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
 
-	TransactionSnapshot snapshot = { 0 };
+	instr_time duration;
 
-	if (specs->consistent)
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, startTime);
+
+	/* and write that we successfully finished copying all blobs */
+	CopyBlobsSummary summary = {
+		.pid = getpid(),
+		.count = count,
+		.durationMs = INSTR_TIME_GET_MILLISEC(duration)
+	};
+
+	/* ignore errors on the blob file summary */
+	(void) write_blobs_summary(&summary, specs->cfPaths.done.blobs);
+
+	return true;
+}
+
+
+/*
+ * copydb_copy_blobs_with_workers splits the large objects OIDs in ranges and
+ * starts --blob-jobs processes to copy them. Each range is assigned to a
+ * single worker, and a done file is written for each range once it has been
+ * copied, so that resuming operations skips the ranges that are done.
+ *
+ * The ranges are computed once and saved to disk, so that they are the same
+ * when resuming operations, even if large objects have been added or removed
+ * on the source database in the meantime.
+ */
+bool
+copydb_copy_blobs_with_workers(CopyDataSpec *specs, uint32_t *count)
+{
+	BlobRangeArray rangeArray = { 0 };
+
+	if (!copydb_prepare_blob_ranges(specs, &rangeArray))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	log_info("Copying large objects in %d ranges using %d processes",
+			 rangeArray.count,
+			 specs->blobJobs);
+
+	for (int i = 0; i < specs->blobJobs; i++)
 	{
 		/*
-		 * In the context of the `pgcopydb copy blobs` command, we want to
-		 * re-use the already prepared snapshot.
+		 * Flush stdio channels just before fork, to avoid double-output
+		 * problems.
 		 */
-		if (specs->section == DATA_SECTION_BLOBS)
-		{
-			src = &(specs->sourceSnapshot.pgsql);
-		}
-		else
+		fflush(stdout);
+		fflush(stderr);
+
+		int fpid = fork();
+
+		switch (fpid)
 		{
-			/*
-			 * In the context of a full copy command, we want to re-use the
-			 * already exported snapshot and make sure to use a private PGSQL
-			 * client connection instance.
-			 */
-			if (!copydb_copy_snapshot(specs, &snapshot))
+			case -1:
 			{
-				/* errors have already been logged */
+				log_error("Failed to fork a worker process: %m");
 				return false;
 			}
 
-			/* swap the new instance in place of the previous one */
-			specs->sourceSnapshot = snapshot;
-
-			src = &(specs->sourceSnapshot.pgsql);
+			case 0:
+			{
+				/* child process runs the command */
+				if (!copydb_blob_worker(specs, &rangeArray, i))
+				{
+					/* errors have already been logged */
+					exit(EXIT_CODE_INTERNAL_ERROR);
+				}
+
+				exit(EXIT_CODE_QUIT);
+			}
 
-			if (!copydb_set_snapshot(specs))
+			default:
 			{
-				/* errors have already been logged */
-				return false;
+				/* fork succeeded, in parent */
+				break;
 			}
 		}
 	}
-	else
+
+	if (!copydb_wait_for_subprocesses(specs->failFast))
 	{
-		/*
-		 * In the context of --not-consistent we don't have an already
-		 * established snapshot to set nor a connection to piggyback onto, so
-		 * we have to initialize our client connection now.
-		 */
-		if (!pgsql_init(&pgsql, specs->source_pguri, PGSQL_CONN_SOURCE))
+		log_error("Some BLOB worker processes have exited with error status, "
+				  "see above for details");
+		free(rangeArray.array);
+		return false;
+	}
+
+	/* now sum-up the count of large objects copied in each range */
+	*count = 0;
+
+	for (int r = 0; r < rangeArray.count; r++)
+	{
+		char doneFile[MAXPGPATH] = { 0 };
+		CopyBlobsSummary summary = { 0 };
+
+		sformat(doneFile, sizeof(doneFile), "%s/%d.done",
+				specs->cfPaths.blobdir,
+				rangeArray.array[r].number);
+
+		if (!read_blobs_summary(&summary, doneFile))
 		{
 			/* errors have already been logged */
+			free(rangeArray.array);
+			return false;
+		}
+
+		*count += summary.count;
+	}
+
+	free(rangeArray.array);
+
+	return true;
+}
+
+
+/*
+ * copydb_blob_worker copies the large objects of the ranges assigned to the
+ * given worker, skipping the ranges that are already done.
+ */
+bool
+copydb_blob_worker(CopyDataSpec *specs, BlobRangeArray *rangeArray, int worker)
+{
+	log_notice("Started BLOB worker %d [%d]", getpid(), getppid());
+
+	for (int r = worker; r < rangeArray->count; r += specs->blobJobs)
+	{
+		BlobRange *range = &(rangeArray->array[r]);
+		char doneFile[MAXPGPATH] = { 0 };
+
+		sformat(doneFile, sizeof(doneFile), "%s/%d.done",
+				specs->cfPaths.blobdir,
+				range->number);
+
+		if (file_exists(doneFile))
+		{
+			log_info("Skipping large objects range %d (%u-%u), already done",
+					 range->number,
+					 range->min,
+					 range->max);
+			continue;
+		}
+
+		if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
+		{
+			log_error("BLOB worker has been interrupted");
+			return false;
+		}
+
+		instr_time startTime;
+
+		INSTR_TIME_SET_CURRENT(startTime);
+
+		uint32_t count = 0;
+
+		if (!copydb_copy_blobs_range(specs, range, &count))
+		{
+			log_error("Failed to copy large objects range %d (%u-%u)",
+					  range->number,
+					  range->min,
+					  range->max);
 			return false;
 		}
 
-		src = &pgsql;
+		instr_time duration;
 
-		if (!pgsql_begin(src))
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, startTime);
+
+		CopyBlobsSummary summary = {
+			.pid = getpid(),
+			.count = count,
+			.durationMs = INSTR_TIME_GET_MILLISEC(duration)
+		};
+
+		if (!write_blobs_summary(&summary, doneFile))
 		{
 			/* errors have already been logged */
 			return false;
 		}
 	}
 
+	return true;
+}
+
+
+/*
+ * copydb_prepare_blob_ranges reads the large objects ranges from disk when
+ * resuming operations, or computes them on the source database and then
+ * saves them to disk.
+ */
+bool
+copydb_prepare_blob_ranges(CopyDataSpec *specs, BlobRangeArray *rangeArray)
+{
+	char rangesFile[MAXPGPATH] = { 0 };
+
+	sformat(rangesFile, sizeof(rangesFile), "%s/ranges",
+			specs->cfPaths.blobdir);
+
+	if (file_exists(rangesFile))
+	{
+		return copydb_read_blob_ranges(rangesFile, rangeArray);
+	}
+
+	PGSQL *src = NULL;
+	PGSQL pgsql = { 0 };
+	bool reuseSnapshot = specs->section == DATA_SECTION_BLOBS;
+
+	if (!copydb_blobs_open_source(specs, reuseSnapshot, &pgsql, &src))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* use more ranges than workers to balance the load */
+	int rangeCount = specs->blobJobs * BLOB_RANGES_PER_JOB;
+
+	if (!schema_list_blob_ranges(src, rangeCount, rangeArray))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!copydb_blobs_close_source(specs, reuseSnapshot, src))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	PQExpBuffer contents = createPQExpBuffer();
+
+	if (contents == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	for (int r = 0; r < rangeArray->count; r++)
+	{
+		BlobRange *range = &(rangeArray->array[r]);
+
+		appendPQExpBuffer(contents, "%d %u %u\n",
+						  range->number,
+						  range->min,
+						  range->max);
+	}
+
+	if (PQExpBufferBroken(contents))
+	{
+		log_error("Failed to prepare large objects ranges: out of memory");
+		destroyPQExpBuffer(contents);
+		return false;
+	}
+
+	if (!write_file(contents->data, contents->len, rangesFile))
+	{
+		/* errors have already been logged */
+		destroyPQExpBuffer(contents);
+		return false;
+	}
+
+	destroyPQExpBuffer(contents);
+
+	return true;
+}
+
+
+/*
+ * copydb_read_blob_ranges reads the large objects ranges from the given file.
+ */
+bool
+copydb_read_blob_ranges(const char *filename, BlobRangeArray *rangeArray)
+{
+	char *fileContents = NULL;
+	long fileSize = 0L;
+
+	if (!read_file(filename, &fileContents, &fileSize))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	char *fileLines[BUFSIZE] = { 0 };
+	int lineCount = splitLines(fileContents, fileLines, BUFSIZE);
+
+	rangeArray->count = 0;
+	rangeArray->array = (BlobRange *) calloc(lineCount, sizeof(BlobRange));
+
+	if (lineCount > 0 && rangeArray->array == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		free(fileContents);
+		return false;
+	}
+
+	for (int i = 0; i < lineCount; i++)
+	{
+		BlobRange *range = &(rangeArray->array[rangeArray->count]);
+
+		if (IS_EMPTY_STRING_BUFFER(fileLines[i]))
+		{
+			continue;
+		}
+
+		if (sscanf(fileLines[i], "%d %u %u",
+				   &(range->number),
+				   &(range->min),
+				   &(range->max)) != 3)
+		{
+			log_error("Failed to parse large objects range \"%s\" in \"%s\"",
+					  fileLines[i],
+					  filename);
+			free(fileContents);
+			return false;
+		}
+
+		++rangeArray->count;
+	}
+
+	free(fileContents);
+
+	return true;
+}
+
+
+/*
+ * copydb_copy_blobs_range copies the large objects found in the given range
+ * of OIDs, or all of them when range is NULL.
+ */
+bool
+copydb_copy_blobs_range(CopyDataSpec *specs, BlobRange *range, uint32_t *count)
+{
+	PGSQL *src = NULL;
+	PGSQL pgsql = { 0 };
+	PGSQL dst = { 0 };
+
+	/*
+	 * In the context of the `pgcopydb copy blobs` command, when the large
+	 * objects are all copied in the main process, we want to re-use the
+	 * already prepared snapshot.
+	 */
+	bool reuseSnapshot = specs->section == DATA_SECTION_BLOBS && range == NULL;
+
+	if (!copydb_blobs_open_source(specs, reuseSnapshot, &pgsql, &src))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	if (!pgsql_init(&dst, specs->target_pguri, PGSQL_CONN_TARGET))
 	{
 		/* errors have already been logged */
@@ -158,23 +475,69 @@ copydb_copy_blobs(CopyDataSpec *specs)
 		return false;
 	}
 
-	uint32_t count = 0;
+	uint32_t minOid = range == NULL ? 0 : range->min;
+	uint32_t maxOid = range == NULL ? UINT32_MAX : range->max;
 
 	if (!pg_copy_large_objects(src,
 							   &dst,
 							   specs->restoreOptions.dropIfExists,
-							   &count))
+							   minOid,
+							   maxOid,
+							   count))
 	{
 		log_error("Failed to copy large objects");
 		return false;
 	}
 
-	/* if we opened a snapshot, now is the time to close it */
+	if (!copydb_blobs_close_source(specs, reuseSnapshot, src))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* close connection to the target database now */
+	(void) pgsql_finish(&dst);
+
+	return true;
+}
+
+
+/*
+ * copydb_blobs_open_source opens a connection to the source database that
+ * uses our snapshot, unless when using --not-consistent.
+ *
+ * When reuseSnapshot is true, we use the already prepared snapshot connection
+ * of the current process. Otherwise we need a private PGSQL client connection
+ * instance in which to set the already exported snapshot.
+ */
+bool
+copydb_blobs_open_source(CopyDataSpec *specs,
+						 bool reuseSnapshot,
+						 PGSQL *pgsql,
+						 PGSQL **src)
+{
 	if (specs->consistent)
 	{
-		if (specs->section != DATA_SECTION_BLOBS)
+		if (reuseSnapshot)
 		{
-			if (!copydb_close_snapshot(specs))
+			*src = &(specs->sourceSnapshot.pgsql);
+		}
+		else
+		{
+			TransactionSnapshot snapshot = { 0 };
+
+			if (!copydb_copy_snapshot(specs, &snapshot))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			/* swap the new instance in place of the previous one */
+			specs->sourceSnapshot = snapshot;
+
+			*src = &(specs->sourceSnapshot.pgsql);
+
+			if (!copydb_set_snapshot(specs))
 			{
 				/* errors have already been logged */
 				return false;
@@ -183,30 +546,57 @@ copydb_copy_blobs(CopyDataSpec *specs)
 	}
 	else
 	{
-		if (!pgsql_commit(src))
+		/*
+		 * In the context of --not-consistent we don't have an already
+		 * established snapshot to set nor a connection to piggyback onto, so
+		 * we have to initialize our client connection now.
+		 */
+		if (!pgsql_init(pgsql, specs->source_pguri, PGSQL_CONN_SOURCE))
 		{
 			/* errors have already been logged */
 			return false;
 		}
-	}
 
-	/* close connection to the target database now */
-	(void) pgsql_finish(&dst);
+		*src = pgsql;
 
-	instr_time duration;
+		if (!pgsql_begin(*src))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
 
-	INSTR_TIME_SET_CURRENT(duration);
-	INSTR_TIME_SUBTRACT(duration, startTime);
+	return true;
+}
 
-	/* and write that we successfully finished copying all blobs */
-	CopyBlobsSummary summary = {
-		.pid = getpid(),
-		.count = count,
-		.durationMs = INSTR_TIME_GET_MILLISEC(duration)
-	};
 
-	/* ignore errors on the blob file summary */
-	(void) write_blobs_summary(&summary, specs->cfPaths.done.blobs);
+/*
+ * copydb_blobs_close_source closes the connection to the source database that
+ * has been opened with copydb_blobs_open_source.
+ */
+bool
+copydb_blobs_close_source(CopyDataSpec *specs, bool reuseSnapshot, PGSQL *src)
+{
+	/* if we opened a snapshot, now is the time to close it */
+	if (specs->consistent)
+	{
+		if (!reuseSnapshot)
+		{
+			if (!copydb_close_snapshot(specs))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+	}
+	else
+	{
+		if (!pgsql_commit(src))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
 
 	return true;
 }
@@ -29,7 +29,12 @@
 	"  --dir                      Work directory to use\n" \
 	"  --table-jobs               Number of concurrent COPY jobs to run\n" \
 	"  --index-jobs               Number of concurrent CREATE INDEX jobs to run\n" \
+	"  --vacuum-jobs              Number of concurrent VACUUM jobs to run\n" \
+	"  --blob-jobs                Number of concurrent Large Objects jobs to run\n" \
+	"  --restore-jobs             Number of concurrent pre-data restore jobs to run\n" \
+	"  --dump-jobs                Number of concurrent pg_dump jobs to run\n" \
 	"  --split-tables-larger-than Same-table concurrency size threshold\n" \
+	"  --estimate-table-sizes     Estimate table sizes from the catalogs\n" \
 	"  --drop-if-exists           On the target database, clean-up from a previous run first\n" \
 	"  --roles                    Also copy roles found on source to target\n" \
 	"  --no-role-passwords        Do not dump passwords for roles\n" \
@@ -40,10 +45,13 @@
 	"  --skip-extensions          Skip restoring extensions\n" \
 	"  --skip-collations          Skip restoring collations\n" \
 	"  --skip-vacuum              Skip running VACUUM ANALYZE\n" \
+	"  --vacuum-freeze            Freeze tables with VACUUM once loaded\n" \
+	"  --import-stats             Import planner statistics from the source database\n" \
 	"  --filters <filename>       Use the filters defined in <filename>\n" \
 	"  --fail-fast                Abort early in case of error\n" \
 	"  --restart                  Allow restarting when temp files exist already\n" \
 	"  --resume                   Allow resuming operations after a failure\n" \
+	"  --progress-files           Track progress with one file per table and index\n" \
 	"  --not-consistent           Allow taking a new snapshot on the source database\n" \
 	"  --snapshot                 Use snapshot obtained with pg_export_snapshot\n" \
 	"  --follow                   Implement logical decoding to replay changes\n" \
@@ -52,6 +60,11 @@
 	"  --create-slot              Create the replication slot\n" \
 	"  --origin                   Use this Postgres replication origin node name\n" \
 	"  --endpos                   Stop replaying changes when reaching this LSN\n" \
+	"  --prepared-statements      Replay changes using prepared statements\n" \
+	"  --copy-inserts             Replay runs of INSERT statements using COPY\n" \
+	"  --pipeline                 Replay changes using libpq pipeline mode\n" \
+	"  --apply-jobs               Apply changes using that many connections\n" \
+	"  --group-commit             Apply that many transactions per target transaction\n" \
 
 CommandLine clone_command =
 	make_command(
@@ -99,7 +112,12 @@ CommandLine follow_command =
 		"  --slot-name           Use this Postgres replication slot name\n"
 		"  --create-slot         Create the replication slot\n"
 		"  --origin              Use this Postgres replication origin node name\n"
-		"  --endpos              Stop replaying changes when reaching this LSN\n",
+		"  --endpos              Stop replaying changes when reaching this LSN\n"
+		"  --prepared-statements Replay changes using prepared statements\n"
+		"  --copy-inserts        Replay runs of INSERT statements using COPY\n"
+		"  --pipeline            Replay changes using libpq pipeline mode\n"
+		"  --apply-jobs          Apply changes using that many connections\n"
+		"  --group-commit        Apply that many transactions per target transaction\n",
 		cli_copy_db_getopts,
 		cli_follow);
 
@@ -205,7 +223,12 @@ clone_and_follow(CopyDataSpec *copySpecs)
 						   STREAM_MODE_CATCHUP,
 						   copyDBoptions.stdIn,
 						   copyDBoptions.stdOut,
-						   logSQL))
+						   logSQL,
+						   copyDBoptions.preparedStatements,
+						   copyDBoptions.copyInserts,
+						   copyDBoptions.pipeline,
+						   copyDBoptions.applyJobs,
+						   copyDBoptions.groupCommit))
 	{
 		/* errors have already been logged */
 		exit(EXIT_CODE_INTERNAL_ERROR);
@@ -345,7 +368,12 @@ cli_follow(int argc, char **argv)
 						   STREAM_MODE_CATCHUP,
 						   copyDBoptions.stdIn,
 						   copyDBoptions.stdOut,
-						   logSQL))
+						   logSQL,
+						   copyDBoptions.preparedStatements,
+						   copyDBoptions.copyInserts,
+						   copyDBoptions.pipeline,
+						   copyDBoptions.applyJobs,
+						   copyDBoptions.groupCommit))
 	{
 		/* errors have already been logged */
 		exit(EXIT_CODE_INTERNAL_ERROR);
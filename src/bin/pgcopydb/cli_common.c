@@ -235,6 +235,138 @@ cli_copydb_getenv(CopyDBOptions *options)
 		}
 	}
 
+	if (env_exists(PGCOPYDB_VACUUM_JOBS))
+	{
+		char jobs[BUFSIZE] = { 0 };
+
+		if (get_env_copy(PGCOPYDB_VACUUM_JOBS, jobs, sizeof(jobs)))
+		{
+			if (!stringToInt(jobs, &options->vacuumJobs) ||
+				options->vacuumJobs < 1 ||
+				options->vacuumJobs > 128)
+			{
+				log_fatal("Failed to parse PGCOPYDB_VACUUM_JOBS: \"%s\"",
+						  jobs);
+				++errors;
+			}
+		}
+		else
+		{
+			/* errors have already been logged */
+			++errors;
+		}
+	}
+
+	if (env_exists(PGCOPYDB_BLOB_JOBS))
+	{
+		char jobs[BUFSIZE] = { 0 };
+
+		if (get_env_copy(PGCOPYDB_BLOB_JOBS, jobs, sizeof(jobs)))
+		{
+			if (!stringToInt(jobs, &options->blobJobs) ||
+				options->blobJobs < 1 ||
+				options->blobJobs > 128)
+			{
+				log_fatal("Failed to parse PGCOPYDB_BLOB_JOBS: \"%s\"",
+						  jobs);
+				++errors;
+			}
+		}
+		else
+		{
+			/* errors have already been logged */
+			++errors;
+		}
+	}
+
+	if (env_exists(PGCOPYDB_GROUP_COMMIT))
+	{
+		char groupCommit[BUFSIZE] = { 0 };
+
+		if (get_env_copy(PGCOPYDB_GROUP_COMMIT, groupCommit, sizeof(groupCommit)))
+		{
+			if (!stringToInt(groupCommit, &options->groupCommit) ||
+				options->groupCommit < 1 ||
+				options->groupCommit > 10000)
+			{
+				log_fatal("Failed to parse PGCOPYDB_GROUP_COMMIT: \"%s\"",
+						  groupCommit);
+				++errors;
+			}
+		}
+		else
+		{
+			/* errors have already been logged */
+			++errors;
+		}
+	}
+
+	if (env_exists(PGCOPYDB_APPLY_JOBS))
+	{
+		char jobs[BUFSIZE] = { 0 };
+
+		if (get_env_copy(PGCOPYDB_APPLY_JOBS, jobs, sizeof(jobs)))
+		{
+			if (!stringToInt(jobs, &options->applyJobs) ||
+				options->applyJobs < 1 ||
+				options->applyJobs > 128)
+			{
+				log_fatal("Failed to parse PGCOPYDB_APPLY_JOBS: \"%s\"",
+						  jobs);
+				++errors;
+			}
+		}
+		else
+		{
+			/* errors have already been logged */
+			++errors;
+		}
+	}
+
+	if (env_exists(PGCOPYDB_RESTORE_JOBS))
+	{
+		char jobs[BUFSIZE] = { 0 };
+
+		if (get_env_copy(PGCOPYDB_RESTORE_JOBS, jobs, sizeof(jobs)))
+		{
+			if (!stringToInt(jobs, &options->restoreJobs) ||
+				options->restoreJobs < 1 ||
+				options->restoreJobs > 128)
+			{
+				log_fatal("Failed to parse PGCOPYDB_RESTORE_JOBS: \"%s\"",
+						  jobs);
+				++errors;
+			}
+		}
+		else
+		{
+			/* errors have already been logged */
+			++errors;
+		}
+	}
+
+	if (env_exists(PGCOPYDB_DUMP_JOBS))
+	{
+		char jobs[BUFSIZE] = { 0 };
+
+		if (get_env_copy(PGCOPYDB_DUMP_JOBS, jobs, sizeof(jobs)))
+		{
+			if (!stringToInt(jobs, &options->dumpJobs) ||
+				options->dumpJobs < 1 ||
+				options->dumpJobs > 128)
+			{
+				log_fatal("Failed to parse PGCOPYDB_DUMP_JOBS: \"%s\"",
+						  jobs);
+				++errors;
+			}
+		}
+		else
+		{
+			/* errors have already been logged */
+			++errors;
+		}
+	}
+
 	if (env_exists(PGCOPYDB_SPLIT_TABLES_LARGER_THAN))
 	{
 		char bytes[BUFSIZE] = { 0 };
@@ -368,6 +500,105 @@ cli_copydb_getenv(CopyDBOptions *options)
 		}
 	}
 
+	/* when --progress-files has not been used, check PGCOPYDB_PROGRESS_FILES */
+	if (!options->progressFiles)
+	{
+		if (env_exists(PGCOPYDB_PROGRESS_FILES))
+		{
+			char PROGRESS_FILES[BUFSIZE] = { 0 };
+
+			if (!get_env_copy(PGCOPYDB_PROGRESS_FILES,
+							  PROGRESS_FILES,
+							  sizeof(PROGRESS_FILES)))
+			{
+				/* errors have already been logged */
+				++errors;
+			}
+			else if (!parse_bool(PROGRESS_FILES, &(options->progressFiles)))
+			{
+				log_error("Failed to parse environment variable \"%s\" "
+						  "value \"%s\", expected a boolean (on/off)",
+						  PGCOPYDB_PROGRESS_FILES,
+						  PROGRESS_FILES);
+				++errors;
+			}
+		}
+	}
+
+	/* when --prepared-statements has not been used, check the environment */
+	if (!options->preparedStatements)
+	{
+		if (env_exists(PGCOPYDB_PREPARED_STATEMENTS))
+		{
+			char PREPARED_STATEMENTS[BUFSIZE] = { 0 };
+
+			if (!get_env_copy(PGCOPYDB_PREPARED_STATEMENTS,
+							  PREPARED_STATEMENTS,
+							  sizeof(PREPARED_STATEMENTS)))
+			{
+				/* errors have already been logged */
+				++errors;
+			}
+			else if (!parse_bool(PREPARED_STATEMENTS,
+								 &(options->preparedStatements)))
+			{
+				log_error("Failed to parse environment variable \"%s\" "
+						  "value \"%s\", expected a boolean (on/off)",
+						  PGCOPYDB_PREPARED_STATEMENTS,
+						  PREPARED_STATEMENTS);
+				++errors;
+			}
+		}
+	}
+
+	/* when --copy-inserts has not been used, check the environment */
+	if (!options->copyInserts)
+	{
+		if (env_exists(PGCOPYDB_COPY_INSERTS))
+		{
+			char COPY_INSERTS[BUFSIZE] = { 0 };
+
+			if (!get_env_copy(PGCOPYDB_COPY_INSERTS,
+							  COPY_INSERTS,
+							  sizeof(COPY_INSERTS)))
+			{
+				/* errors have already been logged */
+				++errors;
+			}
+			else if (!parse_bool(COPY_INSERTS, &(options->copyInserts)))
+			{
+				log_error("Failed to parse environment variable \"%s\" "
+						  "value \"%s\", expected a boolean (on/off)",
+						  PGCOPYDB_COPY_INSERTS,
+						  COPY_INSERTS);
+				++errors;
+			}
+		}
+	}
+
+	/* when --pipeline has not been used, check the environment */
+	if (!options->pipeline)
+	{
+		if (env_exists(PGCOPYDB_PIPELINE))
+		{
+			char PIPELINE[BUFSIZE] = { 0 };
+
+			if (!get_env_copy(PGCOPYDB_PIPELINE, PIPELINE, sizeof(PIPELINE)))
+			{
+				/* errors have already been logged */
+				++errors;
+			}
+			else if (!parse_bool(PIPELINE, &(options->pipeline)))
+			{
+				log_error("Failed to parse environment variable \"%s\" "
+						  "value \"%s\", expected a boolean (on/off)",
+						  PGCOPYDB_PIPELINE,
+						  PIPELINE);
+				++errors;
+			}
+		}
+	}
+
 	return errors == 0;
 }
 
@@ -653,6 +884,12 @@ cli_copy_db_getopts(int argc, char **argv)
 		{ "jobs", required_argument, NULL, 'J' },
 		{ "table-jobs", required_argument, NULL, 'J' },
 		{ "index-jobs", required_argument, NULL, 'I' },
+		{ "vacuum-jobs", required_argument, NULL, 'W' },
+		{ "blob-jobs", required_argument, NULL, 'b' },
+		{ "restore-jobs", required_argument, NULL, 'j' },
+		{ "dump-jobs", required_argument, NULL, 'k' },
+		{ "apply-jobs", required_argument, NULL, 'w' },
+		{ "group-commit", required_argument, NULL, 'g' },
 		{ "split-tables-larger-than", required_argument, NULL, 'L' },
 		{ "split-at", required_argument, NULL, 'L' },
 		{ "drop-if-exists", no_argument, NULL, 'c' }, /* pg_restore -c */
@@ -666,6 +903,10 @@ cli_copy_db_getopts(int argc, char **argv)
 		{ "skip-extensions", no_argument, NULL, 'e' },
 		{ "skip-collations", no_argument, NULL, 'l' },
 		{ "skip-vacuum", no_argument, NULL, 'U' },
+		{ "vacuum-freeze", no_argument, NULL, 'Y' },
+		{ "import-stats", no_argument, NULL, 'a' },
+		{ "estimate-table-sizes", no_argument, NULL, 'G' },
+		{ "progress-files", no_argument, NULL, 'y' },
 		{ "filter", required_argument, NULL, 'F' },
 		{ "filters", required_argument, NULL, 'F' },
 		{ "fail-fast", no_argument, NULL, 'i' },
@@ -679,6 +920,9 @@ cli_copy_db_getopts(int argc, char **argv)
 		{ "origin", required_argument, NULL, 'o' },
 		{ "create-slot", no_argument, NULL, 't' },
 		{ "endpos", required_argument, NULL, 'E' },
+		{ "prepared-statements", no_argument, NULL, 'Z' },
+		{ "copy-inserts", no_argument, NULL, 'Q' },
+		{ "pipeline", no_argument, NULL, 'K' },
 		{ "version", no_argument, NULL, 'V' },
 		{ "verbose", no_argument, NULL, 'v' },
 		{ "notice", no_argument, NULL, 'v' },
@@ -694,6 +938,11 @@ cli_copy_db_getopts(int argc, char **argv)
 	/* install default values */
 	options.tableJobs = DEFAULT_TABLE_JOBS;
 	options.indexJobs = DEFAULT_INDEX_JOBS;
+	options.blobJobs = DEFAULT_BLOB_JOBS;
+	options.restoreJobs = DEFAULT_RESTORE_JOBS;
+	options.dumpJobs = DEFAULT_DUMP_JOBS;
+	options.applyJobs = DEFAULT_APPLY_JOBS;
+	options.groupCommit = DEFAULT_GROUP_COMMIT;
 	options.splitTablesLargerThan = DEFAULT_SPLIT_TABLES_LARGER_THAN;
 
 	/* read values from the environment */
@@ -768,6 +1017,90 @@ cli_copy_db_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'W':
+			{
+				if (!stringToInt(optarg, &options.vacuumJobs) ||
+					options.vacuumJobs < 1 ||
+					options.vacuumJobs > 128)
+				{
+					log_fatal("Failed to parse --vacuum-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--vacuum-jobs %d", options.vacuumJobs);
+				break;
+			}
+
+			case 'b':
+			{
+				if (!stringToInt(optarg, &options.blobJobs) ||
+					options.blobJobs < 1 ||
+					options.blobJobs > 128)
+				{
+					log_fatal("Failed to parse --blob-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--blob-jobs %d", options.blobJobs);
+				break;
+			}
+
+			case 'j':
+			{
+				if (!stringToInt(optarg, &options.restoreJobs) ||
+					options.restoreJobs < 1 ||
+					options.restoreJobs > 128)
+				{
+					log_fatal("Failed to parse --restore-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--restore-jobs %d", options.restoreJobs);
+				break;
+			}
+
+			case 'g':
+			{
+				if (!stringToInt(optarg, &options.groupCommit) ||
+					options.groupCommit < 1 ||
+					options.groupCommit > 10000)
+				{
+					log_fatal("Failed to parse --group-commit count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--group-commit %d", options.groupCommit);
+				break;
+			}
+
+			case 'w':
+			{
+				if (!stringToInt(optarg, &options.applyJobs) ||
+					options.applyJobs < 1 ||
+					options.applyJobs > 128)
+				{
+					log_fatal("Failed to parse --apply-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--apply-jobs %d", options.applyJobs);
+				break;
+			}
+
+			case 'k':
+			{
+				if (!stringToInt(optarg, &options.dumpJobs) ||
+					options.dumpJobs < 1 ||
+					options.dumpJobs > 128)
+				{
+					log_fatal("Failed to parse --dump-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--dump-jobs %d", options.dumpJobs);
+				break;
+			}
+
 			case 'L':
 			{
 				if (!cli_parse_bytes_pretty(
@@ -857,6 +1190,55 @@ cli_copy_db_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'Y':
+			{
+				options.vacuumFreeze = true;
+				log_trace("--vacuum-freeze");
+				break;
+			}
+
+			case 'y':
+			{
+				options.progressFiles = true;
+				log_trace("--progress-files");
+				break;
+			}
+
+			case 'Z':
+			{
+				options.preparedStatements = true;
+				log_trace("--prepared-statements");
+				break;
+			}
+
+			case 'Q':
+			{
+				options.copyInserts = true;
+				log_trace("--copy-inserts");
+				break;
+			}
+
+			case 'K':
+			{
+				options.pipeline = true;
+				log_trace("--pipeline");
+				break;
+			}
+
+			case 'a':
+			{
+				options.importStats = true;
+				log_trace("--import-stats");
+				break;
+			}
+
+			case 'G':
+			{
+				options.estimateTableSizes = true;
+				log_trace("--estimate-table-sizes");
+				break;
+			}
+
 			case 'i':
 			{
 				options.failFast = true;
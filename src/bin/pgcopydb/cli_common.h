@@ -29,6 +29,11 @@ typedef struct CopyDBOptions
 
 	int tableJobs;
 	int indexJobs;
+	int vacuumJobs;
+	int blobJobs;
+	int restoreJobs;
+	int dumpJobs;
+	int applyJobs;
 	uint64_t splitTablesLargerThan;
 	char splitTablesLargerThanPretty[NAMEDATALEN];
 
@@ -39,6 +44,14 @@ typedef struct CopyDBOptions
 	bool skipExtensions;
 	bool skipCollations;
 	bool skipVacuum;
+	bool vacuumFreeze;
+	bool importStats;
+	bool progressFiles;
+	bool preparedStatements;
+	bool copyInserts;
+	bool pipeline;
+	int groupCommit;
+	bool estimateTableSizes;
 	bool noRolesPasswords;
 	bool failFast;
 
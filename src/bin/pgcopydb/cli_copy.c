@@ -39,6 +39,10 @@ static CommandLine copy_db_command =
 		"  --dir                 Work directory to use\n"
 		"  --table-jobs          Number of concurrent COPY jobs to run\n"
 		"  --index-jobs          Number of concurrent CREATE INDEX jobs to run\n"
+		"  --vacuum-jobs         Number of concurrent VACUUM jobs to run\n"
+		"  --blob-jobs           Number of concurrent Large Objects jobs to run\n"
+		"  --restore-jobs        Number of concurrent pre-data restore jobs to run\n"
+		"  --dump-jobs           Number of concurrent pg_dump jobs to run\n"
 		"  --drop-if-exists      On the target database, clean-up from a previous run first\n"
 		"  --roles               Also copy roles found on source to target\n"
 		"  --no-owner            Do not set ownership of objects to match the original database\n"
@@ -49,6 +53,7 @@ static CommandLine copy_db_command =
 		"  --fail-fast           Abort early in case of error\n"
 		"  --restart             Allow restarting when temp files exist already\n"
 		"  --resume              Allow resuming operations after a failure\n"
+		"  --progress-files      Track progress with one file per table and index\n"
 		"  --not-consistent      Allow taking a new snapshot on the source database\n"
 		"  --snapshot            Use snapshot obtained with pg_export_snapshot\n",
 		cli_copy_db_getopts,
@@ -62,6 +67,8 @@ static CommandLine copy_schema_command =
 		"  --source              Postgres URI to the source database\n"
 		"  --target              Postgres URI to the target database\n"
 		"  --dir                 Work directory to use\n"
+		"  --restore-jobs        Number of concurrent pre-data restore jobs to run\n"
+		"  --dump-jobs           Number of concurrent pg_dump jobs to run\n"
 		"  --filters <filename>  Use the filters defined in <filename>\n"
 		"  --restart             Allow restarting when temp files exist already\n"
 		"  --resume              Allow resuming operations after a failure\n"
@@ -107,10 +114,13 @@ static CommandLine copy_data_command =
 		"  --dir                 Work directory to use\n"
 		"  --table-jobs          Number of concurrent COPY jobs to run\n"
 		"  --index-jobs          Number of concurrent CREATE INDEX jobs to run\n"
+		"  --vacuum-jobs         Number of concurrent VACUUM jobs to run\n"
+		"  --blob-jobs           Number of concurrent Large Objects jobs to run\n"
 		"  --skip-large-objects  Skip copying large objects (blobs)\n"
 		"  --filters <filename>  Use the filters defined in <filename>\n"
 		"  --restart             Allow restarting when temp files exist already\n"
 		"  --resume              Allow resuming operations after a failure\n"
+		"  --progress-files      Track progress with one file per table and index\n"
 		"  --not-consistent      Allow taking a new snapshot on the source database\n"
 		"  --snapshot            Use snapshot obtained with pg_export_snapshot\n",
 		cli_copy_db_getopts,
@@ -141,6 +151,7 @@ static CommandLine copy_blobs_command =
 		"  --source          Postgres URI to the source database\n"
 		"  --target          Postgres URI to the target database\n"
 		"  --dir             Work directory to use\n"
+		"  --blob-jobs       Number of concurrent Large Objects jobs to run\n"
 		"  --drop-if-exists  On the target database, drop and create large objects\n"
 		"  --restart         Allow restarting when temp files exist already\n"
 		"  --resume          Allow resuming operations after a failure\n"
@@ -38,6 +38,7 @@ static CommandLine dump_schema_command =
 		"  --source          Postgres URI to the source database\n"
 		"  --target          Directory where to save the dump files\n"
 		"  --dir             Work directory to use\n"
+		"  --dump-jobs       Number of concurrent pg_dump jobs to run\n"
 		"  --snapshot        Use snapshot obtained with pg_export_snapshot\n",
 		cli_dump_schema_getopts,
 		cli_dump_schema);
@@ -50,6 +51,7 @@ static CommandLine dump_schema_pre_data_command =
 		"  --source          Postgres URI to the source database\n"
 		"  --target          Directory where to save the dump files\n"
 		"  --dir             Work directory to use\n"
+		"  --dump-jobs       Number of concurrent pg_dump jobs to run\n"
 		"  --snapshot        Use snapshot obtained with pg_export_snapshot\n",
 		cli_dump_schema_getopts,
 		cli_dump_schema_pre_data);
@@ -62,6 +64,7 @@ static CommandLine dump_schema_post_data_command =
 		"  --source          Postgres URI to the source database\n"
 		"  --target          Directory where to save the dump files\n"
 		"  --dir             Work directory to use\n"
+		"  --dump-jobs       Number of concurrent pg_dump jobs to run\n"
 		"  --snapshot        Use snapshot obtained with pg_export_snapshot\n",
 		cli_dump_schema_getopts,
 		cli_dump_schema_post_data);
@@ -106,6 +109,7 @@ cli_dump_schema_getopts(int argc, char **argv)
 		{ "source", required_argument, NULL, 'S' },
 		{ "target", required_argument, NULL, 'T' },
 		{ "dir", required_argument, NULL, 'D' },
+		{ "dump-jobs", required_argument, NULL, 'k' },
 		{ "no-role-passwords", no_argument, NULL, 'P' },
 		{ "restart", no_argument, NULL, 'r' },
 		{ "resume", no_argument, NULL, 'R' },
@@ -168,6 +172,20 @@ cli_dump_schema_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'k':
+			{
+				if (!stringToInt(optarg, &options.dumpJobs) ||
+					options.dumpJobs < 1 ||
+					options.dumpJobs > 128)
+				{
+					log_fatal("Failed to parse --dump-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--dump-jobs %d", options.dumpJobs);
+				break;
+			}
+
 			case 'P':
 			{
 				options.noRolesPasswords = true;
@@ -708,6 +708,7 @@ cli_list_tables(int argc, char **argv)
 	}
 
 	bool createdTableSizeTable = false;
+	bool computedTableSize = false;
 	bool dropCache = listDBoptions.cache;
 
 	if (!schema_prepare_pgcopydb_table_size(&pgsql,
@@ -715,7 +716,9 @@ cli_list_tables(int argc, char **argv)
 											hasDBCreatePrivilege,
 											listDBoptions.cache,
 											dropCache,
-											&createdTableSizeTable))
+											false, /* estimate */
+											&createdTableSizeTable,
+											&computedTableSize))
 	{
 		/* errors have already been logged */
 		exit(EXIT_CODE_INTERNAL_ERROR);
@@ -871,6 +874,7 @@ cli_list_table_parts(int argc, char **argv)
 	/* just don't query for privileges, assume read-only */
 	bool hasDBCreatePrivilege = false;
 	bool createdTableSizeTable = false;
+	bool computedTableSize = false;
 
 	if (!pgsql_prepend_search_path(&pgsql, "pgcopydb"))
 	{
@@ -883,7 +887,9 @@ cli_list_table_parts(int argc, char **argv)
 											hasDBCreatePrivilege,
 											false, /* cache */
 											false, /* dropCache */
-											&createdTableSizeTable))
+											false, /* estimate */
+											&createdTableSizeTable,
+											&computedTableSize))
 	{
 		/* errors have already been logged */
 		exit(EXIT_CODE_INTERNAL_ERROR);
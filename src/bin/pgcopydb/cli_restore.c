@@ -42,6 +42,7 @@ static CommandLine restore_schema_command =
 		"  --no-owner           Do not set ownership of objects to match the original database\n"
 		"  --no-acl             Prevent restoration of access privileges (grant/revoke commands).\n"
 		"  --no-comments        Do not output commands to restore comments\n"
+		"  --restore-jobs       Number of concurrent pre-data restore jobs to run\n"
 		"  --filters <filename> Use the filters defined in <filename>\n"
 		"  --restart            Allow restarting when temp files exist already\n"
 		"  --resume             Allow resuming operations after a failure\n"
@@ -61,6 +62,7 @@ static CommandLine restore_schema_pre_data_command =
 		"  --no-owner           Do not set ownership of objects to match the original database\n"
 		"  --no-acl             Prevent restoration of access privileges (grant/revoke commands).\n"
 		"  --no-comments        Do not output commands to restore comments\n"
+		"  --restore-jobs       Number of concurrent pre-data restore jobs to run\n"
 		"  --filters <filename> Use the filters defined in <filename>\n"
 		"  --restart            Allow restarting when temp files exist already\n"
 		"  --resume             Allow resuming operations after a failure\n"
@@ -148,6 +150,7 @@ cli_restore_schema_getopts(int argc, char **argv)
 		{ "no-owner", no_argument, NULL, 'O' },       /* pg_restore -O */
 		{ "no-comments", no_argument, NULL, 'X' },
 		{ "no-acl", no_argument, NULL, 'x' }, /* pg_restore -x */
+		{ "restore-jobs", required_argument, NULL, 'j' },
 		{ "filter", required_argument, NULL, 'F' },
 		{ "filters", required_argument, NULL, 'F' },
 		{ "skip-extensions", no_argument, NULL, 'e' },
@@ -240,6 +243,20 @@ cli_restore_schema_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'j':
+			{
+				if (!stringToInt(optarg, &options.restoreJobs) ||
+					options.restoreJobs < 1 ||
+					options.restoreJobs > 128)
+				{
+					log_fatal("Failed to parse --restore-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--restore-jobs %d", options.restoreJobs);
+				break;
+			}
+
 			case 'e':
 			{
 				options.skipExtensions = true;
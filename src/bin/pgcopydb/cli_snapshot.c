@@ -293,7 +293,12 @@ cli_create_snapshot(int argc, char **argv)
 							   STREAM_MODE_CATCHUP,
 							   createSNoptions.stdIn,
 							   createSNoptions.stdOut,
-							   logSQL))
+							   logSQL,
+							   createSNoptions.preparedStatements,
+							   createSNoptions.copyInserts,
+							   createSNoptions.pipeline,
+							   createSNoptions.applyJobs,
+							   createSNoptions.groupCommit))
 		{
 			/* errors have already been logged */
 			exit(EXIT_CODE_INTERNAL_ERROR);
@@ -87,7 +87,9 @@ static CommandLine stream_prefetch_command =
 		"  --resume         Allow resuming operations after a failure\n"
 		"  --not-consistent Allow taking a new snapshot on the source database\n"
 		"  --slot-name      Stream changes recorded by this slot\n"
-		"  --endpos         LSN position where to stop receiving changes",
+		"  --endpos         LSN position where to stop receiving changes\n"
+		"  --prepared-statements Transform changes to prepared statements\n"
+		"  --copy-inserts   Transform runs of INSERT statements into COPY",
 		cli_stream_getopts,
 		cli_stream_prefetch);
 
@@ -104,7 +106,10 @@ static CommandLine stream_catchup_command =
 		"  --not-consistent Allow taking a new snapshot on the source database\n"
 		"  --slot-name      Stream changes recorded by this slot\n"
 		"  --endpos         LSN position where to stop receiving changes\n"
-		"  --origin         Name of the Postgres replication origin\n",
+		"  --origin         Name of the Postgres replication origin\n"
+		"  --pipeline       Apply changes using libpq pipeline mode\n"
+		"  --apply-jobs     Apply changes using that many connections\n"
+		"  --group-commit   Apply that many transactions per target transaction\n",
 		cli_stream_getopts,
 		cli_stream_catchup);
 
@@ -121,7 +126,12 @@ static CommandLine stream_replay_command =
 		"  --not-consistent Allow taking a new snapshot on the source database\n"
 		"  --slot-name      Stream changes recorded by this slot\n"
 		"  --endpos         LSN position where to stop receiving changes\n"
-		"  --origin         Name of the Postgres replication origin\n",
+		"  --origin         Name of the Postgres replication origin\n"
+		"  --prepared-statements Transform changes to prepared statements\n"
+		"  --copy-inserts   Transform runs of INSERT statements into COPY\n"
+		"  --pipeline       Apply changes using libpq pipeline mode\n"
+		"  --apply-jobs     Apply changes using that many connections\n"
+		"  --group-commit   Apply that many transactions per target transaction\n",
 		cli_stream_getopts,
 		cli_stream_replay);
 
@@ -150,7 +160,9 @@ static CommandLine stream_transform_command =
 		"  --dir            Work directory to use\n"
 		"  --restart        Allow restarting when temp files exist already\n"
 		"  --resume         Allow resuming operations after a failure\n"
-		"  --not-consistent Allow taking a new snapshot on the source database\n",
+		"  --not-consistent Allow taking a new snapshot on the source database\n"
+		"  --prepared-statements Transform changes to prepared statements\n"
+		"  --copy-inserts   Transform runs of INSERT statements into COPY\n",
 		cli_stream_getopts,
 		cli_stream_transform);
 
@@ -164,7 +176,10 @@ static CommandLine stream_apply_command =
 		"  --restart        Allow restarting when temp files exist already\n"
 		"  --resume         Allow resuming operations after a failure\n"
 		"  --not-consistent Allow taking a new snapshot on the source database\n"
-		"  --origin         Name of the Postgres replication origin\n",
+		"  --origin         Name of the Postgres replication origin\n"
+		"  --pipeline       Apply changes using libpq pipeline mode\n"
+		"  --apply-jobs     Apply changes using that many connections\n"
+		"  --group-commit   Apply that many transactions per target transaction\n",
 		cli_stream_getopts,
 		cli_stream_apply);
 
@@ -212,6 +227,11 @@ cli_stream_getopts(int argc, char **argv)
 		{ "not-consistent", no_argument, NULL, 'C' },
 		{ "to-stdout", no_argument, NULL, 'O' },
 		{ "from-stdin", no_argument, NULL, 'I' },
+		{ "prepared-statements", no_argument, NULL, 'Z' },
+		{ "copy-inserts", no_argument, NULL, 'Q' },
+		{ "pipeline", no_argument, NULL, 'K' },
+		{ "apply-jobs", required_argument, NULL, 'w' },
+		{ "group-commit", required_argument, NULL, 'g' },
 		{ "version", no_argument, NULL, 'V' },
 		{ "verbose", no_argument, NULL, 'v' },
 		{ "notice", no_argument, NULL, 'v' },
@@ -224,6 +244,10 @@ cli_stream_getopts(int argc, char **argv)
 
 	optind = 0;
 
+	/* install default values */
+	options.applyJobs = DEFAULT_APPLY_JOBS;
+	options.groupCommit = DEFAULT_GROUP_COMMIT;
+
 	/* read values from the environment */
 	if (!cli_copydb_getenv(&options))
 	{
@@ -231,7 +255,7 @@ cli_stream_getopts(int argc, char **argv)
 		exit(EXIT_CODE_BAD_ARGS);
 	}
 
-	while ((c = getopt_long(argc, argv, "S:T:j:p:s:o:t:PVvdzqh",
+	while ((c = getopt_long(argc, argv, "S:T:j:p:s:o:t:w:g:PVvdzqh",
 							long_options, &option_index)) != -1)
 	{
 		switch (c)
@@ -343,6 +367,55 @@ cli_stream_getopts(int argc, char **argv)
 				break;
 			}
 
+			case 'Z':
+			{
+				options.preparedStatements = true;
+				log_trace("--prepared-statements");
+				break;
+			}
+
+			case 'Q':
+			{
+				options.copyInserts = true;
+				log_trace("--copy-inserts");
+				break;
+			}
+
+			case 'K':
+			{
+				options.pipeline = true;
+				log_trace("--pipeline");
+				break;
+			}
+
+			case 'g':
+			{
+				if (!stringToInt(optarg, &options.groupCommit) ||
+					options.groupCommit < 1 ||
+					options.groupCommit > 10000)
+				{
+					log_fatal("Failed to parse --group-commit count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--group-commit %d", options.groupCommit);
+				break;
+			}
+
+			case 'w':
+			{
+				if (!stringToInt(optarg, &options.applyJobs) ||
+					options.applyJobs < 1 ||
+					options.applyJobs > 128)
+				{
+					log_fatal("Failed to parse --apply-jobs count: \"%s\"",
+							  optarg);
+					++errors;
+				}
+				log_trace("--apply-jobs %d", options.applyJobs);
+				break;
+			}
+
 			case 'I':
 			{
 				options.stdIn = true;
@@ -557,7 +630,12 @@ cli_stream_setup(int argc, char **argv)
 						   STREAM_MODE_CATCHUP,
 						   streamDBoptions.stdIn,
 						   streamDBoptions.stdOut,
-						   logSQL))
+						   logSQL,
+						   streamDBoptions.preparedStatements,
+						   streamDBoptions.copyInserts,
+						   streamDBoptions.pipeline,
+						   streamDBoptions.applyJobs,
+						   streamDBoptions.groupCommit))
 	{
 		/* errors have already been logged */
 		exit(EXIT_CODE_INTERNAL_ERROR);
@@ -669,7 +747,12 @@ cli_stream_catchup(int argc, char **argv)
 						   STREAM_MODE_CATCHUP,
 						   streamDBoptions.stdIn,
 						   streamDBoptions.stdOut,
-						   logSQL))
+						   logSQL,
+						   streamDBoptions.preparedStatements,
+						   streamDBoptions.copyInserts,
+						   streamDBoptions.pipeline,
+						   streamDBoptions.applyJobs,
+						   streamDBoptions.groupCommit))
 	{
 		/* errors have already been logged */
 		exit(EXIT_CODE_INTERNAL_ERROR);
@@ -752,7 +835,12 @@ cli_stream_replay(int argc, char **argv)
 						   STREAM_MODE_REPLAY,
 						   true,  /* stdin */
 						   true, /* stdout */
-						   logSQL))
+						   logSQL,
+						   streamDBoptions.preparedStatements,
+						   streamDBoptions.copyInserts,
+						   streamDBoptions.pipeline,
+						   streamDBoptions.applyJobs,
+						   streamDBoptions.groupCommit))
 	{
 		/* errors have already been logged */
 		exit(EXIT_CODE_INTERNAL_ERROR);
@@ -877,7 +965,12 @@ cli_stream_transform(int argc, char **argv)
 						   STREAM_MODE_CATCHUP,
 						   streamDBoptions.stdIn,
 						   streamDBoptions.stdOut,
-						   logSQL))
+						   logSQL,
+						   streamDBoptions.preparedStatements,
+						   streamDBoptions.copyInserts,
+						   streamDBoptions.pipeline,
+						   streamDBoptions.applyJobs,
+						   streamDBoptions.groupCommit))
 	{
 		/* errors have already been logged */
 		exit(EXIT_CODE_INTERNAL_ERROR);
@@ -1012,7 +1105,12 @@ cli_stream_apply(int argc, char **argv)
 							   STREAM_MODE_CATCHUP,
 							   true, /* streamDBoptions.stdIn */
 							   false, /* streamDBoptions.stdOut */
-							   logSQL))
+							   logSQL,
+							   streamDBoptions.preparedStatements,
+							   streamDBoptions.copyInserts,
+							   streamDBoptions.pipeline,
+							   streamDBoptions.applyJobs,
+							   streamDBoptions.groupCommit))
 		{
 			/* errors have already been logged */
 			exit(EXIT_CODE_INTERNAL_ERROR);
@@ -1032,6 +1130,9 @@ cli_stream_apply(int argc, char **argv)
 		StreamApplyContext context = { 0 };
 
 		strlcpy(context.sqlFileName, sqlfilename, sizeof(context.sqlFileName));
+		context.pipeline.enabled = streamDBoptions.pipeline;
+		context.jobs.count = streamDBoptions.applyJobs;
+		context.group.maxTransactions = streamDBoptions.groupCommit;
 
 		if (!setupReplicationOrigin(&context,
 									&(copySpecs.cfPaths.cdc),
@@ -1111,7 +1212,12 @@ stream_start_in_mode(LogicalStreamMode mode)
 						   mode,
 						   streamDBoptions.stdIn,
 						   streamDBoptions.stdOut,
-						   logSQL))
+						   logSQL,
+						   streamDBoptions.preparedStatements,
+						   streamDBoptions.copyInserts,
+						   streamDBoptions.pipeline,
+						   streamDBoptions.applyJobs,
+						   streamDBoptions.groupCommit))
 	{
 		/* errors have already been logged */
 		exit(EXIT_CODE_INTERNAL_ERROR);
@@ -14,6 +14,7 @@
 #include "cli_common.h"
 #include "copydb.h"
 #include "env_utils.h"
+#include "journal.h"
 #include "lock_utils.h"
 #include "log.h"
 #include "parsing_utils.h"
@@ -183,6 +184,8 @@ copydb_init_workdir(CopyDataSpec *copySpecs,
 		cfPaths->rundir,
 		cfPaths->tbldir,
 		cfPaths->idxdir,
+		cfPaths->blobdir,
+		cfPaths->predatadir,
 		cfPaths->cdc.dir,
 		NULL
 	};
@@ -196,6 +199,20 @@ copydb_init_workdir(CopyDataSpec *copySpecs,
 		}
 	}
 
+	/*
+	 * When resuming operations, compact the progress journal left by the
+	 * previous run. Only the main service does that, because no other process
+	 * may append to the journal while it's being rewritten.
+	 */
+	if (service && serviceName == NULL && !removeDir)
+	{
+		if (!journal_compact())
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
 	return true;
 }
 
@@ -453,6 +470,18 @@ copydb_prepare_filepaths(CopyFilePaths *cfPaths,
 	sformat(cfPaths->rundir, MAXPGPATH, "%s/run", cfPaths->topdir);
 	sformat(cfPaths->tbldir, MAXPGPATH, "%s/run/tables", cfPaths->topdir);
 	sformat(cfPaths->idxdir, MAXPGPATH, "%s/run/indexes", cfPaths->topdir);
+	sformat(cfPaths->blobdir, MAXPGPATH, "%s/run/blobs", cfPaths->topdir);
+	sformat(cfPaths->predatadir, MAXPGPATH, "%s/run/pre-data",
+			cfPaths->topdir);
+	sformat(cfPaths->journalfile, MAXPGPATH, "%s/run/progress.journal",
+			cfPaths->topdir);
+
+	/* table and index done files are registered in the progress journal */
+	if (!journal_init(cfPaths->topdir, cfPaths->journalfile))
+	{
+		/* errors have already been logged */
+		return false;
+	}
 
 	/* prepare also the name of the schema file (JSON) */
 	sformat(cfPaths->schemafile, MAXPGPATH, "%s/schema.json", cfPaths->topdir);
@@ -651,6 +680,10 @@ copydb_init_specs(CopyDataSpec *specs,
 		.skipExtensions = options->skipExtensions,
 		.skipCollations = options->skipCollations,
 		.skipVacuum = options->skipVacuum,
+		.vacuumFreeze = options->vacuumFreeze,
+		.importStats = options->importStats,
+		.progressFiles = options->progressFiles,
+		.estimateTableSizes = options->estimateTableSizes,
 		.noRolesPasswords = options->noRolesPasswords,
 		.failFast = options->failFast,
 
@@ -661,8 +694,13 @@ copydb_init_specs(CopyDataSpec *specs,
 		.tableJobs = options->tableJobs,
 		.indexJobs = options->indexJobs,
 
-		/* at the moment we don't have --vacuumJobs separately */
-		.vacuumJobs = options->tableJobs,
+		/* --vacuum-jobs defaults to --table-jobs */
+		.vacuumJobs = options->vacuumJobs > 0
+					  ? options->vacuumJobs
+					  : options->tableJobs,
+		.blobJobs = options->blobJobs,
+		.restoreJobs = options->restoreJobs,
+		.dumpJobs = options->dumpJobs,
 
 		.splitTablesLargerThan = options->splitTablesLargerThan,
 
@@ -768,14 +806,19 @@ copydb_init_specs(CopyDataSpec *specs,
 		specs->skipLargeObjects = true;
 	}
 
+	/* --progress-files writes one done file per table and index again */
+	(void) journal_use_progress_files(specs->progressFiles);
+
 	return true;
 }
 
 
 /*
  * copydb_init_table_specs prepares a CopyTableDataSpec structure from its
- * pieces and also initialises files paths necessary for the orchestration of
- * the per-table processes and their summary files.
+ * pieces. The files paths necessary for the orchestration of the per-table
+ * processes and their summary files are computed on-demand with
+ * copydb_init_table_specs_paths, so that the tableSpecsArray remains small
+ * even when the source database has millions of tables.
  */
 bool
 copydb_init_table_specs(CopyTableDataSpec *tableSpecs,
@@ -808,10 +851,19 @@ copydb_init_table_specs(CopyTableDataSpec *tableSpecs,
 	*tableSpecs = tmpTableSpecs;
 
 	/* compute the table fully qualified name */
-	sformat(tableSpecs->qname, sizeof(tableSpecs->qname),
-			"\"%s\".\"%s\"",
-			tableSpecs->sourceTable->nspname,
-			tableSpecs->sourceTable->relname);
+	char qname[NAMEDATALEN * 2 + 5] = { 0 };
+
+	sformat(qname, sizeof(qname), "\"%s\".\"%s\"",
+			source->nspname,
+			source->relname);
+
+	tableSpecs->qname = string_arena_strdup(&(specs->strings), qname);
+
+	if (tableSpecs->qname == NULL)
+	{
+		/* errors have already been logged */
+		return false;
+	}
 
 	/* This CopyTableDataSpec might be for a partial COPY */
 	if (source->partsArray.count >= 1)
@@ -820,38 +872,11 @@ copydb_init_table_specs(CopyTableDataSpec *tableSpecs,
 			.partNumber = partNumber,
 			.partCount = source->partsArray.array[partNumber].partCount,
 			.min = source->partsArray.array[partNumber].min,
-			.max = source->partsArray.array[partNumber].max
+			.max = source->partsArray.array[partNumber].max,
+			.partKey = source->partKey
 		};
 
 		tableSpecs->part = part;
-
-		strlcpy(tableSpecs->part.partKey, source->partKey, NAMEDATALEN);
-
-		/* now compute the table-specific paths we are using in copydb */
-		if (!copydb_init_tablepaths_for_part(tableSpecs->cfPaths,
-											 &(tableSpecs->tablePaths),
-											 tableSpecs->sourceTable->oid,
-											 partNumber))
-		{
-			log_error("Failed to prepare pathnames for partition %d of table %s",
-					  partNumber,
-					  tableSpecs->qname);
-			return false;
-		}
-
-		/* used only by one process, the one finishing a partial COPY last */
-		sformat(tableSpecs->tablePaths.idxListFile, MAXPGPATH, "%s/%u.idx",
-				tableSpecs->cfPaths->tbldir,
-				source->oid);
-
-		/*
-		 * And now the truncateLockFile and truncateDoneFile, which are used to
-		 * provide a critical section to the same-table concurrent processes.
-		 */
-		sformat(tableSpecs->tablePaths.truncateDoneFile, MAXPGPATH,
-				"%s/%u.truncate",
-				tableSpecs->cfPaths->tbldir,
-				source->oid);
 	}
 	else
 	{
@@ -864,18 +889,59 @@ copydb_init_table_specs(CopyTableDataSpec *tableSpecs,
 					  source->partsArray.count);
 			return false;
 		}
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_init_table_specs_paths computes the table-specific paths we are using
+ * in copydb for the given CopyTableDataSpec, which might be for a partial
+ * COPY.
+ */
+bool
+copydb_init_table_specs_paths(CopyTableDataSpec *tableSpecs,
+							  TableFilePaths *tablePaths)
+{
+	CopyFilePaths *cfPaths = tableSpecs->cfPaths;
+	uint32_t oid = tableSpecs->sourceTable->oid;
 
-		/* now compute the table-specific paths we are using in copydb */
-		if (!copydb_init_tablepaths(tableSpecs->cfPaths,
-									&(tableSpecs->tablePaths),
-									tableSpecs->sourceTable->oid))
+	if (tableSpecs->part.partCount == 0)
+	{
+		if (!copydb_init_tablepaths(cfPaths, tablePaths, oid))
 		{
-			log_error("Failed to prepare pathnames for table %u",
-					  tableSpecs->sourceTable->oid);
+			log_error("Failed to prepare pathnames for table %u", oid);
 			return false;
 		}
+
+		return true;
 	}
 
+	int partNumber = tableSpecs->part.partNumber;
+
+	if (!copydb_init_tablepaths_for_part(cfPaths, tablePaths, oid, partNumber))
+	{
+		log_error("Failed to prepare pathnames for partition %d of table %s",
+				  partNumber,
+				  tableSpecs->qname);
+		return false;
+	}
+
+	/* used only by one process, the one finishing a partial COPY last */
+	sformat(tablePaths->idxListFile, MAXPGPATH, "%s/%u.idx",
+			cfPaths->tbldir,
+			oid);
+
+	/*
+	 * And now the truncateLockFile and truncateDoneFile, which are used to
+	 * provide a critical section to the same-table concurrent processes.
+	 */
+	sformat(tablePaths->truncateDoneFile, MAXPGPATH,
+			"%s/%u.truncate",
+			cfPaths->tbldir,
+			oid);
+
 	return true;
 }
 
@@ -14,6 +14,7 @@
 #include "pgcmd.h"
 #include "pgsql.h"
 #include "schema.h"
+#include "string_utils.h"
 #include "summary.h"
 
 
@@ -115,7 +116,7 @@ typedef struct CopyTableDataPartSpec
 	int64_t min;                /* WHERE partKey >= min */
 	int64_t max;                /*   AND partKey  < max */
 
-	char partKey[NAMEDATALEN];
+	char *partKey;              /* points to the SourceTable partKey */
 } CopyTableDataPartSpec;
 
 
@@ -130,7 +131,7 @@ typedef struct CopyTableDataSpec
 	CopyDataSection section;
 	bool resume;
 
-	char qname[NAMEDATALEN * 2 + 1];
+	char *qname;                /* allocated in the specs string arena */
 	SourceTable *sourceTable;
 	CopyTableSummary *summary;
 	SourceIndexArray *indexArray;
@@ -140,9 +141,6 @@ typedef struct CopyTableDataSpec
 	Semaphore *indexSemaphore;  /* pointer to the main specs semaphore */
 	Semaphore *truncateSemaphore;
 
-	TableFilePaths tablePaths;
-	IndexFilePathsArray indexPathsArray;
-
 	/* same-table concurrency with COPY WHERE clause partitioning */
 	CopyTableDataPartSpec part;
 } CopyTableDataSpec;
@@ -205,6 +203,46 @@ typedef struct SourceFilterItem
 } SourceFilterItem;
 
 
+/*
+ * DoneObjectOid is a hash table entry for an index or a constraint that has
+ * already been processed, as found in the indexes work directory.
+ */
+typedef struct DoneObjectOid
+{
+	uint32_t oid;
+
+	UT_hash_handle hh;          /* makes this structure hashable */
+} DoneObjectOid;
+
+
+/*
+ * CatalogCache tracks the catalog information that is saved in the schema.json
+ * file, so that another pgcopydb command, or the same command when resuming
+ * operations, may use it instead of running the catalog queries again.
+ *
+ * The cache is only valid for the same source system identifier, the same
+ * snapshot, and the same filtering setup and options.
+ */
+typedef struct CatalogCache
+{
+	bool enabled;
+	char systemIdentifier[NAMEDATALEN];
+	char filtersHash[NAMEDATALEN];
+
+	/* catalog information found in the specs, fetched or loaded */
+	bool tables;
+	bool indexes;
+	bool sequences;
+	bool filtered;
+
+	/* catalog information loaded from the cache */
+	bool cachedTables;
+	bool cachedIndexes;
+	bool cachedSequences;
+	bool cachedFiltered;
+} CatalogCache;
+
+
 /* all that's needed to start a TABLE DATA copy for a whole database, or a subset of schemas */
 typedef struct CopyDataSpec
 {
@@ -228,6 +266,10 @@ typedef struct CopyDataSpec
 	bool skipExtensions;
 	bool skipCollations;
 	bool skipVacuum;
+	bool vacuumFreeze;
+	bool importStats;
+	bool progressFiles;
+	bool estimateTableSizes;
 	bool noRolesPasswords;
 
 	bool restart;
@@ -240,6 +282,9 @@ typedef struct CopyDataSpec
 	int tableJobs;
 	int indexJobs;
 	int vacuumJobs;
+	int blobJobs;
+	int restoreJobs;
+	int dumpJobs;
 
 	uint64_t splitTablesLargerThan;
 	char splitTablesLargerThanPretty[NAMEDATALEN];
@@ -265,9 +310,58 @@ typedef struct CopyDataSpec
 
 	SourceTable *sourceTableHashByOid;
 	SourceIndex *sourceIndexHashByOid;
+
+	CatalogCache catalogCache;
+
+	/* per-table strings of the tableSpecsArray */
+	StringArena strings;
 } CopyDataSpec;
 
 
+/* context used when writing the pg_restore list file */
+typedef struct RestoreListContext
+{
+	CopyDataSpec *specs;
+	DoneObjectOid *doneSet;
+	FILE *listFile;
+} RestoreListContext;
+
+
+/*
+ * RestoreWaveItem is a hash table entry for an archive object of the pre-data
+ * section, as found in the pre-data --use-list file. Objects are restored in
+ * waves, where each object belongs to the wave that follows the waves of all
+ * its dependencies.
+ *
+ * Objects that depend on the same relation, such as the partitions of a given
+ * table, are grouped together and restored by the same worker, so that
+ * concurrent transactions do not compete for the same locks.
+ */
+typedef struct RestoreWaveItem
+{
+	int dumpId;
+	uint32_t catalogOid;
+	uint32_t objectOid;
+
+	bool isRelation;
+	int wave;                       /* -1 until dependencies are known */
+	struct RestoreWaveItem *group;  /* union-find parent, self when root */
+
+	UT_hash_handle hh;              /* makes this structure hashable */
+} RestoreWaveItem;
+
+
+/* context used when computing the pre-data restore waves */
+typedef struct RestoreWaveContext
+{
+	CopyDataSpec *specs;
+	RestoreWaveItem *items;
+	int count;
+	int waveCount;
+	bool sorted;
+} RestoreWaveContext;
+
+
 /* specify section of a dump: pre-data, post-data, data, schema */
 typedef enum
 {
@@ -316,6 +410,9 @@ bool copydb_init_table_specs(CopyTableDataSpec *tableSpecs,
 							 SourceTable *source,
 							 int partNumber);
 
+bool copydb_init_table_specs_paths(CopyTableDataSpec *tableSpecs,
+								   TableFilePaths *tablePaths);
+
 bool copydb_init_tablepaths(CopyFilePaths *cfPaths,
 							TableFilePaths *tablePaths,
 							uint32_t oid);
@@ -416,6 +513,10 @@ bool copydb_prepare_create_index_command(SourceIndex *index,
 										 bool ifNotExists,
 										 char **command);
 
+bool copydb_check_target_index(PGSQL *dst,
+							   SourceIndex *index,
+							   bool *buildIndex);
+
 bool copydb_prepare_create_constraint_command(SourceIndex *index,
 											  char **command);
 
@@ -427,31 +528,108 @@ bool copydb_target_prepare_namespaces(CopyDataSpec *specs);
 bool copydb_dump_source_schema(CopyDataSpec *specs,
 							   const char *snapshot,
 							   PostgresDumpSection section);
+bool copydb_dump_source_section(CopyDataSpec *specs,
+								const char *snapshot,
+								PostgresDumpSection section);
 bool copydb_target_prepare_schema(CopyDataSpec *specs);
 bool copydb_target_drop_tables(CopyDataSpec *specs);
 bool copydb_target_finalize_schema(CopyDataSpec *specs);
 
-bool copydb_objectid_has_been_processed_already(CopyDataSpec *specs,
+bool copydb_read_done_objectids(CopyDataSpec *specs, DoneObjectOid **doneSet);
+void copydb_free_done_objectids(DoneObjectOid **doneSet);
+
+bool copydb_objectid_has_been_processed_already(DoneObjectOid *doneSet,
 												uint32_t oid);
 
 bool copydb_write_restore_list(CopyDataSpec *specs, PostgresDumpSection section);
+bool copydb_write_restore_list_item(void *ctx, ArchiveContentItem *item);
+
+bool copydb_target_restore_pre_data_waves(CopyDataSpec *specs);
+bool copydb_prepare_restore_waves(CopyDataSpec *specs,
+								  RestoreWaveContext *context);
+bool copydb_restore_wave_item(void *ctx,
+							  ArchiveContentItem *item,
+							  int depCount,
+							  int *dependencies);
+bool copydb_write_restore_wave_lists(CopyDataSpec *specs,
+									 RestoreWaveContext *context,
+									 int wave,
+									 int *counts);
+bool copydb_restore_wave(CopyDataSpec *specs, int wave, int *counts);
+void copydb_free_restore_waves(RestoreWaveContext *context);
 
 /* sequences.c */
+#define SEQUENCE_BATCH_SIZE 1000
+
 bool copydb_copy_all_sequences(CopyDataSpec *specs);
 bool copydb_start_seq_process(CopyDataSpec *specs);
 bool copydb_prepare_sequence_specs(CopyDataSpec *specs, PGSQL *pgsql);
 
+bool copydb_fetch_sequence_values(PGSQL *pgsql,
+								  SourceSequence **batch,
+								  int count,
+								  int *errors);
+
+bool copydb_set_sequence_values(CopyDataSpec *specs,
+								PGSQL *dst,
+								SourceSequence *batch,
+								int count,
+								int *errors);
+
 /* copydb_schema.c */
 bool copydb_fetch_schema_and_prepare_specs(CopyDataSpec *specs);
 bool copydb_objectid_is_filtered_out(CopyDataSpec *specs,
 									 uint32_t oid,
 									 char *restoreListName);
 
+#define TABLE_SIZE_PARALLEL_MIN_RELATIONS 1000
+
+bool copydb_prepare_table_size(CopyDataSpec *specs,
+							   PGSQL *src,
+							   bool *createdTableSizeTable);
+
+bool copydb_table_size_with_workers(CopyDataSpec *specs,
+									TableSizeArray *sizeArray);
+
+bool copydb_table_size_worker(CopyDataSpec *specs,
+							  TableSizeArray *sizeArray,
+							  int n);
+
+bool copydb_schema_worker_open_source(CopyDataSpec *specs,
+									  PGSQL *pgsql,
+									  PGSQL **src);
+
+bool copydb_schema_worker_close_source(CopyDataSpec *specs, PGSQL *src);
+
+void copydb_table_size_range(TableSizeArray *sizeArray,
+							 int jobs,
+							 int n,
+							 TableSizeArray *range);
+
+bool copydb_read_table_size_file(CopyDataSpec *specs,
+								 TableSizeArray *range,
+								 int n);
+
 bool copydb_prepare_table_specs(CopyDataSpec *specs, PGSQL *pgsql);
+
+bool copydb_prepare_table_parts(CopyDataSpec *specs,
+								PGSQL *pgsql,
+								SourceTable **tables,
+								int count);
+
+bool copydb_table_parts_worker(CopyDataSpec *specs,
+							   SourceTable **tables,
+							   int count,
+							   int jobs,
+							   int n);
+
+bool copydb_read_table_parts_file(CopyDataSpec *specs, int n);
 bool copydb_prepare_index_specs(CopyDataSpec *specs, PGSQL *pgsql);
 bool copydb_fetch_filtered_oids(CopyDataSpec *specs, PGSQL *pgsql);
+bool copydb_prepare_catalog_cache(CopyDataSpec *specs, PGSQL *pgsql);
 
 char * copydb_ObjectKindToString(ObjectKind kind);
+ObjectKind copydb_ObjectKindFromString(const char *kind);
 
 /* table-data.c */
 bool copydb_copy_all_table_data(CopyDataSpec *specs);
@@ -481,13 +659,45 @@ bool copydb_prepare_copy_query(CopyTableDataSpec *tableSpecs,
 							   bool source);
 
 /* blobs.c */
+#define BLOB_RANGES_PER_JOB 4
+
 bool copydb_start_blob_process(CopyDataSpec *specs);
 bool copydb_copy_blobs(CopyDataSpec *specs);
+bool copydb_copy_blobs_with_workers(CopyDataSpec *specs, uint32_t *count);
+bool copydb_blob_worker(CopyDataSpec *specs,
+						BlobRangeArray *rangeArray,
+						int worker);
+bool copydb_prepare_blob_ranges(CopyDataSpec *specs,
+								BlobRangeArray *rangeArray);
+bool copydb_read_blob_ranges(const char *filename, BlobRangeArray *rangeArray);
+bool copydb_copy_blobs_range(CopyDataSpec *specs,
+							 BlobRange *range,
+							 uint32_t *count);
+bool copydb_blobs_open_source(CopyDataSpec *specs,
+							  bool reuseSnapshot,
+							  PGSQL *pgsql,
+							  PGSQL **src);
+bool copydb_blobs_close_source(CopyDataSpec *specs,
+							   bool reuseSnapshot,
+							   PGSQL *src);
 
 /* vacuum.c */
+#define VACUUM_QUEUE_BATCH_SIZE 64
+
 bool vacuum_start_workers(CopyDataSpec *specs);
 bool vacuum_worker(CopyDataSpec *specs);
+bool vacuum_receive_largest(CopyDataSpec *specs, QMessage *mesg);
 bool vacuum_analyze_table_by_oid(CopyDataSpec *specs, uint32_t oid);
+bool vacuum_prepare_command(CopyDataSpec *specs,
+							PGSQL *dst,
+							SourceTable *table,
+							bool analyze,
+							char *command,
+							size_t size);
+bool vacuum_import_table_stats(CopyDataSpec *specs,
+							   PGSQL *dst,
+							   SourceTable *table,
+							   bool *analyze);
 bool vacuum_add_table(CopyDataSpec *specs, uint32_t oid);
 bool vacuum_send_stop(CopyDataSpec *specs);
 
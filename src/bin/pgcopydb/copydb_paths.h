@@ -68,6 +68,9 @@ typedef struct CopyFilePaths
 	char rundir[MAXPGPATH];           /* /tmp/pgcopydb/run */
 	char tbldir[MAXPGPATH];           /* /tmp/pgcopydb/run/tables */
 	char idxdir[MAXPGPATH];           /* /tmp/pgcopydb/run/indexes */
+	char blobdir[MAXPGPATH];          /* /tmp/pgcopydb/run/blobs */
+	char predatadir[MAXPGPATH];       /* /tmp/pgcopydb/run/pre-data */
+	char journalfile[MAXPGPATH];      /* /tmp/pgcopydb/run/progress.journal */
 
 	CDCPaths cdc;
 	CopyDoneFilePaths done;
@@ -14,6 +14,7 @@
 #include "lock_utils.h"
 #include "log.h"
 #include "pidfile.h"
+#include "progress.h"
 #include "schema.h"
 #include "signals.h"
 #include "string_utils.h"
@@ -139,11 +140,32 @@ copydb_fetch_schema_and_prepare_specs(CopyDataSpec *specs)
 		log_info("Fetched information for %d collations", collationArray->count);
 	}
 
+	bool needTables =
+		specs->section == DATA_SECTION_ALL ||
+		specs->section == DATA_SECTION_TABLE_DATA;
+
+	bool needIndexes =
+		specs->section == DATA_SECTION_ALL ||
+		specs->section == DATA_SECTION_INDEXES ||
+		specs->section == DATA_SECTION_CONSTRAINTS;
+
+	bool needSequences =
+		specs->section == DATA_SECTION_ALL ||
+		specs->section == DATA_SECTION_SET_SEQUENCES;
+
+	/* use the catalog information from a previous run when possible */
+	if (!copydb_prepare_catalog_cache(specs, src))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	CatalogCache *cache = &(specs->catalogCache);
+
 	/* now fetch the list of tables from the source database */
 	bool createdTableSizeTable = false;
 
-	if (specs->section == DATA_SECTION_ALL ||
-		specs->section == DATA_SECTION_TABLE_DATA)
+	if (needTables)
 	{
 		/*
 		 * First, if it doesn't exist yet, create the pgcopydb.table_size
@@ -152,13 +174,12 @@ copydb_fetch_schema_and_prepare_specs(CopyDataSpec *specs)
 		 *
 		 * In order to allow for users to prepare that table in advance, we do
 		 * not use a TEMP table here.
+		 *
+		 * When the tables are found in the catalog cache, their size and COPY
+		 * partitions have already been computed.
 		 */
-		if (!schema_prepare_pgcopydb_table_size(src,
-												&(specs->filters),
-												specs->hasDBCreatePrivilege,
-												false, /* cache */
-												false, /* dropCache */
-												&createdTableSizeTable))
+		if (!cache->cachedTables &&
+			!copydb_prepare_table_size(specs, src, &createdTableSizeTable))
 		{
 			/* errors have already been logged */
 			return false;
@@ -172,9 +193,7 @@ copydb_fetch_schema_and_prepare_specs(CopyDataSpec *specs)
 	}
 
 	/* fetch the list of all the indexes that are going to be created again */
-	if (specs->section == DATA_SECTION_ALL ||
-		specs->section == DATA_SECTION_INDEXES ||
-		specs->section == DATA_SECTION_CONSTRAINTS)
+	if (needIndexes)
 	{
 		if (!copydb_prepare_index_specs(specs, src))
 		{
@@ -183,8 +202,7 @@ copydb_fetch_schema_and_prepare_specs(CopyDataSpec *specs)
 		}
 	}
 
-	if (specs->section == DATA_SECTION_ALL ||
-		specs->section == DATA_SECTION_SET_SEQUENCES)
+	if (needSequences && !cache->cachedSequences)
 	{
 		if (!copydb_prepare_sequence_specs(specs, src))
 		{
@@ -194,12 +212,33 @@ copydb_fetch_schema_and_prepare_specs(CopyDataSpec *specs)
 	}
 
 	/* prepare the Oids of objects that are filtered out */
-	if (!copydb_fetch_filtered_oids(specs, src))
+	if (!cache->cachedFiltered && !copydb_fetch_filtered_oids(specs, src))
 	{
 		/* errors have already been logged */
 		return false;
 	}
 
+	/* update the catalog cache with what we had to fetch */
+	if (cache->enabled)
+	{
+		bool fetched =
+			(needTables && !cache->cachedTables) ||
+			(needIndexes && !cache->cachedIndexes) ||
+			(needSequences && !cache->cachedSequences) ||
+			!cache->cachedFiltered;
+
+		cache->tables = cache->tables || needTables;
+		cache->indexes = cache->indexes || needIndexes;
+		cache->sequences = cache->sequences || needSequences;
+		cache->filtered = true;
+
+		if (fetched && !copydb_prepare_schema_json_file(specs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
 	if (createdTableSizeTable)
 	{
 		if (!schema_drop_pgcopydb_table_size(src))
@@ -223,6 +262,408 @@ copydb_fetch_schema_and_prepare_specs(CopyDataSpec *specs)
 }
 
 
+/*
+ * copydb_prepare_table_size prepares the pgcopydb_table_size table that is
+ * used to decide which tables are split with --split-tables-larger-than, and
+ * to order the tables to COPY by size.
+ *
+ * Computing pg_table_size() for every relation is slow when the source
+ * database has a lot of relations, because it needs to stat() every file of
+ * each relation. With --estimate-table-sizes we compute the size from
+ * relpages instead, and only compute the exact size of the tables that are
+ * near the --split-tables-larger-than threshold, or estimated to be empty.
+ * When using --table-jobs with a large enough number of relations, those
+ * exact sizes are computed by several processes, each with its own
+ * connection using the same snapshot.
+ */
+bool
+copydb_prepare_table_size(CopyDataSpec *specs,
+						  PGSQL *src,
+						  bool *createdTableSizeTable)
+{
+	bool estimate = specs->estimateTableSizes;
+	bool computedTableSize = false;
+
+	if (!schema_prepare_pgcopydb_table_size(src,
+											&(specs->filters),
+											specs->hasDBCreatePrivilege,
+											false, /* cache */
+											false, /* dropCache */
+											estimate,
+											createdTableSizeTable,
+											&computedTableSize))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* when re-using a pgcopydb.pgcopydb_table_size table, we're done */
+	if (!estimate || !computedTableSize)
+	{
+		return true;
+	}
+
+	/*
+	 * Now refine the estimates near the --split-tables-larger-than threshold,
+	 * and the estimates that can't be trusted.
+	 */
+	uint64_t lowBytes = 1;
+	uint64_t highBytes = 0;
+
+	if (specs->splitTablesLargerThan > 0)
+	{
+		lowBytes = specs->splitTablesLargerThan / 2;
+		highBytes = specs->splitTablesLargerThan * 2;
+	}
+
+	TableSizeArray sizeArray = { 0 };
+
+	if (!schema_list_table_size_estimates(src,
+										  lowBytes,
+										  highBytes,
+										  &sizeArray))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	log_info("Computing table size for %d relations", sizeArray.count);
+
+	bool success = true;
+
+	if (specs->tableJobs > 1 &&
+		sizeArray.count >= TABLE_SIZE_PARALLEL_MIN_RELATIONS)
+	{
+		success = copydb_table_size_with_workers(specs, &sizeArray);
+	}
+	else
+	{
+		success = schema_get_table_sizes(src, &sizeArray);
+	}
+
+	success = success && schema_set_table_sizes(src, &sizeArray);
+
+	free(sizeArray.oids);
+	free(sizeArray.bytes);
+
+	return success;
+}
+
+
+/*
+ * copydb_table_size_with_workers computes pg_table_size() for the given
+ * relations using --table-jobs sub-processes, each of them processing a
+ * contiguous range of the given array. Sub-processes write their results in
+ * a file, which we then read to fill-in the sizeArray bytes.
+ */
+bool
+copydb_table_size_with_workers(CopyDataSpec *specs, TableSizeArray *sizeArray)
+{
+	int jobs = specs->tableJobs;
+
+	for (int i = 0; i < jobs; i++)
+	{
+		/*
+		 * Flush stdio channels just before fork, to avoid double-output
+		 * problems.
+		 */
+		fflush(stdout);
+		fflush(stderr);
+
+		int fpid = fork();
+
+		switch (fpid)
+		{
+			case -1:
+			{
+				log_error("Failed to fork a worker process: %m");
+				return false;
+			}
+
+			case 0:
+			{
+				/* child process runs the command */
+				if (!copydb_table_size_worker(specs, sizeArray, i))
+				{
+					/* errors have already been logged */
+					exit(EXIT_CODE_INTERNAL_ERROR);
+				}
+
+				exit(EXIT_CODE_QUIT);
+			}
+
+			default:
+			{
+				/* fork succeeded, in parent */
+				break;
+			}
+		}
+	}
+
+	if (!copydb_wait_for_subprocesses(specs->failFast))
+	{
+		log_error("Some table size worker processes have exited with "
+				  "error status, see above for details");
+		return false;
+	}
+
+	for (int i = 0; i < jobs; i++)
+	{
+		TableSizeArray range = { 0 };
+
+		copydb_table_size_range(sizeArray, jobs, i, &range);
+
+		if (!copydb_read_table_size_file(specs, &range, i))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_table_size_worker computes pg_table_size() for its range of the
+ * given relations, and writes the results to its table size file.
+ */
+bool
+copydb_table_size_worker(CopyDataSpec *specs, TableSizeArray *sizeArray, int n)
+{
+	TableSizeArray range = { 0 };
+
+	copydb_table_size_range(sizeArray, specs->tableJobs, n, &range);
+
+	log_notice("Started table size worker %d [%d] for %d relations",
+			   getpid(),
+			   getppid(),
+			   range.count);
+
+	if (range.count == 0)
+	{
+		return true;
+	}
+
+	PGSQL pgsql = { 0 };
+	PGSQL *src = NULL;
+
+	if (!copydb_schema_worker_open_source(specs, &pgsql, &src))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	bool success = schema_get_table_sizes(src, &range);
+
+	success = copydb_schema_worker_close_source(specs, src) && success;
+
+	if (!success)
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	PQExpBuffer contents = createPQExpBuffer();
+
+	for (int i = 0; i < range.count; i++)
+	{
+		appendPQExpBuffer(contents, "%u %lld\n",
+						  range.oids[i],
+						  (long long) range.bytes[i]);
+	}
+
+	char filename[MAXPGPATH] = { 0 };
+
+	sformat(filename, sizeof(filename), "%s/table-size.%d",
+			specs->cfPaths.rundir,
+			n);
+
+	if (PQExpBufferBroken(contents) ||
+		!write_file(contents->data, contents->len, filename))
+	{
+		log_error("Failed to write table size file \"%s\"", filename);
+		destroyPQExpBuffer(contents);
+		return false;
+	}
+
+	destroyPQExpBuffer(contents);
+
+	return true;
+}
+
+
+/*
+ * copydb_schema_worker_open_source opens a connection to the source database
+ * from a sub-process, using the same snapshot as the main process unless
+ * --not-consistent is in use.
+ */
+bool
+copydb_schema_worker_open_source(CopyDataSpec *specs, PGSQL *pgsql, PGSQL **src)
+{
+	if (specs->consistent)
+	{
+		TransactionSnapshot snapshot = { 0 };
+
+		if (!copydb_copy_snapshot(specs, &snapshot))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		/* swap the new instance in place of the previous one */
+		specs->sourceSnapshot = snapshot;
+
+		if (!copydb_set_snapshot(specs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		*src = &(specs->sourceSnapshot.pgsql);
+	}
+	else
+	{
+		if (!pgsql_init(pgsql, specs->source_pguri, PGSQL_CONN_SOURCE))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		*src = pgsql;
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_schema_worker_close_source closes the connection opened with
+ * copydb_schema_worker_open_source.
+ */
+bool
+copydb_schema_worker_close_source(CopyDataSpec *specs, PGSQL *src)
+{
+	if (specs->consistent)
+	{
+		return copydb_close_snapshot(specs);
+	}
+
+	pgsql_finish(src);
+
+	return true;
+}
+
+
+/*
+ * copydb_table_size_range sets the given range to point to the part of the
+ * given sizeArray that worker n processes, out of jobs workers.
+ */
+void
+copydb_table_size_range(TableSizeArray *sizeArray,
+						int jobs,
+						int n,
+						TableSizeArray *range)
+{
+	int perJob = sizeArray->count / jobs;
+	int first = n * perJob;
+	int count = n == (jobs - 1) ? sizeArray->count - first : perJob;
+
+	range->count = count;
+	range->oids = sizeArray->oids + first;
+	range->bytes = sizeArray->bytes + first;
+}
+
+
+/*
+ * copydb_read_table_size_file reads the table size file written by worker n,
+ * and fills-in the bytes of the given range. The file is removed afterwards.
+ */
+bool
+copydb_read_table_size_file(CopyDataSpec *specs, TableSizeArray *range, int n)
+{
+	if (range->count == 0)
+	{
+		return true;
+	}
+
+	char filename[MAXPGPATH] = { 0 };
+
+	sformat(filename, sizeof(filename), "%s/table-size.%d",
+			specs->cfPaths.rundir,
+			n);
+
+	char *contents = NULL;
+	long size = 0L;
+
+	if (!read_file(filename, &contents, &size))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	char **lines = (char **) calloc(range->count + 1, sizeof(char *));
+
+	if (lines == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		free(contents);
+		return false;
+	}
+
+	int lineCount = splitLines(contents, lines, range->count + 1);
+
+	if (lineCount != range->count)
+	{
+		log_error("Failed to parse table size file \"%s\": "
+				  "found %d lines, expected %d",
+				  filename,
+				  lineCount,
+				  range->count);
+		free(lines);
+		free(contents);
+		return false;
+	}
+
+	int errors = 0;
+
+	for (int i = 0; i < lineCount; i++)
+	{
+		uint32_t oid = 0;
+		char *sep = strchr(lines[i], ' ');
+
+		if (sep == NULL)
+		{
+			log_error("Failed to parse table size line \"%s\"", lines[i]);
+			++errors;
+			continue;
+		}
+
+		*sep = '\0';
+
+		if (!stringToUInt32(lines[i], &oid) ||
+			oid != range->oids[i] ||
+			!stringToInt64(sep + 1, &(range->bytes[i])))
+		{
+			log_error("Failed to parse table size for OID \"%s\"", lines[i]);
+			++errors;
+		}
+	}
+
+	free(lines);
+	free(contents);
+
+	if (errors > 0)
+	{
+		return false;
+	}
+
+	(void) unlink_file(filename);
+
+	return true;
+}
+
+
 /*
  * copydb_prepare_table_specs fetches the list of tables to COPY data from the
  * source and into the target, and initialises our internal
@@ -233,11 +674,14 @@ copydb_prepare_table_specs(CopyDataSpec *specs, PGSQL *pgsql)
 {
 	SourceTableArray *tableArray = &(specs->sourceTableArray);
 	CopyTableDataSpecsArray *tableSpecsArray = &(specs->tableSpecsArray);
+	bool cached = specs->catalogCache.cachedTables;
 
 	/*
-	 * Now get the list of the tables we want to COPY over.
+	 * Now get the list of the tables we want to COPY over, unless we already
+	 * have it from the catalog cache.
 	 */
-	if (!schema_list_ordinary_tables(pgsql,
+	if (!cached &&
+		!schema_list_ordinary_tables(pgsql,
 									 &(specs->filters),
 									 tableArray))
 	{
@@ -256,10 +700,17 @@ copydb_prepare_table_specs(CopyDataSpec *specs, PGSQL *pgsql)
 	/* prepare a SourceTable hash table, indexed by Oid */
 	SourceTable *sourceTableHashByOid = NULL;
 
-	/*
-	 * Source table might be split in several concurrent COPY processes. In
-	 * that case we produce a CopyDataSpec entry for each COPY partition.
-	 */
+	/* prepare the list of tables to split in several COPY processes */
+	int splitCount = 0;
+	SourceTable **splitTables =
+		(SourceTable **) calloc(tableArray->count + 1, sizeof(SourceTable *));
+
+	if (splitTables == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
 	for (int tableIndex = 0; tableIndex < tableArray->count; tableIndex++)
 	{
 		SourceTable *source = &(tableArray->array[tableIndex]);
@@ -285,18 +736,38 @@ copydb_prepare_table_specs(CopyDataSpec *specs, PGSQL *pgsql)
 						 source->nspname,
 						 source->relname);
 
-				++copySpecsCount;
 				continue;
 			}
 
-			if (!schema_list_partitions(pgsql,
-										source,
-										specs->splitTablesLargerThan))
-			{
-				/* errors have already been logged */
-				return false;
-			}
+			splitTables[splitCount++] = source;
+		}
+	}
+
+	/* now attach the final hash table head to the specs */
+	specs->sourceTableHashByOid = sourceTableHashByOid;
 
+	/* compute the COPY partitions, possibly using sub-processes */
+	if (!cached &&
+		!copydb_prepare_table_parts(specs, pgsql, splitTables, splitCount))
+	{
+		/* errors have already been logged */
+		free(splitTables);
+		return false;
+	}
+
+	free(splitTables);
+
+	/*
+	 * Source table might be split in several concurrent COPY processes. In
+	 * that case we produce a CopyDataSpec entry for each COPY partition.
+	 */
+	for (int tableIndex = 0; tableIndex < tableArray->count; tableIndex++)
+	{
+		SourceTable *source = &(tableArray->array[tableIndex]);
+
+		if (specs->splitTablesLargerThan > 0 &&
+			specs->splitTablesLargerThan <= source->bytes)
+		{
 			if (source->partsArray.count > 1)
 			{
 				log_info("Table \"%s\".\"%s\" is %s large, "
@@ -320,9 +791,6 @@ copydb_prepare_table_specs(CopyDataSpec *specs, PGSQL *pgsql)
 		}
 	}
 
-	/* now attach the final hash table head to the specs */
-	specs->sourceTableHashByOid = sourceTableHashByOid;
-
 	/* only use as many processes as required */
 	if (copySpecsCount < specs->tableJobs)
 	{
@@ -402,6 +870,305 @@ copydb_prepare_table_specs(CopyDataSpec *specs, PGSQL *pgsql)
 }
 
 
+/*
+ * copydb_prepare_table_parts computes the COPY partitions of the given tables,
+ * which are larger than --split-tables-larger-than. Each table needs a query
+ * that computes min() and max() of its partition key on the source database,
+ * so when using --table-jobs the tables are distributed to sub-processes
+ * that share the same snapshot.
+ */
+bool
+copydb_prepare_table_parts(CopyDataSpec *specs,
+						   PGSQL *pgsql,
+						   SourceTable **tables,
+						   int count)
+{
+	if (count == 0)
+	{
+		return true;
+	}
+
+	int jobs = specs->tableJobs < count ? specs->tableJobs : count;
+
+	if (jobs <= 1)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (!schema_list_partitions(pgsql,
+										tables[i],
+										specs->splitTablesLargerThan))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	log_info("Computing COPY partitions for %d tables using %d processes",
+			 count,
+			 jobs);
+
+	for (int i = 0; i < jobs; i++)
+	{
+		/*
+		 * Flush stdio channels just before fork, to avoid double-output
+		 * problems.
+		 */
+		fflush(stdout);
+		fflush(stderr);
+
+		int fpid = fork();
+
+		switch (fpid)
+		{
+			case -1:
+			{
+				log_error("Failed to fork a worker process: %m");
+				return false;
+			}
+
+			case 0:
+			{
+				/* child process runs the command */
+				if (!copydb_table_parts_worker(specs, tables, count, jobs, i))
+				{
+					/* errors have already been logged */
+					exit(EXIT_CODE_INTERNAL_ERROR);
+				}
+
+				exit(EXIT_CODE_QUIT);
+			}
+
+			default:
+			{
+				/* fork succeeded, in parent */
+				break;
+			}
+		}
+	}
+
+	if (!copydb_wait_for_subprocesses(specs->failFast))
+	{
+		log_error("Some COPY partitions worker processes have exited with "
+				  "error status, see above for details");
+		return false;
+	}
+
+	for (int i = 0; i < jobs; i++)
+	{
+		if (!copydb_read_table_parts_file(specs, i))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_table_parts_worker computes the COPY partitions for the tables that
+ * are assigned to worker n (every jobs tables starting at n), and writes the
+ * results to its table parts file.
+ */
+bool
+copydb_table_parts_worker(CopyDataSpec *specs,
+						  SourceTable **tables,
+						  int count,
+						  int jobs,
+						  int n)
+{
+	log_notice("Started COPY partitions worker %d [%d]", getpid(), getppid());
+
+	PGSQL pgsql = { 0 };
+	PGSQL *src = NULL;
+
+	if (!copydb_schema_worker_open_source(specs, &pgsql, &src))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	PQExpBuffer contents = createPQExpBuffer();
+
+	for (int i = n; i < count; i += jobs)
+	{
+		SourceTable *table = tables[i];
+
+		if (!schema_list_partitions(src, table, specs->splitTablesLargerThan))
+		{
+			/* errors have already been logged */
+			(void) copydb_schema_worker_close_source(specs, src);
+			destroyPQExpBuffer(contents);
+			return false;
+		}
+
+		appendPQExpBuffer(contents, "%u %d\n",
+						  table->oid,
+						  table->partsArray.count);
+
+		for (int p = 0; p < table->partsArray.count; p++)
+		{
+			SourceTableParts *parts = &(table->partsArray.array[p]);
+
+			appendPQExpBuffer(contents, "%d %d %lld %lld %lld\n",
+							  parts->partNumber,
+							  parts->partCount,
+							  (long long) parts->min,
+							  (long long) parts->max,
+							  (long long) parts->count);
+		}
+	}
+
+	if (!copydb_schema_worker_close_source(specs, src))
+	{
+		/* errors have already been logged */
+		destroyPQExpBuffer(contents);
+		return false;
+	}
+
+	char filename[MAXPGPATH] = { 0 };
+
+	sformat(filename, sizeof(filename), "%s/table-parts.%d",
+			specs->cfPaths.rundir,
+			n);
+
+	if (PQExpBufferBroken(contents) ||
+		!write_file(contents->data, contents->len, filename))
+	{
+		log_error("Failed to write COPY partitions file \"%s\"", filename);
+		destroyPQExpBuffer(contents);
+		return false;
+	}
+
+	destroyPQExpBuffer(contents);
+
+	return true;
+}
+
+
+/*
+ * copydb_read_table_parts_file reads the table parts file written by worker n
+ * and fills-in the partsArray of the tables found in the file, using the
+ * specs->sourceTableHashByOid hash table. The file is removed afterwards.
+ */
+bool
+copydb_read_table_parts_file(CopyDataSpec *specs, int n)
+{
+	char filename[MAXPGPATH] = { 0 };
+
+	sformat(filename, sizeof(filename), "%s/table-parts.%d",
+			specs->cfPaths.rundir,
+			n);
+
+	char *contents = NULL;
+	long size = 0L;
+
+	if (!read_file(filename, &contents, &size))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* we have at most one line per byte in the file */
+	char **lines = (char **) calloc(size + 1, sizeof(char *));
+
+	if (lines == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		free(contents);
+		return false;
+	}
+
+	int lineCount = splitLines(contents, lines, size + 1);
+	int errors = 0;
+
+	for (int lineNumber = 0; lineNumber < lineCount && errors == 0;)
+	{
+		uint32_t oid = 0;
+		int partCount = 0;
+		SourceTable *table = NULL;
+
+		if (sscanf(lines[lineNumber], "%u %d", &oid, &partCount) != 2 ||
+			partCount < 0 ||
+			lineCount < (lineNumber + 1 + partCount))
+		{
+			log_error("Failed to parse COPY partitions file \"%s\" "
+					  "at line %d: \"%s\"",
+					  filename,
+					  lineNumber + 1,
+					  lines[lineNumber]);
+			++errors;
+			break;
+		}
+
+		HASH_FIND(hh, specs->sourceTableHashByOid, &oid, sizeof(oid), table);
+
+		if (table == NULL)
+		{
+			log_error("Failed to find table with oid %u in COPY partitions "
+					  "file \"%s\"",
+					  oid,
+					  filename);
+			++errors;
+			break;
+		}
+
+		table->partsArray.count = partCount;
+		table->partsArray.array =
+			(SourceTableParts *) calloc(partCount + 1, sizeof(SourceTableParts));
+
+		if (table->partsArray.array == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			++errors;
+			break;
+		}
+
+		++lineNumber;
+
+		for (int p = 0; p < partCount; p++, lineNumber++)
+		{
+			SourceTableParts *parts = &(table->partsArray.array[p]);
+			long long min = 0, max = 0, count = 0;
+
+			if (sscanf(lines[lineNumber], "%d %d %lld %lld %lld",
+					   &(parts->partNumber),
+					   &(parts->partCount),
+					   &min, &max, &count) != 5)
+			{
+				log_error("Failed to parse COPY partitions file \"%s\" "
+						  "at line %d: \"%s\"",
+						  filename,
+						  lineNumber + 1,
+						  lines[lineNumber]);
+				++errors;
+				break;
+			}
+
+			parts->min = (int64_t) min;
+			parts->max = (int64_t) max;
+			parts->count = (int64_t) count;
+		}
+	}
+
+	free(lines);
+	free(contents);
+
+	if (errors > 0)
+	{
+		return false;
+	}
+
+	(void) unlink_file(filename);
+
+	return true;
+}
+
+
 /*
  * copydb_prepare_index_specs fetches the list of indexes to create again on
  * the target database, and set our internal hash table entries with a
@@ -412,7 +1179,8 @@ copydb_prepare_index_specs(CopyDataSpec *specs, PGSQL *pgsql)
 {
 	SourceIndexArray *indexArray = &(specs->sourceIndexArray);
 
-	if (!schema_list_all_indexes(pgsql, &(specs->filters), indexArray))
+	if (!specs->catalogCache.cachedIndexes &&
+		!schema_list_all_indexes(pgsql, &(specs->filters), indexArray))
 	{
 		/* errors have already been logged */
 		return false;
@@ -797,6 +1565,7 @@ copydb_fetch_filtered_oids(CopyDataSpec *specs, PGSQL *pgsql)
 			conItem->oid = index->constraintOid;
 			conItem->kind = OBJECT_KIND_CONSTRAINT;
 			conItem->index = *index;
+			conItem->restoreListName[0] = '\0';
 
 			/* at the moment we lack restore names for constraints */
 			HASH_ADD(hOid, hOid, oid, sizeof(uint32_t), conItem);
@@ -888,6 +1657,64 @@ copydb_fetch_filtered_oids(CopyDataSpec *specs, PGSQL *pgsql)
 }
 
 
+/*
+ * copydb_prepare_catalog_cache computes the keys of the catalog cache and
+ * loads the catalog information found in the schema.json file when it has
+ * been prepared for the same keys.
+ *
+ * The catalogs are only cached when using a snapshot, because then they
+ * can't change in between two pgcopydb commands that share the same
+ * snapshot, and when we can fetch the source system identifier.
+ */
+bool
+copydb_prepare_catalog_cache(CopyDataSpec *specs, PGSQL *pgsql)
+{
+	CatalogCache *cache = &(specs->catalogCache);
+
+	*cache = (CatalogCache) { 0 };
+
+	if (!specs->consistent ||
+		IS_EMPTY_STRING_BUFFER(specs->sourceSnapshot.snapshot))
+	{
+		log_debug("Skipping the catalog cache: not using a snapshot");
+		return true;
+	}
+
+	if (!schema_get_system_identifier(pgsql,
+									  cache->systemIdentifier,
+									  sizeof(cache->systemIdentifier)))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (IS_EMPTY_STRING_BUFFER(cache->systemIdentifier))
+	{
+		log_debug("Skipping the catalog cache: "
+				  "failed to fetch the source system identifier");
+		return true;
+	}
+
+	if (!copydb_filters_hash(specs,
+							 cache->filtersHash,
+							 sizeof(cache->filtersHash)))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	cache->enabled = true;
+
+	if (!copydb_load_catalog_cache(specs))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	return true;
+}
+
+
 /*
  * copydb_ObjectKindToString returns the string representation of an ObjectKind
  * enum value.
@@ -945,3 +1772,34 @@ copydb_ObjectKindToString(ObjectKind kind)
 
 	return "unknown";
 }
+
+
+/*
+ * copydb_ObjectKindFromString returns the ObjectKind enum value from its
+ * string representation, as returned by copydb_ObjectKindToString.
+ */
+ObjectKind
+copydb_ObjectKindFromString(const char *kind)
+{
+	ObjectKind kinds[] = {
+		OBJECT_KIND_SCHEMA,
+		OBJECT_KIND_EXTENSION,
+		OBJECT_KIND_COLLATION,
+		OBJECT_KIND_TABLE,
+		OBJECT_KIND_INDEX,
+		OBJECT_KIND_CONSTRAINT,
+		OBJECT_KIND_SEQUENCE,
+		OBJECT_KIND_DEFAULT,
+		OBJECT_KIND_UNKNOWN
+	};
+
+	for (int i = 0; kinds[i] != OBJECT_KIND_UNKNOWN; i++)
+	{
+		if (streq(kind, copydb_ObjectKindToString(kinds[i])))
+		{
+			return kinds[i];
+		}
+	}
+
+	return OBJECT_KIND_UNKNOWN;
+}
@@ -28,6 +28,11 @@
 #define PGCOPYDB_TARGET_PGURI "PGCOPYDB_TARGET_PGURI"
 #define PGCOPYDB_TABLE_JOBS "PGCOPYDB_TABLE_JOBS"
 #define PGCOPYDB_INDEX_JOBS "PGCOPYDB_INDEX_JOBS"
+#define PGCOPYDB_VACUUM_JOBS "PGCOPYDB_VACUUM_JOBS"
+#define PGCOPYDB_BLOB_JOBS "PGCOPYDB_BLOB_JOBS"
+#define PGCOPYDB_RESTORE_JOBS "PGCOPYDB_RESTORE_JOBS"
+#define PGCOPYDB_APPLY_JOBS "PGCOPYDB_APPLY_JOBS"
+#define PGCOPYDB_DUMP_JOBS "PGCOPYDB_DUMP_JOBS"
 #define PGCOPYDB_SPLIT_TABLES_LARGER_THAN "PGCOPYDB_SPLIT_TABLES_LARGER_THAN"
 #define PGCOPYDB_DROP_IF_EXISTS "PGCOPYDB_DROP_IF_EXISTS"
 #define PGCOPYDB_SNAPSHOT "PGCOPYDB_SNAPSHOT"
@@ -38,12 +43,22 @@
 #define PGCOPYDB_LOG_FILENAME "PGCOPYDB_LOG_FILENAME"
 #define PGCOPYDB_FAIL_FAST "PGCOPYDB_FAIL_FAST"
 #define PGCOPYDB_SKIP_VACUUM "PGCOPYDB_SKIP_VACUUM"
+#define PGCOPYDB_PROGRESS_FILES "PGCOPYDB_PROGRESS_FILES"
+#define PGCOPYDB_PREPARED_STATEMENTS "PGCOPYDB_PREPARED_STATEMENTS"
+#define PGCOPYDB_COPY_INSERTS "PGCOPYDB_COPY_INSERTS"
+#define PGCOPYDB_PIPELINE "PGCOPYDB_PIPELINE"
+#define PGCOPYDB_GROUP_COMMIT "PGCOPYDB_GROUP_COMMIT"
 
 #define PGCOPYDB_PGAPPNAME "pgcopydb"
 
 /* default values for the command line options */
 #define DEFAULT_TABLE_JOBS 4
 #define DEFAULT_INDEX_JOBS 4
+#define DEFAULT_BLOB_JOBS 1
+#define DEFAULT_RESTORE_JOBS 1
+#define DEFAULT_DUMP_JOBS 1
+#define DEFAULT_APPLY_JOBS 1
+#define DEFAULT_GROUP_COMMIT 1 /* one target transaction per source transaction */
 #define DEFAULT_SPLIT_TABLES_LARGER_THAN 0 /* no COPY partitioning by default */
 
 #define POSTGRES_CONNECT_TIMEOUT "10"
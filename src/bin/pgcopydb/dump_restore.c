@@ -3,6 +3,7 @@
  *     Implementation of a CLI to copy a database between two Postgres instances
  */
 
+#include <dirent.h>
 #include <errno.h>
 #include <getopt.h>
 #include <inttypes.h>
@@ -11,6 +12,7 @@
 
 #include "copydb.h"
 #include "env_utils.h"
+#include "journal.h"
 #include "lock_utils.h"
 #include "log.h"
 #include "pidfile.h"
@@ -20,91 +22,342 @@
 #include "summary.h"
 
 
+/* context used when iterating over the progress journal entries */
+typedef struct DoneObjectIdsContext
+{
+	const char *idxdir;
+	DoneObjectOid **doneSet;
+	int count;
+} DoneObjectIdsContext;
+
+
+static bool copydb_add_done_objectid(DoneObjectIdsContext *context,
+									 const char *filename);
+static bool copydb_add_done_objectid_hook(void *ctx, const char *filePath);
+
+
+/*
+ * copydb_read_done_objectids scans the indexes work directory once and builds
+ * a hash table of the OIDs of the indexes and constraints for which a doneFile
+ * exists, either on-disk or in the progress journal. This allows checking a
+ * large number of archive entries without calling stat() for each of them.
+ */
+bool
+copydb_read_done_objectids(CopyDataSpec *specs, DoneObjectOid **doneSet)
+{
+	*doneSet = NULL;
+
+	DoneObjectIdsContext context = {
+		.idxdir = specs->cfPaths.idxdir,
+		.doneSet = doneSet,
+		.count = 0
+	};
+
+	if (!journal_iter(&context, &copydb_add_done_objectid_hook))
+	{
+		/* errors have already been logged */
+		copydb_free_done_objectids(doneSet);
+		return false;
+	}
+
+	DIR *dir = opendir(specs->cfPaths.idxdir);
+
+	if (dir == NULL)
+	{
+		/* no directory means nothing has been processed yet */
+		if (errno == ENOENT)
+		{
+			return true;
+		}
+
+		log_error("Failed to open directory \"%s\": %m",
+				  specs->cfPaths.idxdir);
+		copydb_free_done_objectids(doneSet);
+		return false;
+	}
+
+	struct dirent *entry = NULL;
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (!copydb_add_done_objectid(&context, entry->d_name))
+		{
+			/* errors have already been logged */
+			closedir(dir);
+			copydb_free_done_objectids(doneSet);
+			return false;
+		}
+	}
+
+	closedir(dir);
+
+	log_debug("Found %d indexes and constraints already processed in \"%s\"",
+			  context.count,
+			  specs->cfPaths.idxdir);
+
+	return true;
+}
+
+
+/*
+ * copydb_add_done_objectid_hook is a journal_iter callback that adds the OIDs
+ * of the index and constraint done files registered in the progress journal.
+ */
+static bool
+copydb_add_done_objectid_hook(void *ctx, const char *filePath)
+{
+	DoneObjectIdsContext *context = (DoneObjectIdsContext *) ctx;
+
+	size_t len = strlen(context->idxdir);
+
+	/* only consider the done files found in the indexes work directory */
+	if (strncmp(filePath, context->idxdir, len) != 0 || filePath[len] != '/')
+	{
+		return true;
+	}
+
+	return copydb_add_done_objectid(context, filePath + len + 1);
+}
+
+
+/*
+ * copydb_add_done_objectid adds the OID of the given <oid>.done filename to
+ * the hash table, and skips any other filename.
+ */
+static bool
+copydb_add_done_objectid(DoneObjectIdsContext *context, const char *filename)
+{
+	char name[NAMEDATALEN] = { 0 };
+	char *ext = strrchr(filename, '.');
+
+	/* only consider the <oid>.done files */
+	if (ext == NULL || strcmp(ext, ".done") != 0)
+	{
+		return true;
+	}
+
+	size_t len = ext - filename;
+
+	if (len == 0 || len >= sizeof(name))
+	{
+		return true;
+	}
+
+	strlcpy(name, filename, len + 1);
+
+	uint32_t oid = 0;
+
+	if (!stringToUInt32(name, &oid))
+	{
+		return true;
+	}
+
+	DoneObjectOid *item = NULL;
+
+	HASH_FIND(hh, *(context->doneSet), &oid, sizeof(oid), item);
+
+	if (item != NULL)
+	{
+		return true;
+	}
+
+	item = (DoneObjectOid *) calloc(1, sizeof(DoneObjectOid));
+
+	if (item == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	item->oid = oid;
+
+	HASH_ADD(hh, *(context->doneSet), oid, sizeof(uint32_t), item);
+
+	++(context->count);
+
+	return true;
+}
+
+
+/*
+ * copydb_free_done_objectids frees the memory allocated for the given hash
+ * table of already processed object OIDs.
+ */
+void
+copydb_free_done_objectids(DoneObjectOid **doneSet)
+{
+	DoneObjectOid *item = NULL;
+	DoneObjectOid *tmp = NULL;
+
+	HASH_ITER(hh, *doneSet, item, tmp)
+	{
+		HASH_DEL(*doneSet, item);
+		free(item);
+	}
+
+	*doneSet = NULL;
+}
+
+
 /*
  * copydb_objectid_has_been_processed_already returns true when a doneFile
- * could be found on-disk for the given target object OID.
+ * has been found on-disk for the given target object OID, as registered in
+ * the given hash table by copydb_read_done_objectids().
  */
 bool
-copydb_objectid_has_been_processed_already(CopyDataSpec *specs, uint32_t oid)
+copydb_objectid_has_been_processed_already(DoneObjectOid *doneSet, uint32_t oid)
 {
-	char doneFile[MAXPGPATH] = { 0 };
+	DoneObjectOid *item = NULL;
 
-	/* build the doneFile for the target index or constraint */
-	sformat(doneFile, sizeof(doneFile), "%s/%u.done",
-			specs->cfPaths.idxdir,
-			oid);
+	HASH_FIND(hh, doneSet, &oid, sizeof(oid), item);
 
-	return file_exists(doneFile);
+	return item != NULL;
 }
 
 
 /*
  * copydb_dump_source_schema uses pg_dump -Fc --schema --section=pre-data or
  * --section=post-data to dump the source database schema to files.
+ *
+ * When using --dump-jobs, the pre-data and the post-data sections are dumped
+ * at the same time by two pg_dump processes, using the same snapshot. We don't
+ * use pg_dump --jobs: it only hands TABLE DATA entries to its workers, so it
+ * would not make a schema-only dump any faster.
  */
 bool
 copydb_dump_source_schema(CopyDataSpec *specs,
 						  const char *snapshot,
 						  PostgresDumpSection section)
 {
-	if (section == PG_DUMP_SECTION_SCHEMA ||
+	bool preData =
+		section == PG_DUMP_SECTION_SCHEMA ||
 		section == PG_DUMP_SECTION_PRE_DATA ||
-		section == PG_DUMP_SECTION_ALL)
+		section == PG_DUMP_SECTION_ALL;
+
+	bool postData =
+		section == PG_DUMP_SECTION_SCHEMA ||
+		section == PG_DUMP_SECTION_POST_DATA ||
+		section == PG_DUMP_SECTION_ALL;
+
+	if (preData && postData && specs->dumpJobs > 1)
 	{
-		if (file_exists(specs->cfPaths.done.preDataDump))
-		{
-			log_info("Skipping pg_dump --section=pre-data, "
-					 "as \"%s\" already exists",
-					 specs->cfPaths.done.preDataDump);
-		}
-		else if (!pg_dump_db(&(specs->pgPaths),
-							 specs->source_pguri,
-							 &(specs->filters),
-							 snapshot,
-							 "pre-data",
-							 specs->dumpPaths.preFilename))
+		PostgresDumpSection sections[] = {
+			PG_DUMP_SECTION_PRE_DATA,
+			PG_DUMP_SECTION_POST_DATA
+		};
+
+		for (int i = 0; i < 2; i++)
 		{
-			/* errors have already been logged */
-			return false;
+			/*
+			 * Flush stdio channels just before fork, to avoid double-output
+			 * problems.
+			 */
+			fflush(stdout);
+			fflush(stderr);
+
+			int fpid = fork();
+
+			switch (fpid)
+			{
+				case -1:
+				{
+					log_error("Failed to fork a pg_dump process: %m");
+					return false;
+				}
+
+				case 0:
+				{
+					/* child process runs the command */
+					if (!copydb_dump_source_section(specs,
+													snapshot,
+													sections[i]))
+					{
+						/* errors have already been logged */
+						exit(EXIT_CODE_SOURCE);
+					}
+
+					exit(EXIT_CODE_QUIT);
+				}
+
+				default:
+				{
+					/* fork succeeded, in parent */
+					break;
+				}
+			}
 		}
 
-		/* now write the doneFile to keep track */
-		if (!write_file("", 0, specs->cfPaths.done.preDataDump))
+		if (!copydb_wait_for_subprocesses(specs->failFast))
 		{
-			log_error("Failed to write the tracking file \"%s\"",
-					  specs->cfPaths.done.preDataDump);
+			log_error("Some pg_dump processes have exited with error status, "
+					  "see above for details");
 			return false;
 		}
+
+		return true;
 	}
 
-	if (section == PG_DUMP_SECTION_SCHEMA ||
-		section == PG_DUMP_SECTION_POST_DATA ||
-		section == PG_DUMP_SECTION_ALL)
+	if (preData &&
+		!copydb_dump_source_section(specs, snapshot, PG_DUMP_SECTION_PRE_DATA))
 	{
-		if (file_exists(specs->cfPaths.done.postDataDump))
-		{
-			log_info("Skipping pg_dump --section=post-data, "
-					 "as \"%s\" already exists",
-					 specs->cfPaths.done.postDataDump);
-		}
-		else if (!pg_dump_db(&(specs->pgPaths),
-							 specs->source_pguri,
-							 &(specs->filters),
-							 snapshot,
-							 "post-data",
-							 specs->dumpPaths.postFilename))
-		{
-			/* errors have already been logged */
-			return false;
-		}
+		/* errors have already been logged */
+		return false;
+	}
 
-		/* now write the doneFile to keep track */
-		if (!write_file("", 0, specs->cfPaths.done.postDataDump))
-		{
-			log_error("Failed to write the tracking file \"%s\"",
-					  specs->cfPaths.done.postDataDump);
-			return false;
-		}
+	if (postData &&
+		!copydb_dump_source_section(specs, snapshot, PG_DUMP_SECTION_POST_DATA))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_dump_source_section runs pg_dump for either the pre-data or the
+ * post-data section, unless it has already been done on a previous run.
+ */
+bool
+copydb_dump_source_section(CopyDataSpec *specs,
+						   const char *snapshot,
+						   PostgresDumpSection section)
+{
+	bool preData = section == PG_DUMP_SECTION_PRE_DATA;
+
+	char *sectionName = preData ? "pre-data" : "post-data";
+	char *filename =
+		preData ? specs->dumpPaths.preFilename : specs->dumpPaths.postFilename;
+	char *doneFile =
+		preData
+		? specs->cfPaths.done.preDataDump
+		: specs->cfPaths.done.postDataDump;
+
+	if (file_exists(doneFile))
+	{
+		log_info("Skipping pg_dump --section=%s, as \"%s\" already exists",
+				 sectionName,
+				 doneFile);
+		return true;
+	}
+
+	if (!pg_dump_db(&(specs->pgPaths),
+					specs->source_pguri,
+					&(specs->filters),
+					snapshot,
+					sectionName,
+					filename))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* now write the doneFile to keep track */
+	if (!write_file("", 0, doneFile))
+	{
+		log_error("Failed to write the tracking file \"%s\"", doneFile);
+		return false;
 	}
 
 	return true;
@@ -169,13 +422,20 @@ copydb_target_prepare_schema(CopyDataSpec *specs)
 		}
 	 }
 
-
-	if (!pg_restore_db(&(specs->pgPaths),
-					   specs->target_pguri,
-					   &(specs->filters),
-					   specs->dumpPaths.preFilename,
-					   specs->dumpPaths.preListFilename,
-					   specs->restoreOptions))
+	if (specs->restoreJobs > 1)
+	{
+		if (!copydb_target_restore_pre_data_waves(specs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+	else if (!pg_restore_db(&(specs->pgPaths),
+							specs->target_pguri,
+							&(specs->filters),
+							specs->dumpPaths.preFilename,
+							specs->dumpPaths.preListFilename,
+							specs->restoreOptions))
 	{
 		/* errors have already been logged */
 		return false;
@@ -193,6 +453,539 @@ copydb_target_prepare_schema(CopyDataSpec *specs)
 }
 
 
+/*
+ * copydb_target_restore_pre_data_waves restores the pre-data section using
+ * --restore-jobs concurrent pg_restore processes.
+ *
+ * The archive objects are split in waves, following the dependencies that
+ * pg_restore --verbose --list reports: schemas and other objects without
+ * dependencies are restored first, then the objects that only depend on
+ * those, such as types and tables, then the objects that depend on them, such
+ * as partitions, and so on. Each wave is then split in as many --use-list
+ * files as --restore-jobs, and restored with a transaction per worker.
+ *
+ * A done file is written for each worker and each wave, so that resuming
+ * operations skips the parts of the pre-data section that have already been
+ * restored.
+ */
+bool
+copydb_target_restore_pre_data_waves(CopyDataSpec *specs)
+{
+	RestoreWaveContext context = { 0 };
+
+	if (!copydb_prepare_restore_waves(specs, &context))
+	{
+		/* errors have already been logged */
+		copydb_free_restore_waves(&context);
+		return false;
+	}
+
+	/*
+	 * pg_dump sorts the archive objects so that dependencies are restored
+	 * first. Should we find an object before one of its dependencies, then
+	 * restore the whole pre-data section in a single transaction instead.
+	 */
+	if (!context.sorted)
+	{
+		log_warn("Failed to compute pre-data restore waves, "
+				 "restoring the pre-data section with a single process");
+
+		copydb_free_restore_waves(&context);
+
+		return pg_restore_db(&(specs->pgPaths),
+							 specs->target_pguri,
+							 &(specs->filters),
+							 specs->dumpPaths.preFilename,
+							 specs->dumpPaths.preListFilename,
+							 specs->restoreOptions);
+	}
+
+	log_info("Restoring %d pre-data objects in %d waves using %d processes",
+			 context.count,
+			 context.waveCount,
+			 specs->restoreJobs);
+
+	int *counts = (int *) calloc(specs->restoreJobs, sizeof(int));
+
+	if (counts == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		copydb_free_restore_waves(&context);
+		return false;
+	}
+
+	bool success = true;
+
+	for (int wave = 0; wave < context.waveCount; wave++)
+	{
+		char doneFile[MAXPGPATH] = { 0 };
+
+		sformat(doneFile, sizeof(doneFile), "%s/%d.done",
+				specs->cfPaths.predatadir,
+				wave);
+
+		if (file_exists(doneFile))
+		{
+			log_info("Skipping pre-data restore wave %d, "
+					 "done on a previous run",
+					 wave);
+			continue;
+		}
+
+		if (!copydb_write_restore_wave_lists(specs, &context, wave, counts) ||
+			!copydb_restore_wave(specs, wave, counts))
+		{
+			/* errors have already been logged */
+			success = false;
+			break;
+		}
+
+		if (!write_file("", 0, doneFile))
+		{
+			log_error("Failed to write the tracking file \"%s\"", doneFile);
+			success = false;
+			break;
+		}
+	}
+
+	free(counts);
+	copydb_free_restore_waves(&context);
+
+	return success;
+}
+
+
+/*
+ * copydb_prepare_restore_waves reads the pre-data --use-list file that has
+ * been prepared already, and then the pg_restore --verbose --list output of
+ * the pre-data archive, to compute the wave of each archive object that is
+ * going to be restored.
+ */
+bool
+copydb_prepare_restore_waves(CopyDataSpec *specs, RestoreWaveContext *context)
+{
+	context->specs = specs;
+	context->items = NULL;
+	context->count = 0;
+	context->waveCount = 0;
+	context->sorted = true;
+
+	const char *listFilename = specs->dumpPaths.preListFilename;
+	FILE *stream = fopen_read_only(listFilename);
+
+	if (stream == NULL)
+	{
+		log_error("Failed to open file \"%s\": %m", listFilename);
+		return false;
+	}
+
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len = 0;
+	bool success = true;
+
+	/* only the objects that are not commented out are restored */
+	while ((len = getline(&line, &size, stream)) != -1)
+	{
+		ArchiveContentItem item = { 0 };
+		bool isItem = false;
+
+		if (len > 0 && line[len - 1] == '\n')
+		{
+			line[len - 1] = '\0';
+		}
+
+		if (!parse_archive_list_line(line, &item, &isItem))
+		{
+			/* errors have already been logged */
+			success = false;
+			break;
+		}
+
+		if (!isItem)
+		{
+			continue;
+		}
+
+		RestoreWaveItem *waveItem =
+			(RestoreWaveItem *) calloc(1, sizeof(RestoreWaveItem));
+
+		if (waveItem == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			success = false;
+			break;
+		}
+
+		waveItem->dumpId = item.dumpId;
+		waveItem->catalogOid = item.catalogOid;
+		waveItem->objectOid = item.objectOid;
+		waveItem->wave = -1;
+		waveItem->group = waveItem;
+
+		HASH_ADD(hh, context->items, dumpId, sizeof(int), waveItem);
+		++(context->count);
+	}
+
+	if (success && ferror(stream))
+	{
+		log_error("Failed to read file \"%s\": %m", listFilename);
+		success = false;
+	}
+
+	free(line);
+	fclose(stream);
+
+	if (!success)
+	{
+		return false;
+	}
+
+	char dependsFilename[MAXPGPATH] = { 0 };
+
+	sformat(dependsFilename, sizeof(dependsFilename), "%s/depends.list",
+			specs->cfPaths.predatadir);
+
+	if (!pg_restore_list_dependencies(&(specs->pgPaths),
+									  specs->dumpPaths.preFilename,
+									  dependsFilename,
+									  context,
+									  &copydb_restore_wave_item))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	RestoreWaveItem *waveItem;
+	RestoreWaveItem *tmp;
+
+	HASH_ITER(hh, context->items, waveItem, tmp)
+	{
+		if (waveItem->wave == -1)
+		{
+			log_debug("Archive object %d was not found in \"%s\"",
+					  waveItem->dumpId,
+					  dependsFilename);
+			context->sorted = false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_restore_wave_group returns the root of the group of the given item,
+ * using path halving.
+ */
+static RestoreWaveItem *
+copydb_restore_wave_group(RestoreWaveItem *item)
+{
+	while (item->group != item)
+	{
+		item->group = item->group->group;
+		item = item->group;
+	}
+
+	return item;
+}
+
+
+/*
+ * copydb_restore_wave_item is an ArchiveDependencyCB callback that computes
+ * the wave of an archive object from the waves of its dependencies. Archive
+ * objects that are not part of the --use-list file are skipped, and so are
+ * dependencies on such objects.
+ */
+bool
+copydb_restore_wave_item(void *ctx,
+						 ArchiveContentItem *item,
+						 int depCount,
+						 int *dependencies)
+{
+	RestoreWaveContext *context = (RestoreWaveContext *) ctx;
+	RestoreWaveItem *waveItem = NULL;
+
+	HASH_FIND(hh, context->items, &(item->dumpId), sizeof(int), waveItem);
+
+	if (waveItem == NULL)
+	{
+		return true;
+	}
+
+	waveItem->isRelation =
+		streq(item->desc, "TABLE") ||
+		streq(item->desc, "FOREIGN TABLE") ||
+		streq(item->desc, "SEQUENCE") ||
+		streq(item->desc, "VIEW") ||
+		streq(item->desc, "MATERIALIZED VIEW");
+
+	waveItem->wave = 0;
+
+	for (int i = 0; i < depCount; i++)
+	{
+		RestoreWaveItem *dep = NULL;
+
+		HASH_FIND(hh, context->items, &(dependencies[i]), sizeof(int), dep);
+
+		if (dep == NULL)
+		{
+			continue;
+		}
+
+		if (dep->wave == -1)
+		{
+			log_debug("Archive object %d depends on object %d "
+					  "which is listed after it",
+					  waveItem->dumpId,
+					  dep->dumpId);
+			context->sorted = false;
+			continue;
+		}
+
+		if (waveItem->wave <= dep->wave)
+		{
+			waveItem->wave = dep->wave + 1;
+		}
+
+		/* objects that depend on the same relation are restored together */
+		if (dep->isRelation)
+		{
+			RestoreWaveItem *root = copydb_restore_wave_group(dep);
+			RestoreWaveItem *self = copydb_restore_wave_group(waveItem);
+
+			if (root != self)
+			{
+				self->group = root;
+			}
+		}
+	}
+
+	if (context->waveCount <= waveItem->wave)
+	{
+		context->waveCount = waveItem->wave + 1;
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_write_restore_wave_lists writes a pg_restore --use-list file per
+ * worker for the given wave, and counts how many archive objects have been
+ * assigned to each worker. All the objects of the same group are assigned to
+ * the same worker.
+ */
+bool
+copydb_write_restore_wave_lists(CopyDataSpec *specs,
+								RestoreWaveContext *context,
+								int wave,
+								int *counts)
+{
+	FILE **files = (FILE **) calloc(specs->restoreJobs, sizeof(FILE *));
+
+	if (files == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	for (int w = 0; w < specs->restoreJobs; w++)
+	{
+		char listFilename[MAXPGPATH] = { 0 };
+
+		sformat(listFilename, sizeof(listFilename), "%s/%d.%d.list",
+				specs->cfPaths.predatadir,
+				wave,
+				w);
+
+		counts[w] = 0;
+		files[w] = fopen_with_umask(listFilename, "wb", FOPEN_FLAGS_W, 0644);
+
+		if (files[w] == NULL)
+		{
+			log_error("Failed to create file \"%s\": %m", listFilename);
+
+			for (int i = 0; i < w; i++)
+			{
+				fclose(files[i]);
+			}
+
+			free(files);
+			return false;
+		}
+	}
+
+	bool success = true;
+
+	RestoreWaveItem *waveItem;
+	RestoreWaveItem *tmp;
+
+	/* uthash iterates in insertion order, which is the archive order */
+	HASH_ITER(hh, context->items, waveItem, tmp)
+	{
+		if (waveItem->wave != wave)
+		{
+			continue;
+		}
+
+		RestoreWaveItem *root = copydb_restore_wave_group(waveItem);
+		int w = root->dumpId % specs->restoreJobs;
+
+		/* pg_restore --use-list only reads the dumpId before the ';' */
+		if (fprintf(files[w], "%d; %u %u\n",
+					waveItem->dumpId,
+					waveItem->catalogOid,
+					waveItem->objectOid) < 0)
+		{
+			log_error("Failed to write pre-data list file: %m");
+			success = false;
+			break;
+		}
+
+		++counts[w];
+	}
+
+	for (int w = 0; w < specs->restoreJobs; w++)
+	{
+		if (fclose(files[w]) != 0)
+		{
+			log_error("Failed to write pre-data list file: %m");
+			success = false;
+		}
+	}
+
+	free(files);
+
+	return success;
+}
+
+
+/*
+ * copydb_restore_wave starts a pg_restore sub-process for each worker that
+ * has been assigned archive objects in the given wave, skipping the workers
+ * that are done already, and waits until they are all done.
+ */
+bool
+copydb_restore_wave(CopyDataSpec *specs, int wave, int *counts)
+{
+	log_info("Restoring pre-data wave %d", wave);
+
+	for (int w = 0; w < specs->restoreJobs; w++)
+	{
+		char listFilename[MAXPGPATH] = { 0 };
+		char doneFile[MAXPGPATH] = { 0 };
+
+		if (counts[w] == 0)
+		{
+			continue;
+		}
+
+		sformat(listFilename, sizeof(listFilename), "%s/%d.%d.list",
+				specs->cfPaths.predatadir,
+				wave,
+				w);
+
+		sformat(doneFile, sizeof(doneFile), "%s/%d.%d.done",
+				specs->cfPaths.predatadir,
+				wave,
+				w);
+
+		if (file_exists(doneFile))
+		{
+			log_info("Skipping pre-data restore wave %d worker %d, "
+					 "done on a previous run",
+					 wave,
+					 w);
+			continue;
+		}
+
+		/*
+		 * Flush stdio channels just before fork, to avoid double-output
+		 * problems.
+		 */
+		fflush(stdout);
+		fflush(stderr);
+
+		int fpid = fork();
+
+		switch (fpid)
+		{
+			case -1:
+			{
+				log_error("Failed to fork a worker process: %m");
+				return false;
+			}
+
+			case 0:
+			{
+				/* child process runs the command */
+				log_notice("Started pre-data restore worker %d [%d]: "
+						   "%d objects in wave %d",
+						   getpid(),
+						   getppid(),
+						   counts[w],
+						   wave);
+
+				if (!pg_restore_db(&(specs->pgPaths),
+								   specs->target_pguri,
+								   &(specs->filters),
+								   specs->dumpPaths.preFilename,
+								   listFilename,
+								   specs->restoreOptions))
+				{
+					/* errors have already been logged */
+					exit(EXIT_CODE_TARGET);
+				}
+
+				if (!write_file("", 0, doneFile))
+				{
+					log_error("Failed to write the tracking file \"%s\"",
+							  doneFile);
+					exit(EXIT_CODE_INTERNAL_ERROR);
+				}
+
+				exit(EXIT_CODE_QUIT);
+			}
+
+			default:
+			{
+				/* fork succeeded, in parent */
+				break;
+			}
+		}
+	}
+
+	if (!copydb_wait_for_subprocesses(specs->failFast))
+	{
+		log_error("Some pre-data restore processes have exited with error "
+				  "status, see above for details");
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_free_restore_waves frees the memory used for the restore waves.
+ */
+void
+copydb_free_restore_waves(RestoreWaveContext *context)
+{
+	RestoreWaveItem *waveItem;
+	RestoreWaveItem *tmp;
+
+	HASH_ITER(hh, context->items, waveItem, tmp)
+	{
+		HASH_DEL(context->items, waveItem);
+		free(waveItem);
+	}
+
+	context->items = NULL;
+}
+
+
 /*
  * copydb_target_drop_tables prepares and executes a SQL query that prepares
  * our target database by means of a DROP IF EXISTS ... CASCADE statement that
@@ -358,79 +1151,103 @@ copydb_write_restore_list(CopyDataSpec *specs, PostgresDumpSection section)
 	 *   1. pg_restore -f- --list post.dump > post.list
 	 *   2. edit post.list to comment out lines
 	 *   3. pg_restore --use-list post.list post.dump
+	 *
+	 * Archives may contain millions of objects, so we process the
+	 * pg_restore --list output one line at a time.
 	 */
-	ArchiveContentArray contents = { 0 };
+	RestoreListContext context = { 0 };
+
+	context.specs = specs;
 
-	if (!pg_restore_list(&(specs->pgPaths), dumpFilename, &contents))
+	/* read the list of already processed indexes and constraints once */
+	if (!copydb_read_done_objectids(specs, &(context.doneSet)))
 	{
 		/* errors have already been logged */
 		return false;
 	}
 
-	/* edit our post.list file now */
-	PQExpBuffer listContents = createPQExpBuffer();
+	/* the pg_restore --list output is streamed from a temporary file */
+	char rawListFilename[MAXPGPATH] = { 0 };
 
-	if (listContents == NULL)
+	sformat(rawListFilename, sizeof(rawListFilename), "%s.raw", listFilename);
+
+	context.listFile =
+		fopen_with_umask(listFilename, "wb", FOPEN_FLAGS_W, 0644);
+
+	if (context.listFile == NULL)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
-		free(listContents);
+		/* errors have already been logged */
+		copydb_free_done_objectids(&(context.doneSet));
 		return false;
 	}
 
-	/* for each object in the list, comment when we already processed it */
-	for (int i = 0; i < contents.count; i++)
+	bool success = pg_restore_list_stream(&(specs->pgPaths),
+										  dumpFilename,
+										  rawListFilename,
+										  &context,
+										  &copydb_write_restore_list_item);
+
+	copydb_free_done_objectids(&(context.doneSet));
+
+	if (fclose(context.listFile) == EOF)
 	{
-		uint32_t oid = contents.array[i].objectOid;
-		char *name = contents.array[i].restoreListName;
-		char *prefix = "";
+		log_error("Failed to write file \"%s\"", listFilename);
+		success = false;
+	}
 
-		if (copydb_objectid_has_been_processed_already(specs, oid))
-		{
-			prefix = ";";
+	(void) unlink_file(rawListFilename);
 
-			log_notice("Skipping already processed dumpId %d: %s %u %s",
-					   contents.array[i].dumpId,
-					   contents.array[i].desc,
-					   contents.array[i].objectOid,
-					   contents.array[i].restoreListName);
-		}
-		else if (copydb_objectid_is_filtered_out(specs, oid, name))
-		{
-			prefix = ";";
+	return success;
+}
 
-			log_notice("Skipping filtered-out dumpId %d: %s %u %s",
-					   contents.array[i].dumpId,
-					   contents.array[i].desc,
-					   contents.array[i].objectOid,
-					   contents.array[i].restoreListName);
-		}
 
-		appendPQExpBuffer(listContents, "%s%d; %u %u %s %s\n",
-						  prefix,
-						  contents.array[i].dumpId,
-						  contents.array[i].catalogOid,
-						  contents.array[i].objectOid,
-						  contents.array[i].desc,
-						  contents.array[i].restoreListName);
-	}
+/*
+ * copydb_write_restore_list_item writes the given archive item to the
+ * pg_restore list file, commented out when we already processed it or when
+ * it is filtered out.
+ */
+bool
+copydb_write_restore_list_item(void *ctx, ArchiveContentItem *item)
+{
+	RestoreListContext *context = (RestoreListContext *) ctx;
 
-	/* memory allocation could have failed while building string */
-	if (PQExpBufferBroken(listContents))
+	uint32_t oid = item->objectOid;
+	char *name = item->restoreListName;
+	char *prefix = "";
+
+	if (copydb_objectid_has_been_processed_already(context->doneSet, oid))
 	{
-		log_error("Failed to create pg_restore list file: out of memory");
-		destroyPQExpBuffer(listContents);
-		return false;
+		prefix = ";";
+
+		log_notice("Skipping already processed dumpId %d: %s %u %s",
+				   item->dumpId,
+				   item->desc,
+				   item->objectOid,
+				   item->restoreListName);
+	}
+	else if (copydb_objectid_is_filtered_out(context->specs, oid, name))
+	{
+		prefix = ";";
+
+		log_notice("Skipping filtered-out dumpId %d: %s %u %s",
+				   item->dumpId,
+				   item->desc,
+				   item->objectOid,
+				   item->restoreListName);
 	}
 
-	if (!write_file(listContents->data, listContents->len, listFilename))
+	if (fprintf(context->listFile, "%s%d; %u %u %s %s\n",
+				prefix,
+				item->dumpId,
+				item->catalogOid,
+				item->objectOid,
+				item->desc,
+				item->restoreListName) < 0)
 	{
-		/* errors have already been logged */
-		destroyPQExpBuffer(listContents);
+		log_error("Failed to write pg_restore list file: %m");
 		return false;
 	}
 
-	destroyPQExpBuffer(listContents);
-
 	return true;
 }
 
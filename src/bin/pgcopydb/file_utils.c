@@ -23,6 +23,24 @@
 #include "signals.h"
 #include "string_utils.h"
 
+/*
+ * read_from_stream keeps the bytes of the line being read in a LineBuffer.
+ */
+typedef struct LineBuffer
+{
+	char *data;                 /* malloc'ed area */
+	size_t size;                /* allocated size */
+	size_t len;                 /* bytes read and not processed yet */
+} LineBuffer;
+
+static bool read_from_stream_lines(LineBuffer *buffer,
+								   ReadFromStreamContext *context,
+								   bool eof,
+								   bool *stop);
+static bool line_buffer_init(LineBuffer *buffer);
+static bool line_buffer_reserve(LineBuffer *buffer);
+static bool line_buffer_shrink(LineBuffer *buffer);
+
 static bool read_file_internal(FILE *fileStream,
 							   const char *filePath,
 							   char **contents,
@@ -377,6 +395,12 @@ read_file_internal(FILE *fileStream,
  * read_from_stream reads lines from an input stream, such as a Unix Pipe, and
  * for each line read calls the provided context->callback function with its
  * own private context as an argument.
+ *
+ * Input is read in chunks of READ_FROM_STREAM_CHUNK_SIZE bytes into a buffer
+ * that only grows when a single line does not fit, up to the
+ * READ_FROM_STREAM_MAX_LINE_SIZE limit, and that shrinks back to its initial
+ * size once the large line has been processed. A line that spans over
+ * several chunks is kept in the buffer until its end has been read.
  */
 bool
 read_from_stream(FILE *stream, ReadFromStreamContext *context)
@@ -387,6 +411,14 @@ read_from_stream(FILE *stream, ReadFromStreamContext *context)
 	context->fd = fileno(stream);
 	nfds = context->fd + 1;
 
+	LineBuffer buffer = { 0 };
+
+	if (!line_buffer_init(&buffer))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	bool doneReading = false;
 
 	while (!doneReading)
@@ -421,6 +453,7 @@ read_from_stream(FILE *stream, ReadFromStreamContext *context)
 			{
 				log_error("Failed to select on file descriptor %d: %m",
 						  context->fd);
+				free(buffer.data);
 				return false;
 			}
 		}
@@ -433,6 +466,14 @@ read_from_stream(FILE *stream, ReadFromStreamContext *context)
 		 */
 		if (countFdsReadyToRead == 0)
 		{
+			if (context->idle != NULL && !(*context->idle)(context->ctx))
+			{
+				log_error("Failed to process idle input stream, "
+						  "see above for details");
+				free(buffer.data);
+				return false;
+			}
+
 			if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
 			{
 				doneReading = true;
@@ -442,100 +483,231 @@ read_from_stream(FILE *stream, ReadFromStreamContext *context)
 			continue;
 		}
 
-		/*
-		 * data is expected to be written one line at a time, if any data is
-		 * available per select(2) call, then we should be able to read an
-		 * entire line now.
-		 */
 		if (FD_ISSET(context->fd, &readFileDescriptorSet))
 		{
-			/*
-			 * Allocate a 128 MB string to receive data from the input stream.
-			 *
-			 * TODO: That's a large allocation but should allow us to accept
-			 * logical decoding traffic. The general case would be to loop over
-			 * memory chunks and then split and re-join chunks into JSON lines,
-			 * or use a streaming JSON parsing API.
-			 *
-			 * Also, because we switch the output stream of producing processes
-			 * to line buffered, this only should become a problem when a
-			 * single JSON message is more than the 128 MB we allocate here.
-			 */
-			size_t s = 128 * 1024 * 1024;
-			char *buf = calloc(s + 1, sizeof(char));
-			size_t bytes = read(context->fd, buf, s);
+			if (!line_buffer_reserve(&buffer))
+			{
+				/* errors have already been logged */
+				free(buffer.data);
+				return false;
+			}
+
+			ssize_t bytes = read(context->fd,
+								 buffer.data + buffer.len,
+								 buffer.size - buffer.len - 1);
 
 			if (bytes == -1)
 			{
 				log_error("Failed to read from input stream: %m");
-				free(buf);
+				free(buffer.data);
 				return false;
 			}
-			else if (bytes == 0)
-			{
-				free(buf);
-				doneReading = true;
-				continue;
-			}
-			else if (bytes == s)
-			{
-				char bytesPretty[BUFSIZE] = { 0 };
-				char limitPretty[BUFSIZE] = { 0 };
 
-				(void) pretty_print_bytes(bytesPretty, BUFSIZE, bytes);
-				(void) pretty_print_bytes(limitPretty, BUFSIZE, s);
+			log_trace("read_from_stream read %lld bytes from input",
+					  (long long) bytes);
+
+			/* at end of stream, process the last line even without newline */
+			bool eof = bytes == 0;
+
+			buffer.len += bytes;
+			buffer.data[buffer.len] = '\0';
 
-				log_error("Failed to read from input stream, message is larger "
-						  "than pgcopydb limit (%s): %s",
-						  limitPretty,
-						  bytesPretty);
+			bool stop = false;
 
-				free(buf);
+			if (!read_from_stream_lines(&buffer, context, eof, &stop))
+			{
+				/* errors have already been logged */
+				free(buffer.data);
 				return false;
 			}
 
-			log_trace("read_from_stream read %lld bytes from input",
-					  (long long) bytes);
+			doneReading = eof || stop;
+		}
 
-			char *lines[BUFSIZE] = { 0 };
-			int lineCount = splitLines(buf, lines, BUFSIZE);
+		/* doneReading might have been set from the user callback already */
+		doneReading = doneReading || feof(stream) != 0;
+	}
 
-			log_trace("read_from_stream: read %d lines", lineCount);
+	free(buffer.data);
 
-			for (int i = 0; i < lineCount; i++)
-			{
-				/*
-				 * Now might look like a good time to check for interrupts...
-				 * That said we want to finish processing the current buffer.
-				 */
-				char *line = lines[i];
+	return true;
+}
 
-				/* we count stream input lines as if reading from a file */
-				++context->lineno;
 
-				/* call the used provided function */
-				bool stop = false;
+/*
+ * read_from_stream_lines calls the context->callback function for each
+ * complete line found in the given buffer, and then keeps only the bytes of
+ * the next incomplete line in the buffer. Empty lines are skipped.
+ */
+static bool
+read_from_stream_lines(LineBuffer *buffer,
+					   ReadFromStreamContext *context,
+					   bool eof,
+					   bool *stop)
+{
+	size_t offset = 0;
 
-				if (!(*context->callback)(context->ctx, line, &stop))
-				{
-					free(buf);
-					return false;
-				}
+	while (offset < buffer->len)
+	{
+		char *line = buffer->data + offset;
+		char *newline = memchr(line, '\n', buffer->len - offset);
 
-				if (stop)
-				{
-					doneReading = true;
-					break;
-				}
+		if (newline == NULL)
+		{
+			if (!eof)
+			{
+				break;
 			}
 
-			free(buf);
+			/* the buffer is always NUL-terminated */
+			newline = buffer->data + buffer->len;
 		}
 
-		/* doneReading might have been set from the user callback already */
-		doneReading = doneReading || feof(stream) != 0;
+		*newline = '\0';
+		offset = newline - buffer->data + 1;
+
+		if (*line == '\0')
+		{
+			continue;
+		}
+
+		/* we count stream input lines as if reading from a file */
+		++context->lineno;
+
+		/* call the used provided function */
+		if (!(*context->callback)(context->ctx, line, stop))
+		{
+			return false;
+		}
+
+		if (*stop)
+		{
+			break;
+		}
+	}
+
+	if (offset > buffer->len)
+	{
+		offset = buffer->len;
 	}
 
+	/* keep the bytes of the next line for the next round */
+	if (offset > 0)
+	{
+		memmove(buffer->data, buffer->data + offset, buffer->len - offset);
+		buffer->len -= offset;
+		buffer->data[buffer->len] = '\0';
+	}
+
+	return line_buffer_shrink(buffer);
+}
+
+
+/*
+ * line_buffer_init allocates the initial buffer used by read_from_stream.
+ */
+static bool
+line_buffer_init(LineBuffer *buffer)
+{
+	buffer->size = READ_FROM_STREAM_CHUNK_SIZE + 1;
+	buffer->len = 0;
+	buffer->data = (char *) malloc(buffer->size);
+
+	if (buffer->data == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	buffer->data[0] = '\0';
+
+	return true;
+}
+
+
+/*
+ * line_buffer_reserve makes sure that the buffer has room to read another
+ * chunk of input, growing it when the line being read does not fit.
+ */
+static bool
+line_buffer_reserve(LineBuffer *buffer)
+{
+	if (buffer->size - buffer->len - 1 >= READ_FROM_STREAM_CHUNK_SIZE)
+	{
+		return true;
+	}
+
+	if (buffer->len >= READ_FROM_STREAM_MAX_LINE_SIZE)
+	{
+		char bytesPretty[BUFSIZE] = { 0 };
+		char limitPretty[BUFSIZE] = { 0 };
+
+		(void) pretty_print_bytes(bytesPretty, BUFSIZE, buffer->len);
+		(void) pretty_print_bytes(limitPretty,
+								  BUFSIZE,
+								  READ_FROM_STREAM_MAX_LINE_SIZE);
+
+		log_error("Failed to read from input stream, message is larger "
+				  "than pgcopydb limit (%s): %s",
+				  limitPretty,
+				  bytesPretty);
+
+		return false;
+	}
+
+	size_t size = buffer->size;
+
+	while (size - buffer->len - 1 < READ_FROM_STREAM_CHUNK_SIZE)
+	{
+		size = 2 * (size - 1) + 1;
+	}
+
+	char *data = (char *) realloc(buffer->data, size);
+
+	if (data == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	buffer->data = data;
+	buffer->size = size;
+
+	return true;
+}
+
+
+/*
+ * line_buffer_shrink releases the memory used to read a large line, once the
+ * remaining bytes fit in the initial buffer size again.
+ *
+ * A buffer that holds a partial line and room for another chunk of input is
+ * 2 * READ_FROM_STREAM_CHUNK_SIZE bytes, which is the size we shrink to. To
+ * avoid a realloc() call at each round when lines are about that size, we
+ * only shrink buffers that are more than twice as big as that.
+ */
+static bool
+line_buffer_shrink(LineBuffer *buffer)
+{
+	size_t size = 2 * READ_FROM_STREAM_CHUNK_SIZE + 1;
+
+	if (buffer->size <= 2 * (size - 1) + 1 ||
+		buffer->len >= READ_FROM_STREAM_CHUNK_SIZE)
+	{
+		return true;
+	}
+
+	char *data = (char *) realloc(buffer->data, size);
+
+	if (data == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	buffer->data = data;
+	buffer->size = size;
+
 	return true;
 }
 
@@ -32,7 +32,15 @@ typedef struct SearchPath
 	char matches[1024][MAXPGPATH];
 } SearchPath;
 
+/*
+ * read_from_stream reads its input in chunks of READ_FROM_STREAM_CHUNK_SIZE
+ * bytes, and accepts lines of up to READ_FROM_STREAM_MAX_LINE_SIZE bytes.
+ */
+#define READ_FROM_STREAM_CHUNK_SIZE (64 * 1024)
+#define READ_FROM_STREAM_MAX_LINE_SIZE (128 * 1024 * 1024)
+
 typedef bool (*ReadFromStream) (void *ctx, const char *line, bool *stop);
+typedef bool (*ReadFromStreamIdle) (void *ctx);
 
 typedef struct ReadFromStreamContext
 {
@@ -40,6 +48,7 @@ typedef struct ReadFromStreamContext
 	uint64_t lineno;
 	bool earlyExit;
 	ReadFromStream callback;
+	ReadFromStreamIdle idle;    /* optional, called when no input is ready */
 	void *ctx;                  /* user-defined context */
 } ReadFromStreamContext;
 
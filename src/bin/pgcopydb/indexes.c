@@ -11,6 +11,7 @@
 
 #include "copydb.h"
 #include "env_utils.h"
+#include "journal.h"
 #include "lock_utils.h"
 #include "log.h"
 #include "pidfile.h"
@@ -332,7 +333,8 @@ copydb_table_indexes_are_done(CopyDataSpec *specs,
 			return false;
 		}
 
-		builtAllIndexes = builtAllIndexes && file_exists(indexPaths.doneFile);
+		builtAllIndexes = builtAllIndexes &&
+						  journal_file_exists(indexPaths.doneFile);
 	}
 
 	if (builtAllIndexes)
@@ -784,7 +786,19 @@ copydb_create_index(const char *pguri,
 			return false;
 		}
 
-		if (!pgsql_execute(&dst, summary->command))
+		bool buildIndex = true;
+
+		if (!constraint)
+		{
+			if (!copydb_check_target_index(&dst, index, &buildIndex))
+			{
+				/* errors have already been logged */
+				(void) pgsql_finish(&dst);
+				return false;
+			}
+		}
+
+		if (buildIndex && !pgsql_execute(&dst, summary->command))
 		{
 			/* errors have already been logged */
 			return false;
@@ -807,6 +821,103 @@ copydb_create_index(const char *pguri,
 }
 
 
+/*
+ * copydb_check_target_index looks for an index with the same qualified name
+ * as the given SourceIndex on the target database, and sets buildIndex to
+ * false when that index is valid, non-empty, and has the same definition as
+ * on the source database. This allows skipping the build of indexes that are
+ * already there, such as when resuming without the done files from a
+ * previous run, or when targeting a database where indexes already exist.
+ *
+ * An invalid index, typically left-over by an interrupted build, is dropped
+ * so that it can be built again. So is an index with a different definition
+ * than on the source database, or that is empty: otherwise the CREATE INDEX
+ * command would either fail or, with IF NOT EXISTS, keep the wrong index.
+ */
+bool
+copydb_check_target_index(PGSQL *dst, SourceIndex *index, bool *buildIndex)
+{
+	TargetIndexState state = { 0 };
+
+	*buildIndex = true;
+
+	if (!schema_get_target_index_state(dst,
+									   index->indexNamespace,
+									   index->indexRelname,
+									   &state))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!state.exists)
+	{
+		return true;
+	}
+
+	if (!state.isValid || !state.isReady)
+	{
+		log_warn("Dropping invalid index \"%s\".\"%s\" on the target database "
+				 "before building it again",
+				 index->indexNamespace,
+				 index->indexRelname);
+	}
+	else if (!streq(state.indexDef, index->indexDef))
+	{
+		log_warn("Dropping index \"%s\".\"%s\" on the target database "
+				 "before building it again, because its definition \"%s\" "
+				 "is different from the definition \"%s\" on the source "
+				 "database",
+				 index->indexNamespace,
+				 index->indexRelname,
+				 state.indexDef,
+				 index->indexDef);
+	}
+	else if (state.bytes == 0)
+	{
+		log_warn("Dropping empty index \"%s\".\"%s\" on the target database "
+				 "before building it again",
+				 index->indexNamespace,
+				 index->indexRelname);
+	}
+	else
+	{
+		log_info("Skipping index \"%s\".\"%s\" which already exists "
+				 "on the target database with the same definition",
+				 index->indexNamespace,
+				 index->indexRelname);
+
+		free(state.indexDef);
+		*buildIndex = false;
+
+		return true;
+	}
+
+	char sql[BUFSIZE] = { 0 };
+
+	sformat(sql, sizeof(sql), "DROP INDEX IF EXISTS \"%s\".\"%s\"",
+			index->indexNamespace,
+			index->indexRelname);
+
+	if (!pgsql_execute(dst, sql))
+	{
+		log_error("Failed to drop index \"%s\".\"%s\" on the target database, "
+				  "which conflicts with the index definition \"%s\" from the "
+				  "source database",
+				  index->indexNamespace,
+				  index->indexRelname,
+				  index->indexDef);
+
+		free(state.indexDef);
+		return false;
+	}
+
+	free(state.indexDef);
+
+	return true;
+}
+
+
 /*
  * copydb_index_is_being_processed checks lock and done files to see if a given
  * index is already being processed, or has been processed entirely by another
@@ -845,7 +956,7 @@ copydb_index_is_being_processed(SourceIndex *index,
 	/* enter the critical section */
 	(void) semaphore_lock(lockFileSemaphore);
 
-	if (file_exists(doneFile))
+	if (journal_file_exists(doneFile))
 	{
 		*isDone = true;
 		*isBeingProcessed = false;
@@ -0,0 +1,867 @@
+/*
+ * src/bin/pgcopydb/journal.c
+ *	 Append-only progress journal, used in place of per-object done files.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "postgres_fe.h"
+#include "pqexpbuffer.h"
+
+#include "defaults.h"
+#include "file_utils.h"
+#include "journal.h"
+#include "log.h"
+#include "string_utils.h"
+
+
+/*
+ * The progress journal is shared by all the pgcopydb processes that use the
+ * same work directory: sub-processes inherit it from their parent process,
+ * append their own records, and read the records appended by the other
+ * processes when looking up a done file.
+ */
+static ProgressJournal journal = { .fd = -1 };
+
+
+static void journal_reset(void);
+static bool journal_refresh(void);
+static bool journal_parse(char *buffer, long size, long *consumed);
+static bool journal_parse_header(char *ptr, char *end,
+								 unsigned int *crc, long *len, char **name,
+								 char **data);
+static char * journal_next_record(char *ptr, char *end);
+static bool journal_add_entry(const char *name, const char *data, long size);
+static JournalEntry * journal_lookup(const char *filePath);
+static const char * journal_entry_name(const char *filePath);
+static uint32_t journal_crc32(const char *name, const char *data, long size);
+
+
+/*
+ * journal_init initializes the progress journal for the given work
+ * directory. The journal file is only created when the first record is
+ * appended to it.
+ */
+bool
+journal_init(const char *topdir, const char *filename)
+{
+	journal_reset();
+
+	journal.initialized = true;
+
+	strlcpy(journal.topdir, topdir, sizeof(journal.topdir));
+	strlcpy(journal.filename, filename, sizeof(journal.filename));
+
+	return true;
+}
+
+
+/*
+ * journal_use_progress_files switches to writing one file per done object, as
+ * with previous versions of pgcopydb. Done files found in the journal are
+ * still used when reading.
+ */
+void
+journal_use_progress_files(bool progressFiles)
+{
+	journal.progressFiles = progressFiles;
+}
+
+
+/*
+ * journal_write_file appends a record for the given done file to the
+ * journal, or writes the file itself when the journal is not in use.
+ *
+ * Records are appended with a single write(2) call on a file descriptor
+ * opened with O_APPEND, so that concurrent processes do not interleave
+ * their records. The file is only fsync'ed every JOURNAL_FSYNC_BATCH
+ * records, see journal_sync().
+ */
+bool
+journal_write_file(char *data, long fileSize, const char *filePath)
+{
+	if (!journal.initialized || journal.progressFiles)
+	{
+		return write_file(data, fileSize, filePath);
+	}
+
+	/* the journal file might have been removed, e.g. with --restart */
+	if (journal.fd != -1)
+	{
+		struct stat st = { 0 };
+
+		if (fstat(journal.fd, &st) != 0 || st.st_nlink == 0)
+		{
+			close(journal.fd);
+			journal.fd = -1;
+		}
+	}
+
+	if (journal.fd == -1)
+	{
+		journal.fd = open(journal.filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+		if (journal.fd == -1)
+		{
+			log_error("Failed to open journal file \"%s\": %m",
+					  journal.filename);
+			return false;
+		}
+
+		journal.pending = 0;
+	}
+
+	const char *name = journal_entry_name(filePath);
+	uint32_t crc = journal_crc32(name, data, fileSize);
+
+	PQExpBuffer record = createPQExpBuffer();
+
+	appendPQExpBuffer(record, "%08x %ld %s\n", crc, fileSize, name);
+	appendBinaryPQExpBuffer(record, data, fileSize);
+	appendPQExpBufferChar(record, '\n');
+
+	if (PQExpBufferBroken(record))
+	{
+		log_error("Failed to prepare journal record for \"%s\": out of memory",
+				  filePath);
+		destroyPQExpBuffer(record);
+		return false;
+	}
+
+	size_t written = 0;
+
+	while (written < record->len)
+	{
+		ssize_t bytes =
+			write(journal.fd, record->data + written, record->len - written);
+
+		if (bytes < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			log_error("Failed to write to journal file \"%s\": %m",
+					  journal.filename);
+			destroyPQExpBuffer(record);
+			return false;
+		}
+
+		written += bytes;
+	}
+
+	destroyPQExpBuffer(record);
+
+	if (++journal.pending >= JOURNAL_FSYNC_BATCH)
+	{
+		return journal_sync();
+	}
+
+	return true;
+}
+
+
+/*
+ * journal_file_exists returns true when the given done file has been
+ * registered in the journal, or otherwise exists on-disk.
+ */
+bool
+journal_file_exists(const char *filePath)
+{
+	if (journal_lookup(filePath) != NULL)
+	{
+		return true;
+	}
+
+	return file_exists(filePath);
+}
+
+
+/*
+ * journal_read_file reads the contents of the given done file from the
+ * journal, or otherwise from the file on-disk. The contents are returned in
+ * a malloc'ed area, like read_file() does.
+ */
+bool
+journal_read_file(const char *filePath, char **contents, long *fileSize)
+{
+	JournalEntry *entry = journal_lookup(filePath);
+
+	if (entry == NULL)
+	{
+		return read_file(filePath, contents, fileSize);
+	}
+
+	*contents = (char *) malloc(entry->size + 1);
+
+	if (*contents == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	memcpy(*contents, entry->contents, entry->size);
+	(*contents)[entry->size] = '\0';
+
+	*fileSize = entry->size;
+
+	return true;
+}
+
+
+/*
+ * journal_iter calls the given callback function with the full path of each
+ * done file registered in the journal.
+ */
+bool
+journal_iter(void *context, JournalIterFun *callback)
+{
+	if (!journal.initialized)
+	{
+		return true;
+	}
+
+	if (!journal_refresh())
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	JournalEntry *entry;
+	JournalEntry *tmp;
+
+	HASH_ITER(hh, journal.entries, entry, tmp)
+	{
+		char filePath[MAXPGPATH] = { 0 };
+
+		sformat(filePath, sizeof(filePath), "%s/%s",
+				journal.topdir,
+				entry->filename);
+
+		if (!(*callback)(context, filePath))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * journal_sync fsyncs the records that this process appended to the journal.
+ */
+bool
+journal_sync(void)
+{
+	if (journal.fd == -1 || journal.pending == 0)
+	{
+		return true;
+	}
+
+	if (fsync(journal.fd) != 0)
+	{
+		log_error("Failed to fsync journal file \"%s\": %m", journal.filename);
+		return false;
+	}
+
+	journal.pending = 0;
+
+	return true;
+}
+
+
+/*
+ * journal_compact rewrites the journal file with a single record per done
+ * file, skipping the records that have been overwritten or that failed their
+ * checksum. The new file is written next to the current one and then renamed
+ * over it, so that a crash at any point leaves a usable journal.
+ *
+ * Compacting is only safe when no other process appends to the journal, so
+ * it is done by the main pgcopydb command when it starts.
+ */
+bool
+journal_compact(void)
+{
+	if (!journal.initialized || !file_exists(journal.filename))
+	{
+		return true;
+	}
+
+	if (!journal_refresh())
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	int count = HASH_COUNT(journal.entries);
+
+	if (journal.corrupted == 0 && journal.records == count)
+	{
+		log_debug("Journal \"%s\" has %d records, no compaction needed",
+				  journal.filename,
+				  count);
+		return true;
+	}
+
+	log_info("Compacting journal \"%s\" from %d to %d records "
+			 "(%d corrupted records skipped)",
+			 journal.filename,
+			 journal.records,
+			 count,
+			 journal.corrupted);
+
+	char tmpfile[MAXPGPATH] = { 0 };
+
+	sformat(tmpfile, sizeof(tmpfile), "%s.tmp", journal.filename);
+
+	int fd = open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd == -1)
+	{
+		log_error("Failed to open file \"%s\": %m", tmpfile);
+		return false;
+	}
+
+	PQExpBuffer contents = createPQExpBuffer();
+
+	JournalEntry *entry;
+	JournalEntry *tmp;
+
+	HASH_ITER(hh, journal.entries, entry, tmp)
+	{
+		uint32_t crc =
+			journal_crc32(entry->filename, entry->contents, entry->size);
+
+		appendPQExpBuffer(contents, "%08x %ld %s\n",
+						  crc,
+						  entry->size,
+						  entry->filename);
+		appendBinaryPQExpBuffer(contents, entry->contents, entry->size);
+		appendPQExpBufferChar(contents, '\n');
+	}
+
+	if (PQExpBufferBroken(contents))
+	{
+		log_error("Failed to compact journal \"%s\": out of memory",
+				  journal.filename);
+		destroyPQExpBuffer(contents);
+		close(fd);
+		return false;
+	}
+
+	size_t written = 0;
+
+	while (written < contents->len)
+	{
+		ssize_t bytes =
+			write(fd, contents->data + written, contents->len - written);
+
+		if (bytes < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			log_error("Failed to write file \"%s\": %m", tmpfile);
+			destroyPQExpBuffer(contents);
+			close(fd);
+			return false;
+		}
+
+		written += bytes;
+	}
+
+	destroyPQExpBuffer(contents);
+
+	if (fsync(fd) != 0 || close(fd) != 0)
+	{
+		log_error("Failed to fsync file \"%s\": %m", tmpfile);
+		return false;
+	}
+
+	if (rename(tmpfile, journal.filename) != 0)
+	{
+		log_error("Failed to rename \"%s\" to \"%s\": %m",
+				  tmpfile,
+				  journal.filename);
+		return false;
+	}
+
+	/* load the compacted journal file again */
+	journal_reset();
+
+	return journal_refresh();
+}
+
+
+/*
+ * journal_reset frees the in-memory index of the journal, and closes the
+ * journal file.
+ */
+static void
+journal_reset(void)
+{
+	JournalEntry *entry;
+	JournalEntry *tmp;
+
+	HASH_ITER(hh, journal.entries, entry, tmp)
+	{
+		HASH_DEL(journal.entries, entry);
+
+		free(entry->filename);
+		free(entry->contents);
+		free(entry);
+	}
+
+	if (journal.fd != -1)
+	{
+		(void) journal_sync();
+		close(journal.fd);
+	}
+
+	journal.entries = NULL;
+	journal.fd = -1;
+	journal.pending = 0;
+	journal.inode = 0;
+	journal.offset = 0;
+	journal.records = 0;
+	journal.corrupted = 0;
+}
+
+
+/*
+ * journal_refresh loads the records that have been appended to the journal
+ * file since the last time we read it, by this or another process.
+ */
+static bool
+journal_refresh(void)
+{
+	struct stat st = { 0 };
+
+	if (stat(journal.filename, &st) != 0)
+	{
+		if (errno == ENOENT)
+		{
+			/* no journal yet, or the work directory has been removed */
+			if (journal.inode != 0)
+			{
+				journal_reset();
+			}
+
+			return true;
+		}
+
+		log_error("Failed to stat journal file \"%s\": %m", journal.filename);
+		return false;
+	}
+
+	/* the journal might have been compacted, or removed and created again */
+	if (journal.inode != 0 && journal.inode != st.st_ino)
+	{
+		journal_reset();
+	}
+
+	journal.inode = st.st_ino;
+
+	if (st.st_size <= journal.offset)
+	{
+		return true;
+	}
+
+	long size = st.st_size - journal.offset;
+	char *buffer = (char *) malloc(size + 1);
+
+	if (buffer == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	int fd = open(journal.filename, O_RDONLY);
+
+	if (fd == -1)
+	{
+		log_error("Failed to open journal file \"%s\": %m", journal.filename);
+		free(buffer);
+		return false;
+	}
+
+	long bytesRead = 0;
+
+	while (bytesRead < size)
+	{
+		ssize_t bytes = pread(fd,
+							  buffer + bytesRead,
+							  size - bytesRead,
+							  journal.offset + bytesRead);
+
+		if (bytes < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			log_error("Failed to read journal file \"%s\": %m",
+					  journal.filename);
+			close(fd);
+			free(buffer);
+			return false;
+		}
+
+		if (bytes == 0)
+		{
+			break;
+		}
+
+		bytesRead += bytes;
+	}
+
+	close(fd);
+
+	buffer[bytesRead] = '\0';
+
+	long consumed = 0;
+
+	if (!journal_parse(buffer, bytesRead, &consumed))
+	{
+		/* errors have already been logged */
+		free(buffer);
+		return false;
+	}
+
+	journal.offset += consumed;
+
+	free(buffer);
+
+	return true;
+}
+
+
+/*
+ * journal_parse parses the journal records found in the given buffer. A
+ * record that is not complete yet, because it is being appended by another
+ * process, is left for the next call: the consumed count stops before it.
+ *
+ * Records are appended with a single write(2), so an incomplete record that
+ * is followed by a complete one has been torn, by a crash for instance. Such
+ * a record, and a record that fails its checksum, are skipped: parsing then
+ * resumes at the next line that starts a valid record.
+ */
+static bool
+journal_parse(char *buffer, long size, long *consumed)
+{
+	char *ptr = buffer;
+	char *end = buffer + size;
+
+	while (ptr < end)
+	{
+		char *eol = memchr(ptr, '\n', end - ptr);
+
+		if (eol == NULL)
+		{
+			break;
+		}
+
+		unsigned int crc = 0;
+		long len = 0;
+		char *name = NULL;
+		char *data = NULL;
+
+		if (!journal_parse_header(ptr, end, &crc, &len, &name, &data))
+		{
+			log_warn("Skipping corrupted journal record header \"%.*s\"",
+					 (int) (eol - ptr), ptr);
+
+			char *next = journal_next_record(eol + 1, end);
+
+			++journal.corrupted;
+			ptr = next != NULL ? next : eol + 1;
+			continue;
+		}
+
+		/* wait until the whole record has been written, unless it's torn */
+		if (data + len >= end)
+		{
+			char *next = journal_next_record(eol + 1, end);
+
+			if (next == NULL)
+			{
+				*eol = '\n';
+				break;
+			}
+
+			log_warn("Skipping torn journal record for \"%s\"", name);
+
+			++journal.corrupted;
+			ptr = next;
+			continue;
+		}
+
+		if (data[len] != '\n' || journal_crc32(name, data, len) != crc)
+		{
+			log_warn("Skipping corrupted journal record for \"%s\"", name);
+
+			char *next = journal_next_record(eol + 1, end);
+
+			++journal.corrupted;
+			ptr = next != NULL ? next : eol + 1;
+			continue;
+		}
+
+		if (!journal_add_entry(name, data, len))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		ptr = data + len + 1;
+	}
+
+	*consumed = ptr - buffer;
+
+	return true;
+}
+
+
+/*
+ * journal_parse_header parses the header line of the journal record that
+ * starts at ptr, and terminates the line. The record name is then found at
+ * name, and its contents at data, with len bytes that might not all have been
+ * written yet. Returns false when the header is invalid, including when len
+ * is larger than JOURNAL_RECORD_MAX_SIZE.
+ */
+static bool
+journal_parse_header(char *ptr, char *end,
+					 unsigned int *crc, long *len, char **name, char **data)
+{
+	char *eol = memchr(ptr, '\n', end - ptr);
+
+	if (eol == NULL)
+	{
+		return false;
+	}
+
+	*eol = '\0';
+
+	int n = 0;
+
+	if (sscanf(ptr, "%8x %ld %n", crc, len, &n) != 2 ||
+		n == 0 ||
+		*len < 0 ||
+		*len > JOURNAL_RECORD_MAX_SIZE)
+	{
+		*eol = '\n';
+		return false;
+	}
+
+	*name = ptr + n;
+	*data = eol + 1;
+
+	return true;
+}
+
+
+/*
+ * journal_next_record returns the start of the first line at or after ptr
+ * where a complete and valid journal record is found, or NULL.
+ */
+static char *
+journal_next_record(char *ptr, char *end)
+{
+	while (ptr < end)
+	{
+		char *eol = memchr(ptr, '\n', end - ptr);
+
+		if (eol == NULL)
+		{
+			return NULL;
+		}
+
+		unsigned int crc = 0;
+		long len = 0;
+		char *name = NULL;
+		char *data = NULL;
+
+		if (journal_parse_header(ptr, end, &crc, &len, &name, &data))
+		{
+			bool valid =
+				data + len < end &&
+				data[len] == '\n' &&
+				journal_crc32(name, data, len) == crc;
+
+			*eol = '\n';
+
+			if (valid)
+			{
+				return ptr;
+			}
+		}
+
+		ptr = eol + 1;
+	}
+
+	return NULL;
+}
+
+
+/*
+ * journal_add_entry adds or replaces an entry in the in-memory index of the
+ * journal.
+ */
+static bool
+journal_add_entry(const char *name, const char *data, long size)
+{
+	JournalEntry *entry = NULL;
+
+	HASH_FIND_STR(journal.entries, name, entry);
+
+	char *contents = (char *) malloc(size + 1);
+
+	if (contents == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	memcpy(contents, data, size);
+	contents[size] = '\0';
+
+	if (entry != NULL)
+	{
+		free(entry->contents);
+	}
+	else
+	{
+		entry = (JournalEntry *) calloc(1, sizeof(JournalEntry));
+
+		if (entry == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			free(contents);
+			return false;
+		}
+
+		entry->filename = strdup(name);
+
+		if (entry->filename == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			free(contents);
+			free(entry);
+			return false;
+		}
+
+		HASH_ADD_KEYPTR(hh,
+						journal.entries,
+						entry->filename,
+						strlen(entry->filename),
+						entry);
+	}
+
+	entry->contents = contents;
+	entry->size = size;
+
+	++journal.records;
+
+	return true;
+}
+
+
+/*
+ * journal_lookup returns the journal entry for the given done file, or NULL.
+ */
+static JournalEntry *
+journal_lookup(const char *filePath)
+{
+	if (!journal.initialized)
+	{
+		return NULL;
+	}
+
+	if (!journal_refresh())
+	{
+		log_warn("Failed to read journal file \"%s\", "
+				 "see above for details",
+				 journal.filename);
+	}
+
+	JournalEntry *entry = NULL;
+	const char *name = journal_entry_name(filePath);
+
+	HASH_FIND_STR(journal.entries, name, entry);
+
+	return entry;
+}
+
+
+/*
+ * journal_entry_name returns the given path relative to the work directory.
+ */
+static const char *
+journal_entry_name(const char *filePath)
+{
+	size_t len = strlen(journal.topdir);
+
+	if (len > 0 &&
+		strncmp(filePath, journal.topdir, len) == 0 &&
+		filePath[len] == '/')
+	{
+		return filePath + len + 1;
+	}
+
+	return filePath;
+}
+
+
+/*
+ * journal_crc32 computes the CRC-32 (IEEE 802.3) checksum of a journal
+ * record key and contents.
+ */
+static uint32_t
+journal_crc32(const char *name, const char *data, long size)
+{
+	static uint32_t table[256];
+	static bool tableReady = false;
+
+	if (!tableReady)
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+
+			for (int k = 0; k < 8; k++)
+			{
+				c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			}
+
+			table[i] = c;
+		}
+
+		tableReady = true;
+	}
+
+	uint32_t crc = 0xFFFFFFFF;
+
+	for (const char *p = name; *p != '\0'; p++)
+	{
+		crc = table[(crc ^ (unsigned char) *p) & 0xFF] ^ (crc >> 8);
+	}
+
+	for (long i = 0; i < size; i++)
+	{
+		crc = table[(crc ^ (unsigned char) data[i]) & 0xFF] ^ (crc >> 8);
+	}
+
+	return crc ^ 0xFFFFFFFF;
+}
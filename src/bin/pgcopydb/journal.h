@@ -0,0 +1,73 @@
+/*
+ * src/bin/pgcopydb/journal.h
+ *	 Append-only progress journal, used in place of per-object done files.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "postgres_fe.h"
+
+#include "uthash.h"
+
+/* fsync(2) the journal file every so many records */
+#define JOURNAL_FSYNC_BATCH 64
+
+/* a done file is a few lines of text, a larger record header is corrupted */
+#define JOURNAL_RECORD_MAX_SIZE (1024 * 1024)
+
+/*
+ * The journal registers the contents of the per-object done files (tables,
+ * table parts, indexes, constraints) as records in a single append-only file
+ * rather than as one file each. Every record contains a checksum of its key
+ * and contents, so that a torn or corrupted record is detected and skipped
+ * when loading the journal.
+ *
+ * The key of a record is the path of the done file it replaces, relative to
+ * the work directory.
+ */
+typedef struct JournalEntry
+{
+	char *filename;             /* malloc'ed area, hash key */
+	char *contents;             /* malloc'ed area */
+	long size;
+
+	UT_hash_handle hh;
+} JournalEntry;
+
+typedef struct ProgressJournal
+{
+	bool initialized;
+	bool progressFiles;         /* write per-object files instead */
+
+	char topdir[MAXPGPATH];
+	char filename[MAXPGPATH];
+
+	int fd;                     /* opened for append on first write */
+	int pending;                /* records not yet fsync'ed */
+
+	/* in-memory index of the journal file contents */
+	ino_t inode;
+	off_t offset;
+	int records;
+	int corrupted;
+	JournalEntry *entries;
+} ProgressJournal;
+
+typedef bool (JournalIterFun)(void *context, const char *filePath);
+
+bool journal_init(const char *topdir, const char *filename);
+void journal_use_progress_files(bool progressFiles);
+
+bool journal_write_file(char *data, long fileSize, const char *filePath);
+bool journal_file_exists(const char *filePath);
+bool journal_read_file(const char *filePath, char **contents, long *fileSize);
+bool journal_iter(void *context, JournalIterFun *callback);
+
+bool journal_sync(void);
+bool journal_compact(void);
+
+#endif /* JOURNAL_H */
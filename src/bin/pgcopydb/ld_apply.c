@@ -13,6 +13,7 @@
 #include "postgres_fe.h"
 #include "access/xlog_internal.h"
 #include "access/xlogdefs.h"
+#include "pqexpbuffer.h"
 
 #include "parson.h"
 
@@ -31,6 +32,16 @@
 #include "string_utils.h"
 #include "summary.h"
 
+static bool stream_apply_pipeline_sync(StreamApplyContext *context);
+static bool stream_apply_group_commit(StreamApplyContext *context,
+									  LogicalMessageMetadata *metadata);
+static PGSQL * stream_apply_connection(StreamApplyContext *context,
+									   PreparedStmt ***preparedStmt);
+static bool stream_apply_prepare_connection(PGSQL *pgsql,
+											PreparedStmt **preparedStmt,
+											PreparedStmt *statement);
+static void stream_apply_copy_escape(PQExpBuffer buf, const char *value);
+
 
 /*
  * stream_apply_catchup catches up with SQL files that have been prepared by
@@ -66,6 +77,10 @@ stream_apply_catchup(StreamSpecs *specs)
 	log_debug("Source database wal_segment_size is %u", context.WalSegSz);
 	log_debug("Source database timeline is %d", context.system.timeline);
 
+	context.pipeline.enabled = specs->pipeline;
+	context.jobs.count = specs->applyJobs;
+	context.group.maxTransactions = specs->groupCommit;
+
 	if (!setupReplicationOrigin(&context,
 								&(specs->paths),
 								specs->source_pguri,
@@ -126,7 +141,7 @@ stream_apply_catchup(StreamSpecs *specs)
 			log_info("File \"%s\" does not exists yet, exit",
 					 context.sqlFileName);
 
-			(void) pgsql_finish(&(context.pgsql));
+			(void) stream_apply_disconnect(&context);
 			return true;
 		}
 
@@ -136,7 +151,7 @@ stream_apply_catchup(StreamSpecs *specs)
 		if (!stream_apply_file(&context))
 		{
 			/* errors have already been logged */
-			(void) pgsql_finish(&(context.pgsql));
+			(void) stream_apply_disconnect(&context);
 			return false;
 		}
 
@@ -171,7 +186,7 @@ stream_apply_catchup(StreamSpecs *specs)
 		if (!computeSQLFileName(&context))
 		{
 			/* errors have already been logged */
-			(void) pgsql_finish(&(context.pgsql));
+			(void) stream_apply_disconnect(&context);
 			return false;
 		}
 
@@ -186,13 +201,13 @@ stream_apply_catchup(StreamSpecs *specs)
 					 currentSQLFileName,
 					 LSN_FORMAT_ARGS(context.previousLSN));
 
-			(void) pgsql_finish(&(context.pgsql));
+			(void) stream_apply_disconnect(&context);
 			return true;
 		}
 	}
 
 	/* we might still have to disconnect now */
-	(void) pgsql_finish(&(context.pgsql));
+	(void) stream_apply_disconnect(&context);
 
 	return true;
 }
@@ -296,7 +311,9 @@ stream_apply_sync_sentinel(StreamApplyContext *context)
 	/* limit the amount of logging of the apply process */
 	src.logSQL = context->logSQL;
 
-	if (!pgsql_sync_sentinel_apply(&src, context->previousLSN, &sentinel))
+	if (!pgsql_sync_sentinel_apply(&src,
+								   stream_apply_replayed_lsn(context),
+								   &sentinel))
 	{
 		log_warn("Failed to sync progress with the pgcopydb sentinel");
 	}
@@ -332,7 +349,7 @@ stream_apply_send_sync_sentinel(StreamApplyContext *context)
 	/* limit the amount of logging of the apply process */
 	src->logSQL = true;
 
-	if (!pgsql_send_sync_sentinel_apply(src, context->previousLSN))
+	if (!pgsql_send_sync_sentinel_apply(src, stream_apply_replayed_lsn(context)))
 	{
 		log_error("Failed to sync progress with the pgcopydb sentinel");
 		return false;
@@ -465,6 +482,21 @@ stream_apply_file(StreamApplyContext *context)
 	free(content.buffer);
 	free(content.lines);
 
+	/* commit the transactions of the current group, if any */
+	if (!stream_apply_keepalive_flush(context) ||
+		!stream_apply_group_flush(context))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* make sure the changes sent in pipeline mode have been applied */
+	if (!stream_apply_pipeline_drain(context))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	return true;
 }
 
@@ -550,16 +582,40 @@ stream_apply_sql(StreamApplyContext *context,
 				return true;
 			}
 
+			context->inTransaction = true;
+
+			/*
+			 * When using --apply-jobs, pick a connection that is not applying
+			 * a conflicting transaction.
+			 */
+			if (context->jobs.count > 1)
+			{
+				if (!stream_apply_jobs_begin(context, metadata, sql))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+
+				break;
+			}
+
 			/*
 			 * We're all good to replay that transaction, let's BEGIN and
-			 * register our origin tracking on the target database.
+			 * register our origin tracking on the target database. With
+			 * --group-commit, the target transaction might be open already.
 			 */
-			if (!pgsql_begin(pgsql))
+			if (context->group.count == 0)
 			{
-				/* errors have already been logged */
-				return false;
+				if (!pgsql_begin(pgsql))
+				{
+					/* errors have already been logged */
+					return false;
+				}
 			}
 
+			context->pipeline.current.xid = metadata->xid;
+			context->pipeline.current.lsn = metadata->txnCommitLSN;
+
 			break;
 		}
 
@@ -570,33 +626,70 @@ stream_apply_sql(StreamApplyContext *context,
 				return true;
 			}
 
-			/*
-			 * update replication progress with metadata->lsn, that is,
-			 * transaction COMMIT LSN
-			 */
-			char lsn[PG_LSN_MAXLENGTH] = { 0 };
-
-			sformat(lsn, sizeof(lsn), "%X/%X",
-					LSN_FORMAT_ARGS(metadata->lsn));
-
-			if (!pgsql_replication_origin_xact_setup(pgsql,
-													 lsn,
-													 metadata->timestamp))
-			{
-				/* errors have already been logged */
-				return false;
-			}
-
 			log_trace("COMMIT %lld LSN %X/%X",
 					  (long long) metadata->xid,
 					  LSN_FORMAT_ARGS(metadata->lsn));
 
+			context->inTransaction = false;
 
-			/* calling pgsql_commit() would finish the connection, avoid */
-			if (!pgsql_execute(pgsql, "COMMIT"))
+			/* this COMMIT advances the replication origin further */
+			if (context->keepalive.pending &&
+				context->keepalive.lsn <= metadata->lsn)
 			{
-				/* errors have already been logged */
-				return false;
+				context->keepalive.pending = false;
+			}
+
+			if (context->jobs.count > 1)
+			{
+				/* transactions are committed in order by the dispatcher */
+				if (!stream_apply_jobs_commit(context, metadata))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+			}
+			else if (context->group.maxTransactions > 1)
+			{
+				/* the target transaction might be committed later */
+				if (!stream_apply_group_commit(context, metadata))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+			}
+			else
+			{
+				/*
+				 * update replication progress with metadata->lsn, that is,
+				 * transaction COMMIT LSN
+				 */
+				char lsn[PG_LSN_MAXLENGTH] = { 0 };
+
+				sformat(lsn, sizeof(lsn), "%X/%X",
+						LSN_FORMAT_ARGS(metadata->lsn));
+
+				if (!pgsql_replication_origin_xact_setup(pgsql,
+														 lsn,
+														 metadata->timestamp))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+
+				/* calling pgsql_commit() would finish the connection, avoid */
+				if (!pgsql_execute(pgsql, "COMMIT"))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+
+				context->pipeline.current.lsn = metadata->lsn;
+
+				if (!stream_apply_pipeline_sync(context))
+				{
+					/* errors have already been logged */
+					return false;
+				}
 			}
 
 			context->previousLSN = metadata->lsn;
@@ -673,31 +766,22 @@ stream_apply_sql(StreamApplyContext *context,
 				return true;
 			}
 
-			if (!pgsql_begin(pgsql))
+			/*
+			 * Keep the KEEPALIVE pending: the next COMMIT is going to advance
+			 * the replication origin further anyway.
+			 */
+			if (!context->keepalive.pending)
 			{
-				/* errors have already been logged */
-				return false;
-			}
+				context->keepalive.pending = true;
+				context->keepalive.previousLSN = context->previousLSN;
 
-			char lsn[PG_LSN_MAXLENGTH] = { 0 };
-
-			sformat(lsn, sizeof(lsn), "%X/%X",
-					LSN_FORMAT_ARGS(metadata->lsn));
-
-			if (!pgsql_replication_origin_xact_setup(pgsql,
-													 lsn,
-													 metadata->timestamp))
-			{
-				/* errors have already been logged */
-				return false;
+				INSTR_TIME_SET_CURRENT(context->keepalive.startTime);
 			}
 
-			/* calling pgsql_commit() would finish the connection, avoid */
-			if (!pgsql_execute(pgsql, "COMMIT"))
-			{
-				/* errors have already been logged */
-				return false;
-			}
+			context->keepalive.lsn = metadata->lsn;
+			strlcpy(context->keepalive.timestamp,
+					metadata->timestamp,
+					sizeof(context->keepalive.timestamp));
 
 			context->previousLSN = metadata->lsn;
 
@@ -715,7 +799,13 @@ stream_apply_sql(StreamApplyContext *context,
 				log_notice("Apply reached end position %X/%X at %X/%X",
 						   LSN_FORMAT_ARGS(context->endpos),
 						   LSN_FORMAT_ARGS(context->previousLSN));
-				break;
+
+				return stream_apply_keepalive_flush(context);
+			}
+
+			if (stream_apply_keepalive_timeout(context))
+			{
+				return stream_apply_keepalive_flush(context);
 			}
 
 			break;
@@ -740,7 +830,70 @@ stream_apply_sql(StreamApplyContext *context,
 				*ptr = '\0';
 			}
 
-			if (!pgsql_execute(pgsql, sql))
+			PreparedStmt **preparedStmt = NULL;
+			PGSQL *target = stream_apply_connection(context, &preparedStmt);
+
+			if (target == NULL || !pgsql_execute(target, sql))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			if (!stream_apply_pipeline_wait(context,
+											APPLY_PIPELINE_MAX_TRANSACTIONS,
+											APPLY_PIPELINE_MAX_QUERIES))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+			break;
+		}
+
+		/*
+		 * The PREPARE command is only written once per SQL file, register
+		 * the statement even when skipping already applied transactions.
+		 */
+		case STREAM_ACTION_PREPARE:
+		{
+			if (!stream_apply_prepare(context, sql))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+			break;
+		}
+
+		case STREAM_ACTION_EXECUTE:
+		{
+			if (!context->reachedStartPos)
+			{
+				return true;
+			}
+
+			if (!stream_apply_execute(context, sql))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			if (!stream_apply_pipeline_wait(context,
+											APPLY_PIPELINE_MAX_TRANSACTIONS,
+											APPLY_PIPELINE_MAX_QUERIES))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+			break;
+		}
+
+		case STREAM_ACTION_COPY:
+		{
+			if (!context->reachedStartPos)
+			{
+				return true;
+			}
+
+			if (!stream_apply_copy(context, sql))
 			{
 				/* errors have already been logged */
 				return false;
@@ -763,163 +916,1212 @@ stream_apply_sql(StreamApplyContext *context,
 
 
 /*
- * setupReplicationOrigin ensures that a replication origin has been created on
- * the target database, and if it has been created previously then fetches the
- * previous LSN position it was at.
+ * stream_apply_prepare registers the statement found in the given PREPARE
+ * command. The transform process writes the PREPARE command only once per SQL
+ * file, and the statement might then be executed on any of the target
+ * connections, so it is prepared on a connection when first executed there.
  *
- * Also setupReplicationOrigin calls pg_replication_origin_setup() in the
- * current connection, that is set to be
+ * The command looks like: PREPARE 8d1b2c3a AS INSERT INTO ... VALUES ($1);
  */
 bool
-setupReplicationOrigin(StreamApplyContext *context,
-					   CDCPaths *paths,
-					   char *source_pguri,
-					   char *target_pguri,
-					   char *origin,
-					   uint64_t endpos,
-					   bool apply,
-					   bool logSQL)
+stream_apply_prepare(StreamApplyContext *context, const char *sql)
 {
-	PGSQL *pgsql = &(context->pgsql);
-	char *nodeName = context->origin;
+	const char *ptr = sql + strlen(OUTPUT_PREPARE);
+	const char *as = strstr(ptr, " AS ");
 
-	/*
-	 * We have to consider both the --endpos command line option and the
-	 * pgcopydb sentinel endpos value. Typically the sentinel is updated after
-	 * the fact, but we still give precedence to --endpos.
-	 *
-	 * The endpos parameter here comes from the --endpos command line option,
-	 * the context->endpos might have been set by calling
-	 * stream_apply_wait_for_sentinel() earlier (when in STREAM_MODE_PREFETCH).
-	 */
-	if (endpos != InvalidXLogRecPtr)
+	if (as == NULL || (as - ptr) >= NAMEDATALEN)
 	{
-		if (context->endpos != InvalidXLogRecPtr && context->endpos != endpos)
-		{
-			log_warn("Option --endpos %X/%X is used, "
-					 "even when the pgcopydb sentinel endpos was set to %X/%X",
-					 LSN_FORMAT_ARGS(endpos),
-					 LSN_FORMAT_ARGS(context->endpos));
-		}
-		context->endpos = endpos;
+		log_error("Failed to parse PREPARE command: %s", sql);
+		return false;
 	}
 
-	context->paths = *paths;
-	context->apply = apply;
-	strlcpy(context->source_pguri, source_pguri, sizeof(context->source_pguri));
-	strlcpy(context->target_pguri, target_pguri, sizeof(context->target_pguri));
-	strlcpy(context->origin, origin, sizeof(context->origin));
+	char name[NAMEDATALEN] = { 0 };
+	strlcpy(name, ptr, as - ptr + 1);
 
-	if (!pgsql_init(pgsql, context->target_pguri, PGSQL_CONN_TARGET))
+	char *query = strdup(as + strlen(" AS "));
+
+	if (query == NULL)
 	{
-		/* errors have already been logged */
+		log_error(ALLOCATION_FAILED_ERROR);
 		return false;
 	}
 
-	/* we're going to send several replication origin commands */
-	pgsql->connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
-
-	/* we also might want to skip logging any SQL query that we apply */
-	pgsql->logSQL = logSQL;
-
-	uint32_t oid = 0;
+	/* chomp the final semi-colon that we added */
+	int len = strlen(query);
 
-	if (!pgsql_replication_origin_oid(pgsql, nodeName, &oid))
+	if (len > 0 && query[len - 1] == ';')
 	{
-		/* errors have already been logged */
-		return false;
+		query[len - 1] = '\0';
 	}
 
-	log_debug("setupReplicationOrigin: oid == %u", oid);
+	PreparedStmt *stmt = NULL;
+	HASH_FIND_STR(context->statements, name, stmt);
 
-	if (oid == 0)
+	if (stmt == NULL)
 	{
-		log_error("Failed to fetch progress for replication origin \"%s\": "
-				  "replication origin not found on target database",
-				  nodeName);
-		(void) pgsql_finish(pgsql);
-		return false;
+		stmt = (PreparedStmt *) calloc(1, sizeof(PreparedStmt));
+
+		if (stmt == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			free(query);
+			return false;
+		}
+
+		strlcpy(stmt->name, name, sizeof(stmt->name));
+		HASH_ADD_STR(context->statements, name, stmt);
 	}
 
-	if (!pgsql_replication_origin_progress(pgsql,
-										   nodeName,
-										   true,
-										   &(context->previousLSN)))
+	/* two different statements might hash to the same name */
+	free(stmt->sql);
+	stmt->sql = query;
+
+	return true;
+}
+
+
+/*
+ * stream_apply_prepare_connection makes sure that the given statement is
+ * prepared on the given connection, unless it has been prepared there
+ * already.
+ */
+static bool
+stream_apply_prepare_connection(PGSQL *pgsql,
+								PreparedStmt **preparedStmt,
+								PreparedStmt *statement)
+{
+	/* prepared statements do not survive a new connection */
+	if (pgsql->connection == NULL)
 	{
-		/* errors have already been logged */
-		return false;
+		(void) stream_free_prepared_stmts(preparedStmt);
 	}
 
-	if (IS_EMPTY_STRING_BUFFER(context->sqlFileName))
+	PreparedStmt *stmt = NULL;
+	HASH_FIND_STR(*preparedStmt, statement->name, stmt);
+
+	if (stmt != NULL)
 	{
-		if (!computeSQLFileName(context))
+		if (streq(stmt->sql, statement->sql))
+		{
+			return true;
+		}
+
+		/* two different statements hash to the same name, replace it */
+		log_debug("Replacing prepared statement %s", statement->name);
+
+		char deallocate[BUFSIZE] = { 0 };
+		sformat(deallocate, sizeof(deallocate),
+				"DEALLOCATE \"%s\"", statement->name);
+
+		if (!pgsql_execute(pgsql, deallocate))
 		{
 			/* errors have already been logged */
 			return false;
 		}
+
+		HASH_DEL(*preparedStmt, stmt);
+		free(stmt->sql);
+		free(stmt);
 	}
 
-	/* compute the WAL filename that would host the previous LSN */
-	log_debug("setupReplicationOrigin: replication origin \"%s\" "
-			  "found at %X/%X, expected in file \"%s\"",
-			  nodeName,
-			  LSN_FORMAT_ARGS(context->previousLSN),
-			  context->sqlFileName);
+	char *query = strdup(statement->sql);
 
-	if (!pgsql_replication_origin_session_setup(pgsql, nodeName))
+	if (query == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	if (!pgsql_prepare(pgsql, statement->name, query, 0, NULL))
 	{
 		/* errors have already been logged */
+		free(query);
+		return false;
+	}
+
+	stmt = (PreparedStmt *) calloc(1, sizeof(PreparedStmt));
+
+	if (stmt == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		free(query);
 		return false;
 	}
 
+	strlcpy(stmt->name, statement->name, sizeof(stmt->name));
+	stmt->sql = query;
+
+	HASH_ADD_STR(*preparedStmt, name, stmt);
+
 	return true;
 }
 
 
 /*
- * computeSQLFileName updates the StreamApplyContext structure with the current
- * LSN applied to the target system, and computed
+ * stream_apply_execute executes a statement that has been registered already,
+ * using the JSON array of parameters found in the given EXECUTE command.
+ *
+ * The command looks like: EXECUTE 8d1b2c3a["42",null,"foo"];
  */
 bool
-computeSQLFileName(StreamApplyContext *context)
+stream_apply_execute(StreamApplyContext *context, const char *sql)
 {
-	XLogSegNo segno;
+	PreparedStmt **preparedStmt = NULL;
+	PGSQL *pgsql = stream_apply_connection(context, &preparedStmt);
 
-	if (context->WalSegSz == 0)
+	if (pgsql == NULL)
 	{
-		log_error("Failed to compute the SQL filename for LSN %X/%X "
-				  "without context->wal_segment_size",
-				  LSN_FORMAT_ARGS(context->previousLSN));
+		/* errors have already been logged */
 		return false;
 	}
 
-	XLByteToSeg(context->previousLSN, segno, context->WalSegSz);
-	XLogFileName(context->wal, context->system.timeline, segno, context->WalSegSz);
-
-	sformat(context->sqlFileName, sizeof(context->sqlFileName),
-			"%s/%s.sql",
-			context->paths.dir,
-			context->wal);
+	const char *ptr = sql + strlen(OUTPUT_EXECUTE);
+	const char *params = strchr(ptr, '[');
 
-	log_debug("computeSQLFileName: %X/%X \"%s\"",
-			  LSN_FORMAT_ARGS(context->previousLSN),
-			  context->sqlFileName);
+	if (params == NULL || (params - ptr) >= NAMEDATALEN)
+	{
+		log_error("Failed to parse EXECUTE command: %s", sql);
+		return false;
+	}
 
-	return true;
-}
+	char name[NAMEDATALEN] = { 0 };
+	strlcpy(name, ptr, params - ptr + 1);
 
+	PreparedStmt *statement = NULL;
+	HASH_FIND_STR(context->statements, name, statement);
 
-/*
- * parseSQLAction returns the action that is implemented in the given SQL
- * query.
- */
-bool
-parseSQLAction(const char *query, LogicalMessageMetadata *metadata)
-{
-	metadata->action = STREAM_ACTION_UNKNOWN;
+	if (statement == NULL)
+	{
+		log_error("Failed to execute prepared statement %s: "
+				  "statement has not been prepared",
+				  name);
+		return false;
+	}
 
-	if (strcmp(query, "") == 0)
+	if (!stream_apply_prepare_connection(pgsql, preparedStmt, statement))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* chomp the final semi-colon that we added */
+	char *json = strdup(params);
+
+	if (json == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	int len = strlen(json);
+
+	if (len > 0 && json[len - 1] == ';')
+	{
+		json[len - 1] = '\0';
+	}
+
+	JSON_Value *js = json_parse_string(json);
+	JSON_Array *jsArray = json_value_get_array(js);
+
+	free(json);
+
+	if (jsArray == NULL)
+	{
+		log_error("Failed to parse EXECUTE parameters: %s", sql);
+		json_value_free(js);
+		return false;
+	}
+
+	int paramCount = json_array_get_count(jsArray);
+	const char **paramValues = NULL;
+
+	if (paramCount > 0)
+	{
+		paramValues = (const char **) calloc(paramCount, sizeof(char *));
+
+		if (paramValues == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			json_value_free(js);
+			return false;
+		}
+	}
+
+	for (int i = 0; i < paramCount; i++)
+	{
+		/* json_array_get_string returns NULL for JSON null values */
+		paramValues[i] = json_array_get_string(jsArray, i);
+	}
+
+	bool success =
+		pgsql_execute_prepared(pgsql, name, paramCount, paramValues,
+							   NULL, NULL);
+
+	free(paramValues);
+	json_value_free(js);
+
+	return success;
+}
+
+
+/*
+ * stream_apply_copy applies a run of INSERT statements using the COPY
+ * protocol. The command looks like:
+ *
+ * COPY {"nspname":"public","relname":"t","columns":["a"],"rows":[["1"]]};
+ *
+ * COPY is not supported in pipeline mode, so the connection leaves pipeline
+ * mode for the duration of the COPY, once the results of the statements
+ * already sent have been received.
+ */
+bool
+stream_apply_copy(StreamApplyContext *context, const char *sql)
+{
+	PreparedStmt **preparedStmt = NULL;
+	PGSQL *pgsql = stream_apply_connection(context, &preparedStmt);
+
+	if (pgsql == NULL)
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* chomp the final semi-colon that we added */
+	char *json = strdup(sql + strlen(OUTPUT_COPY));
+
+	if (json == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	int len = strlen(json);
+
+	if (len > 0 && json[len - 1] == ';')
+	{
+		json[len - 1] = '\0';
+	}
+
+	JSON_Value *js = json_parse_string(json);
+	JSON_Object *jsobj = json_value_get_object(js);
+
+	free(json);
+
+	const char *nspname = json_object_get_string(jsobj, "nspname");
+	const char *relname = json_object_get_string(jsobj, "relname");
+	JSON_Array *jsColumns = json_object_get_array(jsobj, "columns");
+	JSON_Array *jsRows = json_object_get_array(jsobj, "rows");
+
+	if (nspname == NULL || relname == NULL ||
+		jsColumns == NULL || jsRows == NULL)
+	{
+		log_error("Failed to parse COPY command: %s", sql);
+		json_value_free(js);
+		return false;
+	}
+
+	int cols = json_array_get_count(jsColumns);
+	PQExpBuffer qname = createPQExpBuffer();
+	PQExpBuffer row = createPQExpBuffer();
+
+	appendPQExpBuffer(qname, "\"%s\".\"%s\" (", nspname, relname);
+
+	for (int c = 0; c < cols; c++)
+	{
+		appendPQExpBuffer(qname, "%s\"%s\"",
+						  c > 0 ? ", " : "",
+						  json_array_get_string(jsColumns, c));
+	}
+
+	appendPQExpBufferStr(qname, ")");
+
+	if (PQExpBufferBroken(qname))
+	{
+		log_error("Failed to build COPY command: out of memory");
+		destroyPQExpBuffer(qname);
+		destroyPQExpBuffer(row);
+		json_value_free(js);
+		return false;
+	}
+
+	bool pipelineMode = pgsql->pipelineMode;
+
+	if (pipelineMode)
+	{
+		if (!stream_apply_pipeline_wait(context, 0, 0) ||
+			!pgsql_pipeline_exit(pgsql))
+		{
+			/* errors have already been logged */
+			destroyPQExpBuffer(qname);
+			destroyPQExpBuffer(row);
+			json_value_free(js);
+			return false;
+		}
+	}
+
+	bool success = pg_copy_from_stdin(pgsql, qname->data);
+
+	int count = json_array_get_count(jsRows);
+
+	for (int r = 0; success && r < count; r++)
+	{
+		JSON_Array *jsRow = json_array_get_array(jsRows, r);
+
+		if (jsRow == NULL || json_array_get_count(jsRow) != cols)
+		{
+			log_error("Failed to parse row %d of COPY command: %s", r, sql);
+			success = false;
+			break;
+		}
+
+		resetPQExpBuffer(row);
+
+		for (int c = 0; c < cols; c++)
+		{
+			const char *value = json_array_get_string(jsRow, c);
+
+			if (c > 0)
+			{
+				appendPQExpBufferChar(row, '\t');
+			}
+
+			(void) stream_apply_copy_escape(row, value);
+		}
+
+		if (PQExpBufferBroken(row))
+		{
+			log_error("Failed to build COPY row: out of memory");
+			success = false;
+			break;
+		}
+
+		success = pg_copy_row_from_stdin(pgsql, "s", row->data);
+	}
+
+	/* pg_copy_row_from_stdin closes the connection on errors */
+	if (pgsql->connection != NULL)
+	{
+		if (success)
+		{
+			success = pg_copy_end(pgsql);
+		}
+		else
+		{
+			(void) pgsql_finish(pgsql);
+		}
+	}
+
+	destroyPQExpBuffer(qname);
+	destroyPQExpBuffer(row);
+	json_value_free(js);
+
+	if (!success)
+	{
+		log_error("Failed to COPY %d rows into \"%s\".\"%s\", "
+				  "see above for details",
+				  count,
+				  nspname,
+				  relname);
+		return false;
+	}
+
+	if (pipelineMode)
+	{
+		return pgsql_pipeline_enter(pgsql);
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_apply_copy_escape appends the given value to the buffer in the COPY text
+ * format, where NULL is represented as \N.
+ */
+static void
+stream_apply_copy_escape(PQExpBuffer buf, const char *value)
+{
+	if (value == NULL)
+	{
+		appendPQExpBufferStr(buf, "\\N");
+		return;
+	}
+
+	for (const char *p = value; *p != '\0'; p++)
+	{
+		switch (*p)
+		{
+			case '\\':
+			{
+				appendPQExpBufferStr(buf, "\\\\");
+				break;
+			}
+
+			case '\t':
+			{
+				appendPQExpBufferStr(buf, "\\t");
+				break;
+			}
+
+			case '\n':
+			{
+				appendPQExpBufferStr(buf, "\\n");
+				break;
+			}
+
+			case '\r':
+			{
+				appendPQExpBufferStr(buf, "\\r");
+				break;
+			}
+
+			default:
+			{
+				appendPQExpBufferChar(buf, *p);
+				break;
+			}
+		}
+	}
+}
+
+
+/*
+ * stream_apply_free_prepared releases the memory used to track statements
+ * found in the SQL files and prepared on the current connection.
+ */
+void
+stream_apply_free_prepared(StreamApplyContext *context)
+{
+	(void) stream_free_prepared_stmts(&(context->statements));
+	(void) stream_free_prepared_stmts(&(context->preparedStmt));
+}
+
+
+/*
+ * stream_free_prepared_stmts releases the memory used by the given hash table
+ * of prepared statements.
+ */
+void
+stream_free_prepared_stmts(PreparedStmt **preparedStmt)
+{
+	PreparedStmt *stmt = NULL;
+	PreparedStmt *tmp = NULL;
+
+	HASH_ITER(hh, *preparedStmt, stmt, tmp)
+	{
+		HASH_DEL(*preparedStmt, stmt);
+		free(stmt->sql);
+		free(stmt);
+	}
+
+	*preparedStmt = NULL;
+}
+
+
+/*
+ * stream_apply_connection returns the target connection where to apply the
+ * statements of the current transaction, and the statements that have been
+ * prepared on that connection.
+ */
+static PGSQL *
+stream_apply_connection(StreamApplyContext *context,
+						PreparedStmt ***preparedStmt)
+{
+	if (context->jobs.count > 1)
+	{
+		return stream_apply_jobs_connection(context, preparedStmt);
+	}
+
+	*preparedStmt = &(context->preparedStmt);
+
+	return &(context->pgsql);
+}
+
+
+/*
+ * stream_apply_disconnect closes the target connections and releases the
+ * memory used to track their prepared statements.
+ */
+void
+stream_apply_disconnect(StreamApplyContext *context)
+{
+	(void) pgsql_finish(&(context->pgsql));
+	(void) stream_apply_free_prepared(context);
+
+	if (context->jobs.count > 1)
+	{
+		(void) stream_apply_jobs_finish(context);
+	}
+}
+
+
+/*
+ * stream_apply_pipeline_enter switches the target connection to pipeline
+ * mode, where SQL commands are sent without waiting for their results.
+ */
+bool
+stream_apply_pipeline_enter(StreamApplyContext *context)
+{
+	if (!pgsql_pipeline_enter(&(context->pgsql)))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	context->pipeline.first = 0;
+	context->pipeline.count = 0;
+	context->pipeline.appliedLSN = context->previousLSN;
+
+	log_info("Applying changes in pipeline mode, "
+			 "with up to %d transactions in flight",
+			 APPLY_PIPELINE_MAX_TRANSACTIONS);
+
+	return true;
+}
+
+
+/*
+ * stream_apply_pipeline_sync ends the current transaction in the pipeline
+ * with a sync point, and registers the transaction as being in flight.
+ */
+static bool
+stream_apply_pipeline_sync(StreamApplyContext *context)
+{
+	ApplyPipeline *pipeline = &(context->pipeline);
+
+	if (!pipeline->enabled)
+	{
+		return true;
+	}
+
+	/* make room for the current transaction */
+	if (!stream_apply_pipeline_wait(context,
+									APPLY_PIPELINE_MAX_TRANSACTIONS - 1,
+									APPLY_PIPELINE_MAX_QUERIES))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!pgsql_pipeline_sync(&(context->pgsql)))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	int last = (pipeline->first + pipeline->count) %
+			   APPLY_PIPELINE_MAX_TRANSACTIONS;
+
+	pipeline->txns[last] = pipeline->current;
+	++(pipeline->count);
+
+	return true;
+}
+
+
+/*
+ * stream_apply_pipeline_wait consumes results from the pipeline until no more
+ * than maxTransactions transactions and maxQueries queries are in flight.
+ *
+ * A failed query is reported with the transaction it belongs to: that's the
+ * oldest transaction in flight, or the transaction being sent when all the
+ * previous ones have been confirmed already.
+ */
+bool
+stream_apply_pipeline_wait(StreamApplyContext *context,
+						   int maxTransactions,
+						   int maxQueries)
+{
+	PGSQL *pgsql = &(context->pgsql);
+	ApplyPipeline *pipeline = &(context->pipeline);
+
+	if (context->jobs.count > 1)
+	{
+		return stream_apply_jobs_wait(context, maxQueries);
+	}
+
+	if (!pipeline->enabled)
+	{
+		return true;
+	}
+
+	while (pipeline->count > maxTransactions ||
+		   pgsql->pipelineQueries > maxQueries)
+	{
+		bool isSync = false;
+		bool success = false;
+
+		if (!pgsql_pipeline_consume(pgsql, &isSync, &success))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		ApplyPipelineTxn *txn =
+			pipeline->count > 0
+			? &(pipeline->txns[pipeline->first])
+			: &(pipeline->current);
+
+		if (!success)
+		{
+			(void) stream_apply_log_txn_failure(txn);
+			return false;
+		}
+
+		if (isSync)
+		{
+			if (pipeline->count == 0)
+			{
+				log_error("BUG: stream_apply_pipeline_wait consumed a sync "
+						  "point without a transaction in flight");
+				return false;
+			}
+
+			pipeline->appliedLSN = txn->lsn;
+
+			pipeline->first =
+				(pipeline->first + 1) % APPLY_PIPELINE_MAX_TRANSACTIONS;
+			--(pipeline->count);
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_apply_pipeline_drain waits until all the queries sent in pipeline
+ * mode have been processed by the target database.
+ */
+bool
+stream_apply_pipeline_drain(StreamApplyContext *context)
+{
+	if (context->jobs.count > 1)
+	{
+		return stream_apply_jobs_drain(context);
+	}
+
+	return stream_apply_pipeline_wait(context, 0, 0);
+}
+
+
+/*
+ * stream_apply_group_commit registers that the current source transaction is
+ * complete, and commits the target transaction when the group is full, when
+ * it has been open for long enough, or when the endpos has been reached.
+ */
+static bool
+stream_apply_group_commit(StreamApplyContext *context,
+						  LogicalMessageMetadata *metadata)
+{
+	ApplyGroupCommit *group = &(context->group);
+
+	if (group->count == 0)
+	{
+		INSTR_TIME_SET_CURRENT(group->startTime);
+	}
+
+	group->lsn = metadata->lsn;
+	strlcpy(group->timestamp, metadata->timestamp, sizeof(group->timestamp));
+
+	++(group->count);
+
+	if (group->count >= group->maxTransactions ||
+		stream_apply_group_timeout(context) ||
+		(context->endpos != InvalidXLogRecPtr &&
+		 context->endpos <= metadata->lsn))
+	{
+		return stream_apply_group_flush(context);
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_apply_group_flush commits the target transaction that contains the
+ * source transactions of the current group, if any, and advances the
+ * replication origin to the COMMIT LSN of the last one.
+ *
+ * A source transaction that is still being applied can not be committed yet,
+ * in that case the group remains open.
+ */
+bool
+stream_apply_group_flush(StreamApplyContext *context)
+{
+	PGSQL *pgsql = &(context->pgsql);
+	ApplyGroupCommit *group = &(context->group);
+
+	if (group->count == 0 || context->inTransaction)
+	{
+		return true;
+	}
+
+	char lsn[PG_LSN_MAXLENGTH] = { 0 };
+
+	sformat(lsn, sizeof(lsn), "%X/%X", LSN_FORMAT_ARGS(group->lsn));
+
+	if (!pgsql_replication_origin_xact_setup(pgsql, lsn, group->timestamp))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* calling pgsql_commit() would finish the connection, avoid */
+	if (!pgsql_execute(pgsql, "COMMIT"))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	context->pipeline.current.lsn = group->lsn;
+
+	if (!stream_apply_pipeline_sync(context))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	log_debug("Committed %d transactions up to COMMIT LSN %X/%X",
+			  group->count,
+			  LSN_FORMAT_ARGS(group->lsn));
+
+	group->committedLSN = group->lsn;
+	group->count = 0;
+
+	return true;
+}
+
+
+/*
+ * stream_apply_group_timeout returns true when the current group has been
+ * open for more than APPLY_GROUP_COMMIT_TIMEOUT_MS.
+ */
+bool
+stream_apply_group_timeout(StreamApplyContext *context)
+{
+	ApplyGroupCommit *group = &(context->group);
+
+	if (group->count == 0)
+	{
+		return false;
+	}
+
+	instr_time duration;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, group->startTime);
+
+	return INSTR_TIME_GET_MILLISEC(duration) >= APPLY_GROUP_COMMIT_TIMEOUT_MS;
+}
+
+
+/*
+ * stream_apply_keepalive_flush advances the replication origin to the LSN of
+ * the pending KEEPALIVE message, if any. When a --group-commit group is open,
+ * the group is committed at the KEEPALIVE LSN, otherwise a target transaction
+ * is used only to advance the replication origin.
+ *
+ * The replication origin session is set up on the target connection, which
+ * prevents using pg_replication_origin_advance() outside of a transaction.
+ */
+bool
+stream_apply_keepalive_flush(StreamApplyContext *context)
+{
+	PGSQL *pgsql = &(context->pgsql);
+	ApplyKeepalive *keepalive = &(context->keepalive);
+
+	if (!keepalive->pending || context->inTransaction)
+	{
+		return true;
+	}
+
+	if (context->jobs.count > 1)
+	{
+		LogicalMessageMetadata metadata = {
+			.action = STREAM_ACTION_KEEPALIVE,
+			.lsn = keepalive->lsn
+		};
+
+		strlcpy(metadata.timestamp,
+				keepalive->timestamp,
+				sizeof(metadata.timestamp));
+
+		if (!stream_apply_jobs_keepalive(context, &metadata))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		keepalive->pending = false;
+
+		return true;
+	}
+
+	if (context->group.count > 0)
+	{
+		context->group.lsn = keepalive->lsn;
+		strlcpy(context->group.timestamp,
+				keepalive->timestamp,
+				sizeof(context->group.timestamp));
+
+		keepalive->pending = false;
+
+		return stream_apply_group_flush(context);
+	}
+
+	if (!pgsql_begin(pgsql))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	context->pipeline.current.xid = 0;
+	context->pipeline.current.lsn = keepalive->lsn;
+
+	char lsn[PG_LSN_MAXLENGTH] = { 0 };
+
+	sformat(lsn, sizeof(lsn), "%X/%X", LSN_FORMAT_ARGS(keepalive->lsn));
+
+	if (!pgsql_replication_origin_xact_setup(pgsql, lsn, keepalive->timestamp))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* calling pgsql_commit() would finish the connection, avoid */
+	if (!pgsql_execute(pgsql, "COMMIT"))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/*
+	 * KEEPALIVE messages are sent when the source database is idle, wait
+	 * until all the changes in flight have been applied so that progress
+	 * reporting catches up.
+	 */
+	if (!stream_apply_pipeline_sync(context) ||
+		!stream_apply_pipeline_drain(context))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	log_debug("Advanced replication origin to KEEPALIVE LSN %X/%X",
+			  LSN_FORMAT_ARGS(keepalive->lsn));
+
+	context->group.committedLSN = keepalive->lsn;
+	keepalive->pending = false;
+
+	return true;
+}
+
+
+/*
+ * stream_apply_keepalive_timeout returns true when a KEEPALIVE message has
+ * been pending for more than APPLY_KEEPALIVE_TIMEOUT_MS.
+ */
+bool
+stream_apply_keepalive_timeout(StreamApplyContext *context)
+{
+	ApplyKeepalive *keepalive = &(context->keepalive);
+
+	if (!keepalive->pending)
+	{
+		return false;
+	}
+
+	instr_time duration;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, keepalive->startTime);
+
+	return INSTR_TIME_GET_MILLISEC(duration) >= APPLY_KEEPALIVE_TIMEOUT_MS;
+}
+
+
+/*
+ * stream_apply_log_txn_failure logs which transaction failed to apply.
+ */
+void
+stream_apply_log_txn_failure(ApplyPipelineTxn *txn)
+{
+	if (txn->xid == 0)
+	{
+		log_error("Failed to apply KEEPALIVE at LSN %X/%X, "
+				  "see above for details",
+				  LSN_FORMAT_ARGS(txn->lsn));
+	}
+	else
+	{
+		log_error("Failed to apply transaction %lld "
+				  "with COMMIT LSN %X/%X, see above for details",
+				  (long long) txn->xid,
+				  LSN_FORMAT_ARGS(txn->lsn));
+	}
+}
+
+
+/*
+ * stream_apply_replayed_lsn returns the LSN of the last transaction known to
+ * have been applied on the target database. In pipeline mode that might be
+ * behind the LSN of the last transaction that has been sent.
+ */
+uint64_t
+stream_apply_replayed_lsn(StreamApplyContext *context)
+{
+	if (context->jobs.count > 1)
+	{
+		return context->jobs.appliedLSN;
+	}
+
+	if (context->pipeline.enabled)
+	{
+		return context->pipeline.appliedLSN;
+	}
+
+	if (context->group.maxTransactions > 1)
+	{
+		return context->group.committedLSN;
+	}
+
+	if (context->keepalive.pending)
+	{
+		return context->keepalive.previousLSN;
+	}
+
+	return context->previousLSN;
+}
+
+
+/*
+ * setupReplicationOrigin ensures that a replication origin has been created on
+ * the target database, and if it has been created previously then fetches the
+ * previous LSN position it was at.
+ *
+ * Also setupReplicationOrigin calls pg_replication_origin_setup() in the
+ * current connection, that is set to be
+ */
+bool
+setupReplicationOrigin(StreamApplyContext *context,
+					   CDCPaths *paths,
+					   char *source_pguri,
+					   char *target_pguri,
+					   char *origin,
+					   uint64_t endpos,
+					   bool apply,
+					   bool logSQL)
+{
+	PGSQL *pgsql = &(context->pgsql);
+	char *nodeName = context->origin;
+
+	/*
+	 * We have to consider both the --endpos command line option and the
+	 * pgcopydb sentinel endpos value. Typically the sentinel is updated after
+	 * the fact, but we still give precedence to --endpos.
+	 *
+	 * The endpos parameter here comes from the --endpos command line option,
+	 * the context->endpos might have been set by calling
+	 * stream_apply_wait_for_sentinel() earlier (when in STREAM_MODE_PREFETCH).
+	 */
+	if (endpos != InvalidXLogRecPtr)
+	{
+		if (context->endpos != InvalidXLogRecPtr && context->endpos != endpos)
+		{
+			log_warn("Option --endpos %X/%X is used, "
+					 "even when the pgcopydb sentinel endpos was set to %X/%X",
+					 LSN_FORMAT_ARGS(endpos),
+					 LSN_FORMAT_ARGS(context->endpos));
+		}
+		context->endpos = endpos;
+	}
+
+	context->paths = *paths;
+	context->apply = apply;
+	strlcpy(context->source_pguri, source_pguri, sizeof(context->source_pguri));
+	strlcpy(context->target_pguri, target_pguri, sizeof(context->target_pguri));
+	strlcpy(context->origin, origin, sizeof(context->origin));
+
+	if (!pgsql_init(pgsql, context->target_pguri, PGSQL_CONN_TARGET))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* we're going to send several replication origin commands */
+	pgsql->connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+	/* we also might want to skip logging any SQL query that we apply */
+	pgsql->logSQL = logSQL;
+
+	uint32_t oid = 0;
+
+	if (!pgsql_replication_origin_oid(pgsql, nodeName, &oid))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	log_debug("setupReplicationOrigin: oid == %u", oid);
+
+	if (oid == 0)
+	{
+		log_error("Failed to fetch progress for replication origin \"%s\": "
+				  "replication origin not found on target database",
+				  nodeName);
+		(void) pgsql_finish(pgsql);
+		return false;
+	}
+
+	if (!pgsql_replication_origin_progress(pgsql,
+										   nodeName,
+										   true,
+										   &(context->previousLSN)))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (IS_EMPTY_STRING_BUFFER(context->sqlFileName))
+	{
+		if (!computeSQLFileName(context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	/* compute the WAL filename that would host the previous LSN */
+	log_debug("setupReplicationOrigin: replication origin \"%s\" "
+			  "found at %X/%X, expected in file \"%s\"",
+			  nodeName,
+			  LSN_FORMAT_ARGS(context->previousLSN),
+			  context->sqlFileName);
+
+	if (!pgsql_replication_origin_session_setup(pgsql, nodeName))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	context->group.committedLSN = context->previousLSN;
+
+	/* --apply-jobs takes precedence over --pipeline and --group-commit */
+	if (context->jobs.count > 1)
+	{
+		if (context->group.maxTransactions > 1)
+		{
+			log_warn("Ignoring --group-commit %d when using --apply-jobs %d",
+					 context->group.maxTransactions,
+					 context->jobs.count);
+
+			context->group.maxTransactions = 1;
+		}
+
+		if (!stream_apply_jobs_start(context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+	else if (context->pipeline.enabled)
+	{
+		if (!stream_apply_pipeline_enter(context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_apply_set_replica_role sets session_replication_role to replica on
+ * the given target connection, as Postgres logical replication does: user
+ * triggers and foreign key checks do not fire when applying changes, because
+ * they already did on the source database. This is only done for the
+ * --apply-jobs connections, where foreign keys would otherwise be checked
+ * against rows that a concurrent transaction is still applying.
+ */
+bool
+stream_apply_set_replica_role(PGSQL *pgsql)
+{
+	if (!pgsql_execute(pgsql, "SET session_replication_role TO 'replica'"))
+	{
+		log_error("Failed to set session_replication_role to replica, "
+				  "which requires superuser privileges or the SET privilege "
+				  "on that parameter");
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * computeSQLFileName updates the StreamApplyContext structure with the current
+ * LSN applied to the target system, and computed
+ */
+bool
+computeSQLFileName(StreamApplyContext *context)
+{
+	XLogSegNo segno;
+
+	if (context->WalSegSz == 0)
+	{
+		log_error("Failed to compute the SQL filename for LSN %X/%X "
+				  "without context->wal_segment_size",
+				  LSN_FORMAT_ARGS(context->previousLSN));
+		return false;
+	}
+
+	XLByteToSeg(context->previousLSN, segno, context->WalSegSz);
+	XLogFileName(context->wal, context->system.timeline, segno, context->WalSegSz);
+
+	sformat(context->sqlFileName, sizeof(context->sqlFileName),
+			"%s/%s.sql",
+			context->paths.dir,
+			context->wal);
+
+	log_debug("computeSQLFileName: %X/%X \"%s\"",
+			  LSN_FORMAT_ARGS(context->previousLSN),
+			  context->sqlFileName);
+
+	return true;
+}
+
+
+/*
+ * parseSQLAction returns the action that is implemented in the given SQL
+ * query.
+ */
+bool
+parseSQLAction(const char *query, LogicalMessageMetadata *metadata)
+{
+	metadata->action = STREAM_ACTION_UNKNOWN;
+
+	if (strcmp(query, "") == 0)
+	{
+		return true;
+	}
+
+	/* prepared statements parameters may contain any text */
+	if (strncmp(query, OUTPUT_PREPARE, strlen(OUTPUT_PREPARE)) == 0)
+	{
+		metadata->action = STREAM_ACTION_PREPARE;
+		return true;
+	}
+	else if (strncmp(query, OUTPUT_EXECUTE, strlen(OUTPUT_EXECUTE)) == 0)
+	{
+		metadata->action = STREAM_ACTION_EXECUTE;
+		return true;
+	}
+	else if (strncmp(query, OUTPUT_COPY, strlen(OUTPUT_COPY)) == 0)
 	{
+		metadata->action = STREAM_ACTION_COPY;
 		return true;
 	}
 
@@ -0,0 +1,1011 @@
+/*
+ * src/bin/pgcopydb/ld_parallel.c
+ *     Apply changes to the target database using several connections
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include "postgres.h"
+#include "postgres_fe.h"
+#include "access/xlog_internal.h"
+#include "access/xlogdefs.h"
+
+#include "parson.h"
+
+#include "copydb.h"
+#include "ld_stream.h"
+#include "log.h"
+#include "pgsql.h"
+#include "string_utils.h"
+
+
+static int writeSetKeyCmp(const void *a, const void *b);
+static int relationHashCmp(const void *a, const void *b);
+static bool stream_write_set_key_conflicts(WriteSetKeyType a, WriteSetKeyType b);
+
+static bool stream_apply_jobs_list_unique_relations(ApplyJobs *jobs,
+													PGSQL *pgsql);
+static void stream_apply_jobs_unique_keys(ApplyJobs *jobs, WriteSet *writeSet);
+static ApplyWorker * stream_apply_jobs_idle_worker(ApplyJobs *jobs);
+static bool stream_apply_jobs_has_conflict(ApplyJobs *jobs,
+										   ApplyWorker *worker);
+static bool stream_apply_jobs_dispatch(StreamApplyContext *context,
+									   ApplyWorker *worker,
+									   uint64_t xid,
+									   uint64_t lsn);
+static bool stream_apply_jobs_send_commit(StreamApplyContext *context,
+										  ApplyWorker *worker);
+static bool stream_apply_jobs_advance(StreamApplyContext *context, bool wait);
+static bool stream_apply_jobs_poll(StreamApplyContext *context);
+static bool stream_apply_jobs_wait_head(StreamApplyContext *context);
+
+
+/*
+ * stream_hash_string updates the given 64-bit FNV-1a hash with the contents of
+ * the given string, including its terminating zero byte so that consecutive
+ * strings are separated.
+ */
+uint64_t
+stream_hash_string(uint64_t hash, const char *str)
+{
+	const unsigned char *p = (const unsigned char *) str;
+
+	for (; *p != '\0'; p++)
+	{
+		hash ^= *p;
+		hash *= UINT64_C(1099511628211);
+	}
+
+	hash ^= 0;
+	hash *= UINT64_C(1099511628211);
+
+	return hash;
+}
+
+
+/*
+ * stream_relation_hash returns the hash of the given qualified relation name.
+ */
+uint64_t
+stream_relation_hash(const char *nspname, const char *relname)
+{
+	uint64_t hash = WRITE_SET_HASH_SEED;
+
+	hash = stream_hash_string(hash, nspname);
+	hash = stream_hash_string(hash, relname);
+
+	return hash;
+}
+
+
+/*
+ * stream_write_set_add adds a key to the given write set. When the write set
+ * is full, it's marked unknown and the function returns false.
+ */
+bool
+stream_write_set_add(WriteSet *writeSet, WriteSetKeyType type, uint64_t hash)
+{
+	if (!writeSet->known)
+	{
+		return false;
+	}
+
+	if (writeSet->count == APPLY_WRITE_SET_MAX_KEYS)
+	{
+		writeSet->known = false;
+		return false;
+	}
+
+	writeSet->keys[writeSet->count].type = type;
+	writeSet->keys[writeSet->count].hash = hash;
+	++(writeSet->count);
+
+	return true;
+}
+
+
+/*
+ * writeSetKeyCmp is a qsort comparison function for WriteSetKey entries.
+ */
+static int
+writeSetKeyCmp(const void *a, const void *b)
+{
+	const WriteSetKey *ka = (const WriteSetKey *) a;
+	const WriteSetKey *kb = (const WriteSetKey *) b;
+
+	if (ka->hash != kb->hash)
+	{
+		return ka->hash < kb->hash ? -1 : 1;
+	}
+
+	return (int) ka->type - (int) kb->type;
+}
+
+
+/*
+ * stream_write_set_sort sorts the keys of the given write set and removes
+ * duplicate entries.
+ */
+void
+stream_write_set_sort(WriteSet *writeSet)
+{
+	if (writeSet->count < 2)
+	{
+		return;
+	}
+
+	qsort(writeSet->keys, writeSet->count, sizeof(WriteSetKey), writeSetKeyCmp);
+
+	int n = 1;
+
+	for (int i = 1; i < writeSet->count; i++)
+	{
+		if (writeSetKeyCmp(&(writeSet->keys[n - 1]), &(writeSet->keys[i])) != 0)
+		{
+			writeSet->keys[n++] = writeSet->keys[i];
+		}
+	}
+
+	writeSet->count = n;
+}
+
+
+/*
+ * stream_write_set_key_conflicts returns true when two keys with the same
+ * hash conflict, depending on their types.
+ */
+static bool
+stream_write_set_key_conflicts(WriteSetKeyType a, WriteSetKeyType b)
+{
+	if (a == b)
+	{
+		return a == WRITE_SET_KEY_ROW ||
+			   a == WRITE_SET_KEY_TRUNCATE ||
+			   a == WRITE_SET_KEY_UNIQUE;
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_write_set_conflicts returns true when the given sorted write sets
+ * conflict, or when any of them is unknown.
+ */
+bool
+stream_write_set_conflicts(WriteSet *a, WriteSet *b)
+{
+	if (!a->known || !b->known)
+	{
+		return true;
+	}
+
+	int i = 0;
+	int j = 0;
+
+	while (i < a->count && j < b->count)
+	{
+		uint64_t hash = a->keys[i].hash;
+
+		if (hash < b->keys[j].hash)
+		{
+			++i;
+			continue;
+		}
+		else if (hash > b->keys[j].hash)
+		{
+			++j;
+			continue;
+		}
+
+		/* same hash, check every pair of keys types with that hash */
+		int iEnd = i;
+		int jEnd = j;
+
+		while (iEnd < a->count && a->keys[iEnd].hash == hash)
+		{
+			++iEnd;
+		}
+
+		while (jEnd < b->count && b->keys[jEnd].hash == hash)
+		{
+			++jEnd;
+		}
+
+		for (int ia = i; ia < iEnd; ia++)
+		{
+			for (int jb = j; jb < jEnd; jb++)
+			{
+				if (stream_write_set_key_conflicts(a->keys[ia].type,
+												   b->keys[jb].type))
+				{
+					return true;
+				}
+			}
+		}
+
+		i = iEnd;
+		j = jEnd;
+	}
+
+	return false;
+}
+
+
+/*
+ * stream_write_set_parse parses the "keys" array of a BEGIN message, as
+ * written by the transform process when using --apply-jobs. When the message
+ * has no such array the write set is unknown.
+ */
+bool
+stream_write_set_parse(const char *message, WriteSet *writeSet)
+{
+	writeSet->known = false;
+	writeSet->count = 0;
+
+	JSON_Value *json = json_parse_string(message);
+	JSON_Object *jsobj = json_value_get_object(json);
+
+	if (jsobj == NULL)
+	{
+		log_error("Failed to parse BEGIN message: %s", message);
+		json_value_free(json);
+		return false;
+	}
+
+	JSON_Array *jskeys = json_object_get_array(jsobj, "keys");
+
+	if (jskeys == NULL)
+	{
+		json_value_free(json);
+		return true;
+	}
+
+	writeSet->known = true;
+
+	int count = json_array_get_count(jskeys);
+
+	for (int i = 0; i < count; i++)
+	{
+		const char *key = json_array_get_string(jskeys, i);
+
+		if (key == NULL || strlen(key) < 2)
+		{
+			log_error("Failed to parse write set key %d in BEGIN message: %s",
+					  i,
+					  message);
+			json_value_free(json);
+			return false;
+		}
+
+		WriteSetKeyType type = (WriteSetKeyType) key[0];
+		uint64_t hash = strtoull(key + 1, NULL, 16);
+
+		if (!stream_write_set_add(writeSet, type, hash))
+		{
+			/* too many keys, consider the write set unknown */
+			break;
+		}
+	}
+
+	json_value_free(json);
+
+	stream_write_set_sort(writeSet);
+
+	return true;
+}
+
+
+/*
+ * stream_apply_jobs_start opens the target connections used to apply
+ * transactions in parallel.
+ *
+ * Transactions are not applied in the source order anymore: only their
+ * commits are. The connections then use session_replication_role replica,
+ * the same as Postgres logical replication, so that foreign keys are not
+ * checked against rows that a concurrent transaction is still applying.
+ *
+ * Unique constraints are still checked. Two transactions that update
+ * different rows do not conflict in their write sets, yet when the first one
+ * changes a unique column away from a value that the second one then uses,
+ * applying the second one first fails with a unique violation. So we list the
+ * tables that have unique indexes besides their replica identity, and the
+ * transactions that update or delete rows in those tables are applied in
+ * order, see stream_apply_jobs_unique_keys.
+ */
+bool
+stream_apply_jobs_start(StreamApplyContext *context)
+{
+	ApplyJobs *jobs = &(context->jobs);
+
+	/* the replication origin session moves to the committing connection */
+	(void) pgsql_finish(&(context->pgsql));
+
+	jobs->workers = (ApplyWorker *) calloc(jobs->count, sizeof(ApplyWorker));
+	jobs->order = (int *) calloc(jobs->count, sizeof(int));
+
+	if (jobs->workers == NULL || jobs->order == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	jobs->current = -1;
+	jobs->first = 0;
+	jobs->inflight = 0;
+	jobs->appliedLSN = context->previousLSN;
+
+	for (int i = 0; i < jobs->count; i++)
+	{
+		ApplyWorker *worker = &(jobs->workers[i]);
+		PGSQL *pgsql = &(worker->pgsql);
+
+		worker->id = i;
+
+		if (!pgsql_init(pgsql, context->target_pguri, PGSQL_CONN_TARGET))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		pgsql->connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+		pgsql->logSQL = context->logSQL;
+
+		if (!stream_apply_set_replica_role(pgsql))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		if (i == 0 && !stream_apply_jobs_list_unique_relations(jobs, pgsql))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		if (!pgsql_pipeline_enter(pgsql))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	log_info("Applying changes using %d parallel connections", jobs->count);
+
+	return true;
+}
+
+
+/*
+ * stream_apply_jobs_begin dispatches the transaction that starts with the
+ * given BEGIN message to a connection that is not applying a conflicting
+ * transaction, waiting for previous transactions to commit when needed.
+ */
+bool
+stream_apply_jobs_begin(StreamApplyContext *context,
+						LogicalMessageMetadata *metadata,
+						const char *sql)
+{
+	ApplyJobs *jobs = &(context->jobs);
+	ApplyWorker *worker = NULL;
+
+	if (jobs->current != -1)
+	{
+		log_error("BUG: stream_apply_jobs_begin called while transaction "
+				  "%lld is being dispatched",
+				  (long long) jobs->workers[jobs->current].txn.xid);
+		return false;
+	}
+
+	while ((worker = stream_apply_jobs_idle_worker(jobs)) == NULL)
+	{
+		if (!stream_apply_jobs_wait_head(context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	const char *message = sql + strlen(OUTPUT_BEGIN);
+
+	if (!stream_write_set_parse(message, &(worker->writeSet)))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	(void) stream_apply_jobs_unique_keys(jobs, &(worker->writeSet));
+
+	while (stream_apply_jobs_has_conflict(jobs, worker))
+	{
+		if (!stream_apply_jobs_wait_head(context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return stream_apply_jobs_dispatch(context,
+									  worker,
+									  metadata->xid,
+									  metadata->txnCommitLSN);
+}
+
+
+/*
+ * stream_apply_jobs_commit registers that the current transaction is complete,
+ * and commits the transactions that are next in the commit order when their
+ * results are available.
+ */
+bool
+stream_apply_jobs_commit(StreamApplyContext *context,
+						 LogicalMessageMetadata *metadata)
+{
+	ApplyJobs *jobs = &(context->jobs);
+
+	if (jobs->current == -1)
+	{
+		log_error("BUG: stream_apply_jobs_commit called without a transaction "
+				  "being dispatched, for COMMIT LSN %X/%X",
+				  LSN_FORMAT_ARGS(metadata->lsn));
+		return false;
+	}
+
+	ApplyWorker *worker = &(jobs->workers[jobs->current]);
+
+	worker->txn.lsn = metadata->lsn;
+	strlcpy(worker->timestamp, metadata->timestamp, sizeof(worker->timestamp));
+
+	worker->complete = true;
+	jobs->current = -1;
+
+	return stream_apply_jobs_advance(context, false);
+}
+
+
+/*
+ * stream_apply_jobs_keepalive advances the replication origin to the LSN of
+ * the given KEEPALIVE message, once all the previous transactions have been
+ * committed.
+ */
+bool
+stream_apply_jobs_keepalive(StreamApplyContext *context,
+							LogicalMessageMetadata *metadata)
+{
+	ApplyJobs *jobs = &(context->jobs);
+
+	/*
+	 * A KEEPALIVE message found in the middle of a transaction that spans
+	 * over several SQL files is skipped: the COMMIT LSN comes next.
+	 */
+	if (jobs->current != -1)
+	{
+		log_debug("Skipping KEEPALIVE at LSN %X/%X in transaction %lld",
+				  LSN_FORMAT_ARGS(metadata->lsn),
+				  (long long) jobs->workers[jobs->current].txn.xid);
+		return true;
+	}
+
+	if (!stream_apply_jobs_drain(context))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	ApplyWorker *worker = stream_apply_jobs_idle_worker(jobs);
+
+	if (worker == NULL)
+	{
+		log_error("BUG: stream_apply_jobs_keepalive found no idle connection");
+		return false;
+	}
+
+	worker->writeSet.known = true;
+	worker->writeSet.count = 0;
+
+	if (!stream_apply_jobs_dispatch(context, worker, 0, metadata->lsn))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	return stream_apply_jobs_commit(context, metadata) &&
+		   stream_apply_jobs_drain(context);
+}
+
+
+/*
+ * stream_apply_jobs_wait consumes the results of the statements sent for the
+ * current transaction until no more than maxQueries are in flight.
+ *
+ * The current transaction might be waiting for a lock held by a previous
+ * transaction that is complete, and that only needs its COMMIT to be sent.
+ * So rather than blocking on the current connection, previous transactions
+ * are committed as their results come in, and we wait for results on both
+ * the current connection and the committing one.
+ */
+bool
+stream_apply_jobs_wait(StreamApplyContext *context, int maxQueries)
+{
+	ApplyJobs *jobs = &(context->jobs);
+
+	if (jobs->current == -1)
+	{
+		return true;
+	}
+
+	ApplyWorker *worker = &(jobs->workers[jobs->current]);
+
+	while (worker->pgsql.pipelineQueries > maxQueries)
+	{
+		bool isSync = false;
+		bool success = false;
+
+		if (!stream_apply_jobs_advance(context, false) ||
+			!pgsql_pipeline_flush(&(worker->pgsql)))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		if (!pgsql_pipeline_ready(&(worker->pgsql)))
+		{
+			if (!stream_apply_jobs_poll(context))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			continue;
+		}
+
+		if (!pgsql_pipeline_consume(&(worker->pgsql), &isSync, &success))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		if (!success)
+		{
+			(void) stream_apply_log_txn_failure(&(worker->txn));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_apply_jobs_drain commits all the complete transactions in flight.
+ */
+bool
+stream_apply_jobs_drain(StreamApplyContext *context)
+{
+	ApplyJobs *jobs = &(context->jobs);
+
+	while (jobs->inflight > 0)
+	{
+		ApplyWorker *head = &(jobs->workers[jobs->order[jobs->first]]);
+
+		/* a transaction split over several SQL files is not complete yet */
+		if (!head->complete)
+		{
+			break;
+		}
+
+		if (!stream_apply_jobs_advance(context, true))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_apply_jobs_connection returns the connection used to apply the
+ * current transaction, and its prepared statements.
+ */
+PGSQL *
+stream_apply_jobs_connection(StreamApplyContext *context,
+							 PreparedStmt ***preparedStmt)
+{
+	ApplyJobs *jobs = &(context->jobs);
+
+	if (jobs->current == -1)
+	{
+		log_error("BUG: statement found outside of a transaction "
+				  "when using --apply-jobs");
+		return NULL;
+	}
+
+	ApplyWorker *worker = &(jobs->workers[jobs->current]);
+
+	*preparedStmt = &(worker->preparedStmt);
+
+	return &(worker->pgsql);
+}
+
+
+/*
+ * stream_apply_jobs_finish closes the connections used to apply transactions
+ * in parallel. Transactions still in flight are rolled back.
+ */
+void
+stream_apply_jobs_finish(StreamApplyContext *context)
+{
+	ApplyJobs *jobs = &(context->jobs);
+
+	if (jobs->workers != NULL)
+	{
+		for (int i = 0; i < jobs->count; i++)
+		{
+			(void) pgsql_finish(&(jobs->workers[i].pgsql));
+			(void) stream_free_prepared_stmts(&(jobs->workers[i].preparedStmt));
+		}
+	}
+
+	free(jobs->workers);
+	free(jobs->order);
+	free(jobs->uniqueRelations);
+
+	jobs->workers = NULL;
+	jobs->order = NULL;
+	jobs->uniqueRelations = NULL;
+	jobs->uniqueRelationsCount = 0;
+	jobs->current = -1;
+	jobs->inflight = 0;
+}
+
+
+/*
+ * relationHashCmp is a qsort and bsearch comparison function for relation
+ * hashes.
+ */
+static int
+relationHashCmp(const void *a, const void *b)
+{
+	uint64_t ha = *((const uint64_t *) a);
+	uint64_t hb = *((const uint64_t *) b);
+
+	return ha < hb ? -1 : ha > hb ? 1 : 0;
+}
+
+
+/*
+ * stream_apply_jobs_list_unique_relations fetches the list of tables that have
+ * unique indexes besides their replica identity on the target database, and
+ * keeps the sorted hashes of their names.
+ */
+static bool
+stream_apply_jobs_list_unique_relations(ApplyJobs *jobs, PGSQL *pgsql)
+{
+	TargetRelationArray relationArray = { 0, NULL };
+
+	if (!schema_list_unique_relations(pgsql, &relationArray))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	int count = relationArray.count;
+
+	jobs->uniqueRelationsCount = count;
+	jobs->uniqueRelations = (uint64_t *) calloc(count + 1, sizeof(uint64_t));
+
+	if (jobs->uniqueRelations == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		free(relationArray.array);
+		return false;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		TargetRelation *relation = &(relationArray.array[i]);
+
+		jobs->uniqueRelations[i] =
+			stream_relation_hash(relation->nspname, relation->relname);
+	}
+
+	qsort(jobs->uniqueRelations, count, sizeof(uint64_t), relationHashCmp);
+
+	free(relationArray.array);
+
+	log_debug("Found %d tables with unique indexes besides their "
+			  "replica identity",
+			  count);
+
+	return true;
+}
+
+
+/*
+ * stream_apply_jobs_unique_keys turns the UPDATE keys of the given write set
+ * into UNIQUE keys when their table has unique indexes besides its replica
+ * identity, so that transactions that update or delete rows in those tables
+ * are applied in order.
+ */
+static void
+stream_apply_jobs_unique_keys(ApplyJobs *jobs, WriteSet *writeSet)
+{
+	if (!writeSet->known || jobs->uniqueRelationsCount == 0)
+	{
+		return;
+	}
+
+	for (int i = 0; i < writeSet->count; i++)
+	{
+		WriteSetKey *key = &(writeSet->keys[i]);
+
+		if (key->type == WRITE_SET_KEY_UPDATE &&
+			bsearch(&(key->hash),
+					jobs->uniqueRelations,
+					jobs->uniqueRelationsCount,
+					sizeof(uint64_t),
+					relationHashCmp) != NULL)
+		{
+			key->type = WRITE_SET_KEY_UNIQUE;
+		}
+	}
+}
+
+
+/*
+ * stream_apply_jobs_idle_worker returns a worker that is not applying a
+ * transaction, or NULL when all of them are busy.
+ */
+static ApplyWorker *
+stream_apply_jobs_idle_worker(ApplyJobs *jobs)
+{
+	for (int i = 0; i < jobs->count; i++)
+	{
+		if (!jobs->workers[i].busy)
+		{
+			return &(jobs->workers[i]);
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * stream_apply_jobs_has_conflict returns true when the write set of the given
+ * worker conflicts with the write set of a transaction in flight.
+ */
+static bool
+stream_apply_jobs_has_conflict(ApplyJobs *jobs, ApplyWorker *worker)
+{
+	for (int i = 0; i < jobs->count; i++)
+	{
+		ApplyWorker *busy = &(jobs->workers[i]);
+
+		if (busy->busy &&
+			stream_write_set_conflicts(&(worker->writeSet), &(busy->writeSet)))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+ * stream_apply_jobs_dispatch registers the given worker as applying the
+ * given transaction, and sends BEGIN on its connection.
+ */
+static bool
+stream_apply_jobs_dispatch(StreamApplyContext *context,
+						   ApplyWorker *worker,
+						   uint64_t xid,
+						   uint64_t lsn)
+{
+	ApplyJobs *jobs = &(context->jobs);
+
+	worker->busy = true;
+	worker->complete = false;
+	worker->commitSent = false;
+	worker->txn.xid = xid;
+	worker->txn.lsn = lsn;
+
+	int last = (jobs->first + jobs->inflight) % jobs->count;
+
+	jobs->order[last] = worker->id;
+	++(jobs->inflight);
+
+	jobs->current = worker->id;
+
+	log_trace("Applying transaction %lld using connection %d",
+			  (long long) xid,
+			  worker->id);
+
+	return pgsql_begin(&(worker->pgsql));
+}
+
+
+/*
+ * stream_apply_jobs_send_commit sends the COMMIT of the transaction applied by
+ * the given worker. The replication origin session is only active in a single
+ * session at a time, and transactions are committed one after the other, so
+ * the committing session takes the replication origin and then releases it.
+ */
+static bool
+stream_apply_jobs_send_commit(StreamApplyContext *context, ApplyWorker *worker)
+{
+	PGSQL *pgsql = &(worker->pgsql);
+	char lsn[PG_LSN_MAXLENGTH] = { 0 };
+
+	sformat(lsn, sizeof(lsn), "%X/%X", LSN_FORMAT_ARGS(worker->txn.lsn));
+
+	if (!pgsql_replication_origin_session_setup(pgsql, context->origin) ||
+		!pgsql_replication_origin_xact_setup(pgsql, lsn, worker->timestamp) ||
+		!pgsql_execute(pgsql, "COMMIT") ||
+		!pgsql_replication_origin_session_reset(pgsql) ||
+		!pgsql_pipeline_sync(pgsql))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	worker->commitSent = true;
+
+	return true;
+}
+
+
+/*
+ * stream_apply_jobs_advance commits the complete transactions at the head of
+ * the commit order queue. When wait is true, waits until the oldest
+ * transaction has been committed, otherwise only consumes results that are
+ * already available.
+ */
+static bool
+stream_apply_jobs_advance(StreamApplyContext *context, bool wait)
+{
+	ApplyJobs *jobs = &(context->jobs);
+
+	while (jobs->inflight > 0)
+	{
+		ApplyWorker *worker = &(jobs->workers[jobs->order[jobs->first]]);
+		PGSQL *pgsql = &(worker->pgsql);
+
+		if (!worker->complete)
+		{
+			break;
+		}
+
+		if (!worker->commitSent)
+		{
+			if (!stream_apply_jobs_send_commit(context, worker))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+
+		while (pgsql->pipelineQueries > 0)
+		{
+			bool isSync = false;
+			bool success = false;
+
+			if (!wait && !pgsql_pipeline_ready(pgsql))
+			{
+				return true;
+			}
+
+			if (!pgsql_pipeline_consume(pgsql, &isSync, &success))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			if (!success)
+			{
+				(void) stream_apply_log_txn_failure(&(worker->txn));
+				return false;
+			}
+		}
+
+		jobs->appliedLSN = worker->txn.lsn;
+
+		worker->busy = false;
+		jobs->first = (jobs->first + 1) % jobs->count;
+		--(jobs->inflight);
+
+		/* only wait for the oldest transaction */
+		wait = false;
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_apply_jobs_poll waits until results are available on the connection
+ * of the current transaction, or on the connection of the oldest transaction
+ * when its COMMIT has been sent, or until a short timeout.
+ */
+static bool
+stream_apply_jobs_poll(StreamApplyContext *context)
+{
+	ApplyJobs *jobs = &(context->jobs);
+	PGSQL *connections[2] = { 0 };
+	int count = 0;
+
+	if (jobs->current != -1)
+	{
+		connections[count++] = &(jobs->workers[jobs->current].pgsql);
+	}
+
+	if (jobs->inflight > 0)
+	{
+		ApplyWorker *head = &(jobs->workers[jobs->order[jobs->first]]);
+
+		if (head->id != jobs->current && head->commitSent)
+		{
+			connections[count++] = &(head->pgsql);
+		}
+	}
+
+	fd_set input_mask;
+	int nfds = 0;
+
+	FD_ZERO(&input_mask);
+
+	for (int i = 0; i < count; i++)
+	{
+		int sock = PQsocket(connections[i]->connection);
+
+		if (sock < 0)
+		{
+			log_error("Failed to wait for results: invalid socket");
+			return false;
+		}
+
+		FD_SET(sock, &input_mask);
+		nfds = sock + 1 > nfds ? sock + 1 : nfds;
+	}
+
+	/* sleep for 100ms at most, the caller checks again */
+	struct timeval timeout = { .tv_sec = 0, .tv_usec = 100 * 1000 };
+
+	int r = select(nfds, &input_mask, NULL, NULL, &timeout);
+
+	if (r < 0 && errno != EINTR)
+	{
+		log_error("Failed to wait for results: select failed: %m");
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_apply_jobs_wait_head waits until the oldest transaction in flight has
+ * been committed.
+ */
+static bool
+stream_apply_jobs_wait_head(StreamApplyContext *context)
+{
+	ApplyJobs *jobs = &(context->jobs);
+
+	if (jobs->inflight == 0 ||
+		!jobs->workers[jobs->order[jobs->first]].complete)
+	{
+		log_error("BUG: stream_apply_jobs_wait_head has no complete "
+				  "transaction to wait for");
+		return false;
+	}
+
+	return stream_apply_jobs_advance(context, true);
+}
@@ -23,6 +23,8 @@
 #include "signals.h"
 #include "string_utils.h"
 
+static bool stream_replay_report_progress(StreamApplyContext *context);
+
 
 typedef struct ReplayStreamCtx
 {
@@ -75,6 +77,10 @@ stream_apply_replay(StreamSpecs *specs)
 	log_debug("Source database wal_segment_size is %u", context->WalSegSz);
 	log_debug("Source database timeline is %d", context->system.timeline);
 
+	context->pipeline.enabled = specs->pipeline;
+	context->jobs.count = specs->applyJobs;
+	context->group.maxTransactions = specs->groupCommit;
+
 	if (!setupReplicationOrigin(context,
 								&(specs->paths),
 								specs->source_pguri,
@@ -124,6 +130,7 @@ stream_apply_replay(StreamSpecs *specs)
 
 	ReadFromStreamContext readerContext = {
 		.callback = stream_replay_line,
+		.idle = stream_replay_idle,
 		.ctx = &ctx
 	};
 
@@ -134,6 +141,21 @@ stream_apply_replay(StreamSpecs *specs)
 		return false;
 	}
 
+	/* commit the transactions of the current group, if any */
+	if (!stream_apply_keepalive_flush(context) ||
+		!stream_apply_group_flush(context))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* make sure the changes sent in pipeline mode have been applied */
+	if (!stream_apply_pipeline_drain(context))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	/*
 	 * When we are done reading our input stream and applying changes, we might
 	 * still have a sentinel query in flight. Make sure to terminate it now.
@@ -151,7 +173,7 @@ stream_apply_replay(StreamSpecs *specs)
 	}
 
 	/* we might still have to disconnect now */
-	(void) pgsql_finish(&(context->pgsql));
+	(void) stream_apply_disconnect(context);
 
 	/* make sure to send a last round of sentinel update before exit */
 	if (!stream_apply_sync_sentinel(context))
@@ -210,25 +232,10 @@ stream_replay_line(void *ctx, const char *line, bool *stop)
 		case STREAM_ACTION_COMMIT:
 		case STREAM_ACTION_KEEPALIVE:
 		{
-			uint64_t now = time(NULL);
-
-			if (context->sentinelQueryInProgress)
-			{
-				if (!stream_apply_fetch_sync_sentinel(context))
-				{
-					/* errors have already been logged */
-					return false;
-				}
-			}
-
-			/* rate limit to 1 update per second */
-			else if (1 < (now - context->sentinelSyncTime))
+			if (!stream_replay_report_progress(context))
 			{
-				if (!stream_apply_send_sync_sentinel(context))
-				{
-					/* errors have already been logged */
-					return false;
-				}
+				/* errors have already been logged */
+				return false;
 			}
 			break;
 		}
@@ -265,3 +272,90 @@ stream_replay_line(void *ctx, const char *line, bool *stop)
 
 	return true;
 }
+
+
+/*
+ * stream_replay_idle is a callback function for the ReadFromStreamContext and
+ * read_from_stream infrastructure. It's called when no input has been
+ * received for a while, and commits the current --group-commit group or the
+ * pending KEEPALIVE when they have been waiting for long enough.
+ */
+bool
+stream_replay_idle(void *ctx)
+{
+	ReplayStreamCtx *replayCtx = (ReplayStreamCtx *) ctx;
+	StreamApplyContext *context = &(replayCtx->applyContext);
+
+	if (stream_apply_keepalive_timeout(context))
+	{
+		if (!stream_apply_keepalive_flush(context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	if (stream_apply_group_timeout(context))
+	{
+		if (!stream_apply_group_flush(context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	/*
+	 * Between transactions, make sure the changes sent in pipeline mode have
+	 * been applied, so that the progress we report is not lagging behind
+	 * during quiet periods.
+	 */
+	if (!context->inTransaction && context->group.count == 0)
+	{
+		if (!stream_apply_pipeline_drain(context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		if (!stream_replay_report_progress(context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_replay_report_progress sends the replay LSN position to the pgcopydb
+ * sentinel table, at most once per second, or fetches the result of the
+ * previous update when it is still in progress.
+ */
+static bool
+stream_replay_report_progress(StreamApplyContext *context)
+{
+	uint64_t now = time(NULL);
+
+	if (context->sentinelQueryInProgress)
+	{
+		if (!stream_apply_fetch_sync_sentinel(context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	/* rate limit to 1 update per second */
+	else if (1 < (now - context->sentinelSyncTime))
+	{
+		if (!stream_apply_send_sync_sentinel(context))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
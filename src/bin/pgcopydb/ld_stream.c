@@ -51,13 +51,30 @@ stream_init_specs(StreamSpecs *specs,
 				  LogicalStreamMode mode,
 				  bool stdin,
 				  bool stdout,
-				  bool logSQL)
+				  bool logSQL,
+				  bool preparedStatements,
+				  bool copyInserts,
+				  bool pipeline,
+				  int applyJobs,
+				  int groupCommit)
 {
 	/* just copy into StreamSpecs what's been initialized in copySpecs */
 	specs->mode = mode;
 	specs->stdIn = stdin;
 	specs->stdOut = stdout;
 	specs->logSQL = logSQL;
+	specs->preparedStatements = preparedStatements;
+	specs->copyInserts = copyInserts;
+	specs->pipeline = pipeline;
+	specs->applyJobs = applyJobs;
+	specs->groupCommit = groupCommit;
+
+	/* the transform SQL output format is the same for the whole process */
+	(void) stream_transform_use_prepared_statements(preparedStatements);
+	(void) stream_transform_use_copy_inserts(copyInserts);
+
+	/* parallel apply needs the write set of each transaction */
+	(void) stream_transform_use_write_sets(applyJobs > 1);
 
 	specs->paths = *paths;
 	specs->endpos = endpos;
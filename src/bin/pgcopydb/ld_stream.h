@@ -18,6 +18,9 @@
 #define OUTPUT_COMMIT "COMMIT; -- "
 #define OUTPUT_SWITCHWAL "-- SWITCH WAL "
 #define OUTPUT_KEEPALIVE "-- KEEPALIVE "
+#define OUTPUT_PREPARE "PREPARE "
+#define OUTPUT_EXECUTE "EXECUTE "
+#define OUTPUT_COPY "COPY "
 
 typedef enum
 {
@@ -30,7 +33,14 @@ typedef enum
 	STREAM_ACTION_TRUNCATE = 'T',
 	STREAM_ACTION_MESSAGE = 'M',
 	STREAM_ACTION_SWITCH = 'X',
-	STREAM_ACTION_KEEPALIVE = 'K'
+	STREAM_ACTION_KEEPALIVE = 'K',
+
+	/* only found in our SQL files, see --prepared-statements */
+	STREAM_ACTION_PREPARE = 'P',
+	STREAM_ACTION_EXECUTE = 'E',
+
+	/* only found in our SQL files, runs of INSERT statements */
+	STREAM_ACTION_COPY = 'O'
 } StreamAction;
 
 typedef struct StreamCounters
@@ -118,6 +128,210 @@ typedef struct StreamContext
 } StreamContext;
 
 
+/*
+ * The apply process keeps track of the statements found in the SQL files, and
+ * of the statements that it has prepared on each target connection. The
+ * statement name is computed by the transform process from the statement
+ * text, which is kept around to detect name collisions.
+ */
+typedef struct PreparedStmt
+{
+	char name[NAMEDATALEN];     /* hash key */
+	char *sql;                  /* malloc'ed area */
+
+	UT_hash_handle hh;
+} PreparedStmt;
+
+
+/*
+ * Runs of INSERT statements into the same relation with the same columns are
+ * written as COPY commands in our SQL files, and applied using the COPY
+ * protocol. Short runs are kept as INSERT statements, and long runs are split
+ * in several COPY commands.
+ */
+#define APPLY_COPY_MIN_ROWS 16
+#define APPLY_COPY_MAX_ROWS 1000
+
+/*
+ * Runs of DELETE or UPDATE statements on the same relation are written as a
+ * single set-based statement that targets the rows by replica identity.
+ */
+#define APPLY_BATCH_MIN_ROWS 16
+#define APPLY_BATCH_MAX_ROWS 100
+
+/*
+ * The transform process keeps the statements of a transaction in memory until
+ * its COMMIT message is read. When the JSON messages of a transaction exceed
+ * TRANSFORM_SPILL_THRESHOLD bytes, its statements are written as SQL to a
+ * temporary file, and the file contents are copied to the output at COMMIT.
+ */
+#define TRANSFORM_SPILL_THRESHOLD (64 * 1024 * 1024)
+
+
+/*
+ * When using --pipeline, the apply process keeps several transactions in
+ * flight on the target connection. Each transaction ends with a pipeline sync
+ * point, and the apply process tracks the transactions that have been sent and
+ * not confirmed yet, so that errors map back to the originating transaction
+ * and only confirmed transactions are reported as replayed.
+ */
+#define APPLY_PIPELINE_MAX_TRANSACTIONS 64
+#define APPLY_PIPELINE_MAX_QUERIES 1024
+
+typedef struct ApplyPipelineTxn
+{
+	uint64_t xid;
+	uint64_t lsn;               /* COMMIT LSN, or KEEPALIVE LSN */
+} ApplyPipelineTxn;
+
+typedef struct ApplyPipeline
+{
+	bool enabled;
+
+	ApplyPipelineTxn current;   /* transaction being sent */
+	uint64_t appliedLSN;        /* last confirmed transaction LSN */
+
+	/* ring buffer of transactions sent and not confirmed yet */
+	int first;
+	int count;
+	ApplyPipelineTxn txns[APPLY_PIPELINE_MAX_TRANSACTIONS];
+} ApplyPipeline;
+
+
+/*
+ * When using --apply-jobs, the transform process writes the write set of each
+ * transaction in its BEGIN message, as a list of keys. A key is the hash of
+ * either a relation name or a relation name and the replica identity of a
+ * row, with a type that tells how the transaction touches it:
+ *
+ *  - row keys conflict with the same row key,
+ *  - INSERT keys conflict with UPDATE and TRUNCATE keys for the same relation,
+ *  - UPDATE keys conflict with INSERT and TRUNCATE keys for the same relation,
+ *  - TRUNCATE keys conflict with any key for the same relation.
+ *  - UNIQUE keys conflict with any key for the same relation.
+ *
+ * Rows inserted by a transaction are only known by relation, because the
+ * logical decoding output does not tell which columns are the replica
+ * identity of an INSERT.
+ *
+ * Transactions without a write set (split over several SQL files, or with
+ * more than APPLY_WRITE_SET_MAX_KEYS keys) conflict with every transaction.
+ *
+ * The logical decoding output only has the replica identity of the rows that
+ * an UPDATE or a DELETE changes, not the values that they used in the other
+ * unique indexes of the table. The apply process then turns the UPDATE keys
+ * of tables with such indexes into UNIQUE keys, which conflict with each
+ * other: those transactions are applied in order.
+ */
+#define APPLY_WRITE_SET_MAX_KEYS 1024
+#define WRITE_SET_HASH_SEED UINT64_C(14695981039346656037) /* FNV-1a */
+
+typedef enum
+{
+	WRITE_SET_KEY_ROW = 'R',
+	WRITE_SET_KEY_INSERT = 'I',
+	WRITE_SET_KEY_UPDATE = 'U',
+	WRITE_SET_KEY_TRUNCATE = 'X',
+	WRITE_SET_KEY_UNIQUE = 'Q'  /* only used by the apply process */
+} WriteSetKeyType;
+
+typedef struct WriteSetKey
+{
+	WriteSetKeyType type;
+	uint64_t hash;
+} WriteSetKey;
+
+typedef struct WriteSet
+{
+	bool known;
+	int count;
+	WriteSetKey keys[APPLY_WRITE_SET_MAX_KEYS];
+} WriteSet;
+
+
+/*
+ * With --apply-jobs, transactions are applied by several target connections
+ * at the same time, each one in pipeline mode. Transactions are committed in
+ * the source commit order, and the replication origin session is moved to
+ * the connection that commits, so that the replication origin progress is
+ * the same as when applying transactions one after the other.
+ */
+typedef struct ApplyWorker
+{
+	int id;
+	PGSQL pgsql;
+	PreparedStmt *preparedStmt;
+
+	bool busy;                  /* a transaction has been dispatched */
+	bool complete;              /* its COMMIT message has been read */
+	bool commitSent;            /* its COMMIT has been sent */
+
+	ApplyPipelineTxn txn;
+	char timestamp[PG_MAX_TIMESTAMP];
+	WriteSet writeSet;
+} ApplyWorker;
+
+typedef struct ApplyJobs
+{
+	int count;
+	ApplyWorker *workers;       /* malloc'ed area */
+	int current;                /* worker receiving statements, or -1 */
+
+	/* queue of busy workers, in commit order */
+	int *order;                 /* malloc'ed area */
+	int first;
+	int inflight;
+
+	/* relation hashes of the tables with extra unique indexes, sorted */
+	uint64_t *uniqueRelations;  /* malloc'ed area */
+	int uniqueRelationsCount;
+
+	uint64_t appliedLSN;        /* last committed transaction LSN */
+} ApplyJobs;
+
+
+/*
+ * With --group-commit, consecutive source transactions are applied in a single
+ * target transaction, which is committed when it contains maxTransactions
+ * source transactions or when it has been open for more than
+ * APPLY_GROUP_COMMIT_TIMEOUT_MS milliseconds. The replication origin is then
+ * advanced to the COMMIT LSN of the last source transaction of the group.
+ */
+#define APPLY_GROUP_COMMIT_TIMEOUT_MS 100
+
+typedef struct ApplyGroupCommit
+{
+	int maxTransactions;
+	int count;                  /* source transactions in the open group */
+	instr_time startTime;       /* when the open group started */
+
+	uint64_t lsn;               /* COMMIT LSN of the last transaction */
+	char timestamp[PG_MAX_TIMESTAMP];
+
+	uint64_t committedLSN;      /* last COMMIT LSN committed on the target */
+} ApplyGroupCommit;
+
+
+/*
+ * KEEPALIVE messages only advance the replication origin. Rather than using a
+ * target transaction for each of them, the last one is kept pending until a
+ * transaction with a later COMMIT LSN is applied, or until it has been pending
+ * for more than APPLY_KEEPALIVE_TIMEOUT_MS milliseconds.
+ */
+#define APPLY_KEEPALIVE_TIMEOUT_MS 1000
+
+typedef struct ApplyKeepalive
+{
+	bool pending;
+	instr_time startTime;       /* when the first pending KEEPALIVE was read */
+
+	uint64_t lsn;               /* LSN of the last pending KEEPALIVE */
+	char timestamp[PG_MAX_TIMESTAMP];
+
+	uint64_t previousLSN;       /* applied LSN before the pending KEEPALIVE */
+} ApplyKeepalive;
+
+
 typedef struct StreamApplyContext
 {
 	CDCPaths paths;
@@ -146,9 +360,28 @@ typedef struct StreamApplyContext
 
 	bool reachedStartPos;
 	bool reachedEndPos;
+	bool inTransaction;         /* a source transaction is being applied */
 
 	bool logSQL;
 
+	/* statements found in the SQL files, see --prepared-statements */
+	PreparedStmt *statements;
+
+	/* statements prepared on the target connection */
+	PreparedStmt *preparedStmt;
+
+	/* transactions in flight on the target connection */
+	ApplyPipeline pipeline;
+
+	/* transactions applied in parallel, see --apply-jobs */
+	ApplyJobs jobs;
+
+	/* transactions applied together, see --group-commit */
+	ApplyGroupCommit group;
+
+	/* KEEPALIVE message not applied yet */
+	ApplyKeepalive keepalive;
+
 	char wal[MAXPGPATH];
 	char sqlFileName[MAXPGPATH];
 } StreamApplyContext;
@@ -270,6 +503,9 @@ typedef struct LogicalTransaction
 	uint32_t count;                     /* number of statements */
 	LogicalTransactionStatement *first;
 	LogicalTransactionStatement *last;
+
+	uint64_t bytes;                     /* size of the JSON statements */
+	FILE *spill;                        /* statements written to disk */
 } LogicalTransaction;
 
 typedef struct LogicalTransactionArray
@@ -355,6 +591,11 @@ struct StreamSpecs
 	bool restart;
 	bool resume;
 	bool logSQL;
+	bool preparedStatements;
+	bool copyInserts;
+	bool pipeline;
+	int applyJobs;
+	int groupCommit;
 
 	/* subprocess management */
 	FollowSubProcess prefetch;
@@ -396,7 +637,12 @@ bool stream_init_specs(StreamSpecs *specs,
 					   LogicalStreamMode mode,
 					   bool stdIn,
 					   bool stdOut,
-					   bool logSQL);
+					   bool logSQL,
+					   bool preparedStatements,
+					   bool copyInserts,
+					   bool pipeline,
+					   int applyJobs,
+					   int groupCommit);
 
 bool stream_init_for_mode(StreamSpecs *specs, LogicalStreamMode mode);
 
@@ -463,6 +709,9 @@ bool stream_transform_worker(StreamSpecs *specs);
 bool stream_transform_from_queue(StreamSpecs *specs);
 bool stream_transform_add_file(Queue *queue, uint64_t firstLSN);
 bool stream_transform_send_stop(Queue *queue);
+void stream_transform_use_prepared_statements(bool preparedStatements);
+void stream_transform_use_copy_inserts(bool copyInserts);
+void stream_transform_use_write_sets(bool writeSets);
 
 bool stream_compute_pathnames(uint32_t WalSegSz,
 							  uint32_t timeline,
@@ -495,6 +744,7 @@ bool stream_write_truncate(FILE *out, LogicalMessageTruncate *truncate);
 bool stream_write_update(FILE *out, LogicalMessageUpdate *update);
 bool stream_write_delete(FILE * out, LogicalMessageDelete *delete);
 bool stream_write_value(FILE *out, LogicalMessageValue *value);
+bool stream_add_value_param(JSON_Array *params, LogicalMessageValue *value);
 
 bool parseMessage(LogicalMessage *mesg,
 				  LogicalMessageMetadata *metadata,
@@ -544,6 +794,49 @@ bool stream_apply_sql(StreamApplyContext *context,
 					  LogicalMessageMetadata *metadata,
 					  const char *sql);
 
+bool stream_apply_prepare(StreamApplyContext *context, const char *sql);
+bool stream_apply_execute(StreamApplyContext *context, const char *sql);
+bool stream_apply_copy(StreamApplyContext *context, const char *sql);
+void stream_apply_free_prepared(StreamApplyContext *context);
+void stream_free_prepared_stmts(PreparedStmt **preparedStmt);
+
+bool stream_apply_pipeline_enter(StreamApplyContext *context);
+bool stream_apply_pipeline_wait(StreamApplyContext *context,
+								int maxTransactions,
+								int maxQueries);
+bool stream_apply_pipeline_drain(StreamApplyContext *context);
+bool stream_apply_group_flush(StreamApplyContext *context);
+bool stream_apply_group_timeout(StreamApplyContext *context);
+bool stream_apply_keepalive_flush(StreamApplyContext *context);
+bool stream_apply_keepalive_timeout(StreamApplyContext *context);
+uint64_t stream_apply_replayed_lsn(StreamApplyContext *context);
+void stream_apply_log_txn_failure(ApplyPipelineTxn *txn);
+void stream_apply_disconnect(StreamApplyContext *context);
+
+/* ld_parallel.c */
+bool stream_write_set_add(WriteSet *writeSet,
+						  WriteSetKeyType type,
+						  uint64_t hash);
+void stream_write_set_sort(WriteSet *writeSet);
+bool stream_write_set_conflicts(WriteSet *a, WriteSet *b);
+bool stream_write_set_parse(const char *message, WriteSet *writeSet);
+uint64_t stream_hash_string(uint64_t hash, const char *str);
+uint64_t stream_relation_hash(const char *nspname, const char *relname);
+
+bool stream_apply_jobs_start(StreamApplyContext *context);
+bool stream_apply_jobs_begin(StreamApplyContext *context,
+							 LogicalMessageMetadata *metadata,
+							 const char *sql);
+bool stream_apply_jobs_commit(StreamApplyContext *context,
+							  LogicalMessageMetadata *metadata);
+bool stream_apply_jobs_keepalive(StreamApplyContext *context,
+								 LogicalMessageMetadata *metadata);
+bool stream_apply_jobs_wait(StreamApplyContext *context, int maxQueries);
+bool stream_apply_jobs_drain(StreamApplyContext *context);
+PGSQL * stream_apply_jobs_connection(StreamApplyContext *context,
+									 PreparedStmt ***preparedStmt);
+void stream_apply_jobs_finish(StreamApplyContext *context);
+
 bool setupReplicationOrigin(StreamApplyContext *context,
 							CDCPaths *paths,
 							char *source_pguri,
@@ -554,6 +847,7 @@ bool setupReplicationOrigin(StreamApplyContext *context,
 							bool logSQL);
 
 bool computeSQLFileName(StreamApplyContext *context);
+bool stream_apply_set_replica_role(PGSQL *pgsql);
 
 bool parseSQLAction(const char *query, LogicalMessageMetadata *metadata);
 
@@ -561,6 +855,7 @@ bool parseSQLAction(const char *query, LogicalMessageMetadata *metadata);
 bool stream_replay(StreamSpecs *specs);
 bool stream_apply_replay(StreamSpecs *specs);
 bool stream_replay_line(void *ctx, const char *line, bool *stop);
+bool stream_replay_idle(void *ctx);
 
 /* follow.c */
 bool follow_export_snapshot(CopyDataSpec *copySpecs, StreamSpecs *streamSpecs);
@@ -15,6 +15,7 @@
 #include "postgres_fe.h"
 #include "access/xlog_internal.h"
 #include "access/xlogdefs.h"
+#include "pqexpbuffer.h"
 
 #include "parson.h"
 
@@ -42,6 +43,143 @@ typedef struct TransformStreamCtx
 	LogicalMessageMetadata metadata;
 } TransformStreamCtx;
 
+typedef struct TransformFileCtx
+{
+	FILE *sql;
+	char *sqlfilename;
+	char dir[MAXPGPATH];
+	uint64_t lineno;
+	LogicalMessage currentMsg;
+	LogicalMessageMetadata metadata;
+} TransformFileCtx;
+
+/*
+ * When using --prepared-statements, the SQL files contain PREPARE and EXECUTE
+ * commands rather than DML statements with literal values.
+ */
+static bool transformPreparedStatements = false;
+
+/*
+ * Each statement is prepared only once per SQL file: we keep track of the
+ * statements that have been prepared in the current file already.
+ */
+static PreparedStmt *transformPreparedStmt = NULL;
+
+/*
+ * When using --copy-inserts, runs of INSERT statements into the same table
+ * are written as a COPY command followed by its data rows.
+ */
+static bool transformCopyInserts = false;
+
+static bool stream_transform_split(StreamContext *privateContext,
+								   LogicalMessage *msg);
+static bool stream_transform_write_message(StreamContext *privateContext,
+										   LogicalMessage *msg);
+static bool stream_transform_write_spilled(StreamContext *privateContext,
+										   LogicalMessage *msg);
+static bool stream_transform_write_buffer(StreamContext *privateContext,
+										  char *buffer,
+										  size_t size);
+static bool stream_transform_file_line(void *ctx, const char *line, bool *stop);
+static bool stream_transform_spill(LogicalMessage *msg,
+								   LogicalMessageMetadata *metadata,
+								   size_t size,
+								   const char *dir);
+static FILE * stream_transform_tempfile(const char *dir);
+static bool stream_write_statements(FILE *out,
+									LogicalTransaction *txn,
+									bool *sentBEGIN,
+									bool *splitTx);
+static bool stream_write_spill(FILE *out, LogicalTransaction *txn);
+static void FreeLogicalTransactionStatements(LogicalTransaction *tx);
+static bool stream_write_insert_prepared(FILE *out,
+										 LogicalMessageInsert *insert);
+static bool stream_write_update_prepared(FILE *out,
+										 LogicalMessageUpdate *update);
+static bool stream_write_delete_prepared(FILE *out,
+										 LogicalMessageDelete *delete);
+static bool stream_write_prepared(FILE *out,
+								  PQExpBuffer sql,
+								  JSON_Value *params);
+static bool stream_add_where_params(PQExpBuffer sql,
+									JSON_Array *params,
+									LogicalMessageTuple *old,
+									int *paramCount);
+static uint32_t stream_statement_hash(const char *sql);
+static char * stream_unquote_literal(const char *str);
+
+/*
+ * When using --apply-jobs, the BEGIN messages contain the write set of the
+ * transaction, so that the apply process can find independent transactions.
+ */
+static bool transformWriteSets = false;
+
+static bool stream_write_keys(FILE *out, LogicalTransaction *txn);
+static bool stream_compute_write_set(LogicalTransaction *txn,
+									 WriteSet *writeSet);
+static bool stream_row_hash(uint64_t relhash,
+							LogicalMessageTuple *identity,
+							LogicalMessageTuple *tuple,
+							uint64_t *hash);
+static uint64_t stream_value_hash(uint64_t hash, LogicalMessageValue *value);
+
+static int stream_insert_run(LogicalTransactionStatement *first,
+							 LogicalTransactionStatement **last);
+static bool stream_same_columns(LogicalMessageTuple *a, LogicalMessageTuple *b);
+static bool stream_write_copy(FILE *out,
+							  LogicalTransactionStatement *first,
+							  LogicalTransactionStatement *last);
+static bool stream_write_copy_rows(FILE *out,
+								   LogicalMessageInsert *insert,
+								   LogicalMessageTuple *tuple,
+								   JSON_Value *js);
+static bool stream_write_copy_flush(FILE *out, JSON_Value *js);
+
+static int stream_delete_run(LogicalTransactionStatement *first,
+							 LogicalTransactionStatement **last);
+static int stream_update_run(LogicalTransactionStatement *first,
+							 LogicalTransactionStatement **last);
+static bool stream_write_delete_batch(FILE *out,
+									  LogicalTransactionStatement *first,
+									  LogicalTransactionStatement *last);
+static bool stream_write_update_batch(FILE *out,
+									  LogicalTransactionStatement *first,
+									  LogicalTransactionStatement *last);
+static bool stream_write_identity(FILE *out, LogicalMessageTuple *tuple);
+
+
+/*
+ * stream_transform_use_prepared_statements sets the SQL output format used
+ * when transforming JSON messages.
+ */
+void
+stream_transform_use_prepared_statements(bool preparedStatements)
+{
+	transformPreparedStatements = preparedStatements;
+}
+
+
+/*
+ * stream_transform_use_copy_inserts sets whether runs of INSERT statements
+ * are transformed into a COPY command.
+ */
+void
+stream_transform_use_copy_inserts(bool copyInserts)
+{
+	transformCopyInserts = copyInserts;
+}
+
+
+/*
+ * stream_transform_use_write_sets sets whether BEGIN messages contain the
+ * write set of the transaction.
+ */
+void
+stream_transform_use_write_sets(bool writeSets)
+{
+	transformWriteSets = writeSets;
+}
+
 
 /*
  * stream_transform_stream transforms a JSON formatted input stream (read line
@@ -156,6 +294,16 @@ stream_transform_line(void *ctx, const char *line, bool *stop)
 		return false;
 	}
 
+	/* large transactions are spilled to disk rather than kept in memory */
+	if (!stream_transform_spill(currentMsg,
+								metadata,
+								strlen(line),
+								privateContext->paths.dir))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	if (privateContext->sqlFile == NULL)
 	{
 		if (!stream_transform_rotate(privateContext, metadata))
@@ -165,12 +313,28 @@ stream_transform_line(void *ctx, const char *line, bool *stop)
 		}
 	}
 
+	/*
+	 * A SWITCH WAL or a KEEPALIVE message might happen in the middle of a
+	 * transaction. The transaction is only written out once its COMMIT
+	 * message has been read, so that its BEGIN message has the commit LSN.
+	 */
+	if (currentMsg->isTransaction &&
+		(metadata->action == STREAM_ACTION_KEEPALIVE ||
+		 metadata->action == STREAM_ACTION_SWITCH))
+	{
+		if (!stream_transform_split(privateContext, currentMsg))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
 	/*
 	 * Is it time to close the current message and prepare a new one?
 	 */
-	if (metadata->action == STREAM_ACTION_COMMIT ||
-		metadata->action == STREAM_ACTION_KEEPALIVE ||
-		metadata->action == STREAM_ACTION_SWITCH)
+	else if (metadata->action == STREAM_ACTION_COMMIT ||
+			 metadata->action == STREAM_ACTION_KEEPALIVE ||
+			 metadata->action == STREAM_ACTION_SWITCH)
 	{
 		if (metadata->action == STREAM_ACTION_COMMIT)
 		{
@@ -179,15 +343,8 @@ stream_transform_line(void *ctx, const char *line, bool *stop)
 			txn->commit = true;
 		}
 
-		/* now write the transaction out */
-		if (!stream_write_message(privateContext->out, currentMsg))
-		{
-			/* errors have already been logged */
-			return false;
-		}
-
-		/* now write the transaction out also to file on-disk */
-		if (!stream_write_message(privateContext->sqlFile, currentMsg))
+		/* now write the transaction out, and also to file on-disk */
+		if (!stream_transform_write_message(privateContext, currentMsg))
 		{
 			/* errors have already been logged */
 			return false;
@@ -195,83 +352,364 @@ stream_transform_line(void *ctx, const char *line, bool *stop)
 
 		(void) FreeLogicalMessage(currentMsg);
 
+		/* then prepare a new one, reusing the same memory area */
+		LogicalMessage empty = { 0 };
+
+		*currentMsg = empty;
+
 		if (metadata->action == STREAM_ACTION_COMMIT)
 		{
-			/* then prepare a new one, reusing the same memory area */
-			LogicalMessage empty = { 0 };
-
-			*currentMsg = empty;
 			++(transformCtx->currentMsgIndex);
 		}
-		else if (currentMsg->isTransaction)
+	}
+
+	/* rotate the SQL file when receiving a SWITCH WAL message */
+	if (metadata->action == STREAM_ACTION_SWITCH)
+	{
+		if (!stream_transform_rotate(privateContext, metadata))
 		{
-			/*
-			 * A SWITCH WAL or a KEEPALIVE message happened in the middle of a
-			 * transaction: we need to mark the new transaction as a continued
-			 * part of the previous one.
-			 */
-			log_debug("stream_transform_line: continued transaction at %c: %X/%X",
-					  metadata->action,
-					  LSN_FORMAT_ARGS(metadata->lsn));
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	if (privateContext->endpos != InvalidXLogRecPtr &&
+		privateContext->endpos <= metadata->lsn)
+	{
+		*stop = true;
+
+		log_info("Transform reached end position %X/%X at %X/%X",
+				 LSN_FORMAT_ARGS(privateContext->endpos),
+				 LSN_FORMAT_ARGS(metadata->lsn));
+	}
+
+	return true;
+}
 
-			LogicalMessage new = { 0 };
 
-			new.isTransaction = true;
-			new.action = STREAM_ACTION_BEGIN;
+/*
+ * stream_transform_split handles a SWITCH WAL or a KEEPALIVE message found in
+ * the middle of the given transaction, which parseMessage has added as the
+ * last statement of the transaction.
+ *
+ * The SWITCH WAL message is written right away, so that it's still the last
+ * line of the current SQL file, and the transaction is then written to the
+ * next SQL file. The KEEPALIVE message is skipped: the replication origin can
+ * not be advanced to an LSN found in the middle of a transaction.
+ */
+static bool
+stream_transform_split(StreamContext *privateContext, LogicalMessage *msg)
+{
+	LogicalTransaction *txn = &(msg->command.tx);
+	LogicalTransactionStatement *stmt = txn->last;
 
-			LogicalTransactionStatement *stmt = NULL;
+	if (stmt == NULL ||
+		(stmt->action != STREAM_ACTION_SWITCH &&
+		 stmt->action != STREAM_ACTION_KEEPALIVE))
+	{
+		log_error("BUG: stream_transform_split called without a SWITCH WAL "
+				  "or a KEEPALIVE statement in transaction %u",
+				  txn->xid);
+		return false;
+	}
 
-			stmt = (LogicalTransactionStatement *)
-				   calloc(1,
-						  sizeof(LogicalTransactionStatement));
+	/* remove the statement from the transaction */
+	txn->last = stmt->prev;
 
-			if (stmt == NULL)
-			{
-				log_error(ALLOCATION_FAILED_ERROR);
-				return false;
-			}
+	if (txn->last == NULL)
+	{
+		txn->first = NULL;
+	}
+	else
+	{
+		txn->last->next = NULL;
+	}
+
+	--(txn->count);
 
-			stmt->action = STREAM_ACTION_BEGIN;
+	bool success = true;
 
-			LogicalTransaction *old = &(currentMsg->command.tx);
-			LogicalTransaction *txn = &(new.command.tx);
+	if (stmt->action == STREAM_ACTION_SWITCH)
+	{
+		LogicalMessage switchwal = { 0 };
 
-			txn->continued = true;
+		switchwal.action = STREAM_ACTION_SWITCH;
+		switchwal.command.switchwal = stmt->stmt.switchwal;
 
-			txn->xid = old->xid;
-			txn->beginLSN = old->beginLSN;
-			strlcpy(txn->timestamp, old->timestamp, sizeof(txn->timestamp));
+		log_debug("stream_transform_split: transaction %u continues after "
+				  "SWITCH WAL at %X/%X",
+				  txn->xid,
+				  LSN_FORMAT_ARGS(stmt->stmt.switchwal.lsn));
 
-			txn->first = NULL;
+		success = stream_transform_write_message(privateContext, &switchwal);
+	}
+
+	free(stmt);
+
+	return success;
+}
+
+
+/*
+ * stream_transform_write_message writes the given message as SQL to both the
+ * output stream and the current SQL file. The SQL text is prepared only once,
+ * in memory, and then written to both places.
+ */
+static bool
+stream_transform_write_message(StreamContext *privateContext,
+							   LogicalMessage *msg)
+{
+	/* spilled transactions are too large to be prepared in memory */
+	if (msg->isTransaction && msg->command.tx.spill != NULL)
+	{
+		return stream_transform_write_spilled(privateContext, msg);
+	}
+
+	char *buffer = NULL;
+	size_t size = 0;
+
+	FILE *mem = open_memstream(&buffer, &size);
+
+	if (mem == NULL)
+	{
+		log_error("Failed to open a memory stream: %m");
+		return false;
+	}
+
+	if (!stream_write_message(mem, msg))
+	{
+		/* errors have already been logged */
+		fclose(mem);
+		free(buffer);
+		return false;
+	}
+
+	if (fclose(mem) != 0)
+	{
+		log_error("Failed to close memory stream: %m");
+		free(buffer);
+		return false;
+	}
+
+	bool success = stream_transform_write_buffer(privateContext, buffer, size);
+
+	free(buffer);
+
+	return success;
+}
+
+
+/*
+ * stream_transform_write_spilled writes a transaction that has been spilled to
+ * disk to both the output stream and the current SQL file. The SQL text is
+ * prepared in a temporary file, and then copied over in chunks.
+ */
+static bool
+stream_transform_write_spilled(StreamContext *privateContext,
+							   LogicalMessage *msg)
+{
+	FILE *temp = stream_transform_tempfile(privateContext->paths.dir);
+
+	if (temp == NULL)
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!stream_write_message(temp, msg))
+	{
+		/* errors have already been logged */
+		fclose(temp);
+		return false;
+	}
+
+	if (fflush(temp) != 0 || fseek(temp, 0L, SEEK_SET) != 0)
+	{
+		log_error("Failed to rewind temporary file: %m");
+		fclose(temp);
+		return false;
+	}
+
+	char buffer[BUFSIZ] = { 0 };
+	size_t bytes = 0;
+	bool success = true;
+
+	while (success &&
+		   (bytes = fread(buffer, sizeof(char), sizeof(buffer), temp)) > 0)
+	{
+		success = stream_transform_write_buffer(privateContext, buffer, bytes);
+	}
+
+	if (success && ferror(temp))
+	{
+		log_error("Failed to read from temporary file: %m");
+		success = false;
+	}
+
+	fclose(temp);
+
+	return success;
+}
+
+
+/*
+ * stream_transform_write_buffer writes the given SQL text to both the output
+ * stream and the current SQL file.
+ */
+static bool
+stream_transform_write_buffer(StreamContext *privateContext,
+							  char *buffer,
+							  size_t size)
+{
+	if (fwrite(buffer, sizeof(char), size, privateContext->out) != size)
+	{
+		log_error("Failed to write SQL to output stream: %m");
+		return false;
+	}
+
+	if (fwrite(buffer, sizeof(char), size, privateContext->sqlFile) != size)
+	{
+		log_error("Failed to write to file \"%s\": %m",
+				  privateContext->sqlFileName);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_transform_spill accounts for the size of the JSON message that has
+ * just been parsed into the given message, and when the current transaction
+ * exceeds TRANSFORM_SPILL_THRESHOLD bytes, writes its statements as SQL to a
+ * temporary file and frees them from memory.
+ */
+static bool
+stream_transform_spill(LogicalMessage *msg,
+					   LogicalMessageMetadata *metadata,
+					   size_t size,
+					   const char *dir)
+{
+	if (!msg->isTransaction)
+	{
+		return true;
+	}
+
+	LogicalTransaction *txn = &(msg->command.tx);
+
+	txn->bytes += size;
+
+	if (txn->bytes < TRANSFORM_SPILL_THRESHOLD)
+	{
+		return true;
+	}
+
+	/* SWITCH WAL messages split the transaction, keep them in memory */
+	switch (metadata->action)
+	{
+		case STREAM_ACTION_INSERT:
+		case STREAM_ACTION_UPDATE:
+		case STREAM_ACTION_DELETE:
+		case STREAM_ACTION_TRUNCATE:
+		{
+			break;
+		}
 
-			*currentMsg = new;
+		default:
+		{
+			return true;
 		}
 	}
 
-	/* rotate the SQL file when receiving a SWITCH WAL message */
-	if (metadata->action == STREAM_ACTION_SWITCH)
+	if (txn->spill == NULL)
 	{
-		if (!stream_transform_rotate(privateContext, metadata))
+		txn->spill = stream_transform_tempfile(dir);
+
+		if (txn->spill == NULL)
 		{
 			/* errors have already been logged */
 			return false;
 		}
+
+		log_notice("Spilling transaction %u to disk, "
+				   "more than %d bytes of changes at %X/%X",
+				   txn->xid,
+				   TRANSFORM_SPILL_THRESHOLD,
+				   LSN_FORMAT_ARGS(metadata->lsn));
 	}
 
-	if (privateContext->endpos != InvalidXLogRecPtr &&
-		privateContext->endpos <= metadata->lsn)
-	{
-		*stop = true;
+	/* the BEGIN message is written at COMMIT time, with the commit LSN */
+	bool sentBEGIN = true;
+	bool splitTx = false;
 
-		log_info("Transform reached end position %X/%X at %X/%X",
-				 LSN_FORMAT_ARGS(privateContext->endpos),
-				 LSN_FORMAT_ARGS(metadata->lsn));
+	/*
+	 * The spilled statements are copied at COMMIT time, maybe to the next SQL
+	 * file: don't rely on the statements prepared in the current file.
+	 */
+	(void) stream_free_prepared_stmts(&transformPreparedStmt);
+
+	if (!stream_write_statements(txn->spill, txn, &sentBEGIN, &splitTx))
+	{
+		/* errors have already been logged */
+		return false;
 	}
 
+	log_debug("stream_transform_spill: spilled transaction %u at %X/%X, "
+			  "%u statements so far",
+			  txn->xid,
+			  LSN_FORMAT_ARGS(metadata->lsn),
+			  txn->count);
+
+	/* txn->count still accounts for the statements that are on-disk now */
+	(void) FreeLogicalTransactionStatements(txn);
+
+	txn->bytes = 0;
+
 	return true;
 }
 
 
+/*
+ * stream_transform_tempfile creates and opens an anonymous temporary file in
+ * the given directory. The file is removed from the directory right away, and
+ * its disk space is released when the file is closed.
+ */
+static FILE *
+stream_transform_tempfile(const char *dir)
+{
+	char template[MAXPGPATH] = { 0 };
+
+	sformat(template, sizeof(template), "%s/transform.XXXXXX",
+			IS_EMPTY_STRING_BUFFER(dir) ? "." : dir);
+
+	int fd = mkstemp(template);
+
+	if (fd == -1)
+	{
+		log_error("Failed to create temporary file \"%s\": %m", template);
+		return NULL;
+	}
+
+	if (unlink(template) != 0)
+	{
+		log_error("Failed to remove temporary file \"%s\": %m", template);
+		close(fd);
+		return NULL;
+	}
+
+	FILE *file = fdopen(fd, "w+");
+
+	if (file == NULL)
+	{
+		log_error("Failed to open temporary file \"%s\": %m", template);
+		close(fd);
+		return NULL;
+	}
+
+	return file;
+}
+
+
 /*
  * stream_transform_message transforms a single JSON message from our streaming
  * output into a SQL statement, and appends it to the given opened transaction.
@@ -371,6 +809,10 @@ stream_transform_rotate(StreamContext *privateContext,
 
 	log_notice("Now transforming changes to \"%s\"", sqlFileName);
 	strlcpy(privateContext->walFileName, jsonFileName, MAXPGPATH);
+
+	/* statements are prepared again in the new file */
+	(void) stream_free_prepared_stmts(&transformPreparedStmt);
+
 	strlcpy(privateContext->sqlFileName, sqlFileName, MAXPGPATH);
 
 	privateContext->sqlFile =
@@ -609,170 +1051,80 @@ stream_transform_send_stop(Queue *queue)
  * stream_transform_file transforms a JSON formatted file as received from the
  * wal2json logical decoding plugin into an SQL file ready for applying to the
  * target database.
+ *
+ * The JSON file is read line by line, and each message is written to the SQL
+ * file as soon as it is complete, so that only the currently opened
+ * transaction is kept in memory.
  */
 bool
 stream_transform_file(char *jsonfilename, char *sqlfilename)
 {
-	StreamContent content = { 0 };
-	long size = 0L;
-
 	log_notice("Transforming JSON file \"%s\" into SQL file \"%s\"",
 			   jsonfilename,
 			   sqlfilename);
 
-	strlcpy(content.filename, jsonfilename, sizeof(content.filename));
+	/*
+	 * The output is written to a temp/partial file which is renamed after
+	 * close, so that another tool that would want to read the file won't read
+	 * partial JSON messages in there.
+	 */
+	char tempfilename[MAXPGPATH] = { 0 };
 
-	if (!read_file(content.filename, &(content.buffer), &size))
-	{
-		/* errors have already been logged */
-		return false;
-	}
-
-	content.count = countLines(content.buffer);
-	content.lines = (char **) calloc(content.count, sizeof(char *));
-	content.count = splitLines(content.buffer, content.lines, content.count);
+	sformat(tempfilename, sizeof(tempfilename), "%s.partial", sqlfilename);
 
-	if (content.lines == NULL)
-	{
-		log_error(ALLOCATION_FAILED_ERROR);
-		return false;
-	}
+	TransformFileCtx ctx = {
+		.sqlfilename = sqlfilename,
+		.lineno = 0,
+		.currentMsg = { 0 },
+		.metadata = { 0 }
+	};
 
-	log_debug("stream_transform_file: read %d lines from \"%s\"",
-			  content.count,
-			  content.filename);
+	/* large transactions are spilled to disk next to the SQL file */
+	strlcpy(ctx.dir, sqlfilename, sizeof(ctx.dir));
+	get_parent_directory(ctx.dir);
 
-	content.messages =
-		(LogicalMessageMetadata *) calloc(content.count,
-										  sizeof(LogicalMessageMetadata));
+	FILE *json = fopen_read_only(jsonfilename);
 
-	if (content.messages == NULL)
+	if (json == NULL)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
+		log_error("Failed to open file \"%s\": %m", jsonfilename);
 		return false;
 	}
 
-	/*
-	 * Message are like:
-	 *
-	 * {action: B} {action: C} {action: K} {action: X}
-	 *
-	 * And when we read a COMMIT message (or KEEPALIVE or SWITCH) we prepare
-	 * for the next message already, which means we need one more entry in the
-	 * array than the number of lines read in the JSON file.
-	 */
-	int maxMesgCount = content.count + 1;
-	LogicalMessageArray mesgs = { 0 };
-
-	/* the actual count is maintained in the for loop below */
-	mesgs.count = 0;
-	mesgs.array =
-		(LogicalMessage *) calloc(maxMesgCount, sizeof(LogicalMessage));
+	ctx.sql = fopen_with_umask(tempfilename, "w", FOPEN_FLAGS_W, 0644);
 
-	if (mesgs.array == NULL)
+	if (ctx.sql == NULL)
 	{
-		log_error(ALLOCATION_FAILED_ERROR);
+		log_error("Failed to create and open file \"%s\"", sqlfilename);
+		fclose(json);
 		return false;
 	}
 
-	/*
-	 * Read the JSON-lines file that we received from streaming logical
-	 * decoding messages, and parse the JSON messages into our internal
-	 * representation structure.
-	 */
-	int currentMsgIndex = 0;
-	LogicalMessage *currentMsg = &(mesgs.array[currentMsgIndex]);
-
-	/* we might need to access to the last message metadata after the loop */
-	LogicalMessageMetadata *metadata = NULL;
-
-	for (int i = 0; i < content.count; i++)
-	{
-		char *message = content.lines[i];
-		metadata = &(content.messages[i]);
-
-		log_trace("stream_transform_file[%2d]: %s", i, message);
-
-		JSON_Value *json = json_parse_string(message);
-
-		if (!parseMessageMetadata(metadata, message, json, false))
-		{
-			/* errors have already been logged */
-			json_value_free(json);
-			return false;
-		}
-
-		/*
-		 * Our SQL file might begin with DML messages, in that case it's a
-		 * transaction that continues over a file boundary.
-		 */
-		if (i == 0 &&
-			(metadata->action == STREAM_ACTION_COMMIT ||
-			 metadata->action == STREAM_ACTION_INSERT ||
-			 metadata->action == STREAM_ACTION_UPDATE ||
-			 metadata->action == STREAM_ACTION_DELETE ||
-			 metadata->action == STREAM_ACTION_TRUNCATE))
-		{
-			LogicalMessage new = { 0 };
-
-			new.isTransaction = true;
-			new.action = STREAM_ACTION_BEGIN;
-
-			LogicalTransactionStatement *stmt = NULL;
-
-			stmt = (LogicalTransactionStatement *)
-				   calloc(1,
-						  sizeof(LogicalTransactionStatement));
-
-			if (stmt == NULL)
-			{
-				log_error(ALLOCATION_FAILED_ERROR);
-				return false;
-			}
-
-			stmt->action = STREAM_ACTION_BEGIN;
-
-			LogicalTransaction *txn = &(new.command.tx);
-			txn->continued = true;
-			txn->first = NULL;
-
-			*currentMsg = new;
-		}
+	log_debug("stream_transform_file writing to \"%s\"", tempfilename);
 
-		if (!parseMessage(currentMsg, metadata, message, json))
-		{
-			log_error("Failed to parse JSON message: %s", message);
-			json_value_free(json);
-			return false;
-		}
+	/* statements are prepared again in each file */
+	(void) stream_free_prepared_stmts(&transformPreparedStmt);
 
-		json_value_free(json);
+	ReadFromStreamContext context = {
+		.callback = stream_transform_file_line,
+		.ctx = &ctx
+	};
 
-		/*
-		 * Prepare a new message when we just read the COMMIT message of an
-		 * opened transaction, closing it, or when we just read a standalone
-		 * non-transactional message (such as a KEEPALIVE or a SWITCH WAL
-		 * message).
-		 */
-		if (!currentMsg->isTransaction ||
-			metadata->action == STREAM_ACTION_COMMIT)
-		{
-			++mesgs.count;
-			++currentMsgIndex;
+	bool success = read_from_stream(json, &context);
 
-			if ((maxMesgCount - 1) < currentMsgIndex)
-			{
-				log_error("Parsing message %d, which is more than the "
-						  "maximum allocated message count %d",
-						  currentMsgIndex + 1,
-						  maxMesgCount);
-				return false;
-			}
+	fclose(json);
 
-			currentMsg = &(mesgs.array[currentMsgIndex]);
-		}
+	/* read_from_stream might have stopped before the end of the file */
+	if (success && (asked_to_stop || asked_to_stop_fast || asked_to_quit))
+	{
+		log_notice("Transforming JSON file \"%s\" was interrupted",
+				   jsonfilename);
+		success = false;
 	}
 
+	LogicalMessage *currentMsg = &(ctx.currentMsg);
+	LogicalMessageMetadata *metadata = &(ctx.metadata);
+
 	/*
 	 * We might have a last pending transaction with a COMMIT message to be
 	 * found in a a later file. In that case though, the last message read was
@@ -782,12 +1134,10 @@ stream_transform_file(char *jsonfilename, char *sqlfilename)
 	 * of a transaction, in that case we ignore the transaction and insert a
 	 * KEEPALIVE message with the LSN we have reached.
 	 */
-	if (currentMsg->isTransaction && metadata->action == STREAM_ACTION_SWITCH)
-	{
-		++mesgs.count;
-	}
-	else if (currentMsg->isTransaction &&
-			 metadata->action != STREAM_ACTION_COMMIT)
+	if (success &&
+		currentMsg->isTransaction &&
+		metadata->action != STREAM_ACTION_SWITCH &&
+		metadata->action != STREAM_ACTION_COMMIT)
 	{
 		LogicalTransaction *currentTx = &(currentMsg->command.tx);
 
@@ -802,86 +1152,154 @@ stream_transform_file(char *jsonfilename, char *sqlfilename)
 		if (stmt == NULL)
 		{
 			log_error(ALLOCATION_FAILED_ERROR);
-			return false;
+			success = false;
 		}
+		else
+		{
+			stmt->action = STREAM_ACTION_KEEPALIVE;
+			stmt->stmt.keepalive.lsn = metadata->lsn;
+
+			strlcpy(stmt->stmt.keepalive.timestamp,
+					metadata->timestamp,
+					sizeof(stmt->stmt.keepalive.timestamp));
 
-		stmt->action = STREAM_ACTION_KEEPALIVE;
-		stmt->stmt.keepalive.lsn = metadata->lsn;
+			(void) streamLogicalTransactionAppendStatement(currentTx, stmt);
+		}
+	}
 
-		strlcpy(stmt->stmt.keepalive.timestamp,
-				metadata->timestamp,
-				sizeof(stmt->stmt.keepalive.timestamp));
+	if (success && currentMsg->isTransaction)
+	{
+		success = stream_write_message(ctx.sql, currentMsg);
+	}
 
-		(void) streamLogicalTransactionAppendStatement(currentTx, stmt);
+	(void) FreeLogicalMessage(currentMsg);
 
-		++mesgs.count;
+	if (fclose(ctx.sql) == EOF)
+	{
+		log_error("Failed to write file \"%s\"", sqlfilename);
+		return false;
 	}
 
-	/* free dynamic memory that's not needed anymore */
-	free(content.lines);
-	free(content.messages);
+	if (!success)
+	{
+		/* errors have already been logged */
+		(void) unlink_file(tempfilename);
+		return false;
+	}
 
-	log_debug("stream_transform_file read %d messages", mesgs.count);
+	log_debug("stream_transform_file: mv \"%s\" \"%s\"",
+			  tempfilename, sqlfilename);
 
-	/*
-	 * Now that we have read and parsed the JSON file into our internal
-	 * structure that represents SQL transactions with statements, output the
-	 * content in the SQL format.
-	 *
-	 * The output is written to a temp/partial file which is renamed after
-	 * close, so that another tool that would want to read the file won't read
-	 * partial JSON messages in there.
-	 */
-	char tempfilename[MAXPGPATH] = { 0 };
+	if (rename(tempfilename, sqlfilename) != 0)
+	{
+		log_error("Failed to move \"%s\" to \"%s\": %m",
+				  tempfilename,
+				  sqlfilename);
+		return false;
+	}
+
+	log_info("Transformed %lld JSON messages into SQL file \"%s\"",
+			 (long long) context.lineno,
+			 sqlfilename);
+
+	return true;
+}
 
-	sformat(tempfilename, sizeof(tempfilename), "%s.partial", sqlfilename);
 
-	FILE *sql = fopen_with_umask(tempfilename, "w", FOPEN_FLAGS_W, 0644);
+/*
+ * stream_transform_file_line is a callback function for the
+ * ReadFromStreamContext and read_from_stream infrastructure. It's called on
+ * each line read from a JSON file, and writes complete messages to the SQL
+ * file.
+ */
+static bool
+stream_transform_file_line(void *ctx, const char *line, bool *stop)
+{
+	TransformFileCtx *transformCtx = (TransformFileCtx *) ctx;
+	LogicalMessage *currentMsg = &(transformCtx->currentMsg);
+	LogicalMessageMetadata *metadata = &(transformCtx->metadata);
+
+	char *message = (char *) line;
+
+	log_trace("stream_transform_file[%2lld]: %s",
+			  (long long) transformCtx->lineno,
+			  message);
+
+	/* clean-up from whatever was read previously */
+	LogicalMessageMetadata empty = { 0 };
+	*metadata = empty;
+
+	JSON_Value *json = json_parse_string(message);
 
-	if (sql == NULL)
+	if (!parseMessageMetadata(metadata, message, json, false))
 	{
-		log_error("Failed to create and open file \"%s\"", sqlfilename);
+		/* errors have already been logged */
+		json_value_free(json);
 		return false;
 	}
 
-	log_debug("stream_transform_file writing to \"%s\"", tempfilename);
-
-	for (int i = 0; i < mesgs.count; i++)
+	/*
+	 * Our SQL file might begin with DML messages, in that case it's a
+	 * transaction that continues over a file boundary.
+	 */
+	if (transformCtx->lineno++ == 0 &&
+		(metadata->action == STREAM_ACTION_COMMIT ||
+		 metadata->action == STREAM_ACTION_INSERT ||
+		 metadata->action == STREAM_ACTION_UPDATE ||
+		 metadata->action == STREAM_ACTION_DELETE ||
+		 metadata->action == STREAM_ACTION_TRUNCATE))
 	{
-		LogicalMessage *currentMsg = &(mesgs.array[i]);
+		LogicalMessage new = { 0 };
 
-		if (!stream_write_message(sql, currentMsg))
-		{
-			/* errors have already been logged */
-			return false;
-		}
+		new.isTransaction = true;
+		new.action = STREAM_ACTION_BEGIN;
 
-		(void) FreeLogicalMessage(currentMsg);
-	}
+		LogicalTransaction *txn = &(new.command.tx);
+		txn->continued = true;
+		txn->first = NULL;
 
-	/* free the LogicalMessage array memory area */
-	free(mesgs.array);
+		*currentMsg = new;
+	}
 
-	if (fclose(sql) == EOF)
+	if (!parseMessage(currentMsg, metadata, message, json))
 	{
-		log_error("Failed to write file \"%s\"", sqlfilename);
+		log_error("Failed to parse JSON message: %s", message);
+		json_value_free(json);
 		return false;
 	}
 
-	log_debug("stream_transform_file: mv \"%s\" \"%s\"",
-			  tempfilename, sqlfilename);
+	json_value_free(json);
 
-	if (rename(tempfilename, sqlfilename) != 0)
+	/* large transactions are spilled to disk rather than kept in memory */
+	if (!stream_transform_spill(currentMsg,
+								metadata,
+								strlen(message),
+								transformCtx->dir))
 	{
-		log_error("Failed to move \"%s\" to \"%s\": %m",
-				  tempfilename,
-				  sqlfilename);
+		/* errors have already been logged */
 		return false;
 	}
 
-	log_info("Transformed %d JSON messages into SQL file \"%s\"",
-			 content.count,
-			 sqlfilename);
+	/*
+	 * Write the message when we just read the COMMIT message of an opened
+	 * transaction, closing it, or when we just read a standalone
+	 * non-transactional message (such as a KEEPALIVE or a SWITCH WAL
+	 * message). Then prepare a new one, reusing the same memory area.
+	 */
+	if (!currentMsg->isTransaction ||
+		metadata->action == STREAM_ACTION_COMMIT)
+	{
+		if (!stream_write_message(transformCtx->sql, currentMsg))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		(void) FreeLogicalMessage(currentMsg);
+
+		LogicalMessage empty = { 0 };
+		*currentMsg = empty;
+	}
 
 	return true;
 }
@@ -1220,6 +1638,23 @@ FreeLogicalMessage(LogicalMessage *msg)
  */
 void
 FreeLogicalTransaction(LogicalTransaction *tx)
+{
+	(void) FreeLogicalTransactionStatements(tx);
+
+	if (tx->spill != NULL)
+	{
+		fclose(tx->spill);
+		tx->spill = NULL;
+	}
+}
+
+
+/*
+ * FreeLogicalTransactionStatements frees the malloc'ated memory areas of the
+ * statements of a LogicalTransaction.
+ */
+static void
+FreeLogicalTransactionStatements(LogicalTransaction *tx)
 {
 	LogicalTransactionStatement *currentStmt = tx->first;
 
@@ -1260,6 +1695,7 @@ FreeLogicalTransaction(LogicalTransaction *tx)
 	}
 
 	tx->first = NULL;
+	tx->last = NULL;
 }
 
 
@@ -1380,6 +1816,81 @@ stream_write_transaction(FILE *out, LogicalTransaction *txn)
 	bool sentBEGIN = false;
 	bool splitTx = false;
 
+	/*
+	 * The first statements of a large transaction might have been spilled to
+	 * disk already, in which case they are copied over first.
+	 */
+	if (txn->spill != NULL)
+	{
+		if (!txn->continued)
+		{
+			if (!stream_write_begin(out, txn))
+			{
+				return false;
+			}
+			sentBEGIN = true;
+		}
+
+		if (!stream_write_spill(out, txn))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	if (!stream_write_statements(out, txn, &sentBEGIN, &splitTx))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/*
+	 * Some transactions might be spanning over multiple WAL.{json,sql} files,
+	 * because it just happened at the boundary LSN. In that case we don't want
+	 * to send the COMMIT message yet.
+	 *
+	 * Continued transaction are then represented using several instances of
+	 * our LogicalTransaction data structure, and the last one of the series
+	 * then have the txn->commit metadata forcibly set to true: here we also
+	 * need to obey that.
+	 *
+	 * The first part of a transaction that continues in the next JSON file
+	 * is written before its COMMIT message has been read, and the commit LSN
+	 * is still unknown then.
+	 */
+	bool complete = txn->commitLSN != InvalidXLogRecPtr;
+
+	if ((sentBEGIN && !splitTx && complete) || txn->commit)
+	{
+		if (!stream_write_commit(out, txn))
+		{
+			return false;
+		}
+
+		/* flush out stream at transaction boundaries */
+		if (fflush(out) != 0)
+		{
+			log_error("Failed to flush stream output: %m");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_write_statements writes the statements of the given transaction as
+ * SQL to the already open out stream. The BEGIN statement is written before
+ * the first DML statement, unless *sentBEGIN is already true or the
+ * transaction is continued from a previous file.
+ */
+static bool
+stream_write_statements(FILE *out,
+						LogicalTransaction *txn,
+						bool *sentBEGIN,
+						bool *splitTx)
+{
 	LogicalTransactionStatement *currentStmt = txn->first;
 
 	for (; currentStmt != NULL; currentStmt = currentStmt->next)
@@ -1388,9 +1899,9 @@ stream_write_transaction(FILE *out, LogicalTransaction *txn)
 		{
 			case STREAM_ACTION_SWITCH:
 			{
-				if (sentBEGIN)
+				if (*sentBEGIN)
 				{
-					splitTx = true;
+					*splitTx = true;
 				}
 
 				if (!stream_write_switchwal(out, &(currentStmt->stmt.switchwal)))
@@ -1411,13 +1922,29 @@ stream_write_transaction(FILE *out, LogicalTransaction *txn)
 
 			case STREAM_ACTION_INSERT:
 			{
-				if (!sentBEGIN && !txn->continued)
+				if (!*sentBEGIN && !txn->continued)
 				{
 					if (!stream_write_begin(out, txn))
 					{
 						return false;
 					}
-					sentBEGIN = true;
+					*sentBEGIN = true;
+				}
+
+				/* bulk loads are applied using the COPY protocol */
+				LogicalTransactionStatement *lastStmt = NULL;
+
+				if (transformCopyInserts &&
+					stream_insert_run(currentStmt, &lastStmt) >=
+					APPLY_COPY_MIN_ROWS)
+				{
+					if (!stream_write_copy(out, currentStmt, lastStmt))
+					{
+						return false;
+					}
+
+					currentStmt = lastStmt;
+					break;
 				}
 
 				if (!stream_write_insert(out, &(currentStmt->stmt.insert)))
@@ -1430,13 +1957,28 @@ stream_write_transaction(FILE *out, LogicalTransaction *txn)
 
 			case STREAM_ACTION_UPDATE:
 			{
-				if (!sentBEGIN && !txn->continued)
+				if (!*sentBEGIN && !txn->continued)
 				{
 					if (!stream_write_begin(out, txn))
 					{
 						return false;
 					}
-					sentBEGIN = true;
+					*sentBEGIN = true;
+				}
+
+				/* mass updates are applied using set-based statements */
+				LogicalTransactionStatement *lastStmt = NULL;
+
+				if (stream_update_run(currentStmt, &lastStmt) >=
+					APPLY_BATCH_MIN_ROWS)
+				{
+					if (!stream_write_update_batch(out, currentStmt, lastStmt))
+					{
+						return false;
+					}
+
+					currentStmt = lastStmt;
+					break;
 				}
 
 				if (!stream_write_update(out, &(currentStmt->stmt.update)))
@@ -1448,13 +1990,28 @@ stream_write_transaction(FILE *out, LogicalTransaction *txn)
 
 			case STREAM_ACTION_DELETE:
 			{
-				if (!sentBEGIN && !txn->continued)
+				if (!*sentBEGIN && !txn->continued)
 				{
 					if (!stream_write_begin(out, txn))
 					{
 						return false;
 					}
-					sentBEGIN = true;
+					*sentBEGIN = true;
+				}
+
+				/* mass deletes are applied using set-based statements */
+				LogicalTransactionStatement *lastStmt = NULL;
+
+				if (stream_delete_run(currentStmt, &lastStmt) >=
+					APPLY_BATCH_MIN_ROWS)
+				{
+					if (!stream_write_delete_batch(out, currentStmt, lastStmt))
+					{
+						return false;
+					}
+
+					currentStmt = lastStmt;
+					break;
 				}
 
 				if (!stream_write_delete(out, &(currentStmt->stmt.delete)))
@@ -1466,13 +2023,13 @@ stream_write_transaction(FILE *out, LogicalTransaction *txn)
 
 			case STREAM_ACTION_TRUNCATE:
 			{
-				if (!sentBEGIN && !txn->continued)
+				if (!*sentBEGIN && !txn->continued)
 				{
 					if (!stream_write_begin(out, txn))
 					{
 						return false;
 					}
-					sentBEGIN = true;
+					*sentBEGIN = true;
 				}
 
 				if (!stream_write_truncate(out, &(currentStmt->stmt.truncate)))
@@ -1491,31 +2048,48 @@ stream_write_transaction(FILE *out, LogicalTransaction *txn)
 		}
 	}
 
-	/*
-	 * Some transactions might be spanning over multiple WAL.{json,sql} files,
-	 * because it just happened at the boundary LSN. In that case we don't want
-	 * to send the COMMIT message yet.
-	 *
-	 * Continued transaction are then represented using several instances of
-	 * our LogicalTransaction data structure, and the last one of the series
-	 * then have the txn->commit metadata forcibly set to true: here we also
-	 * need to obey that.
-	 */
-	if ((sentBEGIN && !splitTx) || txn->commit)
+	return true;
+}
+
+
+/*
+ * stream_write_spill copies the statements of a transaction that have been
+ * spilled to disk to the already open out stream.
+ */
+static bool
+stream_write_spill(FILE *out, LogicalTransaction *txn)
+{
+	if (fflush(txn->spill) != 0 || fseek(txn->spill, 0L, SEEK_SET) != 0)
 	{
-		if (!stream_write_commit(out, txn))
-		{
-			return false;
-		}
+		log_error("Failed to rewind transaction spill file: %m");
+		return false;
+	}
 
-		/* flush out stream at transaction boundaries */
-		if (fflush(out) != 0)
+	char buffer[BUFSIZ] = { 0 };
+	size_t bytes = 0;
+
+	while ((bytes = fread(buffer, sizeof(char), sizeof(buffer), txn->spill)) > 0)
+	{
+		if (fwrite(buffer, sizeof(char), bytes, out) != bytes)
 		{
-			log_error("Failed to flush stream output: %m");
+			log_error("Failed to write spilled transaction: %m");
 			return false;
 		}
 	}
 
+	if (ferror(txn->spill))
+	{
+		log_error("Failed to read transaction spill file: %m");
+		return false;
+	}
+
+	/* more statements might be spilled later */
+	if (fseek(txn->spill, 0L, SEEK_END) != 0)
+	{
+		log_error("Failed to seek transaction spill file: %m");
+		return false;
+	}
+
 	return true;
 }
 
@@ -1528,14 +2102,304 @@ stream_write_begin(FILE *out, LogicalTransaction *txn)
 {
 	int ret =
 		fformat(out,
-				"%s{\"xid\":%lld,\"lsn\":\"%X/%X\",\"timestamp\":\"%s\",\"commit_lsn\":\"%X/%X\"}\n",
+				"%s{\"xid\":%lld,\"lsn\":\"%X/%X\",\"timestamp\":\"%s\",\"commit_lsn\":\"%X/%X\"",
 				OUTPUT_BEGIN,
 				(long long) txn->xid,
 				LSN_FORMAT_ARGS(txn->beginLSN),
 				txn->timestamp,
 				LSN_FORMAT_ARGS(txn->commitLSN));
 
-	return ret != -1;
+	if (ret == -1)
+	{
+		return false;
+	}
+
+	if (transformWriteSets && !stream_write_keys(out, txn))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	return fformat(out, "}\n") != -1;
+}
+
+
+/*
+ * stream_write_keys writes the write set of the given transaction as a JSON
+ * array of keys, to be added to its BEGIN message. Nothing is written when the
+ * write set is unknown.
+ */
+static bool
+stream_write_keys(FILE *out, LogicalTransaction *txn)
+{
+	WriteSet *writeSet = (WriteSet *) calloc(1, sizeof(WriteSet));
+
+	if (writeSet == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	if (!stream_compute_write_set(txn, writeSet))
+	{
+		/* errors have already been logged */
+		free(writeSet);
+		return false;
+	}
+
+	bool success = true;
+
+	if (writeSet->known)
+	{
+		success = fformat(out, ",\"keys\":[") != -1;
+
+		for (int i = 0; success && i < writeSet->count; i++)
+		{
+			WriteSetKey *key = &(writeSet->keys[i]);
+
+			success = fformat(out, "%s\"%c%016" PRIx64 "\"",
+							  i > 0 ? "," : "",
+							  (char) key->type,
+							  key->hash) != -1;
+		}
+
+		success = success && fformat(out, "]") != -1;
+	}
+
+	free(writeSet);
+
+	return success;
+}
+
+
+/*
+ * stream_compute_write_set computes the write set of the given transaction.
+ *
+ * The write set is unknown when the transaction is not complete, as happens
+ * when it spans over several SQL files: the BEGIN message is then written
+ * before all the statements are known. It is also unknown when some of the
+ * statements have been spilled to disk.
+ */
+static bool
+stream_compute_write_set(LogicalTransaction *txn, WriteSet *writeSet)
+{
+	writeSet->known = txn->commit && !txn->continued && txn->spill == NULL;
+	writeSet->count = 0;
+
+	LogicalTransactionStatement *stmt = txn->first;
+
+	for (; writeSet->known && stmt != NULL; stmt = stmt->next)
+	{
+		switch (stmt->action)
+		{
+			case STREAM_ACTION_INSERT:
+			{
+				LogicalMessageInsert *insert = &(stmt->stmt.insert);
+
+				(void) stream_write_set_add(writeSet,
+											WRITE_SET_KEY_INSERT,
+											stream_relation_hash(insert->nspname,
+																 insert->relname));
+				break;
+			}
+
+			case STREAM_ACTION_UPDATE:
+			{
+				LogicalMessageUpdate *update = &(stmt->stmt.update);
+				uint64_t relhash =
+					stream_relation_hash(update->nspname, update->relname);
+
+				(void) stream_write_set_add(writeSet,
+											WRITE_SET_KEY_UPDATE,
+											relhash);
+
+				if (update->old.count != update->new.count)
+				{
+					writeSet->known = false;
+					break;
+				}
+
+				/* the row before and after the UPDATE, by replica identity */
+				for (int s = 0; writeSet->known && s < update->old.count; s++)
+				{
+					LogicalMessageTuple *old = &(update->old.array[s]);
+					LogicalMessageTuple *new = &(update->new.array[s]);
+					uint64_t oldHash = 0;
+					uint64_t newHash = 0;
+
+					if (!stream_row_hash(relhash, old, old, &oldHash) ||
+						!stream_row_hash(relhash, old, new, &newHash))
+					{
+						writeSet->known = false;
+						break;
+					}
+
+					(void) stream_write_set_add(writeSet,
+												WRITE_SET_KEY_ROW,
+												oldHash);
+					(void) stream_write_set_add(writeSet,
+												WRITE_SET_KEY_ROW,
+												newHash);
+				}
+				break;
+			}
+
+			case STREAM_ACTION_DELETE:
+			{
+				LogicalMessageDelete *delete = &(stmt->stmt.delete);
+				uint64_t relhash =
+					stream_relation_hash(delete->nspname, delete->relname);
+
+				(void) stream_write_set_add(writeSet,
+											WRITE_SET_KEY_UPDATE,
+											relhash);
+
+				for (int s = 0; writeSet->known && s < delete->old.count; s++)
+				{
+					LogicalMessageTuple *old = &(delete->old.array[s]);
+					uint64_t oldHash = 0;
+
+					if (!stream_row_hash(relhash, old, old, &oldHash))
+					{
+						writeSet->known = false;
+						break;
+					}
+
+					(void) stream_write_set_add(writeSet,
+												WRITE_SET_KEY_ROW,
+												oldHash);
+				}
+				break;
+			}
+
+			case STREAM_ACTION_TRUNCATE:
+			{
+				LogicalMessageTruncate *truncate = &(stmt->stmt.truncate);
+
+				(void) stream_write_set_add(writeSet,
+											WRITE_SET_KEY_TRUNCATE,
+											stream_relation_hash(truncate->nspname,
+																 truncate->relname));
+				break;
+			}
+
+			/* the transaction is split over several SQL files */
+			case STREAM_ACTION_SWITCH:
+			case STREAM_ACTION_KEEPALIVE:
+			{
+				writeSet->known = false;
+				break;
+			}
+
+			default:
+			{
+				break;
+			}
+		}
+	}
+
+	if (writeSet->known)
+	{
+		(void) stream_write_set_sort(writeSet);
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_row_hash computes the hash of a row from its replica identity: the
+ * identity tuple gives the column names, and their values are found in the
+ * given tuple, which is either the identity tuple itself, or the new tuple of
+ * an UPDATE. Returns false when the hash can not be computed.
+ */
+static bool
+stream_row_hash(uint64_t relhash,
+				LogicalMessageTuple *identity,
+				LogicalMessageTuple *tuple,
+				uint64_t *hash)
+{
+	if (identity->values.count != 1 || tuple->values.count != 1)
+	{
+		return false;
+	}
+
+	LogicalMessageValues *values = &(tuple->values.array[0]);
+
+	*hash = relhash;
+
+	for (int c = 0; c < identity->cols; c++)
+	{
+		int v = c;
+
+		if (tuple != identity)
+		{
+			for (v = 0; v < tuple->cols; v++)
+			{
+				if (strcmp(tuple->columns[v], identity->columns[c]) == 0)
+				{
+					break;
+				}
+			}
+		}
+
+		if (v >= tuple->cols || v >= values->cols)
+		{
+			return false;
+		}
+
+		*hash = stream_hash_string(*hash, identity->columns[c]);
+		*hash = stream_value_hash(*hash, &(values->array[v]));
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_value_hash updates the given hash with the given value.
+ */
+static uint64_t
+stream_value_hash(uint64_t hash, LogicalMessageValue *value)
+{
+	char str[BUFSIZE] = { 0 };
+
+	if (value->isNull)
+	{
+		return stream_hash_string(hash, "");
+	}
+
+	switch (value->oid)
+	{
+		case BOOLOID:
+		{
+			return stream_hash_string(hash, value->val.boolean ? "t" : "f");
+		}
+
+		case INT8OID:
+		{
+			sformat(str, sizeof(str), "%lld", (long long) value->val.int8);
+			return stream_hash_string(hash, str);
+		}
+
+		case FLOAT8OID:
+		{
+			sformat(str, sizeof(str), "%.17g", value->val.float8);
+			return stream_hash_string(hash, str);
+		}
+
+		case TEXTOID:
+		case BYTEAOID:
+		{
+			return stream_hash_string(hash, value->val.str);
+		}
+
+		/* unknown values only lead to more conflicts */
+		default:
+		{
+			return hash;
+		}
+	}
 }
 
 
@@ -1602,6 +2466,11 @@ stream_write_keepalive(FILE *out, LogicalMessageKeepalive *keepalive)
 bool
 stream_write_insert(FILE *out, LogicalMessageInsert *insert)
 {
+	if (transformPreparedStatements)
+	{
+		return stream_write_insert_prepared(out, insert);
+	}
+
 	/* loop over INSERT statements targeting the same table */
 	for (int s = 0; s < insert->new.count; s++)
 	{
@@ -1669,72 +2538,311 @@ stream_write_insert(FILE *out, LogicalMessageInsert *insert)
 
 
 /*
- * stream_write_update writes an UPDATE statement to the already open out
- * stream.
+ * stream_insert_run returns how many rows are inserted by the run of INSERT
+ * statements that starts at the given statement, all targeting the same
+ * relation with the same list of columns. The last parameter is set to the
+ * last statement of the run.
  */
-bool
-stream_write_update(FILE *out, LogicalMessageUpdate *update)
+static int
+stream_insert_run(LogicalTransactionStatement *first,
+				  LogicalTransactionStatement **last)
 {
-	if (update->old.count != update->new.count)
-	{
-		log_error("Failed to write UPDATE statement "
-				  "with %d old rows and %d new rows",
-				  update->old.count,
-				  update->new.count);
-		return false;
-	}
+	LogicalMessageInsert *insert = &(first->stmt.insert);
+	LogicalMessageTuple *columns = NULL;
+	int rows = 0;
 
-	/* loop over UPDATE statements targeting the same table */
-	for (int s = 0; s < update->old.count; s++)
-	{
-		LogicalMessageTuple *old = &(update->old.array[s]);
-		LogicalMessageTuple *new = &(update->new.array[s]);
+	*last = first;
 
-		FFORMAT(out, "UPDATE \"%s\".\"%s\" ", update->nspname, update->relname);
+	for (LogicalTransactionStatement *stmt = first;
+		 stmt != NULL && stmt->action == STREAM_ACTION_INSERT;
+		 stmt = stmt->next)
+	{
+		LogicalMessageInsert *current = &(stmt->stmt.insert);
 
-		if (old->values.count != new->values.count ||
-			old->values.count != 1 ||
-			new->values.count != 1)
+		if (strcmp(current->nspname, insert->nspname) != 0 ||
+			strcmp(current->relname, insert->relname) != 0)
 		{
-			log_error("Failed to write multi-values UPDATE statement "
-					  "with %d old rows and %d new rows",
-					  old->values.count,
-					  new->values.count);
-			return false;
+			break;
 		}
 
-		FFORMAT(out, "%s", "SET ");
+		bool sameColumns = true;
+		int stmtRows = 0;
 
-		for (int r = 0; r < new->values.count; r++)
+		for (int s = 0; sameColumns && s < current->new.count; s++)
 		{
-			LogicalMessageValues *values = &(new->values.array[r]);
+			LogicalMessageTuple *tuple = &(current->new.array[s]);
 
-			/* now loop over column values for this VALUES row */
-			for (int v = 0; v < values->cols; v++)
+			if (columns == NULL)
 			{
-				LogicalMessageValue *value = &(values->array[v]);
-
-				if (new->cols <= v)
-				{
-					log_error("Failed to write UPDATE statement with more "
-							  "VALUES (%d) than COLUMNS (%d)",
-							  values->cols,
-							  new->cols);
-					return false;
-				}
+				columns = tuple;
+			}
 
-				FFORMAT(out, "%s", v > 0 ? ", " : "");
-				FFORMAT(out, "\"%s\" = ", new->columns[v]);
+			sameColumns = stream_same_columns(columns, tuple);
 
-				if (!stream_write_value(out, value))
-				{
-					/* errors have already been logged */
-					return false;
-				}
+			for (int r = 0; sameColumns && r < tuple->values.count; r++)
+			{
+				sameColumns = tuple->values.array[r].cols == tuple->cols;
 			}
-		}
 
-		FFORMAT(out, "%s", " WHERE ");
+			stmtRows += tuple->values.count;
+		}
+
+		if (!sameColumns)
+		{
+			break;
+		}
+
+		rows += stmtRows;
+		*last = stmt;
+	}
+
+	return rows;
+}
+
+
+/*
+ * stream_same_columns returns true when both tuples have the same columns.
+ */
+static bool
+stream_same_columns(LogicalMessageTuple *a, LogicalMessageTuple *b)
+{
+	if (a->cols != b->cols)
+	{
+		return false;
+	}
+
+	for (int c = 0; c < a->cols; c++)
+	{
+		if (strcmp(a->columns[c], b->columns[c]) != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_write_copy writes the rows of the given run of INSERT statements as
+ * COPY commands, at most APPLY_COPY_MAX_ROWS rows per command. The command
+ * contains the target relation, the columns, and the rows as a JSON array of
+ * arrays of values in Postgres text format:
+ *
+ * COPY {"nspname":"public","relname":"t","columns":["a"],"rows":[["1"]]};
+ */
+static bool
+stream_write_copy(FILE *out,
+				  LogicalTransactionStatement *first,
+				  LogicalTransactionStatement *last)
+{
+	LogicalMessageInsert *insert = &(first->stmt.insert);
+	JSON_Value *js = json_value_init_object();
+
+	for (LogicalTransactionStatement *stmt = first;
+		 stmt != NULL;
+		 stmt = stmt->next)
+	{
+		LogicalMessageInsert *current = &(stmt->stmt.insert);
+
+		for (int s = 0; s < current->new.count; s++)
+		{
+			if (!stream_write_copy_rows(out,
+										insert,
+										&(current->new.array[s]),
+										js))
+			{
+				/* errors have already been logged */
+				json_value_free(js);
+				return false;
+			}
+		}
+
+		if (stmt == last)
+		{
+			break;
+		}
+	}
+
+	/* write the remaining rows */
+	bool success = stream_write_copy_flush(out, js);
+
+	json_value_free(js);
+
+	return success;
+}
+
+
+/*
+ * stream_write_copy_rows adds the rows of the given tuple to the COPY command
+ * being prepared in the js object, writing the command out each time it
+ * reaches APPLY_COPY_MAX_ROWS rows.
+ */
+static bool
+stream_write_copy_rows(FILE *out,
+					   LogicalMessageInsert *insert,
+					   LogicalMessageTuple *tuple,
+					   JSON_Value *js)
+{
+	JSON_Object *jsobj = json_value_get_object(js);
+
+	for (int r = 0; r < tuple->values.count; r++)
+	{
+		JSON_Array *jsRows = json_object_get_array(jsobj, "rows");
+
+		if (jsRows == NULL)
+		{
+			JSON_Value *jsColumns = json_value_init_array();
+			JSON_Array *jsColumnsArray = json_value_get_array(jsColumns);
+
+			for (int c = 0; c < tuple->cols; c++)
+			{
+				json_array_append_string(jsColumnsArray, tuple->columns[c]);
+			}
+
+			json_object_set_string(jsobj, "nspname", insert->nspname);
+			json_object_set_string(jsobj, "relname", insert->relname);
+			json_object_set_value(jsobj, "columns", jsColumns);
+			json_object_set_value(jsobj, "rows", json_value_init_array());
+
+			jsRows = json_object_get_array(jsobj, "rows");
+		}
+
+		LogicalMessageValues *values = &(tuple->values.array[r]);
+		JSON_Value *jsRow = json_value_init_array();
+		JSON_Array *jsRowArray = json_value_get_array(jsRow);
+
+		for (int v = 0; v < values->cols; v++)
+		{
+			if (!stream_add_value_param(jsRowArray, &(values->array[v])))
+			{
+				/* errors have already been logged */
+				json_value_free(jsRow);
+				return false;
+			}
+		}
+
+		json_array_append_value(jsRows, jsRow);
+
+		if (json_array_get_count(jsRows) == APPLY_COPY_MAX_ROWS)
+		{
+			if (!stream_write_copy_flush(out, js))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_write_copy_flush writes the COPY command prepared in the js object,
+ * if it contains any row.
+ */
+static bool
+stream_write_copy_flush(FILE *out, JSON_Value *js)
+{
+	JSON_Object *jsobj = json_value_get_object(js);
+
+	if (json_object_get_array(jsobj, "rows") == NULL)
+	{
+		return true;
+	}
+
+	char *serialized = json_serialize_to_string(js);
+
+	if (serialized == NULL)
+	{
+		log_error("Failed to serialize COPY command");
+		return false;
+	}
+
+	int ret = fformat(out, "%s%s;\n", OUTPUT_COPY, serialized);
+
+	json_free_serialized_string(serialized);
+
+	/* the next rows go to a new COPY command */
+	json_object_remove(jsobj, "rows");
+
+	return ret != -1;
+}
+
+
+/*
+ * stream_write_update writes an UPDATE statement to the already open out
+ * stream.
+ */
+bool
+stream_write_update(FILE *out, LogicalMessageUpdate *update)
+{
+	if (transformPreparedStatements)
+	{
+		return stream_write_update_prepared(out, update);
+	}
+
+	if (update->old.count != update->new.count)
+	{
+		log_error("Failed to write UPDATE statement "
+				  "with %d old rows and %d new rows",
+				  update->old.count,
+				  update->new.count);
+		return false;
+	}
+
+	/* loop over UPDATE statements targeting the same table */
+	for (int s = 0; s < update->old.count; s++)
+	{
+		LogicalMessageTuple *old = &(update->old.array[s]);
+		LogicalMessageTuple *new = &(update->new.array[s]);
+
+		FFORMAT(out, "UPDATE \"%s\".\"%s\" ", update->nspname, update->relname);
+
+		if (old->values.count != new->values.count ||
+			old->values.count != 1 ||
+			new->values.count != 1)
+		{
+			log_error("Failed to write multi-values UPDATE statement "
+					  "with %d old rows and %d new rows",
+					  old->values.count,
+					  new->values.count);
+			return false;
+		}
+
+		FFORMAT(out, "%s", "SET ");
+
+		for (int r = 0; r < new->values.count; r++)
+		{
+			LogicalMessageValues *values = &(new->values.array[r]);
+
+			/* now loop over column values for this VALUES row */
+			for (int v = 0; v < values->cols; v++)
+			{
+				LogicalMessageValue *value = &(values->array[v]);
+
+				if (new->cols <= v)
+				{
+					log_error("Failed to write UPDATE statement with more "
+							  "VALUES (%d) than COLUMNS (%d)",
+							  values->cols,
+							  new->cols);
+					return false;
+				}
+
+				FFORMAT(out, "%s", v > 0 ? ", " : "");
+				FFORMAT(out, "\"%s\" = ", new->columns[v]);
+
+				if (!stream_write_value(out, value))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+			}
+		}
+
+		FFORMAT(out, "%s", " WHERE ");
 
 		for (int r = 0; r < old->values.count; r++)
 		{
@@ -1779,6 +2887,11 @@ stream_write_update(FILE *out, LogicalMessageUpdate *update)
 bool
 stream_write_delete(FILE *out, LogicalMessageDelete *delete)
 {
+	if (transformPreparedStatements)
+	{
+		return stream_write_delete_prepared(out, delete);
+	}
+
 	/* loop over DELETE statements targeting the same table */
 	for (int s = 0; s < delete->old.count; s++)
 	{
@@ -1828,68 +2941,430 @@ stream_write_delete(FILE *out, LogicalMessageDelete *delete)
 
 
 /*
- * stream_write_truncate writes an TRUNCATE statement to the already open out
- * stream.
+ * stream_delete_run returns how many rows are deleted by the run of DELETE
+ * statements that starts at the given statement, all targeting the same
+ * relation with the same replica identity columns, and sets last to the last
+ * statement of the run. A run contains at most APPLY_BATCH_MAX_ROWS rows.
+ *
+ * Deleting rows does not depend on the order of the statements, so that the
+ * whole run can be applied as a single statement.
  */
-bool
-stream_write_truncate(FILE *out, LogicalMessageTruncate *truncate)
+static int
+stream_delete_run(LogicalTransactionStatement *first,
+				  LogicalTransactionStatement **last)
 {
-	fformat(out, "TRUNCATE ONLY %s.%s\n", truncate->nspname, truncate->relname);
+	LogicalMessageDelete *delete = &(first->stmt.delete);
+	LogicalMessageTuple *identity = NULL;
+	int rows = 0;
 
-	return true;
+	*last = first;
+
+	for (LogicalTransactionStatement *stmt = first;
+		 stmt != NULL && stmt->action == STREAM_ACTION_DELETE;
+		 stmt = stmt->next)
+	{
+		LogicalMessageDelete *current = &(stmt->stmt.delete);
+
+		if (strcmp(current->nspname, delete->nspname) != 0 ||
+			strcmp(current->relname, delete->relname) != 0 ||
+			rows + current->old.count > APPLY_BATCH_MAX_ROWS)
+		{
+			break;
+		}
+
+		bool sameIdentity = true;
+
+		for (int s = 0; sameIdentity && s < current->old.count; s++)
+		{
+			LogicalMessageTuple *old = &(current->old.array[s]);
+
+			if (identity == NULL)
+			{
+				identity = old;
+			}
+
+			sameIdentity =
+				stream_same_columns(identity, old) &&
+				old->values.count == 1 &&
+				old->values.array[0].cols == old->cols;
+		}
+
+		if (!sameIdentity)
+		{
+			break;
+		}
+
+		rows += current->old.count;
+		*last = stmt;
+	}
+
+	return rows;
 }
 
 
 /*
- * stream_write_value writes the given LogicalMessageValue to the out stream.
+ * stream_update_run returns how many rows are updated by the run of UPDATE
+ * statements that starts at the given statement, all targeting the same
+ * relation with the same replica identity columns and the same updated
+ * columns, and sets last to the last statement of the run. A run contains at
+ * most APPLY_BATCH_MAX_ROWS rows.
+ *
+ * A set-based UPDATE finds all its target rows before changing any of them,
+ * so a run stops at the first statement that targets or produces a row that
+ * an earlier statement of the run either targets or produces.
  */
-bool
-stream_write_value(FILE *out, LogicalMessageValue *value)
+static int
+stream_update_run(LogicalTransactionStatement *first,
+				  LogicalTransactionStatement **last)
 {
-	if (value == NULL)
-	{
-		log_error("BUG: stream_write_value value is NULL");
-		return false;
-	}
+	LogicalMessageUpdate *update = &(first->stmt.update);
+	LogicalMessageTuple *identity = NULL;
+	LogicalMessageTuple *columns = NULL;
 
-	if (value->isNull)
-	{
-		fformat(out, "NULL");
-	}
-	else
+	uint64_t relhash = stream_relation_hash(update->nspname, update->relname);
+	uint64_t hashes[2 * APPLY_BATCH_MAX_ROWS] = { 0 };
+	int hashCount = 0;
+	int rows = 0;
+
+	*last = first;
+
+	for (LogicalTransactionStatement *stmt = first;
+		 stmt != NULL && stmt->action == STREAM_ACTION_UPDATE;
+		 stmt = stmt->next)
 	{
-		switch (value->oid)
+		LogicalMessageUpdate *current = &(stmt->stmt.update);
+
+		if (strcmp(current->nspname, update->nspname) != 0 ||
+			strcmp(current->relname, update->relname) != 0 ||
+			current->old.count != current->new.count ||
+			rows + current->old.count > APPLY_BATCH_MAX_ROWS)
 		{
-			case BOOLOID:
-			{
-				fformat(out, "'%s' ", value->val.boolean ? "t" : "f");
-				break;
-			}
+			break;
+		}
 
-			case INT8OID:
+		bool batchable = true;
+		int stmtHashCount = hashCount;
+
+		for (int s = 0; batchable && s < current->old.count; s++)
+		{
+			LogicalMessageTuple *old = &(current->old.array[s]);
+			LogicalMessageTuple *new = &(current->new.array[s]);
+
+			if (identity == NULL)
 			{
-				fformat(out, "%lld", (long long) value->val.int8);
-				break;
+				identity = old;
+				columns = new;
 			}
 
-			case FLOAT8OID:
+			batchable =
+				stream_same_columns(identity, old) &&
+				stream_same_columns(columns, new) &&
+				old->values.count == 1 &&
+				new->values.count == 1 &&
+				old->values.array[0].cols == old->cols &&
+				new->values.array[0].cols == new->cols;
+
+			uint64_t oldHash = 0;
+			uint64_t newHash = 0;
+
+			batchable = batchable &&
+						stream_row_hash(relhash, old, old, &oldHash) &&
+						stream_row_hash(relhash, old, new, &newHash);
+
+			/*
+			 * Neither the target row nor the row it becomes may be known
+			 * already in this run: the set-based UPDATE would then either
+			 * miss the row, or check unique constraints against a row that
+			 * an earlier statement has not moved away yet.
+			 */
+			for (int h = 0; batchable && h < stmtHashCount; h++)
 			{
-				fformat(out, "%g", value->val.float8);
-				break;
+				batchable = hashes[h] != oldHash && hashes[h] != newHash;
 			}
 
-			case TEXTOID:
-			case BYTEAOID:
+			if (batchable)
 			{
-				if (value->isQuoted)
-				{
-					fformat(out, "%s", value->val.str);
-				}
-				else
-				{
-					fformat(out, "'%s'", value->val.str);
-				}
-				break;
+				hashes[stmtHashCount++] = oldHash;
+				hashes[stmtHashCount++] = newHash;
+			}
+		}
+
+		if (!batchable)
+		{
+			break;
+		}
+
+		hashCount = stmtHashCount;
+		rows += current->old.count;
+		*last = stmt;
+	}
+
+	return rows;
+}
+
+
+/*
+ * stream_write_delete_batch writes a single DELETE statement for the given run
+ * of DELETE statements:
+ *
+ * DELETE FROM "public"."t" WHERE ("id") IN ((1), (2), (3));
+ *
+ * An IN list is used rather than a VALUES list so that literals are resolved
+ * to the type of the replica identity columns.
+ */
+static bool
+stream_write_delete_batch(FILE *out,
+						  LogicalTransactionStatement *first,
+						  LogicalTransactionStatement *last)
+{
+	LogicalMessageDelete *delete = &(first->stmt.delete);
+	LogicalMessageTuple *identity = &(delete->old.array[0]);
+	int rows = 0;
+
+	FFORMAT(out, "DELETE FROM \"%s\".\"%s\" WHERE (",
+			delete->nspname,
+			delete->relname);
+
+	for (int c = 0; c < identity->cols; c++)
+	{
+		FFORMAT(out, "%s\"%s\"", c > 0 ? ", " : "", identity->columns[c]);
+	}
+
+	FFORMAT(out, "%s", ") IN (");
+
+	for (LogicalTransactionStatement *stmt = first;
+		 stmt != NULL;
+		 stmt = stmt->next)
+	{
+		LogicalMessageDelete *current = &(stmt->stmt.delete);
+
+		for (int s = 0; s < current->old.count; s++)
+		{
+			FFORMAT(out, "%s", rows++ > 0 ? ", " : "");
+
+			if (!stream_write_identity(out, &(current->old.array[s])))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+
+		if (stmt == last)
+		{
+			break;
+		}
+	}
+
+	FFORMAT(out, "%s", ");\n");
+
+	return true;
+}
+
+
+/*
+ * stream_write_update_batch writes a single UPDATE statement for the given run
+ * of UPDATE statements:
+ *
+ * UPDATE "public"."t"
+ *    SET "id" = CASE WHEN ("id") = (1) THEN 1 WHEN ("id") = (2) THEN 2 ELSE "id" END,
+ *        "v" = CASE WHEN ("id") = (1) THEN 'a' WHEN ("id") = (2) THEN 'b' ELSE "v" END
+ *  WHERE ("id") IN ((1), (2));
+ *
+ * The ELSE branch of the CASE expressions resolves literals to the type of the
+ * column, which a VALUES list would resolve to text instead.
+ */
+static bool
+stream_write_update_batch(FILE *out,
+						  LogicalTransactionStatement *first,
+						  LogicalTransactionStatement *last)
+{
+	LogicalMessageUpdate *update = &(first->stmt.update);
+	LogicalMessageTuple *identity = &(update->old.array[0]);
+	LogicalMessageTuple *columns = &(update->new.array[0]);
+
+	FFORMAT(out, "UPDATE \"%s\".\"%s\" SET ", update->nspname, update->relname);
+
+	for (int c = 0; c < columns->cols; c++)
+	{
+		FFORMAT(out, "%s\"%s\" = CASE", c > 0 ? ", " : "", columns->columns[c]);
+
+		for (LogicalTransactionStatement *stmt = first;
+			 stmt != NULL;
+			 stmt = stmt->next)
+		{
+			LogicalMessageUpdate *current = &(stmt->stmt.update);
+
+			for (int s = 0; s < current->old.count; s++)
+			{
+				LogicalMessageTuple *old = &(current->old.array[s]);
+				LogicalMessageTuple *new = &(current->new.array[s]);
+
+				FFORMAT(out, "%s", " WHEN (");
+
+				for (int i = 0; i < identity->cols; i++)
+				{
+					FFORMAT(out, "%s\"%s\"",
+							i > 0 ? ", " : "",
+							identity->columns[i]);
+				}
+
+				FFORMAT(out, "%s", ") = ");
+
+				if (!stream_write_identity(out, old))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+
+				FFORMAT(out, "%s", " THEN ");
+
+				if (!stream_write_value(out, &(new->values.array[0].array[c])))
+				{
+					/* errors have already been logged */
+					return false;
+				}
+			}
+
+			if (stmt == last)
+			{
+				break;
+			}
+		}
+
+		FFORMAT(out, " ELSE \"%s\" END", columns->columns[c]);
+	}
+
+	FFORMAT(out, "%s", " WHERE (");
+
+	for (int i = 0; i < identity->cols; i++)
+	{
+		FFORMAT(out, "%s\"%s\"", i > 0 ? ", " : "", identity->columns[i]);
+	}
+
+	FFORMAT(out, "%s", ") IN (");
+
+	int rows = 0;
+
+	for (LogicalTransactionStatement *stmt = first;
+		 stmt != NULL;
+		 stmt = stmt->next)
+	{
+		LogicalMessageUpdate *current = &(stmt->stmt.update);
+
+		for (int s = 0; s < current->old.count; s++)
+		{
+			FFORMAT(out, "%s", rows++ > 0 ? ", " : "");
+
+			if (!stream_write_identity(out, &(current->old.array[s])))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+
+		if (stmt == last)
+		{
+			break;
+		}
+	}
+
+	FFORMAT(out, "%s", ");\n");
+
+	return true;
+}
+
+
+/*
+ * stream_write_identity writes the values of the given replica identity tuple
+ * as a row constructor, such as (1, 'foo').
+ */
+static bool
+stream_write_identity(FILE *out, LogicalMessageTuple *tuple)
+{
+	LogicalMessageValues *values = &(tuple->values.array[0]);
+
+	FFORMAT(out, "%s", "(");
+
+	for (int v = 0; v < values->cols; v++)
+	{
+		FFORMAT(out, "%s", v > 0 ? ", " : "");
+
+		if (!stream_write_value(out, &(values->array[v])))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	FFORMAT(out, "%s", ")");
+
+	return true;
+}
+
+
+/*
+ * stream_write_truncate writes an TRUNCATE statement to the already open out
+ * stream.
+ */
+bool
+stream_write_truncate(FILE *out, LogicalMessageTruncate *truncate)
+{
+	fformat(out, "TRUNCATE ONLY %s.%s\n", truncate->nspname, truncate->relname);
+
+	return true;
+}
+
+
+/*
+ * stream_write_value writes the given LogicalMessageValue to the out stream.
+ */
+bool
+stream_write_value(FILE *out, LogicalMessageValue *value)
+{
+	if (value == NULL)
+	{
+		log_error("BUG: stream_write_value value is NULL");
+		return false;
+	}
+
+	if (value->isNull)
+	{
+		fformat(out, "NULL");
+	}
+	else
+	{
+		switch (value->oid)
+		{
+			case BOOLOID:
+			{
+				fformat(out, "'%s' ", value->val.boolean ? "t" : "f");
+				break;
+			}
+
+			case INT8OID:
+			{
+				fformat(out, "%lld", (long long) value->val.int8);
+				break;
+			}
+
+			case FLOAT8OID:
+			{
+				fformat(out, "%g", value->val.float8);
+				break;
+			}
+
+			case TEXTOID:
+			case BYTEAOID:
+			{
+				if (value->isQuoted)
+				{
+					fformat(out, "%s", value->val.str);
+				}
+				else
+				{
+					fformat(out, "'%s'", value->val.str);
+				}
+				break;
 			}
 
 			default:
@@ -1903,3 +3378,493 @@ stream_write_value(FILE *out, LogicalMessageValue *value)
 
 	return true;
 }
+
+
+/*
+ * stream_write_insert_prepared writes an INSERT statement to the already open
+ * out stream, as a PREPARE command for the statement template followed by an
+ * EXECUTE command with the values as parameters.
+ */
+static bool
+stream_write_insert_prepared(FILE *out, LogicalMessageInsert *insert)
+{
+	/* loop over INSERT statements targeting the same table */
+	for (int s = 0; s < insert->new.count; s++)
+	{
+		LogicalMessageTuple *stmt = &(insert->new.array[s]);
+
+		PQExpBuffer sql = createPQExpBuffer();
+		JSON_Value *js = json_value_init_array();
+		JSON_Array *params = json_value_get_array(js);
+
+		int paramCount = 0;
+
+		appendPQExpBuffer(sql, "INSERT INTO \"%s\".\"%s\" (",
+						  insert->nspname,
+						  insert->relname);
+
+		for (int c = 0; c < stmt->cols; c++)
+		{
+			appendPQExpBuffer(sql, "%s\"%s\"",
+							  c > 0 ? ", " : "",
+							  stmt->columns[c]);
+		}
+
+		/* see stream_write_insert about OVERRIDING SYSTEM VALUE */
+		appendPQExpBufferStr(sql, ") overriding system value VALUES ");
+
+		for (int r = 0; r < stmt->values.count; r++)
+		{
+			LogicalMessageValues *values = &(stmt->values.array[r]);
+
+			appendPQExpBuffer(sql, "%s(", r > 0 ? ", " : "");
+
+			for (int v = 0; v < values->cols; v++)
+			{
+				LogicalMessageValue *value = &(values->array[v]);
+
+				appendPQExpBuffer(sql, "%s$%d", v > 0 ? ", " : "", ++paramCount);
+
+				if (!stream_add_value_param(params, value))
+				{
+					/* errors have already been logged */
+					destroyPQExpBuffer(sql);
+					json_value_free(js);
+					return false;
+				}
+			}
+
+			appendPQExpBufferStr(sql, ")");
+		}
+
+		bool success = stream_write_prepared(out, sql, js);
+
+		destroyPQExpBuffer(sql);
+		json_value_free(js);
+
+		if (!success)
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_write_update_prepared writes an UPDATE statement to the already open
+ * out stream, using PREPARE and EXECUTE commands.
+ */
+static bool
+stream_write_update_prepared(FILE *out, LogicalMessageUpdate *update)
+{
+	if (update->old.count != update->new.count)
+	{
+		log_error("Failed to write UPDATE statement "
+				  "with %d old rows and %d new rows",
+				  update->old.count,
+				  update->new.count);
+		return false;
+	}
+
+	/* loop over UPDATE statements targeting the same table */
+	for (int s = 0; s < update->old.count; s++)
+	{
+		LogicalMessageTuple *old = &(update->old.array[s]);
+		LogicalMessageTuple *new = &(update->new.array[s]);
+
+		if (old->values.count != 1 || new->values.count != 1)
+		{
+			log_error("Failed to write multi-values UPDATE statement "
+					  "with %d old rows and %d new rows",
+					  old->values.count,
+					  new->values.count);
+			return false;
+		}
+
+		LogicalMessageValues *values = &(new->values.array[0]);
+
+		if (new->cols < values->cols)
+		{
+			log_error("Failed to write UPDATE statement with more "
+					  "VALUES (%d) than COLUMNS (%d)",
+					  values->cols,
+					  new->cols);
+			return false;
+		}
+
+		PQExpBuffer sql = createPQExpBuffer();
+		JSON_Value *js = json_value_init_array();
+		JSON_Array *params = json_value_get_array(js);
+
+		int paramCount = 0;
+
+		appendPQExpBuffer(sql, "UPDATE \"%s\".\"%s\" SET ",
+						  update->nspname,
+						  update->relname);
+
+		for (int v = 0; v < values->cols; v++)
+		{
+			LogicalMessageValue *value = &(values->array[v]);
+
+			appendPQExpBuffer(sql, "%s\"%s\" = $%d",
+							  v > 0 ? ", " : "",
+							  new->columns[v],
+							  ++paramCount);
+
+			if (!stream_add_value_param(params, value))
+			{
+				/* errors have already been logged */
+				destroyPQExpBuffer(sql);
+				json_value_free(js);
+				return false;
+			}
+		}
+
+		bool success =
+			stream_add_where_params(sql, params, old, &paramCount) &&
+			stream_write_prepared(out, sql, js);
+
+		destroyPQExpBuffer(sql);
+		json_value_free(js);
+
+		if (!success)
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_write_delete_prepared writes a DELETE statement to the already open
+ * out stream, using PREPARE and EXECUTE commands.
+ */
+static bool
+stream_write_delete_prepared(FILE *out, LogicalMessageDelete *delete)
+{
+	/* loop over DELETE statements targeting the same table */
+	for (int s = 0; s < delete->old.count; s++)
+	{
+		LogicalMessageTuple *old = &(delete->old.array[s]);
+
+		PQExpBuffer sql = createPQExpBuffer();
+		JSON_Value *js = json_value_init_array();
+		JSON_Array *params = json_value_get_array(js);
+
+		int paramCount = 0;
+
+		appendPQExpBuffer(sql, "DELETE FROM \"%s\".\"%s\"",
+						  delete->nspname,
+						  delete->relname);
+
+		bool success =
+			stream_add_where_params(sql, params, old, &paramCount) &&
+			stream_write_prepared(out, sql, js);
+
+		destroyPQExpBuffer(sql);
+		json_value_free(js);
+
+		if (!success)
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_add_where_params appends a WHERE clause matching the old tuple
+ * identity to the given statement template, and the matching values to the
+ * params array.
+ */
+static bool
+stream_add_where_params(PQExpBuffer sql,
+						JSON_Array *params,
+						LogicalMessageTuple *old,
+						int *paramCount)
+{
+	appendPQExpBufferStr(sql, " WHERE ");
+
+	for (int r = 0; r < old->values.count; r++)
+	{
+		LogicalMessageValues *values = &(old->values.array[r]);
+
+		for (int v = 0; v < values->cols; v++)
+		{
+			LogicalMessageValue *value = &(values->array[v]);
+
+			if (old->cols <= v)
+			{
+				log_error("Failed to write WHERE clause with more "
+						  "VALUES (%d) than COLUMNS (%d)",
+						  values->cols,
+						  old->cols);
+				return false;
+			}
+
+			appendPQExpBuffer(sql, "%s\"%s\" = $%d",
+							  v > 0 ? " and " : "",
+							  old->columns[v],
+							  ++(*paramCount));
+
+			if (!stream_add_value_param(params, value))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_write_prepared writes a PREPARE command for the given statement
+ * template, followed by an EXECUTE command using the given parameters.
+ *
+ * The name of the prepared statement is a hash of its SQL text, which encodes
+ * the target relation, the action, and the set of columns used. The PREPARE
+ * command is only written the first time the statement is used in the
+ * current SQL file, or when another statement with the same name has been
+ * prepared since.
+ */
+static bool
+stream_write_prepared(FILE *out, PQExpBuffer sql, JSON_Value *params)
+{
+	if (PQExpBufferBroken(sql))
+	{
+		log_error("Failed to build prepared statement: out of memory");
+		return false;
+	}
+
+	char *serialized = json_serialize_to_string(params);
+
+	if (serialized == NULL)
+	{
+		log_error("Failed to serialize prepared statement parameters");
+		return false;
+	}
+
+	char name[NAMEDATALEN] = { 0 };
+	sformat(name, sizeof(name), "%08x", stream_statement_hash(sql->data));
+
+	PreparedStmt *stmt = NULL;
+	HASH_FIND_STR(transformPreparedStmt, name, stmt);
+
+	bool success = true;
+
+	if (stmt == NULL || !streq(stmt->sql, sql->data))
+	{
+		char *query = strdup(sql->data);
+
+		if (query == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			json_free_serialized_string(serialized);
+			return false;
+		}
+
+		if (stmt == NULL)
+		{
+			stmt = (PreparedStmt *) calloc(1, sizeof(PreparedStmt));
+
+			if (stmt == NULL)
+			{
+				log_error(ALLOCATION_FAILED_ERROR);
+				free(query);
+				json_free_serialized_string(serialized);
+				return false;
+			}
+
+			strlcpy(stmt->name, name, sizeof(stmt->name));
+			HASH_ADD_STR(transformPreparedStmt, name, stmt);
+		}
+
+		free(stmt->sql);
+		stmt->sql = query;
+
+		success =
+			fformat(out, "%s%s AS %s;\n", OUTPUT_PREPARE, name, sql->data) != -1;
+	}
+
+	success = success &&
+			  fformat(out, "%s%s%s;\n", OUTPUT_EXECUTE, name, serialized) != -1;
+
+	json_free_serialized_string(serialized);
+
+	return success;
+}
+
+
+/*
+ * stream_statement_hash computes the 32-bit FNV-1a hash of the given string.
+ */
+static uint32_t
+stream_statement_hash(const char *sql)
+{
+	uint32_t hash = 2166136261U;
+
+	for (const unsigned char *p = (const unsigned char *) sql; *p != '\0'; p++)
+	{
+		hash ^= *p;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+
+/*
+ * stream_add_value_param appends the given LogicalMessageValue to a JSON array
+ * of prepared statement parameters, in the text format expected by Postgres.
+ */
+bool
+stream_add_value_param(JSON_Array *params, LogicalMessageValue *value)
+{
+	if (value == NULL)
+	{
+		log_error("BUG: stream_add_value_param value is NULL");
+		return false;
+	}
+
+	if (value->isNull)
+	{
+		json_array_append_null(params);
+		return true;
+	}
+
+	switch (value->oid)
+	{
+		case BOOLOID:
+		{
+			json_array_append_string(params, value->val.boolean ? "t" : "f");
+			break;
+		}
+
+		case INT8OID:
+		{
+			char str[BUFSIZE] = { 0 };
+
+			sformat(str, sizeof(str), "%lld", (long long) value->val.int8);
+			json_array_append_string(params, str);
+			break;
+		}
+
+		case FLOAT8OID:
+		{
+			char str[BUFSIZE] = { 0 };
+			double x = value->val.float8;
+
+			/*
+			 * wal2json sends integer columns as JSON numbers, which we parse
+			 * as doubles: print integral values without an exponent, as the
+			 * integer input functions don't accept one.
+			 */
+			if (x > -1e18 && x < 1e18 && x == (double) (int64_t) x)
+			{
+				sformat(str, sizeof(str), "%lld", (long long) (int64_t) x);
+			}
+			else
+			{
+				/* use the shortest representation that reads back the same */
+				sformat(str, sizeof(str), "%.15g", x);
+
+				if (strtod(str, NULL) != x)
+				{
+					sformat(str, sizeof(str), "%.17g", x);
+				}
+			}
+
+			json_array_append_string(params, str);
+			break;
+		}
+
+		case TEXTOID:
+		case BYTEAOID:
+		{
+			if (value->isQuoted)
+			{
+				char *str = stream_unquote_literal(value->val.str);
+
+				if (str == NULL)
+				{
+					log_error(ALLOCATION_FAILED_ERROR);
+					return false;
+				}
+
+				json_array_append_string(params, str);
+				free(str);
+			}
+			else
+			{
+				json_array_append_string(params, value->val.str);
+			}
+			break;
+		}
+
+		default:
+		{
+			log_error("BUG: stream_add_value_param value with oid %d",
+					  value->oid);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * stream_unquote_literal returns a malloc'ed copy of the given SQL literal as
+ * found in test_decoding output, without the surrounding quotes and with
+ * doubled quotes replaced by a single one. Bit string literals (B'0101') lose
+ * their prefix. Other values (numbers, true, false) are returned as-is.
+ */
+static char *
+stream_unquote_literal(const char *str)
+{
+	const char *p = str;
+
+	if ((p[0] == 'B' || p[0] == 'b') && p[1] == '\'')
+	{
+		++p;
+	}
+
+	size_t len = strlen(p);
+
+	if (len < 2 || p[0] != '\'' || p[len - 1] != '\'')
+	{
+		return strdup(str);
+	}
+
+	char *result = (char *) calloc(len - 1, sizeof(char));
+
+	if (result == NULL)
+	{
+		return NULL;
+	}
+
+	char *r = result;
+
+	for (size_t i = 1; i < len - 1; i++)
+	{
+		*r++ = p[i];
+
+		if (p[i] == '\'' && p[i + 1] == '\'' && i + 1 < len - 1)
+		{
+			++i;
+		}
+	}
+
+	return result;
+}
@@ -965,6 +965,267 @@ pg_restore_list(PostgresPaths *pgPaths, const char *filename,
 }
 
 
+/*
+ * pg_restore_list_stream runs the command pg_restore -l on the given custom
+ * format dump file, with the output sent to the given listFilename, and then
+ * reads that file one line at a time, calling the given callback function for
+ * each archive object. Memory usage does not depend on the archive size.
+ */
+bool
+pg_restore_list_stream(PostgresPaths *pgPaths,
+					   const char *filename,
+					   const char *listFilename,
+					   void *context,
+					   ArchiveContentItemCB *callback)
+{
+	Program prog =
+		run_program(pgPaths->pg_restore, "-f", listFilename, "-l", filename,
+					NULL);
+
+	char command[BUFSIZE] = { 0 };
+	(void) snprintf_program_command_line(&prog, command, BUFSIZE);
+
+	log_notice("%s", command);
+
+	if (prog.returnCode != 0)
+	{
+		log_error("Failed to run pg_restore: exit code %d", prog.returnCode);
+		free_program(&prog);
+
+		return false;
+	}
+
+	free_program(&prog);
+
+	FILE *stream = fopen_read_only(listFilename);
+
+	if (stream == NULL)
+	{
+		log_error("Failed to open file \"%s\": %m", listFilename);
+		return false;
+	}
+
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len = 0;
+	bool success = true;
+
+	while ((len = getline(&line, &size, stream)) != -1)
+	{
+		ArchiveContentItem item = { 0 };
+		bool isItem = false;
+
+		/* remove the trailing newline */
+		if (len > 0 && line[len - 1] == '\n')
+		{
+			line[len - 1] = '\0';
+		}
+
+		if (!parse_archive_list_line(line, &item, &isItem))
+		{
+			/* errors have already been logged */
+			success = false;
+			break;
+		}
+
+		if (isItem && !(*callback)(context, &item))
+		{
+			/* errors have already been logged */
+			success = false;
+			break;
+		}
+	}
+
+	if (success && ferror(stream))
+	{
+		log_error("Failed to read file \"%s\": %m", listFilename);
+		success = false;
+	}
+
+	free(line);
+	fclose(stream);
+
+	return success;
+}
+
+
+/*
+ * pg_restore_list_dependencies runs the command pg_restore --verbose -l on the
+ * given custom format dump file, with the output sent to the given
+ * listFilename, and then reads that file one line at a time. In verbose mode
+ * pg_restore follows each archive object with a comment line that lists the
+ * dumpId of its dependencies:
+ *
+ *   ;	depends on: 5 42
+ *
+ * The given callback function is called once per archive object, with the
+ * array of its dependencies.
+ */
+bool
+pg_restore_list_dependencies(PostgresPaths *pgPaths,
+							 const char *filename,
+							 const char *listFilename,
+							 void *context,
+							 ArchiveDependencyCB *callback)
+{
+	Program prog =
+		run_program(pgPaths->pg_restore,
+					"--verbose", "-f", listFilename, "-l", filename,
+					NULL);
+
+	char command[BUFSIZE] = { 0 };
+	(void) snprintf_program_command_line(&prog, command, BUFSIZE);
+
+	log_notice("%s", command);
+
+	if (prog.returnCode != 0)
+	{
+		log_error("Failed to run pg_restore: exit code %d", prog.returnCode);
+		free_program(&prog);
+
+		return false;
+	}
+
+	free_program(&prog);
+
+	FILE *stream = fopen_read_only(listFilename);
+
+	if (stream == NULL)
+	{
+		log_error("Failed to open file \"%s\": %m", listFilename);
+		return false;
+	}
+
+	const char *dependsOn = ";\tdepends on:";
+	int dependsOnLen = strlen(dependsOn);
+
+	ArchiveContentItem item = { 0 };
+	bool hasItem = false;
+
+	int depCount = 0;
+	int depSize = 0;
+	int *dependencies = NULL;
+
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len = 0;
+	bool success = true;
+
+	while ((len = getline(&line, &size, stream)) != -1)
+	{
+		/* remove the trailing newline */
+		if (len > 0 && line[len - 1] == '\n')
+		{
+			line[len - 1] = '\0';
+		}
+
+		if (strncmp(line, dependsOn, dependsOnLen) == 0)
+		{
+			char *ptr = line + dependsOnLen;
+
+			while (*ptr != '\0')
+			{
+				char *endptr = NULL;
+
+				if (*ptr == ' ')
+				{
+					++ptr;
+					continue;
+				}
+
+				if (depCount == depSize)
+				{
+					depSize = depSize == 0 ? 16 : 2 * depSize;
+
+					int *newDependencies =
+						(int *) realloc(dependencies, depSize * sizeof(int));
+
+					if (newDependencies == NULL)
+					{
+						log_error(ALLOCATION_FAILED_ERROR);
+						free(dependencies);
+						dependencies = NULL;
+						success = false;
+						break;
+					}
+
+					dependencies = newDependencies;
+				}
+
+				long dumpId = strtol(ptr, &endptr, 10);
+
+				if (endptr == ptr || dumpId <= 0 || dumpId > INT_MAX)
+				{
+					log_error("Failed to parse dependencies \"%s\" "
+							  "from pg_restore --list",
+							  line + dependsOnLen);
+					success = false;
+					break;
+				}
+
+				dependencies[depCount] = (int) dumpId;
+				ptr = endptr;
+
+				++depCount;
+			}
+
+			if (!success)
+			{
+				break;
+			}
+
+			continue;
+		}
+
+		ArchiveContentItem next = { 0 };
+		bool isItem = false;
+
+		if (!parse_archive_list_line(line, &next, &isItem))
+		{
+			/* errors have already been logged */
+			success = false;
+			break;
+		}
+
+		if (!isItem)
+		{
+			continue;
+		}
+
+		/* we now have all the dependencies of the previous item */
+		if (hasItem && !(*callback)(context, &item, depCount, dependencies))
+		{
+			/* errors have already been logged */
+			success = false;
+			break;
+		}
+
+		item = next;
+		hasItem = true;
+		depCount = 0;
+	}
+
+	if (success && ferror(stream))
+	{
+		log_error("Failed to read file \"%s\": %m", listFilename);
+		success = false;
+	}
+
+	if (success && hasItem &&
+		!(*callback)(context, &item, depCount, dependencies))
+	{
+		/* errors have already been logged */
+		success = false;
+	}
+
+	free(dependencies);
+	free(line);
+	fclose(stream);
+
+	return success;
+}
+
+
 /*
  * parse_archive_list parses a archive content list as obtained with the
  * pg_restore --list option.
@@ -1078,110 +1339,136 @@ parse_archive_list(char *list, ArchiveContentArray *contents)
 	for (int lineNumber = 0; lineNumber < lineCount; lineNumber++)
 	{
 		ArchiveContentItem *item = &(contents->array[contents->count]);
+		bool isItem = false;
 
-		char *ptr = lines[lineNumber];
-		char *sep = strchr(ptr, ';');
-
-		/* skip lines that start with a separator */
-		if (sep == NULL || sep == ptr)
+		if (!parse_archive_list_line(lines[lineNumber], item, &isItem))
 		{
-			continue;
+			/* errors have already been logged */
+			return false;
 		}
 
-		/* parse the archive dumpId before the separator */
-		*sep = '\0';
-
-		if (!stringToInt(ptr, &(item->dumpId)))
+		if (isItem)
 		{
-			log_error("Failed to parse dumpId \"%s\" from pg_restore --list",
-					  ptr);
-			return false;
+			++contents->count;
 		}
+	}
 
-		/* skip "; " */
-		ptr = sep + 2;
-		sep = strchr(ptr, ' ');
+	return true;
+}
 
-		if (sep == NULL)
-		{
-			log_error("Failed to parse pg_restore --list output");
-			return false;
-		}
 
-		*sep = '\0';
+/*
+ * parse_archive_list_line parses a single line of the pg_restore --list
+ * output. Lines that start with a separator, such as the preamble lines, are
+ * skipped and isItem is then set to false.
+ */
+bool
+parse_archive_list_line(char *line, ArchiveContentItem *item, bool *isItem)
+{
+	char *ptr = line;
+	char *sep = strchr(ptr, ';');
 
-		if (!stringToUInt32(ptr, &(item->catalogOid)))
-		{
-			log_error("Failed to parse catalog OID \"%s\" from pg_restore --list",
-					  ptr);
-			return false;
-		}
+	*isItem = false;
 
-		/* skip " " */
-		ptr = sep + 1;
-		sep = strchr(ptr, ' ');
+	/* skip lines that start with a separator */
+	if (sep == NULL || sep == ptr)
+	{
+		return true;
+	}
 
-		if (sep == NULL)
-		{
-			log_error("Failed to parse pg_restore --list output");
-			return false;
-		}
+	/* parse the archive dumpId before the separator */
+	*sep = '\0';
 
-		*sep = '\0';
+	if (!stringToInt(ptr, &(item->dumpId)))
+	{
+		log_error("Failed to parse dumpId \"%s\" from pg_restore --list",
+				  ptr);
+		return false;
+	}
 
-		if (!stringToUInt32(ptr, &(item->objectOid)))
-		{
-			log_error("Failed to parse OID \"%s\" from pg_restore --list",
-					  ptr);
-			return false;
-		}
+	/* skip "; " */
+	ptr = sep + 2;
+	sep = strchr(ptr, ' ');
 
-		/* skip " " */
-		ptr = sep + 1;
+	if (sep == NULL)
+	{
+		log_error("Failed to parse pg_restore --list output");
+		return false;
+	}
 
-		for (int i = 0; pgRestoreDescriptionArray[i].len != 0; i++)
+	*sep = '\0';
+
+	if (!stringToUInt32(ptr, &(item->catalogOid)))
+	{
+		log_error("Failed to parse catalog OID \"%s\" from pg_restore --list",
+				  ptr);
+		return false;
+	}
+
+	/* skip " " */
+	ptr = sep + 1;
+	sep = strchr(ptr, ' ');
+
+	if (sep == NULL)
+	{
+		log_error("Failed to parse pg_restore --list output");
+		return false;
+	}
+
+	*sep = '\0';
+
+	if (!stringToUInt32(ptr, &(item->objectOid)))
+	{
+		log_error("Failed to parse OID \"%s\" from pg_restore --list",
+				  ptr);
+		return false;
+	}
+
+	/* skip " " */
+	ptr = sep + 1;
+
+	for (int i = 0; pgRestoreDescriptionArray[i].len != 0; i++)
+	{
+		if (strncmp(ptr,
+					pgRestoreDescriptionArray[i].str,
+					pgRestoreDescriptionArray[i].len) == 0)
 		{
-			if (strncmp(ptr,
-						pgRestoreDescriptionArray[i].str,
-						pgRestoreDescriptionArray[i].len) == 0)
+			/*
+			 * Some pg_restore archive catalog TOC entries have a quite a
+			 * special restoreListName, that needs some tweaking to be able
+			 * to match it to the normal one we have in our hash tables.
+			 *
+			 */
+			if (strcmp(pgRestoreDescriptionArray[i].str, "ACL") == 0 ||
+				strcmp(pgRestoreDescriptionArray[i].str, "COMMENT") == 0)
 			{
-				/*
-				 * Some pg_restore archive catalog TOC entries have a quite a
-				 * special restoreListName, that needs some tweaking to be able
-				 * to match it to the normal one we have in our hash tables.
-				 *
-				 */
-				if (strcmp(pgRestoreDescriptionArray[i].str, "ACL") == 0 ||
-					strcmp(pgRestoreDescriptionArray[i].str, "COMMENT") == 0)
-				{
-					/* ignore errors */
-					if (!parse_archive_acl_or_comment(ptr, item))
-					{
-						log_debug("Failed to parse ACL or COMMENT: %s", ptr);
-					}
-				}
-				else
+				/* ignore errors */
+				if (!parse_archive_acl_or_comment(ptr, item))
 				{
-					strlcpy(item->desc,
-							pgRestoreDescriptionArray[i].str,
-							sizeof(item->desc));
-
-					strlcpy(item->restoreListName,
-							ptr + pgRestoreDescriptionArray[i].len + 1,
-							sizeof(item->restoreListName));
+					log_debug("Failed to parse ACL or COMMENT: %s", ptr);
 				}
-				break;
 			}
-		}
+			else
+			{
+				strlcpy(item->desc,
+						pgRestoreDescriptionArray[i].str,
+						sizeof(item->desc));
 
-		if (IS_EMPTY_STRING_BUFFER(item->desc))
-		{
-			log_warn("Failed to parse desc \"%s\"", ptr);
+				strlcpy(item->restoreListName,
+						ptr + pgRestoreDescriptionArray[i].len + 1,
+						sizeof(item->restoreListName));
+			}
+			break;
 		}
+	}
 
-		++contents->count;
+	if (IS_EMPTY_STRING_BUFFER(item->desc))
+	{
+		log_warn("Failed to parse desc \"%s\"", ptr);
 	}
 
+	*isItem = true;
+
 	return true;
 }
 
@@ -70,6 +70,16 @@ typedef struct ArchiveContentArray
 } ArchiveContentArray;
 
 
+/* callback used when streaming the archive contents */
+typedef bool (ArchiveContentItemCB)(void *context, ArchiveContentItem *item);
+
+/* callback used when streaming the archive contents with dependencies */
+typedef bool (ArchiveDependencyCB)(void *context,
+								   ArchiveContentItem *item,
+								   int depCount,
+								   int *dependencies);
+
+
 typedef struct RestoreOptions
 {
 	bool dropIfExists;
@@ -118,7 +128,20 @@ bool pg_restore_db(PostgresPaths *pgPaths,
 bool pg_restore_list(PostgresPaths *pgPaths, const char *filename,
 					 ArchiveContentArray *archive);
 
+bool pg_restore_list_stream(PostgresPaths *pgPaths,
+							const char *filename,
+							const char *listFilename,
+							void *context,
+							ArchiveContentItemCB *callback);
+
+bool pg_restore_list_dependencies(PostgresPaths *pgPaths,
+								  const char *filename,
+								  const char *listFilename,
+								  void *context,
+								  ArchiveDependencyCB *callback);
+
 bool parse_archive_list(char *list, ArchiveContentArray *archive);
+bool parse_archive_list_line(char *line, ArchiveContentItem *item, bool *isItem);
 
 bool parse_archive_acl_or_comment(char *ptr, ArchiveContentItem *item);
 
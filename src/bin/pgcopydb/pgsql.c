@@ -43,6 +43,12 @@ static bool pgsql_fetch_results(PGSQL *pgsql, bool *done,
 								void *context, ParsePostgresResultCB *parseFun);
 
 static bool is_response_ok(PGresult *result);
+static bool pgsql_execute_handle_result(PGSQL *pgsql, PGresult *result,
+										const char *sql,
+										PQExpBuffer debugParameters,
+										void *context,
+										ParsePostgresResultCB *parseFun);
+static bool pgsql_pipeline_sent(PGSQL *pgsql, int ret, const char *sql);
 static bool clear_results(PGSQL *pgsql);
 static void pgsql_handle_notifications(PGSQL *pgsql);
 
@@ -437,6 +443,12 @@ pgsql_finish(PGSQL *pgsql)
 		PQfinish(pgsql->connection);
 		pgsql->connection = NULL;
 
+		/* results still in the pipeline are lost with the connection */
+		pgsql->pipelineMode = false;
+		pgsql->pipelineFlushed = false;
+		pgsql->pipelineQueries = 0;
+		pgsql->pipelineSyncs = 0;
+
 		/* cache invalidation for pgversion */
 		pgsql->pgversion[0] = '\0';
 		pgsql->pgversion_num = 0;
@@ -1278,6 +1290,44 @@ pgsql_has_database_privilege(PGSQL *pgsql, const char *privilege, bool *granted)
 }
 
 
+/*
+ * pgsql_has_table_privilege calls has_table_privilege() and copies the result
+ * in the granted boolean pointer given.
+ */
+bool
+pgsql_has_table_privilege(PGSQL *pgsql,
+						  const char *tablename,
+						  const char *privilege,
+						  bool *granted)
+{
+	SingleValueResultContext parseContext = { { 0 }, PGSQL_RESULT_BOOL, false };
+
+	char *sql = "select has_table_privilege($1, $2);";
+
+	int paramCount = 2;
+	Oid paramTypes[2] = { TEXTOID, TEXTOID };
+	const char *paramValues[2] = { tablename, privilege };
+
+	if (!pgsql_execute_with_params(pgsql, sql,
+								   paramCount, paramTypes, paramValues,
+								   &parseContext, &parseSingleValueResult))
+	{
+		log_error("Failed to query privileges for table \"%s\"", tablename);
+		return false;
+	}
+
+	if (!parseContext.parsedOk)
+	{
+		log_error("Failed to query privileges for table \"%s\"", tablename);
+		return false;
+	}
+
+	*granted = parseContext.boolVal;
+
+	return true;
+}
+
+
 /*
  * pgsql_has_sequence_privilege calls has_sequence_privilege() and copies the
  * result in the granted boolean pointer given.
@@ -1505,24 +1555,457 @@ pgsql_execute_with_params(PGSQL *pgsql, const char *sql, int paramCount,
 			return false;
 		}
 
-		log_sql("[%s] %s;", endpoint, sql);
+		log_sql("[%s] %s;", endpoint, sql);
+
+		if (paramCount > 0)
+		{
+			log_sql("%s", debugParameters->data);
+		}
+	}
+
+	if (pgsql->pipelineMode)
+	{
+		if (debugParameters != NULL)
+		{
+			destroyPQExpBuffer(debugParameters);
+		}
+
+		if (parseFun != NULL)
+		{
+			log_error("BUG: pgsql_execute_with_params called with a result "
+					  "parsing function in pipeline mode: %s",
+					  sql);
+			return false;
+		}
+
+		int ret = PQsendQueryParams(connection, sql,
+									paramCount, paramTypes, paramValues,
+									NULL, NULL, 0);
+
+		return pgsql_pipeline_sent(pgsql, ret, sql);
+	}
+
+	if (paramCount == 0)
+	{
+		result = PQexec(connection, sql);
+	}
+	else
+	{
+		result = PQexecParams(connection, sql,
+							  paramCount, paramTypes, paramValues,
+							  NULL, NULL, 0);
+	}
+
+	return pgsql_execute_handle_result(pgsql, result, sql, debugParameters,
+									   context, parseFun);
+}
+
+
+/*
+ * pgsql_prepare creates a server-side prepared statement with the given name
+ * on the current connection, which must be a PGSQL_CONNECTION_MULTI_STATEMENT
+ * connection for the prepared statement to be of any use.
+ */
+bool
+pgsql_prepare(PGSQL *pgsql, const char *name, const char *sql,
+			  int paramCount, const Oid *paramTypes)
+{
+	PGconn *connection = pgsql_open_connection(pgsql);
+
+	if (connection == NULL)
+	{
+		return false;
+	}
+
+	char *endpoint =
+		pgsql->connectionType == PGSQL_CONN_SOURCE ? "SOURCE" : "TARGET";
+
+	if (pgsql->logSQL)
+	{
+		log_sql("[%s] PREPARE %s AS %s;", endpoint, name, sql);
+	}
+
+	if (pgsql->pipelineMode)
+	{
+		int ret = PQsendPrepare(connection, name, sql, paramCount, paramTypes);
+
+		return pgsql_pipeline_sent(pgsql, ret, sql);
+	}
+
+	PGresult *result =
+		PQprepare(connection, name, sql, paramCount, paramTypes);
+
+	return pgsql_execute_handle_result(pgsql, result, sql, NULL, NULL, NULL);
+}
+
+
+/*
+ * pgsql_execute_prepared executes a statement that has been prepared
+ * previously on the current connection with pgsql_prepare.
+ */
+bool
+pgsql_execute_prepared(PGSQL *pgsql, const char *name,
+					   int paramCount, const char **paramValues,
+					   void *context, ParsePostgresResultCB *parseFun)
+{
+	PQExpBuffer debugParameters = NULL;
+
+	PGconn *connection = pgsql_open_connection(pgsql);
+
+	if (connection == NULL)
+	{
+		return false;
+	}
+
+	char *endpoint =
+		pgsql->connectionType == PGSQL_CONN_SOURCE ? "SOURCE" : "TARGET";
+
+	if (pgsql->logSQL)
+	{
+		debugParameters = createPQExpBuffer();
+
+		if (!build_parameters_list(debugParameters, paramCount, paramValues))
+		{
+			/* errors have already been logged */
+			destroyPQExpBuffer(debugParameters);
+			return false;
+		}
+
+		log_sql("[%s] EXECUTE %s;", endpoint, name);
+
+		if (paramCount > 0)
+		{
+			log_sql("%s", debugParameters->data);
+		}
+	}
+
+	if (pgsql->pipelineMode)
+	{
+		if (debugParameters != NULL)
+		{
+			destroyPQExpBuffer(debugParameters);
+		}
+
+		if (parseFun != NULL)
+		{
+			log_error("BUG: pgsql_execute_prepared called with a result "
+					  "parsing function in pipeline mode: %s",
+					  name);
+			return false;
+		}
+
+		int ret = PQsendQueryPrepared(connection, name,
+									  paramCount, paramValues,
+									  NULL, NULL, 0);
+
+		return pgsql_pipeline_sent(pgsql, ret, name);
+	}
+
+	PGresult *result =
+		PQexecPrepared(connection, name,
+					   paramCount, paramValues,
+					   NULL, NULL, 0);
+
+	return pgsql_execute_handle_result(pgsql, result, name, debugParameters,
+									   context, parseFun);
+}
+
+
+/*
+ * pgsql_pipeline_enter switches the connection to libpq pipeline mode. In
+ * that mode pgsql_execute_with_params, pgsql_prepare, and
+ * pgsql_execute_prepared only send their query to the server, and the results
+ * are read later with pgsql_pipeline_consume, in order.
+ *
+ * See https://www.postgresql.org/docs/current/libpq-pipeline-mode.html
+ */
+bool
+pgsql_pipeline_enter(PGSQL *pgsql)
+{
+#ifdef LIBPQ_HAS_PIPELINING
+	PGconn *connection = pgsql_open_connection(pgsql);
+
+	if (connection == NULL)
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* the pipeline spans several statements and transactions */
+	pgsql->connectionStatementType = PGSQL_CONNECTION_MULTI_STATEMENT;
+
+	if (PQenterPipelineMode(connection) != 1)
+	{
+		log_error("Failed to enter pipeline mode: %s",
+				  PQerrorMessage(connection));
+		return false;
+	}
+
+	pgsql->pipelineMode = true;
+	pgsql->pipelineFlushed = true;
+	pgsql->pipelineQueries = 0;
+	pgsql->pipelineSyncs = 0;
+
+	return true;
+#else
+	log_error("Failed to enter pipeline mode: pgcopydb has been built "
+			  "with a libpq version that does not support pipelining, "
+			  "Postgres 14 or later is required");
+	return false;
+#endif
+}
+
+
+/*
+ * pgsql_pipeline_exit switches the connection back to normal mode, which is
+ * only possible once all the results have been consumed.
+ */
+bool
+pgsql_pipeline_exit(PGSQL *pgsql)
+{
+#ifdef LIBPQ_HAS_PIPELINING
+	if (PQexitPipelineMode(pgsql->connection) != 1)
+	{
+		log_error("Failed to exit pipeline mode: %s",
+				  PQerrorMessage(pgsql->connection));
+		return false;
+	}
+
+	pgsql->pipelineMode = false;
+	pgsql->pipelineFlushed = true;
+	pgsql->pipelineQueries = 0;
+	pgsql->pipelineSyncs = 0;
+
+	return true;
+#else
+	log_error("BUG: pgsql_pipeline_exit requires libpq pipelining support");
+	return false;
+#endif
+}
+
+
+/*
+ * pgsql_pipeline_sent registers a query that has been sent to the server in
+ * pipeline mode, where ret is the return value of the libpq PQsend* function.
+ */
+static bool
+pgsql_pipeline_sent(PGSQL *pgsql, int ret, const char *sql)
+{
+	if (ret != 1)
+	{
+		log_error("Failed to send query in pipeline mode: %s",
+				  PQerrorMessage(pgsql->connection));
+		log_error("SQL query: %s", sql);
+		return false;
+	}
+
+	++(pgsql->pipelineQueries);
+	pgsql->pipelineFlushed = false;
+
+	return true;
+}
+
+
+/*
+ * pgsql_pipeline_sync sends a synchronisation point to the server, which also
+ * flushes the queries sent so far.
+ */
+bool
+pgsql_pipeline_sync(PGSQL *pgsql)
+{
+#ifdef LIBPQ_HAS_PIPELINING
+	if (!pgsql->pipelineMode)
+	{
+		log_error("BUG: pgsql_pipeline_sync called outside of pipeline mode");
+		return false;
+	}
+
+	if (PQpipelineSync(pgsql->connection) != 1)
+	{
+		log_error("Failed to send pipeline sync: %s",
+				  PQerrorMessage(pgsql->connection));
+		return false;
+	}
+
+	++(pgsql->pipelineQueries);
+	++(pgsql->pipelineSyncs);
+	pgsql->pipelineFlushed = true;
+
+	return true;
+#else
+	log_error("BUG: pgsql_pipeline_sync requires libpq pipelining support");
+	return false;
+#endif
+}
+
+
+/*
+ * pgsql_pipeline_flush asks the server to send the results of the queries
+ * sent so far, unless a sync point or a flush request has been sent since.
+ */
+bool
+pgsql_pipeline_flush(PGSQL *pgsql)
+{
+#ifdef LIBPQ_HAS_PIPELINING
+	PGconn *connection = pgsql->connection;
+
+	if (pgsql->pipelineFlushed)
+	{
+		return true;
+	}
+
+	if (PQsendFlushRequest(connection) != 1 || PQflush(connection) != 0)
+	{
+		log_error("Failed to flush the pipeline: %s",
+				  PQerrorMessage(connection));
+		return false;
+	}
+
+	pgsql->pipelineFlushed = true;
+
+	return true;
+#else
+	log_error("BUG: pgsql_pipeline_flush requires libpq pipelining support");
+	return false;
+#endif
+}
+
+
+/*
+ * pgsql_pipeline_ready returns true when the results of the oldest query or
+ * sync point still in the pipeline can be consumed without waiting.
+ */
+bool
+pgsql_pipeline_ready(PGSQL *pgsql)
+{
+	PGconn *connection = pgsql->connection;
+
+	/* a flush request must be sent first, consuming is going to do that */
+	if (!pgsql->pipelineFlushed)
+	{
+		return false;
+	}
+
+	/* let pgsql_pipeline_consume report connection errors */
+	if (PQconsumeInput(connection) == 0)
+	{
+		return true;
+	}
+
+	return PQisBusy(connection) == 0;
+}
+
+
+/*
+ * pgsql_pipeline_consume reads the results of the oldest query or sync point
+ * still in the pipeline, waiting for the server when needed. The isSync
+ * parameter is set to true when a sync point has been consumed, and success is
+ * set to false when the query failed or has been skipped by the server because
+ * of a previous failure in the same pipeline segment.
+ */
+bool
+pgsql_pipeline_consume(PGSQL *pgsql, bool *isSync, bool *success)
+{
+#ifdef LIBPQ_HAS_PIPELINING
+	PGconn *connection = pgsql->connection;
+
+	*isSync = false;
+	*success = true;
+
+	if (!pgsql->pipelineMode || pgsql->pipelineQueries == 0)
+	{
+		log_error("BUG: pgsql_pipeline_consume called without pending queries");
+		return false;
+	}
+
+	/* results are only sent by the server at a sync point or when asked to */
+	if (!pgsql_pipeline_flush(pgsql))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	char *endpoint =
+		pgsql->connectionType == PGSQL_CONN_SOURCE ? "SOURCE" : "TARGET";
+
+	/*
+	 * A sync point has a single result, a query has its results followed by
+	 * a NULL result.
+	 */
+	for (;;)
+	{
+		PGresult *result = PQgetResult(connection);
+
+		(void) pgsql_handle_notifications(pgsql);
+
+		if (result == NULL)
+		{
+			break;
+		}
+
+		ExecStatusType status = PQresultStatus(result);
+
+		if (status == PGRES_PIPELINE_SYNC)
+		{
+			*isSync = true;
+			--(pgsql->pipelineSyncs);
+
+			PQclear(result);
+			break;
+		}
+		else if (status == PGRES_PIPELINE_ABORTED)
+		{
+			/* a previous query failed, errors have already been logged */
+			*success = false;
+		}
+		else if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK)
+		{
+			char *sqlstate = PQresultErrorField(result, PG_DIAG_SQLSTATE);
+			char *message = PQresultErrorMessage(result);
+			char *errorLines[BUFSIZE] = { 0 };
+			int lineCount = splitLines(message, errorLines, BUFSIZE);
+
+			if (sqlstate != NULL)
+			{
+				strlcpy(pgsql->sqlstate, sqlstate, sizeof(pgsql->sqlstate));
+			}
+
+			for (int lineNumber = 0; lineNumber < lineCount; lineNumber++)
+			{
+				log_error("[%s] %s", endpoint, errorLines[lineNumber]);
+			}
+
+			*success = false;
+		}
+
+		PQclear(result);
+	}
+
+	--(pgsql->pipelineQueries);
+
+	return true;
+#else
+	log_error("BUG: pgsql_pipeline_consume requires libpq pipelining support");
+	return false;
+#endif
+}
+
 
-		if (paramCount > 0)
-		{
-			log_sql("%s", debugParameters->data);
-		}
-	}
+/*
+ * pgsql_execute_handle_result checks the result of a query, logs errors when
+ * the query failed, and calls the parseFun callback on success. It then
+ * releases the result, and the connection unless it's been opened for
+ * multiple statements.
+ */
+static bool
+pgsql_execute_handle_result(PGSQL *pgsql, PGresult *result, const char *sql,
+							PQExpBuffer debugParameters,
+							void *context, ParsePostgresResultCB *parseFun)
+{
+	PGconn *connection = pgsql->connection;
 
-	if (paramCount == 0)
-	{
-		result = PQexec(connection, sql);
-	}
-	else
-	{
-		result = PQexecParams(connection, sql,
-							  paramCount, paramTypes, paramValues,
-							  NULL, NULL, 0);
-	}
+	char *endpoint =
+		pgsql->connectionType == PGSQL_CONN_SOURCE ? "SOURCE" : "TARGET";
 
 	if (!is_response_ok(result))
 	{
@@ -1532,7 +2015,10 @@ pgsql_execute_with_params(PGSQL *pgsql, const char *sql, int paramCount,
 		int lineCount = splitLines(message, errorLines, BUFSIZE);
 		int lineNumber = 0;
 
-		strlcpy(pgsql->sqlstate, sqlstate, sizeof(pgsql->sqlstate));
+		if (sqlstate != NULL)
+		{
+			strlcpy(pgsql->sqlstate, sqlstate, sizeof(pgsql->sqlstate));
+		}
 
 		/*
 		 * PostgreSQL Error message might contain several lines. Log each of
@@ -1546,10 +2032,17 @@ pgsql_execute_with_params(PGSQL *pgsql, const char *sql, int paramCount,
 		if (pgsql->logSQL)
 		{
 			log_error("SQL query: %s", sql);
-			log_error("SQL params: %s", debugParameters->data);
+
+			if (debugParameters != NULL)
+			{
+				log_error("SQL params: %s", debugParameters->data);
+			}
 		}
 
-		destroyPQExpBuffer(debugParameters);
+		if (debugParameters != NULL)
+		{
+			destroyPQExpBuffer(debugParameters);
+		}
 
 		/* now stash away the SQL STATE if any */
 		if (context && sqlstate)
@@ -1586,7 +2079,10 @@ pgsql_execute_with_params(PGSQL *pgsql, const char *sql, int paramCount,
 		(*parseFun)(context, result);
 	}
 
-	destroyPQExpBuffer(debugParameters);
+	if (debugParameters != NULL)
+	{
+		destroyPQExpBuffer(debugParameters);
+	}
 
 	PQclear(result);
 	clear_results(pgsql);
@@ -2354,9 +2850,18 @@ pg_copy(PGSQL *src, PGSQL *dst, const char *srcQname, const char *dstQname,
 bool
 pg_copy_from_stdin(PGSQL *pgsql, const char *qname)
 {
-	char sql[BUFSIZE] = { 0 };
+	/* qname might also contain a list of columns */
+	char *template = "COPY %s FROM stdin";
+	size_t len = strlen(template) + strlen(qname) + 1;
+	char *sql = (char *) calloc(len, sizeof(char));
 
-	sformat(sql, sizeof(sql), "COPY %s FROM stdin", qname);
+	if (sql == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	sformat(sql, len, template, qname);
 
 	char *endpoint =
 		pgsql->connectionType == PGSQL_CONN_SOURCE ? "SOURCE" : "TARGET";
@@ -2368,10 +2873,14 @@ pg_copy_from_stdin(PGSQL *pgsql, const char *qname)
 	if (PQresultStatus(res) != PGRES_COPY_IN)
 	{
 		pgcopy_log_error(pgsql, res, sql);
+		free(sql);
 
 		return false;
 	}
 
+	PQclear(res);
+	free(sql);
+
 	return true;
 }
 
@@ -2469,9 +2978,8 @@ pg_copy_end(PGSQL *pgsql)
 		return false;
 	}
 
-	clear_results(pgsql);
-
-	return true;
+	/* errors in the COPY data are reported here */
+	return clear_results(pgsql);
 }
 
 
@@ -3123,10 +3631,24 @@ pgsql_set_gucs(PGSQL *pgsql, GUC *settings)
 
 #define MAX_BLOB_PER_FETCH 1000
 
+/*
+ * Large objects up to that size are fetched in the same query as their OID,
+ * and then written on the target database in a single query per batch.
+ */
+#define MAX_SMALL_BLOB_SIZE (32 * 1024)
+
+/*
+ * Large objects are stored in pg_largeobject in pages of LOBLKSIZE bytes,
+ * which is 2kB with the default BLCKSZ.
+ */
+#define LARGE_OBJECT_PAGE_SIZE 2048
+
 typedef struct BlobMetadataArray
 {
 	int count;
 	Oid oids[MAX_BLOB_PER_FETCH];
+	char *contents[MAX_BLOB_PER_FETCH]; /* malloc'ed area, small blobs only */
+	int sizes[MAX_BLOB_PER_FETCH];
 } BlobMetadataArray;
 
 typedef struct BlobMetadataArrayContext
@@ -3138,15 +3660,32 @@ typedef struct BlobMetadataArrayContext
 
 void parseBlobMetadataArray(void *ctx, PGresult *result);
 
+static bool pg_copy_small_large_objects(PGSQL *dst,
+										BlobMetadataArray *array,
+										bool dropIfExists);
+static void freeBlobMetadataArray(BlobMetadataArray *array);
+
 
 /*
  * pg_copy_large_objects copies all large objects found on the src database
  * into the dst database. The copy includes re-using the same OID for the large
  * objects on both sides.
+ *
+ * Only the large objects with an OID between minOid and maxOid (inclusive)
+ * are copied, which allows several processes to share the work.
+ *
+ * Small large objects contents are fetched with lo_get() in the same cursor
+ * that lists the OIDs, and written on the target database with one query per
+ * batch, avoiding the lo_open/lo_read/lo_write/lo_close round trips. Large
+ * objects bigger than MAX_SMALL_BLOB_SIZE are streamed in chunks.
+ *
+ * When we can read pg_largeobject, the last page number of each large object
+ * is used to only call lo_get() for the small ones, so that we don't read the
+ * first pages of the other large objects twice.
  */
 bool
-pg_copy_large_objects(PGSQL *src, PGSQL *dst,
-					  bool dropIfExists, uint32_t *count)
+pg_copy_large_objects(PGSQL *src, PGSQL *dst, bool dropIfExists,
+					  uint32_t minOid, uint32_t maxOid, uint32_t *count)
 {
 	/*
 	 * We need to keep the same connection throughout the operations here.
@@ -3164,10 +3703,77 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 		return false;
 	}
 
+	/* lo_get(), lo_put() and lo_from_bytea() appeared in Postgres 9.4 */
+	if (!pgsql_server_version(src) || !pgsql_server_version(dst))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	bool fetchContents =
+		src->pgversion_num >= 90400 && dst->pgversion_num >= 90400;
+
+	bool filterBySize = false;
+
+	if (fetchContents)
+	{
+		if (!pgsql_has_table_privilege(src,
+									   "pg_catalog.pg_largeobject",
+									   "select",
+									   &filterBySize))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
 	BlobMetadataArrayContext context = { 0 };
-	char *sql =
-		"DECLARE bloboid CURSOR FOR "
-		"SELECT oid FROM pg_largeobject_metadata ORDER BY 1";
+	BlobMetadataArray *blobs = &(context.array);
+	char sql[BUFSIZE] = { 0 };
+
+	/*
+	 * Use a BINARY cursor so that the contents are fetched as raw bytes
+	 * rather than hex-encoded. Fetch one more byte than the small size
+	 * threshold to know if we got the whole contents of the large object.
+	 */
+	if (fetchContents && filterBySize)
+	{
+		sformat(sql, sizeof(sql),
+				"DECLARE bloboid BINARY CURSOR FOR "
+				"SELECT m.oid::text, "
+				"       CASE WHEN (SELECT coalesce(max(l.pageno), 0) "
+				"                    FROM pg_catalog.pg_largeobject l "
+				"                   WHERE l.loid = m.oid) < %d "
+				"            THEN pg_catalog.lo_get(m.oid, 0, %d) "
+				"        END "
+				"FROM pg_largeobject_metadata m "
+				"WHERE m.oid >= '%u'::oid AND m.oid <= '%u'::oid ORDER BY 1",
+				MAX_SMALL_BLOB_SIZE / LARGE_OBJECT_PAGE_SIZE,
+				MAX_SMALL_BLOB_SIZE + 1,
+				minOid,
+				maxOid);
+	}
+	else if (fetchContents)
+	{
+		sformat(sql, sizeof(sql),
+				"DECLARE bloboid BINARY CURSOR FOR "
+				"SELECT oid::text, pg_catalog.lo_get(oid, 0, %d) "
+				"FROM pg_largeobject_metadata "
+				"WHERE oid >= '%u'::oid AND oid <= '%u'::oid ORDER BY 1",
+				MAX_SMALL_BLOB_SIZE + 1,
+				minOid,
+				maxOid);
+	}
+	else
+	{
+		sformat(sql, sizeof(sql),
+				"DECLARE bloboid BINARY CURSOR FOR "
+				"SELECT oid::text, NULL::bytea "
+				"FROM pg_largeobject_metadata "
+				"WHERE oid >= '%u'::oid AND oid <= '%u'::oid ORDER BY 1",
+				minOid,
+				maxOid);
+	}
 
 	if (!pgsql_execute(src, sql))
 	{
@@ -3196,6 +3802,13 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 			return false;
 		}
 
+		if (!context.parsedOk)
+		{
+			log_error("Failed to fetch large objects metadata");
+			freeBlobMetadataArray(blobs);
+			return false;
+		}
+
 		if (context.array.count == 0)
 		{
 			break;
@@ -3211,16 +3824,33 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 		if (!pgsql_begin(dst))
 		{
 			/* errors have already been logged */
+			freeBlobMetadataArray(blobs);
 			pgsql_finish(src);
 			return false;
 		}
 
 		totalCount += context.array.count;
 
+		/* first, write all the small large objects in a single query */
+		if (!pg_copy_small_large_objects(dst, &(context.array), dropIfExists))
+		{
+			/* errors have already been logged */
+			freeBlobMetadataArray(blobs);
+			pgsql_finish(src);
+			pgsql_finish(dst);
+			return false;
+		}
+
+		/* then stream the contents of the other large objects */
 		for (int i = 0; i < context.array.count; i++)
 		{
 			Oid blobOid = context.array.oids[i];
 
+			if (context.array.contents[i] != NULL)
+			{
+				continue;
+			}
+
 			log_trace("Processing large object %u", blobOid);
 
 			/*
@@ -3237,6 +3867,7 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 
 				(void) pgcopy_log_error(src, NULL, context);
 
+				freeBlobMetadataArray(blobs);
 				pgsql_finish(src);
 				pgsql_finish(dst);
 
@@ -3274,6 +3905,7 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 
 					lo_close(src->connection, srcfd);
 
+					freeBlobMetadataArray(blobs);
 					pgsql_finish(src);
 					pgsql_finish(dst);
 
@@ -3297,6 +3929,7 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 
 				lo_close(src->connection, srcfd);
 
+				freeBlobMetadataArray(blobs);
 				pgsql_finish(src);
 				pgsql_finish(dst);
 
@@ -3328,6 +3961,7 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 					lo_close(src->connection, srcfd);
 					lo_close(dst->connection, dstfd);
 
+					freeBlobMetadataArray(blobs);
 					pgsql_finish(src);
 					pgsql_finish(dst);
 
@@ -3349,6 +3983,7 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 					lo_close(src->connection, srcfd);
 					lo_close(dst->connection, dstfd);
 
+					freeBlobMetadataArray(blobs);
 					pgsql_finish(src);
 					pgsql_finish(dst);
 
@@ -3366,9 +4001,12 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 		if (!pgsql_commit(dst))
 		{
 			/* errors have already been logged */
+			freeBlobMetadataArray(blobs);
 			pgsql_finish(src);
 			return false;
 		}
+
+		freeBlobMetadataArray(blobs);
 	}
 
 	*count = totalCount;
@@ -3379,16 +4017,17 @@ pg_copy_large_objects(PGSQL *src, PGSQL *dst,
 
 /*
  * parseBlobMetadataArray parses the resultset from a FETCH on the cursor for
- * the large object metadata.
+ * the large object metadata. The cursor is a BINARY cursor, the OID is sent as
+ * text though, and the contents of the large object are raw bytes.
  */
 void
 parseBlobMetadataArray(void *ctx, PGresult *result)
 {
 	BlobMetadataArrayContext *context = (BlobMetadataArrayContext *) ctx;
 
-	if (PQnfields(result) != 1)
+	if (PQnfields(result) != 2)
 	{
-		log_error("Query returned %d columns, expected 1", PQnfields(result));
+		log_error("Query returned %d columns, expected 2", PQnfields(result));
 		context->parsedOk = false;
 		return;
 	}
@@ -3399,6 +4038,9 @@ parseBlobMetadataArray(void *ctx, PGresult *result)
 	{
 		char *value = PQgetvalue(result, i, 0);
 
+		context->array.contents[i] = NULL;
+		context->array.sizes[i] = -1;
+
 		if (!stringToUInt32(value, &(context->array.oids[i])))
 		{
 			log_error("Invalid OID \"%s\"", value);
@@ -3406,7 +4048,228 @@ parseBlobMetadataArray(void *ctx, PGresult *result)
 			context->parsedOk = false;
 			return;
 		}
+
+		/* only keep the contents of small large objects */
+		if (PQgetisnull(result, i, 1) ||
+			PQgetlength(result, i, 1) > MAX_SMALL_BLOB_SIZE)
+		{
+			continue;
+		}
+
+		int size = PQgetlength(result, i, 1);
+
+		/* allocate at least one byte for empty large objects */
+		context->array.sizes[i] = size;
+		context->array.contents[i] = (char *) malloc(size + 1);
+
+		if (context->array.contents[i] == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			context->parsedOk = false;
+			return;
+		}
+
+		memcpy(context->array.contents[i], PQgetvalue(result, i, 1), size);
+	}
+
+	context->parsedOk = true;
+}
+
+
+/*
+ * freeBlobMetadataArray frees the memory allocated for the contents of the
+ * small large objects of the current batch.
+ */
+static void
+freeBlobMetadataArray(BlobMetadataArray *array)
+{
+	for (int i = 0; i < array->count; i++)
+	{
+		free(array->contents[i]);
+		array->contents[i] = NULL;
+	}
+}
+
+
+/*
+ * pg_copy_small_large_objects writes the contents of all the small large
+ * objects of the current batch on the target database, using a single query
+ * where the contents are sent as binary parameters.
+ *
+ * In normal cases `pg_dump --section=pre-data` outputs the large object
+ * metadata and we use lo_put() to write the contents. When using
+ * --drop-if-exists, we first unlink the target large objects, then create
+ * them again with lo_from_bytea().
+ */
+static bool
+pg_copy_small_large_objects(PGSQL *dst, BlobMetadataArray *array,
+							bool dropIfExists)
+{
+	int smallCount = 0;
+
+	for (int i = 0; i < array->count; i++)
+	{
+		if (array->contents[i] != NULL)
+		{
+			++smallCount;
+		}
+	}
+
+	if (smallCount == 0)
+	{
+		return true;
+	}
+
+	int paramCount = 2 * smallCount;
+
+	const char **paramValues =
+		(const char **) calloc(paramCount, sizeof(char *));
+	int *paramLengths = (int *) calloc(paramCount, sizeof(int));
+	int *paramFormats = (int *) calloc(paramCount, sizeof(int));
+
+	PQExpBuffer oids = createPQExpBuffer();
+	PQExpBuffer sql = createPQExpBuffer();
+
+	if (paramValues == NULL || paramLengths == NULL || paramFormats == NULL ||
+		oids == NULL || sql == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+
+		free(paramValues);
+		free(paramLengths);
+		free(paramFormats);
+		destroyPQExpBuffer(oids);
+		destroyPQExpBuffer(sql);
+
+		return false;
+	}
+
+	/* OIDs are sent as text, contents as binary */
+	char *oidStrings = (char *) calloc(smallCount, INTSTRING_MAX_DIGITS);
+
+	if (oidStrings == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+
+		free(paramValues);
+		free(paramLengths);
+		free(paramFormats);
+		destroyPQExpBuffer(oids);
+		destroyPQExpBuffer(sql);
+
+		return false;
+	}
+
+	appendPQExpBuffer(sql,
+					  "SELECT pg_catalog.%s FROM (VALUES ",
+					  dropIfExists ? "lo_from_bytea(o, d)" : "lo_put(o, 0, d)");
+
+	int p = 0;
+
+	for (int i = 0; i < array->count; i++)
+	{
+		if (array->contents[i] == NULL)
+		{
+			continue;
+		}
+
+		char *oidString = oidStrings + (p / 2) * INTSTRING_MAX_DIGITS;
+
+		sformat(oidString, INTSTRING_MAX_DIGITS, "%u", array->oids[i]);
+
+		appendPQExpBuffer(oids, "%s%s", p == 0 ? "" : ",", oidString);
+
+		appendPQExpBuffer(sql, "%s($%d::oid, $%d::bytea)",
+						  p == 0 ? "" : ", ",
+						  p + 1,
+						  p + 2);
+
+		paramValues[p] = oidString;
+		paramFormats[p] = 0;
+
+		paramValues[p + 1] = array->contents[i];
+		paramLengths[p + 1] = array->sizes[i];
+		paramFormats[p + 1] = 1;
+
+		p += 2;
+	}
+
+	appendPQExpBufferStr(sql, ") AS blobs(o, d)");
+
+	bool success = !PQExpBufferBroken(sql) && !PQExpBufferBroken(oids);
+
+	if (!success)
+	{
+		log_error("Failed to prepare large objects query: out of memory");
+	}
+
+	if (success && dropIfExists)
+	{
+		char *unlinkSQL =
+			"SELECT pg_catalog.lo_unlink(oid) "
+			"FROM pg_catalog.pg_largeobject_metadata "
+			"WHERE oid = ANY($1::oid[])";
+
+		PQExpBuffer unlinkArray = createPQExpBuffer();
+
+		if (unlinkArray == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			success = false;
+		}
+		else
+		{
+			appendPQExpBuffer(unlinkArray, "{%s}", oids->data);
+
+			if (PQExpBufferBroken(unlinkArray))
+			{
+				log_error("Failed to prepare large objects query: out of memory");
+				success = false;
+			}
+		}
+
+		if (success)
+		{
+			const char *unlinkParams[1] = { unlinkArray->data };
+
+			PGresult *res = PQexecParams(dst->connection, unlinkSQL,
+										 1, NULL, unlinkParams, NULL, NULL, 0);
+
+			if (!is_response_ok(res))
+			{
+				(void) pgcopy_log_error(dst, res, "Failed to delete large objects");
+				success = false;
+			}
+
+			PQclear(res);
+		}
+
+		destroyPQExpBuffer(unlinkArray);
+	}
+
+	if (success)
+	{
+		PGresult *res = PQexecParams(dst->connection, sql->data,
+									 paramCount, NULL, paramValues,
+									 paramLengths, paramFormats, 0);
+
+		if (!is_response_ok(res))
+		{
+			(void) pgcopy_log_error(dst, res, "Failed to write large objects");
+			success = false;
+		}
+
+		PQclear(res);
 	}
+
+	free(oidStrings);
+	free(paramValues);
+	free(paramLengths);
+	free(paramFormats);
+	destroyPQExpBuffer(oids);
+	destroyPQExpBuffer(sql);
+
+	return success;
 }
 
 
@@ -4614,6 +5477,25 @@ pgsql_replication_origin_session_setup(PGSQL *pgsql, char *nodeName)
 }
 
 
+/*
+ * pgsql_replication_origin_session_reset calls
+ * pg_replication_origin_session_reset().
+ */
+bool
+pgsql_replication_origin_session_reset(PGSQL *pgsql)
+{
+	const char *sql = "select pg_replication_origin_session_reset()";
+
+	if (!pgsql_execute(pgsql, sql))
+	{
+		log_error("Failed to reset replication origin session");
+		return false;
+	}
+
+	return true;
+}
+
+
 /*
  * pgsql_replication_origin_xact_setup calls pg_replication_origin_xact_setup().
  */
@@ -5001,6 +5883,49 @@ pgsql_role_exists(PGSQL *pgsql, const char *roleName, bool *exists)
 }
 
 
+/*
+ * pgsql_table_size returns the pg_table_size() of the given table.
+ */
+bool
+pgsql_table_size(PGSQL *pgsql,
+				 const char *nspname,
+				 const char *relname,
+				 int64_t *bytes)
+{
+	SingleValueResultContext context = { { 0 }, PGSQL_RESULT_BIGINT, false };
+
+	char *sql =
+		"select pg_catalog.pg_table_size(c.oid) "
+		"  from pg_catalog.pg_class c "
+		"       join pg_catalog.pg_namespace n on n.oid = c.relnamespace "
+		" where n.nspname = $1 and c.relname = $2";
+
+	int paramCount = 2;
+	Oid paramTypes[2] = { NAMEOID, NAMEOID };
+	const char *paramValues[2] = { nspname, relname };
+
+	if (!pgsql_execute_with_params(pgsql, sql,
+								   paramCount, paramTypes, paramValues,
+								   &context, &parseSingleValueResult))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (!context.parsedOk || context.isNull)
+	{
+		log_error("Failed to get the size of table \"%s\".\"%s\"",
+				  nspname,
+				  relname);
+		return false;
+	}
+
+	*bytes = context.bigint;
+
+	return true;
+}
+
+
 /*
  * pgsql_update_sentinel_startpos updates our pgcopydb sentinel table start pos.
  */
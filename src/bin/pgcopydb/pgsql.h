@@ -182,6 +182,12 @@ typedef struct PGSQL
 	bool notificationReceived;
 
 	bool logSQL;
+
+	/* libpq pipeline mode, see pgsql_pipeline_enter() */
+	bool pipelineMode;
+	bool pipelineFlushed;       /* server has been asked to flush results */
+	int pipelineQueries;        /* queries and syncs sent, not consumed yet */
+	int pipelineSyncs;          /* syncs sent, not consumed yet */
 } PGSQL;
 
 
@@ -269,6 +275,11 @@ bool pgsql_is_in_recovery(PGSQL *pgsql, bool *is_in_recovery);
 bool pgsql_has_database_privilege(PGSQL *pgsql, const char *privilege,
 								  bool *granted);
 
+bool pgsql_has_table_privilege(PGSQL *pgsql,
+							   const char *tablename,
+							   const char *privilege,
+							   bool *granted);
+
 bool pgsql_has_sequence_privilege(PGSQL *pgsql,
 								  const char *seqname,
 								  const char *privilege,
@@ -286,6 +297,20 @@ bool pgsql_execute_with_params(PGSQL *pgsql, const char *sql, int paramCount,
 							   const Oid *paramTypes, const char **paramValues,
 							   void *parseContext, ParsePostgresResultCB *parseFun);
 
+bool pgsql_prepare(PGSQL *pgsql, const char *name, const char *sql,
+				   int paramCount, const Oid *paramTypes);
+
+bool pgsql_execute_prepared(PGSQL *pgsql, const char *name,
+							int paramCount, const char **paramValues,
+							void *context, ParsePostgresResultCB *parseFun);
+
+bool pgsql_pipeline_enter(PGSQL *pgsql);
+bool pgsql_pipeline_exit(PGSQL *pgsql);
+bool pgsql_pipeline_sync(PGSQL *pgsql);
+bool pgsql_pipeline_flush(PGSQL *pgsql);
+bool pgsql_pipeline_consume(PGSQL *pgsql, bool *isSync, bool *success);
+bool pgsql_pipeline_ready(PGSQL *pgsql);
+
 void pgAutoCtlDebugNoticeProcessor(void *arg, const char *message);
 
 bool hostname_from_uri(const char *pguri,
@@ -307,8 +332,8 @@ bool pgsql_get_sequence(PGSQL *pgsql, const char *nspname, const char *relname,
 
 bool pgsql_set_gucs(PGSQL *pgsql, GUC *settings);
 
-bool pg_copy_large_objects(PGSQL *src, PGSQL *dst,
-						   bool dropIfExists, uint32_t *count);
+bool pg_copy_large_objects(PGSQL *src, PGSQL *dst, bool dropIfExists,
+						   uint32_t minOid, uint32_t maxOid, uint32_t *count);
 
 /*
  * Maximum length of serialized pg_lsn value
@@ -478,6 +503,7 @@ bool pgsql_replication_origin_oid(PGSQL *pgsql, char *nodeName, uint32_t *oid);
 bool pgsql_replication_origin_create(PGSQL *pgsql, char *nodeName);
 bool pgsql_replication_origin_drop(PGSQL *pgsql, char *nodeName);
 bool pgsql_replication_origin_session_setup(PGSQL *pgsql, char *nodeName);
+bool pgsql_replication_origin_session_reset(PGSQL *pgsql);
 
 bool pgsql_replication_origin_xact_setup(PGSQL *pgsql,
 										 char *origin_lsn,
@@ -504,6 +530,11 @@ bool pgsql_drop_replication_slot(PGSQL *pgsql, const char *slotName);
 
 bool pgsql_role_exists(PGSQL *pgsql, const char *roleName, bool *exists);
 
+bool pgsql_table_size(PGSQL *pgsql,
+					  const char *nspname,
+					  const char *relname,
+					  int64_t *bytes);
+
 bool pgsql_table_exists(PGSQL *pgsql,
 						const char *relname,
 						const char *nspname,
@@ -13,6 +13,7 @@
 
 #include "copydb.h"
 #include "env_utils.h"
+#include "journal.h"
 #include "log.h"
 #include "parsing_utils.h"
 #include "pidfile.h"
@@ -42,6 +43,26 @@ static bool copydb_seq_array_as_json(SourceSequenceArray *sequenceArray,
 									 JSON_Object *jsobj,
 									 const char *key);
 
+static bool copydb_catalog_as_json(CopyDataSpec *copySpecs,
+								   JSON_Object *jsobj,
+								   const char *key);
+
+static bool copydb_filtered_as_json(SourceFilterItem *hOid,
+									JSON_Object *jsobj,
+									const char *key);
+
+static bool copydb_parse_tables_json(CopyDataSpec *copySpecs,
+									 JSON_Object *jsObj);
+
+static bool copydb_parse_indexes_json(CopyDataSpec *copySpecs,
+									  JSON_Object *jsObj);
+
+static bool copydb_parse_sequences_json(CopyDataSpec *copySpecs,
+										JSON_Object *jsObj);
+
+static bool copydb_parse_filtered_json(CopyDataSpec *copySpecs,
+									   JSON_Object *jsObj);
+
 /*
  * copydb_prepare_schema_json_file prepares a JSON formatted file that contains
  * the list of all the tables and indexes and sequences that are going to be
@@ -69,6 +90,14 @@ copydb_prepare_schema_json_file(CopyDataSpec *copySpecs)
 		return false;
 	}
 
+	/* catalog cache keys, if any */
+	if (copySpecs->catalogCache.enabled &&
+		!copydb_catalog_as_json(copySpecs, jsobj, "catalog"))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	/* array of tables */
 	SourceTableArray *tableArray = &(copySpecs->sourceTableArray);
 
@@ -103,6 +132,15 @@ copydb_prepare_schema_json_file(CopyDataSpec *copySpecs)
 		return false;
 	}
 
+	/* objects that are filtered out, for the catalog cache */
+	if (copySpecs->catalogCache.enabled &&
+		copySpecs->catalogCache.filtered &&
+		!copydb_filtered_as_json(copySpecs->hOid, jsobj, "filtered"))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	/* now pretty-print the JSON to file */
 	char *serialized_string = json_serialize_to_string_pretty(js);
 	size_t len = strlen(serialized_string);
@@ -355,6 +393,36 @@ copydb_table_array_as_json(SourceTableArray *tableArray,
 			json_object_set_value(jsTableObj, "parts", jsParts);
 		}
 
+		/* the attributes list is used to prepare the COPY queries */
+		if (table->attributes.count > 0)
+		{
+			JSON_Value *jsAttrs = json_value_init_array();
+			JSON_Array *jsAttrArray = json_value_get_array(jsAttrs);
+
+			for (int i = 0; i < table->attributes.count; i++)
+			{
+				SourceTableAttribute *attr = &(table->attributes.array[i]);
+
+				JSON_Value *jsAttr = json_value_init_object();
+				JSON_Object *jsAttrObj = json_value_get_object(jsAttr);
+
+				json_object_set_number(jsAttrObj, "attnum",
+									   (double) attr->attnum);
+
+				json_object_set_number(jsAttrObj, "atttypid",
+									   (double) attr->atttypid);
+
+				json_object_set_string(jsAttrObj, "attname", attr->attname);
+
+				json_object_set_boolean(jsAttrObj, "attisprimary",
+										attr->attisprimary);
+
+				json_array_append_value(jsAttrArray, jsAttr);
+			}
+
+			json_object_set_value(jsTableObj, "attributes", jsAttrs);
+		}
+
 		json_array_append_value(jsTableArray, jsTable);
 	}
 
@@ -464,6 +532,7 @@ copydb_seq_array_as_json(SourceSequenceArray *sequenceArray,
 		JSON_Object *jsSeqObj = json_value_get_object(jsSeq);
 
 		json_object_set_number(jsSeqObj, "oid", (double) seq->oid);
+		json_object_set_number(jsSeqObj, "attroid", (double) seq->attroid);
 		json_object_set_string(jsSeqObj, "schema", seq->nspname);
 		json_object_set_string(jsSeqObj, "name", seq->relname);
 
@@ -484,6 +553,144 @@ copydb_seq_array_as_json(SourceSequenceArray *sequenceArray,
 }
 
 
+/*
+ * copydb_catalog_as_json prepares the catalog cache keys and the list of the
+ * catalog information that has been saved in the file, as a JSON object
+ * within the given JSON_Value.
+ */
+static bool
+copydb_catalog_as_json(CopyDataSpec *copySpecs,
+					   JSON_Object *jsobj,
+					   const char *key)
+{
+	CatalogCache *cache = &(copySpecs->catalogCache);
+
+	JSON_Value *jsCatalog = json_value_init_object();
+	JSON_Object *jsCatalogObj = json_value_get_object(jsCatalog);
+
+	json_object_set_string(jsCatalogObj,
+						   "system-identifier",
+						   cache->systemIdentifier);
+
+	json_object_set_string(jsCatalogObj,
+						   "snapshot",
+						   copySpecs->sourceSnapshot.snapshot);
+
+	json_object_set_string(jsCatalogObj, "filters-hash", cache->filtersHash);
+
+	json_object_set_boolean(jsCatalogObj, "tables", cache->tables);
+	json_object_set_boolean(jsCatalogObj, "indexes", cache->indexes);
+	json_object_set_boolean(jsCatalogObj, "sequences", cache->sequences);
+	json_object_set_boolean(jsCatalogObj, "filtered", cache->filtered);
+
+	/* attach the JSON object to the main JSON object under the provided key */
+	json_object_set_value(jsobj, key, jsCatalog);
+
+	return true;
+}
+
+
+/*
+ * copydb_filtered_as_json prepares the objects that are filtered out as a
+ * JSON array of objects within the given JSON_Value.
+ */
+static bool
+copydb_filtered_as_json(SourceFilterItem *hOid,
+						JSON_Object *jsobj,
+						const char *key)
+{
+	JSON_Value *jsFiltered = json_value_init_array();
+	JSON_Array *jsFilteredArray = json_value_get_array(jsFiltered);
+
+	SourceFilterItem *item;
+	SourceFilterItem *tmp;
+
+	HASH_ITER(hOid, hOid, item, tmp)
+	{
+		JSON_Value *jsItem = json_value_init_object();
+		JSON_Object *jsItemObj = json_value_get_object(jsItem);
+
+		json_object_set_number(jsItemObj, "oid", (double) item->oid);
+
+		json_object_set_string(jsItemObj,
+							   "kind",
+							   copydb_ObjectKindToString(item->kind));
+
+		json_object_set_string(jsItemObj,
+							   "restore-list-name",
+							   item->restoreListName);
+
+		json_array_append_value(jsFilteredArray, jsItem);
+	}
+
+	/* attach the JSON array to the main JSON object under the provided key */
+	json_object_set_value(jsobj, key, jsFiltered);
+
+	return true;
+}
+
+
+/*
+ * copydb_filters_hash computes a hash of the filtering setup and of the
+ * options that change the catalog information we fetch from the source
+ * database, used as a key for the catalog cache.
+ */
+bool
+copydb_filters_hash(CopyDataSpec *copySpecs, char *hash, size_t size)
+{
+	JSON_Value *js = json_value_init_object();
+	JSON_Object *jsobj = json_value_get_object(js);
+
+	if (!copydb_filtering_as_json(copySpecs, jsobj, "filters"))
+	{
+		/* errors have already been logged */
+		json_value_free(js);
+		return false;
+	}
+
+	json_object_set_number(jsobj,
+						   "split-tables-larger-than",
+						   (double) copySpecs->splitTablesLargerThan);
+
+	json_object_set_boolean(jsobj,
+							"estimate-table-sizes",
+							copySpecs->estimateTableSizes);
+
+	json_object_set_boolean(jsobj,
+							"skip-extensions",
+							copySpecs->skipExtensions);
+
+	json_object_set_boolean(jsobj,
+							"skip-collations",
+							copySpecs->skipCollations);
+
+	char *serialized = json_serialize_to_string(js);
+
+	if (serialized == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		json_value_free(js);
+		return false;
+	}
+
+	/* 64-bit FNV-1a hash of the serialized JSON string */
+	uint64_t h = 14695981039346656037ULL;
+
+	for (char *p = serialized; *p != '\0'; p++)
+	{
+		h ^= (uint64_t) (unsigned char) *p;
+		h *= 1099511628211ULL;
+	}
+
+	sformat(hash, size, "%016" PRIx64, h);
+
+	json_free_serialized_string(serialized);
+	json_value_free(js);
+
+	return true;
+}
+
+
 /*
  * copydb_parse_schema_json_file parses the JSON file prepared with
  * copydb_prepare_schema_json_file and fills-in the given CopyDataSpec
@@ -517,7 +724,110 @@ copydb_parse_schema_json_file(CopyDataSpec *copySpecs)
 	copySpecs->tableJobs = json_object_dotget_number(jsObj, "setup.table-jobs");
 	copySpecs->indexJobs = json_object_dotget_number(jsObj, "setup.index-jobs");
 
-	/* table section */
+	if (!copydb_parse_tables_json(copySpecs, jsObj) ||
+		!copydb_parse_indexes_json(copySpecs, jsObj))
+	{
+		/* errors have already been logged */
+		json_value_free(json);
+		return false;
+	}
+
+	json_value_free(json);
+
+	return true;
+}
+
+
+/*
+ * copydb_load_catalog_cache loads the catalog information found in the
+ * schema.json file when it has been prepared by a previous pgcopydb command
+ * for the same source system identifier, snapshot, and filters hash. The
+ * catalogCache flags are then set to skip the matching catalog queries.
+ */
+bool
+copydb_load_catalog_cache(CopyDataSpec *copySpecs)
+{
+	CatalogCache *cache = &(copySpecs->catalogCache);
+	char *filename = copySpecs->cfPaths.schemafile;
+
+	if (!cache->enabled || !file_exists(filename))
+	{
+		return true;
+	}
+
+	JSON_Value *json = json_parse_file(filename);
+
+	if (json == NULL)
+	{
+		log_warn("Failed to parse JSON file \"%s\", "
+				 "fetching catalogs from the source database",
+				 filename);
+		return true;
+	}
+
+	JSON_Object *jsObj = json_value_get_object(json);
+
+	const char *sysid =
+		json_object_dotget_string(jsObj, "catalog.system-identifier");
+
+	const char *snapshot =
+		json_object_dotget_string(jsObj, "catalog.snapshot");
+
+	const char *filtersHash =
+		json_object_dotget_string(jsObj, "catalog.filters-hash");
+
+	if (!streq(sysid, cache->systemIdentifier) ||
+		!streq(snapshot, copySpecs->sourceSnapshot.snapshot) ||
+		!streq(filtersHash, cache->filtersHash))
+	{
+		log_notice("Catalog cache in \"%s\" does not match the current "
+				   "source, snapshot, or filters: fetching catalogs again",
+				   filename);
+		json_value_free(json);
+		return true;
+	}
+
+	bool tables = json_object_dotget_boolean(jsObj, "catalog.tables") == 1;
+	bool indexes = json_object_dotget_boolean(jsObj, "catalog.indexes") == 1;
+	bool sequences =
+		json_object_dotget_boolean(jsObj, "catalog.sequences") == 1;
+	bool filtered = json_object_dotget_boolean(jsObj, "catalog.filtered") == 1;
+
+	if ((tables && !copydb_parse_tables_json(copySpecs, jsObj)) ||
+		(indexes && !copydb_parse_indexes_json(copySpecs, jsObj)) ||
+		(sequences && !copydb_parse_sequences_json(copySpecs, jsObj)) ||
+		(filtered && !copydb_parse_filtered_json(copySpecs, jsObj)))
+	{
+		/* errors have already been logged */
+		json_value_free(json);
+		return false;
+	}
+
+	json_value_free(json);
+
+	cache->tables = cache->cachedTables = tables;
+	cache->indexes = cache->cachedIndexes = indexes;
+	cache->sequences = cache->cachedSequences = sequences;
+	cache->filtered = cache->cachedFiltered = filtered;
+
+	log_info("Using catalog cache from \"%s\" "
+			 "(%d tables, %d indexes, %d sequences)",
+			 filename,
+			 copySpecs->sourceTableArray.count,
+			 copySpecs->sourceIndexArray.count,
+			 copySpecs->sequenceArray.count);
+
+	return true;
+}
+
+
+/*
+ * copydb_parse_tables_json parses the "tables" array of the schema.json file
+ * into the sourceTableArray of the given CopyDataSpec.
+ */
+static bool
+copydb_parse_tables_json(CopyDataSpec *copySpecs, JSON_Object *jsObj)
+{
 	JSON_Array *jsTableArray = json_object_get_array(jsObj, "tables");
 	int tableCount = json_array_get_count(jsTableArray);
 
@@ -575,6 +885,12 @@ copydb_parse_schema_json_file(CopyDataSpec *copySpecs)
 			table->partsArray.array =
 				(SourceTableParts *) calloc(partsCount, sizeof(SourceTableParts));
 
+			if (table->partsArray.array == NULL)
+			{
+				log_fatal(ALLOCATION_FAILED_ERROR);
+				return false;
+			}
+
 			for (int i = 0; i < partsCount; i++)
 			{
 				SourceTableParts *part = &(table->partsArray.array[i]);
@@ -592,9 +908,52 @@ copydb_parse_schema_json_file(CopyDataSpec *copySpecs)
 			table->partsArray.count = 0;
 			table->partsArray.array = NULL;
 		}
+
+		if (json_object_has_value(jsTable, "attributes"))
+		{
+			JSON_Array *jsAttrsArray =
+				json_object_get_array(jsTable, "attributes");
+			int attrsCount = json_array_get_count(jsAttrsArray);
+
+			table->attributes.count = attrsCount;
+			table->attributes.array =
+				(SourceTableAttribute *) calloc(attrsCount,
+												sizeof(SourceTableAttribute));
+
+			if (table->attributes.array == NULL)
+			{
+				log_fatal(ALLOCATION_FAILED_ERROR);
+				return false;
+			}
+
+			for (int i = 0; i < attrsCount; i++)
+			{
+				SourceTableAttribute *attr = &(table->attributes.array[i]);
+				JSON_Object *jsAttr = json_array_get_object(jsAttrsArray, i);
+
+				char *attname = (char *) json_object_get_string(jsAttr, "attname");
+
+				attr->attnum = json_object_get_number(jsAttr, "attnum");
+				attr->atttypid = json_object_get_number(jsAttr, "atttypid");
+				attr->attisprimary =
+					json_object_get_boolean(jsAttr, "attisprimary") == 1;
+
+				strlcpy(attr->attname, attname, sizeof(attr->attname));
+			}
+		}
 	}
 
-	/* index section */
+	return true;
+}
+
+
+/*
+ * copydb_parse_indexes_json parses the "indexes" array of the schema.json
+ * file into the sourceIndexArray of the given CopyDataSpec.
+ */
+static bool
+copydb_parse_indexes_json(CopyDataSpec *copySpecs, JSON_Object *jsObj)
+{
 	JSON_Array *jsIndexArray = json_object_get_array(jsObj, "indexes");
 	int indexCount = json_array_get_count(jsIndexArray);
 
@@ -675,8 +1034,8 @@ copydb_parse_schema_json_file(CopyDataSpec *copySpecs)
 			def = (char *) json_object_dotget_string(jsIndex, "constraint.sql");
 
 			listName =
-				(char *) json_object_get_string(jsIndex,
-												"constraint.restore-list-name");
+				(char *) json_object_dotget_string(jsIndex,
+												   "constraint.restore-list-name");
 
 			strlcpy(index->constraintName, name, sizeof(index->constraintName));
 
@@ -708,6 +1067,125 @@ copydb_parse_schema_json_file(CopyDataSpec *copySpecs)
 }
 
 
+/*
+ * copydb_parse_sequences_json parses the "sequences" array of the schema.json
+ * file into the sequenceArray of the given CopyDataSpec.
+ */
+static bool
+copydb_parse_sequences_json(CopyDataSpec *copySpecs, JSON_Object *jsObj)
+{
+	JSON_Array *jsSeqArray = json_object_get_array(jsObj, "sequences");
+	int seqCount = json_array_get_count(jsSeqArray);
+
+	log_debug("copydb_parse_schema_json_file: parsing %d sequences", seqCount);
+
+	copySpecs->sequenceArray.count = seqCount;
+	copySpecs->sequenceArray.array =
+		(SourceSequence *) calloc(seqCount, sizeof(SourceSequence));
+
+	if (copySpecs->sequenceArray.array == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	for (int i = 0; i < seqCount; i++)
+	{
+		SourceSequence *seq = &(copySpecs->sequenceArray.array[i]);
+		JSON_Object *jsSeq = json_array_get_object(jsSeqArray, i);
+
+		char *schema = (char *) json_object_get_string(jsSeq, "schema");
+		char *name = (char *) json_object_get_string(jsSeq, "name");
+		char *listName =
+			(char *) json_object_get_string(jsSeq, "restore-list-name");
+
+		seq->oid = json_object_get_number(jsSeq, "oid");
+		seq->attroid = json_object_get_number(jsSeq, "attroid");
+		seq->lastValue = json_object_get_number(jsSeq, "last-value");
+		seq->isCalled = json_object_get_boolean(jsSeq, "is-called") == 1;
+
+		strlcpy(seq->nspname, schema, sizeof(seq->nspname));
+		strlcpy(seq->relname, name, sizeof(seq->relname));
+		strlcpy(seq->restoreListName, listName, sizeof(seq->restoreListName));
+	}
+
+	return true;
+}
+
+
+/*
+ * copydb_parse_filtered_json parses the "filtered" array of the schema.json
+ * file and builds the hOid and hName hash tables of the given CopyDataSpec,
+ * as copydb_fetch_filtered_oids would.
+ */
+static bool
+copydb_parse_filtered_json(CopyDataSpec *copySpecs, JSON_Object *jsObj)
+{
+	SourceFilterItem *hOid = NULL;
+	SourceFilterItem *hName = NULL;
+
+	JSON_Array *jsFilteredArray = json_object_get_array(jsObj, "filtered");
+	int count = json_array_get_count(jsFilteredArray);
+
+	log_debug("copydb_parse_schema_json_file: parsing %d filtered objects",
+			  count);
+
+	for (int i = 0; i < count; i++)
+	{
+		JSON_Object *jsItem = json_array_get_object(jsFilteredArray, i);
+
+		char *kind = (char *) json_object_get_string(jsItem, "kind");
+		char *listName =
+			(char *) json_object_get_string(jsItem, "restore-list-name");
+
+		SourceFilterItem *item = calloc(1, sizeof(SourceFilterItem));
+
+		if (item == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			return false;
+		}
+
+		item->oid = json_object_get_number(jsItem, "oid");
+		item->kind = copydb_ObjectKindFromString(kind);
+
+		if (listName != NULL)
+		{
+			strlcpy(item->restoreListName, listName, RESTORE_LIST_NAMEDATALEN);
+		}
+
+		HASH_ADD(hOid, hOid, oid, sizeof(uint32_t), item);
+
+		/* only some object kinds are filtered by their restore list name */
+		switch (item->kind)
+		{
+			case OBJECT_KIND_SCHEMA:
+			case OBJECT_KIND_EXTENSION:
+			case OBJECT_KIND_COLLATION:
+			case OBJECT_KIND_TABLE:
+			case OBJECT_KIND_INDEX:
+			case OBJECT_KIND_SEQUENCE:
+			{
+				size_t len = strlen(item->restoreListName);
+				HASH_ADD(hName, hName, restoreListName, len, item);
+				break;
+			}
+
+			default:
+			{
+				break;
+			}
+		}
+	}
+
+	/* publish our hash tables to the main CopyDataSpec instance */
+	copySpecs->hOid = hOid;
+	copySpecs->hName = hName;
+
+	return true;
+}
+
+
 /*
  * copydb_update_progress updates the progress counters with information found
  * on-disk in the work directory (lock and done files, etc).
@@ -751,24 +1229,26 @@ copydb_update_progress(CopyDataSpec *copySpecs, CopyProgress *progress)
 
 		if (partCount <= 1)
 		{
-			CopyTableDataSpec tableSpecs = { 0 };
+			TableFilePaths tablePaths = { 0 };
 
-			if (!copydb_init_table_specs(&tableSpecs, copySpecs, source, 0))
+			if (!copydb_init_tablepaths(&(copySpecs->cfPaths),
+										&tablePaths,
+										source->oid))
 			{
 				/* errors have already been logged */
 				return false;
 			}
 
-			if (file_exists(tableSpecs.tablePaths.doneFile))
+			if (journal_file_exists(tablePaths.doneFile))
 			{
 				done = true;
 			}
-			else if (file_exists(tableSpecs.tablePaths.lockFile))
+			else if (file_exists(tablePaths.lockFile))
 			{
 				CopyTableSummary summary = { .table = source };
 
 				if (!read_table_summary(&summary,
-										tableSpecs.tablePaths.lockFile))
+										tablePaths.lockFile))
 				{
 					/* errors have already been logged */
 					return false;
@@ -791,28 +1271,28 @@ copydb_update_progress(CopyDataSpec *copySpecs, CopyProgress *progress)
 
 			for (int partIndex = 0; partIndex < partCount; partIndex++)
 			{
-				CopyTableDataSpec tableSpecs = { 0 };
+				TableFilePaths tablePaths = { 0 };
 
-				if (!copydb_init_table_specs(&tableSpecs,
-											 copySpecs,
-											 source,
-											 partIndex))
+				if (!copydb_init_tablepaths_for_part(&(copySpecs->cfPaths),
+													 &tablePaths,
+													 source->oid,
+													 partIndex))
 				{
 					/* errors have already been logged */
 					return false;
 				}
 
-				if (!file_exists(tableSpecs.tablePaths.doneFile))
+				if (!journal_file_exists(tablePaths.doneFile))
 				{
 					allPartsAreDone = false;
 				}
 
-				if (file_exists(tableSpecs.tablePaths.lockFile))
+				if (file_exists(tablePaths.lockFile))
 				{
 					CopyTableSummary summary = { .table = source };
 
 					if (!read_table_summary(&summary,
-											tableSpecs.tablePaths.lockFile))
+											tablePaths.lockFile))
 					{
 						/* errors have already been logged */
 						return false;
@@ -872,7 +1352,7 @@ copydb_update_progress(CopyDataSpec *copySpecs, CopyProgress *progress)
 		SourceIndex *index = &(indexArray->array[i]);
 		IndexFilePaths *indexPaths = &(indexPathsArray.array[i]);
 
-		if (file_exists(indexPaths->doneFile))
+		if (journal_file_exists(indexPaths->doneFile))
 		{
 			++progress->indexDoneCount;
 		}
@@ -43,6 +43,8 @@ typedef struct CopyProgress
 
 bool copydb_prepare_schema_json_file(CopyDataSpec *copySpecs);
 bool copydb_parse_schema_json_file(CopyDataSpec *copySpecs);
+bool copydb_load_catalog_cache(CopyDataSpec *copySpecs);
+bool copydb_filters_hash(CopyDataSpec *copySpecs, char *hash, size_t size);
 bool copydb_update_progress(CopyDataSpec *copySpecs, CopyProgress *progress);
 
 bool copydb_progress_as_json(CopyDataSpec *copySpecs,
@@ -150,3 +150,37 @@ queue_receive(Queue *queue, QMessage *msg)
 
 	return true;
 }
+
+
+/*
+ * queue_receive_nowait receives a message from the queue when one is
+ * available already, and sets received to false otherwise.
+ */
+bool
+queue_receive_nowait(Queue *queue, QMessage *msg, bool *received)
+{
+	int errStatus;
+
+	*received = false;
+
+	do {
+		errStatus = msgrcv(queue->qId, msg, sizeof(QMessage), 0, IPC_NOWAIT);
+	} while (errStatus < 0 && errno == EINTR);
+
+	if (errStatus < 0)
+	{
+		if (errno == ENOMSG)
+		{
+			return true;
+		}
+
+		log_error("Failed to receive a message from %s queue (%d): %m",
+				  queue->name,
+				  queue->qId);
+		return false;
+	}
+
+	*received = true;
+
+	return true;
+}
@@ -51,5 +51,6 @@ bool queue_unlink(Queue *queue);
 
 bool queue_send(Queue *queue, QMessage *msg);
 bool queue_receive(Queue *queue, QMessage *msg);
+bool queue_receive_nowait(Queue *queue, QMessage *msg, bool *received);
 
 #endif /* QUEUE_UTILS_H */
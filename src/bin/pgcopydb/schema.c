@@ -19,6 +19,7 @@
 #include "parsing_utils.h"
 #include "pg_depend_sql.h"
 #include "pgsql.h"
+#include "pqexpbuffer.h"
 #include "schema.h"
 #include "signals.h"
 #include "string_utils.h"
@@ -81,6 +82,32 @@ typedef struct SourceSequenceArrayContext
 	bool parsedOk;
 } SourceSequenceArrayContext;
 
+/* Context used when fetching table sizes */
+typedef struct TableSizeArrayContext
+{
+	char sqlstate[SQLSTATE_LENGTH];
+	TableSizeArray *sizeArray;
+	bool parsedOk;
+} TableSizeArrayContext;
+
+/* Context used when fetching privileges for all the sequences */
+typedef struct SequencePrivilegesContext
+{
+	char sqlstate[SQLSTATE_LENGTH];
+	SourceSequenceArray *sequenceArray;
+	bool *granted;
+	bool parsedOk;
+} SequencePrivilegesContext;
+
+/* Context used when fetching values for a batch of sequences */
+typedef struct SequenceValuesContext
+{
+	char sqlstate[SQLSTATE_LENGTH];
+	SourceSequence **sequences;
+	int count;
+	bool parsedOk;
+} SequenceValuesContext;
+
 /* Context used when fetching all the indexes definitions */
 typedef struct SourceIndexArrayContext
 {
@@ -89,6 +116,38 @@ typedef struct SourceIndexArrayContext
 	bool parsedOk;
 } SourceIndexArrayContext;
 
+/* Context used when fetching the state of an index on the target database */
+typedef struct TargetIndexStateContext
+{
+	char sqlstate[SQLSTATE_LENGTH];
+	TargetIndexState *state;
+	bool parsedOk;
+} TargetIndexStateContext;
+
+/* Context used when fetching the tables with extra unique indexes */
+typedef struct TargetRelationArrayContext
+{
+	char sqlstate[SQLSTATE_LENGTH];
+	TargetRelationArray *relationArray;
+	bool parsedOk;
+} TargetRelationArrayContext;
+
+/* Context used when preparing the planner statistics of a table */
+typedef struct SourceTableStatsContext
+{
+	char sqlstate[SQLSTATE_LENGTH];
+	SourceTableStats *stats;
+	bool parsedOk;
+} SourceTableStatsContext;
+
+/* Context used when fetching the large objects OID ranges */
+typedef struct BlobRangeArrayContext
+{
+	char sqlstate[SQLSTATE_LENGTH];
+	BlobRangeArray *rangeArray;
+	bool parsedOk;
+} BlobRangeArrayContext;
+
 /* Context used when fetching all the table dependencies */
 typedef struct SourceDependArrayContext
 {
@@ -136,12 +195,27 @@ static bool parseCurrentSourceSequence(PGresult *result,
 									   int rowNumber,
 									   SourceSequence *table);
 
+static void getTableSizeArray(void *ctx, PGresult *result);
+static void getTableSizes(void *ctx, PGresult *result);
+static bool appendTableSizeOids(PQExpBuffer buffer, TableSizeArray *sizeArray);
+
+static void getSequencePrivileges(void *ctx, PGresult *result);
+static void getSequenceValues(void *ctx, PGresult *result);
+
 static void getIndexArray(void *ctx, PGresult *result);
 
 static bool parseCurrentSourceIndex(PGresult *result,
 									int rowNumber,
 									SourceIndex *index);
 
+static void getTargetIndexState(void *ctx, PGresult *result);
+
+static void getTargetRelationArray(void *ctx, PGresult *result);
+
+static void getTableStats(void *ctx, PGresult *result);
+
+static void getBlobRangeArray(void *ctx, PGresult *result);
+
 static void getDependArray(void *ctx, PGresult *result);
 
 static bool parseCurrentSourceDepend(PGresult *result,
@@ -186,6 +260,62 @@ schema_query_privileges(PGSQL *pgsql,
 }
 
 
+/*
+ * schema_get_system_identifier fetches the system identifier of the given
+ * Postgres instance, when pg_control_system() is available and the current
+ * role is granted EXECUTE on it. Otherwise sysid is set to an empty string.
+ */
+bool
+schema_get_system_identifier(PGSQL *pgsql, char *sysid, size_t size)
+{
+	SingleValueResultContext parseContext =
+	{ { 0 }, PGSQL_RESULT_STRING, false };
+
+	char *sql =
+		"select case when pg_catalog.has_function_privilege("
+		"                   'pg_catalog.pg_control_system()', 'execute') "
+		"            then (select system_identifier::text "
+		"                    from pg_catalog.pg_control_system()) "
+		"        end";
+
+	sysid[0] = '\0';
+
+	if (!pgsql_server_version(pgsql))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	/* pg_control_system() has been added in Postgres 9.6 */
+	if (pgsql->pgversion_num < 90600)
+	{
+		return true;
+	}
+
+	if (!pgsql_execute_with_params(pgsql, sql,
+								   0, NULL, NULL,
+								   &parseContext, &parseSingleValueResult))
+	{
+		log_error("Failed to query the system identifier");
+		return false;
+	}
+
+	if (!parseContext.parsedOk)
+	{
+		log_error("Failed to query the system identifier");
+		return false;
+	}
+
+	if (!parseContext.isNull)
+	{
+		strlcpy(sysid, parseContext.strVal, size);
+		free(parseContext.strVal);
+	}
+
+	return true;
+}
+
+
 /*
  * schema_list_catalogs grabs the list of databases (catalogs) from the given
  * source Postgres instance and allocates a SourceCatalog array with the result
@@ -397,6 +527,22 @@ schema_list_collations(PGSQL *pgsql, SourceCollationArray *array)
 }
 
 
+/*
+ * The pgcopydb_table_size table is computed from the list of relations given
+ * by the listSourceTableSizeSQL queries, either using pg_table_size(), or
+ * using an estimate from the relpages of the table and its TOAST table.
+ */
+#define TABLE_SIZE_EXACT_SQL \
+	"select s.oid, pg_table_size(s.oid) as bytes from (%s) as s"
+
+#define TABLE_SIZE_ESTIMATE_SQL \
+	"select s.oid, " \
+	"       (c.relpages::bigint + coalesce(t.relpages, 0)) " \
+	"       * current_setting('block_size')::bigint as bytes " \
+	"  from (%s) as s " \
+	"       join pg_catalog.pg_class c on c.oid = s.oid " \
+	"       left join pg_catalog.pg_class t on t.oid = c.reltoastrelid"
+
 /*
  * For code simplicity the index array is also the SourceFilterType enum value.
  */
@@ -404,7 +550,7 @@ struct FilteringQueries listSourceTableSizeSQL[] = {
 	{
 		SOURCE_FILTER_TYPE_NONE,
 
-		"  select c.oid, pg_table_size(c.oid) as bytes "
+		"  select c.oid "
 		"    from pg_catalog.pg_class c"
 		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid"
 
@@ -425,7 +571,7 @@ struct FilteringQueries listSourceTableSizeSQL[] = {
 	{
 		SOURCE_FILTER_TYPE_INCL,
 
-		"  select c.oid, pg_table_size(c.oid) as bytes "
+		"  select c.oid "
 		"    from pg_catalog.pg_class c"
 		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid"
 
@@ -456,7 +602,7 @@ struct FilteringQueries listSourceTableSizeSQL[] = {
 	{
 		SOURCE_FILTER_TYPE_EXCL,
 
-		"  select c.oid, pg_table_size(c.oid) as bytes "
+		"  select c.oid "
 		"    from pg_catalog.pg_class c"
 		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid"
 
@@ -496,7 +642,7 @@ struct FilteringQueries listSourceTableSizeSQL[] = {
 	{
 		SOURCE_FILTER_TYPE_LIST_NOT_INCL,
 
-		"  select c.oid, pg_table_size(c.oid) as bytes "
+		"  select c.oid "
 		"    from pg_catalog.pg_class c"
 		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid"
 
@@ -530,7 +676,7 @@ struct FilteringQueries listSourceTableSizeSQL[] = {
 	{
 		SOURCE_FILTER_TYPE_LIST_EXCL,
 
-		"  select c.oid, pg_table_size(c.oid) as bytes "
+		"  select c.oid "
 		"    from pg_catalog.pg_class c"
 		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid"
 
@@ -564,6 +710,12 @@ struct FilteringQueries listSourceTableSizeSQL[] = {
  * schema_prepare_pgcopydb_table_size creates a table named pgcopydb_table_size
  * on the given connection (typically, the source database). The creation is
  * skipped if the table already exists.
+ *
+ * When estimate is true, the table sizes are computed from pg_class.relpages
+ * rather than with pg_table_size(), which avoids a stat() system call per
+ * relation file on the source server. Use schema_set_table_sizes() to refine
+ * the estimates afterwards. The computedTableSize parameter is set to true
+ * when the table has been created here (rather than re-used).
  */
 bool
 schema_prepare_pgcopydb_table_size(PGSQL *pgsql,
@@ -571,8 +723,12 @@ schema_prepare_pgcopydb_table_size(PGSQL *pgsql,
 								   bool hasDBCreatePrivilege,
 								   bool cache,
 								   bool dropCache,
-								   bool *createdTableSizeTable)
+								   bool estimate,
+								   bool *createdTableSizeTable,
+								   bool *computedTableSize)
 {
+	*computedTableSize = false;
+
 	log_trace("schema_prepare_pgcopydb_table_size");
 
 	switch (filters->type)
@@ -660,16 +816,37 @@ schema_prepare_pgcopydb_table_size(PGSQL *pgsql,
 	}
 
 	char *tablename = "pgcopydb_table_size";
-	char sql[BUFSIZE] = { 0 };
+	char query[2 * BUFSIZE] = { 0 };
+	char sql[2 * BUFSIZE] = { 0 };
 	int len = 0;
 
+	if (estimate)
+	{
+		len = sformat(query, sizeof(query), TABLE_SIZE_ESTIMATE_SQL,
+					  listSourceTableSizeSQL[filters->type].sql);
+	}
+	else
+	{
+		len = sformat(query, sizeof(query), TABLE_SIZE_EXACT_SQL,
+					  listSourceTableSizeSQL[filters->type].sql);
+	}
+
+	if (sizeof(query) <= len)
+	{
+		log_error("Failed to prepare pgcopydb_table_size query "
+				  "buffer: %lld bytes are needed, we allocated %lld only",
+				  (long long) len,
+				  (long long) sizeof(query));
+		return false;
+	}
+
 	if (cache)
 	{
 		len =
 			sformat(sql, sizeof(sql),
 					"create table if not exists pgcopydb.%s as %s",
 					tablename,
-					listSourceTableSizeSQL[filters->type].sql);
+					query);
 	}
 	else
 	{
@@ -677,7 +854,7 @@ schema_prepare_pgcopydb_table_size(PGSQL *pgsql,
 			sformat(sql, sizeof(sql),
 					"create temp table %s  on commit drop as %s",
 					tablename,
-					listSourceTableSizeSQL[filters->type].sql);
+					query);
 	}
 
 	if (sizeof(sql) <= len)
@@ -705,6 +882,216 @@ schema_prepare_pgcopydb_table_size(PGSQL *pgsql,
 
 	/* we only consider that we created the cache when cache is true */
 	*createdTableSizeTable = cache;
+	*computedTableSize = true;
+
+	return true;
+}
+
+
+/*
+ * schema_list_table_size_estimates lists the OIDs of the relations found in
+ * the pgcopydb_table_size table for which we want to compute the exact size
+ * with pg_table_size(). Only the relations with a size estimate between
+ * lowBytes and highBytes are selected, and the relations where relpages can't
+ * be trusted: relations estimated to be empty, which includes relations that
+ * have never been vacuumed or analyzed, and relations where reltuples is -1
+ * (Postgres 14 and later). The bytes array is allocated and set to zero.
+ */
+bool
+schema_list_table_size_estimates(PGSQL *pgsql,
+								 uint64_t lowBytes,
+								 uint64_t highBytes,
+								 TableSizeArray *sizeArray)
+{
+	TableSizeArrayContext context = { { 0 }, sizeArray, false };
+
+	char *sql =
+		"  select ts.oid "
+		"    from pgcopydb_table_size ts "
+		"         join pg_catalog.pg_class c on c.oid = ts.oid "
+		"   where ts.bytes between $1 and $2 "
+		"      or ts.bytes = 0 "
+		"      or c.reltuples < 0 "
+		"order by ts.oid";
+
+	IntString lowString = intToString(lowBytes);
+	IntString highString = intToString(highBytes);
+
+	int paramCount = 2;
+	Oid paramTypes[2] = { INT8OID, INT8OID };
+	const char *paramValues[2] = {
+		lowString.strValue,
+		highString.strValue
+	};
+
+	if (!pgsql_execute_with_params(pgsql, sql,
+								   paramCount, paramTypes, paramValues,
+								   &context, &getTableSizeArray))
+	{
+		log_error("Failed to list table size estimates");
+		return false;
+	}
+
+	if (!context.parsedOk)
+	{
+		log_error("Failed to list table size estimates");
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * schema_get_table_sizes computes pg_table_size() for the given relations
+ * using a single query, and fills-in the sizeArray bytes array.
+ */
+bool
+schema_get_table_sizes(PGSQL *pgsql, TableSizeArray *sizeArray)
+{
+	TableSizeArrayContext context = { { 0 }, sizeArray, false };
+
+	if (sizeArray->count == 0)
+	{
+		return true;
+	}
+
+	PQExpBuffer oids = createPQExpBuffer();
+
+	if (!appendTableSizeOids(oids, sizeArray))
+	{
+		/* errors have already been logged */
+		destroyPQExpBuffer(oids);
+		return false;
+	}
+
+	char *sql =
+		"  select ($1::oid[])[i], coalesce(pg_table_size(($1::oid[])[i]), 0) "
+		"    from generate_subscripts($1::oid[], 1) as i "
+		"order by i";
+
+	int paramCount = 1;
+	Oid paramTypes[1] = { TEXTOID };
+	const char *paramValues[1] = { oids->data };
+
+	if (!pgsql_execute_with_params(pgsql, sql,
+								   paramCount, paramTypes, paramValues,
+								   &context, &getTableSizes))
+	{
+		log_error("Failed to compute table size for %d relations",
+				  sizeArray->count);
+		destroyPQExpBuffer(oids);
+		return false;
+	}
+
+	destroyPQExpBuffer(oids);
+
+	if (!context.parsedOk)
+	{
+		log_error("Failed to compute table size for %d relations",
+				  sizeArray->count);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * schema_set_table_sizes updates the pgcopydb_table_size table with the given
+ * sizes, using a single query.
+ */
+bool
+schema_set_table_sizes(PGSQL *pgsql, TableSizeArray *sizeArray)
+{
+	if (sizeArray->count == 0)
+	{
+		return true;
+	}
+
+	PQExpBuffer oids = createPQExpBuffer();
+	PQExpBuffer bytes = createPQExpBuffer();
+
+	if (!appendTableSizeOids(oids, sizeArray))
+	{
+		/* errors have already been logged */
+		destroyPQExpBuffer(oids);
+		destroyPQExpBuffer(bytes);
+		return false;
+	}
+
+	appendPQExpBufferStr(bytes, "{");
+
+	for (int i = 0; i < sizeArray->count; i++)
+	{
+		appendPQExpBuffer(bytes, "%s%lld",
+						  i == 0 ? "" : ",",
+						  (long long) sizeArray->bytes[i]);
+	}
+
+	appendPQExpBufferStr(bytes, "}");
+
+	if (PQExpBufferBroken(bytes))
+	{
+		log_error("Failed to prepare table size query: out of memory");
+		destroyPQExpBuffer(oids);
+		destroyPQExpBuffer(bytes);
+		return false;
+	}
+
+	char *sql =
+		"update pgcopydb_table_size ts "
+		"   set bytes = s.bytes "
+		"  from (select unnest($1::oid[]) as oid, "
+		"               unnest($2::bigint[]) as bytes) as s "
+		" where s.oid = ts.oid";
+
+	int paramCount = 2;
+	Oid paramTypes[2] = { TEXTOID, TEXTOID };
+	const char *paramValues[2] = { oids->data, bytes->data };
+
+	bool success = pgsql_execute_with_params(pgsql, sql,
+											 paramCount,
+											 paramTypes,
+											 paramValues,
+											 NULL, NULL);
+
+	if (!success)
+	{
+		log_error("Failed to update table size for %d relations",
+				  sizeArray->count);
+	}
+
+	destroyPQExpBuffer(oids);
+	destroyPQExpBuffer(bytes);
+
+	return success;
+}
+
+
+/*
+ * appendTableSizeOids appends the OIDs of the given array to the given buffer
+ * as a Postgres array literal.
+ */
+static bool
+appendTableSizeOids(PQExpBuffer buffer, TableSizeArray *sizeArray)
+{
+	appendPQExpBufferStr(buffer, "{");
+
+	for (int i = 0; i < sizeArray->count; i++)
+	{
+		appendPQExpBuffer(buffer, "%s%u",
+						  i == 0 ? "" : ",",
+						  sizeArray->oids[i]);
+	}
+
+	appendPQExpBufferStr(buffer, "}");
+
+	if (PQExpBufferBroken(buffer))
+	{
+		log_error("Failed to prepare table size query: out of memory");
+		return false;
+	}
 
 	return true;
 }
@@ -2081,36 +2468,69 @@ schema_get_sequence_value(PGSQL *pgsql, SourceSequence *seq)
 
 
 /*
- * schema_set_sequence_value calls pg_catalog.setval() on the given sequence.
+ * schema_get_sequence_privileges checks if the current role has been granted
+ * the SELECT privilege on all the sequences of the given array, using a single
+ * query. The granted array must have been allocated with sequenceArray->count
+ * entries.
  */
 bool
-schema_set_sequence_value(PGSQL *pgsql, SourceSequence *seq)
+schema_get_sequence_privileges(PGSQL *pgsql,
+							   SourceSequenceArray *sequenceArray,
+							   bool *granted)
 {
-	SingleValueResultContext parseContext = { { 0 }, PGSQL_RESULT_BIGINT, false };
-	char *sql = "select pg_catalog.setval(format('%I.%I', $1, $2), $3, $4)";
+	SequencePrivilegesContext context = { { 0 }, sequenceArray, granted, false };
 
-	int paramCount = 4;
-	Oid paramTypes[4] = { TEXTOID, TEXTOID, INT8OID, BOOLOID };
-	const char *paramValues[4];
+	if (sequenceArray->count == 0)
+	{
+		return true;
+	}
 
-	paramValues[0] = seq->nspname;
-	paramValues[1] = seq->relname;
-	paramValues[2] = intToString(seq->lastValue).strValue;
-	paramValues[3] = seq->isCalled ? "true" : "false";
+	PQExpBuffer oids = createPQExpBuffer();
+
+	appendPQExpBufferStr(oids, "{");
+
+	for (int i = 0; i < sequenceArray->count; i++)
+	{
+		appendPQExpBuffer(oids, "%s%u",
+						  i == 0 ? "" : ",",
+						  sequenceArray->array[i].oid);
+	}
+
+	appendPQExpBufferStr(oids, "}");
+
+	if (PQExpBufferBroken(oids))
+	{
+		log_error("Failed to prepare sequences privileges query: "
+				  "out of memory");
+		destroyPQExpBuffer(oids);
+		return false;
+	}
+
+	char *sql =
+		"select i, has_sequence_privilege(($1::oid[])[i], 'select') "
+		"  from generate_subscripts($1::oid[], 1) as i "
+		"order by i";
+
+	int paramCount = 1;
+	Oid paramTypes[1] = { TEXTOID };
+	const char *paramValues[1] = { oids->data };
 
 	if (!pgsql_execute_with_params(pgsql, sql,
 								   paramCount, paramTypes, paramValues,
-								   &parseContext, &parseSingleValueResult))
+								   &context, &getSequencePrivileges))
 	{
-		log_error("Failed to set sequence \"%s\".\"%s\" last value to %lld",
-				  seq->nspname, seq->relname, (long long) seq->lastValue);
+		log_error("Failed to query privileges for %d sequences",
+				  sequenceArray->count);
+		destroyPQExpBuffer(oids);
 		return false;
 	}
 
-	if (!parseContext.parsedOk)
+	destroyPQExpBuffer(oids);
+
+	if (!context.parsedOk)
 	{
-		log_error("Failed to set sequence \"%s\".\"%s\" last value to %lld",
-				  seq->nspname, seq->relname, (long long) seq->lastValue);
+		log_error("Failed to query privileges for %d sequences",
+				  sequenceArray->count);
 		return false;
 	}
 
@@ -2119,24 +2539,240 @@ schema_set_sequence_value(PGSQL *pgsql, SourceSequence *seq)
 
 
 /*
- * For code simplicity the index array is also the SourceFilterType enum value.
+ * schema_get_sequence_values fetches last_value and is_called for a batch of
+ * sequences using a single query, a UNION ALL of the per-sequence queries.
+ *
+ * When any of the sequences fails to be queried the whole query fails, and
+ * the current transaction is then aborted. Callers are expected to use a
+ * SAVEPOINT and fallback to schema_get_sequence_value() for each sequence.
  */
-struct FilteringQueries listSourceIndexesSQL[] = {
+bool
+schema_get_sequence_values(PGSQL *pgsql, SourceSequence **sequences, int count)
+{
+	SequenceValuesContext context = { { 0 }, sequences, count, false };
+
+	if (count == 0)
 	{
-		SOURCE_FILTER_TYPE_NONE,
+		return true;
+	}
 
-		"   select i.oid, n.nspname, i.relname,"
-		"          r.oid, rn.nspname, r.relname,"
-		"          indisprimary,"
-		"          indisunique,"
-		"          (select string_agg(attname, ',')"
-		"             from pg_attribute"
-		"            where attrelid = r.oid"
-		"              and array[attnum::integer] <@ indkey::integer[]"
-		"          ) as cols,"
-		"          pg_get_indexdef(indexrelid),"
-		"          c.oid,"
-		"          c.conname,"
+	PQExpBuffer sql = createPQExpBuffer();
+
+	for (int i = 0; i < count; i++)
+	{
+		SourceSequence *seq = sequences[i];
+
+		char *nspname =
+			PQescapeIdentifier(pgsql->connection,
+							   seq->nspname,
+							   strlen(seq->nspname));
+
+		char *relname =
+			PQescapeIdentifier(pgsql->connection,
+							   seq->relname,
+							   strlen(seq->relname));
+
+		if (nspname == NULL || relname == NULL)
+		{
+			log_error("Failed to get values from sequence \"%s\".\"%s\": %s",
+					  seq->nspname,
+					  seq->relname,
+					  PQerrorMessage(pgsql->connection));
+
+			PQfreemem(nspname);
+			PQfreemem(relname);
+			destroyPQExpBuffer(sql);
+
+			return false;
+		}
+
+		appendPQExpBuffer(sql,
+						  "%sselect %d, last_value, is_called from %s.%s",
+						  i == 0 ? "" : " union all ",
+						  i,
+						  nspname,
+						  relname);
+
+		PQfreemem(nspname);
+		PQfreemem(relname);
+	}
+
+	if (PQExpBufferBroken(sql))
+	{
+		log_error("Failed to prepare sequences values query: out of memory");
+		destroyPQExpBuffer(sql);
+		return false;
+	}
+
+	if (!pgsql_execute_with_params(pgsql, sql->data, 0, NULL, NULL,
+								   &context, &getSequenceValues))
+	{
+		log_error("Failed to retrieve values for %d sequences", count);
+		destroyPQExpBuffer(sql);
+		return false;
+	}
+
+	destroyPQExpBuffer(sql);
+
+	if (!context.parsedOk)
+	{
+		log_error("Failed to retrieve values for %d sequences", count);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * schema_set_sequence_values calls pg_catalog.setval() for a batch of
+ * sequences using a single query.
+ *
+ * When any of the setval() calls fails the whole query fails, and the current
+ * transaction is then aborted. Callers are expected to use a SAVEPOINT and
+ * fallback to schema_set_sequence_value() for each sequence.
+ */
+bool
+schema_set_sequence_values(PGSQL *pgsql, SourceSequence *sequences, int count)
+{
+	if (count == 0)
+	{
+		return true;
+	}
+
+	int paramCount = 4 * count;
+
+	Oid *paramTypes = (Oid *) calloc(paramCount, sizeof(Oid));
+	const char **paramValues =
+		(const char **) calloc(paramCount, sizeof(char *));
+	IntString *lastValues = (IntString *) calloc(count, sizeof(IntString));
+
+	PQExpBuffer sql = createPQExpBuffer();
+
+	if (paramTypes == NULL || paramValues == NULL || lastValues == NULL ||
+		sql == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+
+		free(paramTypes);
+		free(paramValues);
+		free(lastValues);
+		destroyPQExpBuffer(sql);
+
+		return false;
+	}
+
+	appendPQExpBufferStr(sql,
+						 "select pg_catalog.setval(format('%I.%I', n, r), v, c) "
+						 "from (values ");
+
+	for (int i = 0; i < count; i++)
+	{
+		SourceSequence *seq = &(sequences[i]);
+		int p = 4 * i;
+
+		lastValues[i] = intToString(seq->lastValue);
+
+		paramTypes[p] = TEXTOID;
+		paramTypes[p + 1] = TEXTOID;
+		paramTypes[p + 2] = INT8OID;
+		paramTypes[p + 3] = BOOLOID;
+
+		paramValues[p] = seq->nspname;
+		paramValues[p + 1] = seq->relname;
+		paramValues[p + 2] = lastValues[i].strValue;
+		paramValues[p + 3] = seq->isCalled ? "true" : "false";
+
+		appendPQExpBuffer(sql, "%s($%d, $%d, $%d, $%d)",
+						  i == 0 ? "" : ", ",
+						  p + 1, p + 2, p + 3, p + 4);
+	}
+
+	appendPQExpBufferStr(sql, ") as s(n, r, v, c)");
+
+	bool success = true;
+
+	if (PQExpBufferBroken(sql))
+	{
+		log_error("Failed to prepare sequences setval query: out of memory");
+		success = false;
+	}
+
+	if (success &&
+		!pgsql_execute_with_params(pgsql, sql->data,
+								   paramCount, paramTypes, paramValues,
+								   NULL, NULL))
+	{
+		log_error("Failed to set values for %d sequences", count);
+		success = false;
+	}
+
+	free(paramTypes);
+	free(paramValues);
+	free(lastValues);
+	destroyPQExpBuffer(sql);
+
+	return success;
+}
+
+
+/*
+ * schema_set_sequence_value calls pg_catalog.setval() on the given sequence.
+ */
+bool
+schema_set_sequence_value(PGSQL *pgsql, SourceSequence *seq)
+{
+	SingleValueResultContext parseContext = { { 0 }, PGSQL_RESULT_BIGINT, false };
+	char *sql = "select pg_catalog.setval(format('%I.%I', $1, $2), $3, $4)";
+
+	int paramCount = 4;
+	Oid paramTypes[4] = { TEXTOID, TEXTOID, INT8OID, BOOLOID };
+	const char *paramValues[4];
+
+	paramValues[0] = seq->nspname;
+	paramValues[1] = seq->relname;
+	paramValues[2] = intToString(seq->lastValue).strValue;
+	paramValues[3] = seq->isCalled ? "true" : "false";
+
+	if (!pgsql_execute_with_params(pgsql, sql,
+								   paramCount, paramTypes, paramValues,
+								   &parseContext, &parseSingleValueResult))
+	{
+		log_error("Failed to set sequence \"%s\".\"%s\" last value to %lld",
+				  seq->nspname, seq->relname, (long long) seq->lastValue);
+		return false;
+	}
+
+	if (!parseContext.parsedOk)
+	{
+		log_error("Failed to set sequence \"%s\".\"%s\" last value to %lld",
+				  seq->nspname, seq->relname, (long long) seq->lastValue);
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * For code simplicity the index array is also the SourceFilterType enum value.
+ */
+struct FilteringQueries listSourceIndexesSQL[] = {
+	{
+		SOURCE_FILTER_TYPE_NONE,
+
+		"   select i.oid, n.nspname, i.relname,"
+		"          r.oid, rn.nspname, r.relname,"
+		"          indisprimary,"
+		"          indisunique,"
+		"          (select string_agg(attname, ',')"
+		"             from pg_attribute"
+		"            where attrelid = r.oid"
+		"              and array[attnum::integer] <@ indkey::integer[]"
+		"          ) as cols,"
+		"          pg_get_indexdef(indexrelid),"
+		"          c.oid,"
+		"          c.conname,"
 		"          pg_get_constraintdef(c.oid),"
 		"          format('%s %s %s', "
 		"                 regexp_replace(n.nspname, '[\\n\\r]', ' '), "
@@ -2664,100 +3300,389 @@ schema_list_table_indexes(PGSQL *pgsql,
 
 
 /*
- * For code simplicity the index array is also the SourceFilterType enum value.
+ * schema_get_target_index_state fetches the definition, validity and size of
+ * the index with the given qualified name on the target database, if any.
  */
-struct FilteringQueries listSourceDependSQL[] = {
-	{
-		SOURCE_FILTER_TYPE_NONE, ""
-	},
+bool
+schema_get_target_index_state(PGSQL *pgsql,
+							  const char *nspname,
+							  const char *relname,
+							  TargetIndexState *state)
+{
+	TargetIndexStateContext context = { { 0 }, state, false };
 
-	{
-		SOURCE_FILTER_TYPE_INCL,
+	char *sql =
+		"   select pg_get_indexdef(x.indexrelid),"
+		"          x.indisvalid,"
+		"          x.indisready,"
+		"          pg_relation_size(x.indexrelid)"
+		"     from pg_index x"
+		"          join pg_class i ON i.oid = x.indexrelid"
+		"          join pg_namespace n ON n.oid = i.relnamespace"
+		"    where n.nspname = $1 and i.relname = $2";
 
-		PG_DEPEND_SQL
-		"  SELECT n.nspname, c.relname, "
-		"         refclassid, refobjid, classid, objid, "
-		"         deptype, type, identity "
-		"    FROM unconcat "
+	int paramCount = 2;
+	Oid paramTypes[2] = { TEXTOID, TEXTOID };
+	const char *paramValues[2] = { nspname, relname };
 
-		/* include-only-schema and include-only-table */
-		"         join pg_class c "
-		"           on unconcat.refclassid = 'pg_class'::regclass "
-		"          and unconcat.refobjid = c.oid "
+	log_trace("schema_get_target_index_state");
 
-		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid "
+	if (!pgsql_execute_with_params(pgsql, sql,
+								   paramCount, paramTypes, paramValues,
+								   &context, &getTargetIndexState))
+	{
+		log_error("Failed to fetch state of index \"%s\".\"%s\"",
+				  nspname, relname);
+		return false;
+	}
 
-		/* include-only-schema */
-		"         left join pg_temp.filter_include_only_schema fn "
-		"                on n.nspname = fn.nspname "
+	if (!context.parsedOk)
+	{
+		log_error("Failed to fetch state of index \"%s\".\"%s\"",
+				  nspname, relname);
+		return false;
+	}
 
-		/* include-only-table */
-		"         left join pg_temp.filter_include_only_table ft "
-		"                on n.nspname = ft.nspname "
-		"               and c.relname = ft.relname "
+	return true;
+}
 
-		"         , pg_identify_object(classid, objid, objsubid) "
 
-		"   WHERE NOT (refclassid = classid AND refobjid = objid) "
+/*
+ * schema_list_unique_relations fetches the list of tables that have a unique
+ * index or an exclusion constraint other than their replica identity. When
+ * the replica identity is FULL, the primary key is such an index too.
+ */
+bool
+schema_list_unique_relations(PGSQL *pgsql, TargetRelationArray *relationArray)
+{
+	TargetRelationArrayContext context = { { 0 }, relationArray, false };
+
+	char *sql =
+		"   select n.nspname, c.relname"
+		"     from pg_class c"
+		"          join pg_namespace n ON n.oid = c.relnamespace"
+		"    where c.relkind = 'r'"
 		"      and n.nspname !~ '^pg_' and n.nspname <> 'information_schema'"
-		"      and n.nspname !~ 'pgcopydb' "
-		"      and type not in ('toast table column', 'default value') "
-		"      and (fn.nspname is not null or ft.relname is not null)"
+		"      and exists("
+		"           select 1"
+		"             from pg_index x"
+		"            where x.indrelid = c.oid"
+		"              and (x.indisunique or x.indisexclusion)"
+		"              and not x.indisreplident"
+		"              and not (x.indisprimary and c.relreplident = 'd')"
+		"          )"
+		" order by n.nspname, c.relname";
+
+	log_trace("schema_list_unique_relations");
 
-		/* remove duplicates due to multiple refobjsubid / objsubid */
-		"GROUP BY n.nspname, c.relname, "
-		"         refclassid, refobjid, classid, objid, deptype, type, identity"
-	},
+	if (!pgsql_execute_with_params(pgsql, sql,
+								   0, NULL, NULL,
+								   &context, &getTargetRelationArray))
+	{
+		log_error("Failed to list tables with unique indexes");
+		return false;
+	}
 
+	if (!context.parsedOk)
 	{
-		SOURCE_FILTER_TYPE_EXCL,
+		log_error("Failed to list tables with unique indexes");
+		return false;
+	}
 
-		PG_DEPEND_SQL
-		"  SELECT n.nspname, relname, "
-		"         refclassid, refobjid, classid, objid, "
-		"         deptype, type, identity "
+	return true;
+}
 
-		"    FROM pg_namespace n "
 
-		/* exclude-schema */
-		"         join pg_temp.filter_exclude_schema fn "
-		"           on n.nspname = fn.nspname "
+/*
+ * The planner statistics of a table are transferred by generating on the
+ * source database the SQL commands that restore them on the target database,
+ * one pg_restore_attribute_stats() call per row in the pg_stats view.
+ *
+ * Postgres 17 added the range type statistics columns to pg_stats.
+ */
+#define TABLE_STATS_SQL_START \
+	"   select exists(select 1 from pg_statistic_ext e where e.stxrelid = c.oid)" \
+	"          or exists(select 1 from pg_index x " \
+	"                     where x.indrelid = c.oid and x.indexprs is not null)" \
+	"          or not exists(select 1 from pg_stats s " \
+	"                         where s.schemaname = n.nspname " \
+	"                           and s.tablename = c.relname)," \
+	"          (select string_agg(" \
+	"                    format('select pg_catalog.pg_restore_attribute_stats(" \
+	"''schemaname'', %L, ''relname'', %L, ''attname'', %L, " \
+	"''inherited'', %L::boolean, ''version'', %s::integer%s);', " \
+	"                           s.schemaname, s.tablename, s.attname, " \
+	"                           s.inherited, " \
+	"                           current_setting('server_version_num'), " \
+	"                           (select string_agg(format(', %L, %L::%s', " \
+	"                                                     k.key, k.val, k.typ)," \
+	"                                              '') " \
+	"                              from (values " \
+	"   ('null_frac', s.null_frac::text, 'real'), " \
+	"   ('avg_width', s.avg_width::text, 'integer'), " \
+	"   ('n_distinct', s.n_distinct::text, 'real'), " \
+	"   ('most_common_vals', s.most_common_vals::text, 'text'), " \
+	"   ('most_common_freqs', s.most_common_freqs::text, 'real[]'), " \
+	"   ('histogram_bounds', s.histogram_bounds::text, 'text'), " \
+	"   ('correlation', s.correlation::text, 'real'), " \
+	"   ('most_common_elems', s.most_common_elems::text, 'text'), " \
+	"   ('most_common_elem_freqs', s.most_common_elem_freqs::text, 'real[]'), " \
+	"   ('elem_count_histogram', s.elem_count_histogram::text, 'real[]')"
+
+#define TABLE_STATS_SQL_RANGE \
+	" , ('range_length_histogram', s.range_length_histogram::text, 'text'), " \
+	"   ('range_empty_frac', s.range_empty_frac::text, 'real'), " \
+	"   ('range_bounds_histogram', s.range_bounds_histogram::text, 'text')"
+
+#define TABLE_STATS_SQL_END \
+	"                                   ) as k(key, val, typ) " \
+	"                             where k.val is not null)), " \
+	"                    ' ') " \
+	"             from pg_stats s " \
+	"            where s.schemaname = n.nspname and s.tablename = c.relname)" \
+	"     from pg_class c " \
+	"          join pg_namespace n on n.oid = c.relnamespace " \
+	"    where c.oid = $1"
 
-		"         left join unconcat "
-		"           on unconcat.refclassid = 'pg_namespace'::regclass "
-		"          and unconcat.refobjid = n.oid "
 
-		"         left join pg_class c "
-		"           on unconcat.classid = 'pg_class'::regclass "
-		"          and unconcat.objid = c.oid "
+/*
+ * schema_prepare_table_stats fetches the planner statistics of the given
+ * table on the source database, in the form of a SQL script to run on the
+ * target database. The statistics are read from the pg_stats view, so that
+ * they are consistent with the current transaction snapshot.
+ */
+bool
+schema_prepare_table_stats(PGSQL *pgsql, uint32_t oid, SourceTableStats *stats)
+{
+	SourceTableStatsContext context = { { 0 }, stats, false };
 
-		"         , pg_identify_object(classid, objid, objsubid) "
+	char *sql = NULL;
 
-		/* remove duplicates due to multiple refobjsubid / objsubid */
-		"GROUP BY n.nspname, c.relname, "
-		"         refclassid, refobjid, classid, objid, deptype, type, identity"
+	if (!pgsql_server_version(pgsql))
+	{
+		/* errors have already been logged */
+		return false;
+	}
 
-		" UNION ALL "
-		" ( "
-		"  SELECT n.nspname, null as relname, "
-		"         null as refclassid, null as refobjid, "
-		"         'pg_namespace'::regclass::oid as classid, n.oid as objid, "
-		"         null as deptype, type, identity "
+	/* pg_statistic_ext has been added in Postgres 10 */
+	if (pgsql->pgversion_num < 100000)
+	{
+		stats->needsAnalyze = true;
+		return true;
+	}
+	else if (pgsql->pgversion_num < 170000)
+	{
+		sql = TABLE_STATS_SQL_START TABLE_STATS_SQL_END;
+	}
+	else
+	{
+		sql = TABLE_STATS_SQL_START TABLE_STATS_SQL_RANGE TABLE_STATS_SQL_END;
+	}
 
-		"    FROM pg_namespace n "
+	IntString oidString = intToString(oid);
 
-		/* exclude-schema */
-		"         join pg_temp.filter_exclude_schema fn "
-		"           on n.nspname = fn.nspname "
+	int paramCount = 1;
+	Oid paramTypes[1] = { OIDOID };
+	const char *paramValues[1] = { oidString.strValue };
 
-		"         , pg_identify_object('pg_namespace'::regclass, n.oid, 0) "
-		" ) "
+	log_trace("schema_prepare_table_stats");
 
-		" UNION ALL "
-		" ( "
+	if (!pgsql_execute_with_params(pgsql, sql,
+								   paramCount, paramTypes, paramValues,
+								   &context, &getTableStats))
+	{
+		log_error("Failed to fetch statistics for table with oid %u", oid);
+		return false;
+	}
 
-		"  SELECT cn.nspname, c.relname, "
-		"         refclassid, refobjid, classid, objid, "
+	if (!context.parsedOk)
+	{
+		log_error("Failed to fetch statistics for table with oid %u", oid);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * schema_list_blob_ranges splits the large objects found on the source
+ * database in rangeCount ranges of OIDs that each contain the same count of
+ * large objects.
+ *
+ * The ranges are then made contiguous and cover the whole OID space, so that
+ * large objects created after the ranges have been computed are still copied,
+ * as happens with --not-consistent or when resuming operations.
+ */
+bool
+schema_list_blob_ranges(PGSQL *pgsql, int rangeCount, BlobRangeArray *rangeArray)
+{
+	BlobRangeArrayContext context = { { 0 }, rangeArray, false };
+
+	char *sql =
+		"  select n, min(oid), max(oid)"
+		"    from ("
+		"           select oid, ntile($1) over(order by oid) as n"
+		"             from pg_largeobject_metadata"
+		"         ) as blobs"
+		" group by n"
+		" order by n";
+
+	IntString countString = intToString(rangeCount);
+
+	int paramCount = 1;
+	Oid paramTypes[1] = { INT4OID };
+	const char *paramValues[1] = { countString.strValue };
+
+	log_trace("schema_list_blob_ranges");
+
+	if (!pgsql_execute_with_params(pgsql, sql,
+								   paramCount, paramTypes, paramValues,
+								   &context, &getBlobRangeArray))
+	{
+		log_error("Failed to list large objects ranges");
+		return false;
+	}
+
+	if (!context.parsedOk)
+	{
+		log_error("Failed to list large objects ranges");
+		return false;
+	}
+
+	/* no large objects yet, still copy the ones that might be created */
+	if (rangeArray->count == 0)
+	{
+		free(rangeArray->array);
+		rangeArray->array = (BlobRange *) calloc(1, sizeof(BlobRange));
+
+		if (rangeArray->array == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			return false;
+		}
+
+		rangeArray->count = 1;
+		rangeArray->array[0].number = 1;
+	}
+
+	for (int r = 0; r < rangeArray->count; r++)
+	{
+		BlobRange *range = &(rangeArray->array[r]);
+
+		if (r == 0)
+		{
+			range->min = 0;
+		}
+
+		if (r == rangeArray->count - 1)
+		{
+			range->max = UINT32_MAX;
+		}
+		else
+		{
+			range->max = rangeArray->array[r + 1].min - 1;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * For code simplicity the index array is also the SourceFilterType enum value.
+ */
+struct FilteringQueries listSourceDependSQL[] = {
+	{
+		SOURCE_FILTER_TYPE_NONE, ""
+	},
+
+	{
+		SOURCE_FILTER_TYPE_INCL,
+
+		PG_DEPEND_SQL
+		"  SELECT n.nspname, c.relname, "
+		"         refclassid, refobjid, classid, objid, "
+		"         deptype, type, identity "
+		"    FROM unconcat "
+
+		/* include-only-schema and include-only-table */
+		"         join pg_class c "
+		"           on unconcat.refclassid = 'pg_class'::regclass "
+		"          and unconcat.refobjid = c.oid "
+
+		"         join pg_catalog.pg_namespace n on c.relnamespace = n.oid "
+
+		/* include-only-schema */
+		"         left join pg_temp.filter_include_only_schema fn "
+		"                on n.nspname = fn.nspname "
+
+		/* include-only-table */
+		"         left join pg_temp.filter_include_only_table ft "
+		"                on n.nspname = ft.nspname "
+		"               and c.relname = ft.relname "
+
+		"         , pg_identify_object(classid, objid, objsubid) "
+
+		"   WHERE NOT (refclassid = classid AND refobjid = objid) "
+		"      and n.nspname !~ '^pg_' and n.nspname <> 'information_schema'"
+		"      and n.nspname !~ 'pgcopydb' "
+		"      and type not in ('toast table column', 'default value') "
+		"      and (fn.nspname is not null or ft.relname is not null)"
+
+		/* remove duplicates due to multiple refobjsubid / objsubid */
+		"GROUP BY n.nspname, c.relname, "
+		"         refclassid, refobjid, classid, objid, deptype, type, identity"
+	},
+
+	{
+		SOURCE_FILTER_TYPE_EXCL,
+
+		PG_DEPEND_SQL
+		"  SELECT n.nspname, relname, "
+		"         refclassid, refobjid, classid, objid, "
+		"         deptype, type, identity "
+
+		"    FROM pg_namespace n "
+
+		/* exclude-schema */
+		"         join pg_temp.filter_exclude_schema fn "
+		"           on n.nspname = fn.nspname "
+
+		"         left join unconcat "
+		"           on unconcat.refclassid = 'pg_namespace'::regclass "
+		"          and unconcat.refobjid = n.oid "
+
+		"         left join pg_class c "
+		"           on unconcat.classid = 'pg_class'::regclass "
+		"          and unconcat.objid = c.oid "
+
+		"         , pg_identify_object(classid, objid, objsubid) "
+
+		/* remove duplicates due to multiple refobjsubid / objsubid */
+		"GROUP BY n.nspname, c.relname, "
+		"         refclassid, refobjid, classid, objid, deptype, type, identity"
+
+		" UNION ALL "
+		" ( "
+		"  SELECT n.nspname, null as relname, "
+		"         null as refclassid, null as refobjid, "
+		"         'pg_namespace'::regclass::oid as classid, n.oid as objid, "
+		"         null as deptype, type, identity "
+
+		"    FROM pg_namespace n "
+
+		/* exclude-schema */
+		"         join pg_temp.filter_exclude_schema fn "
+		"           on n.nspname = fn.nspname "
+
+		"         , pg_identify_object('pg_namespace'::regclass, n.oid, 0) "
+		" ) "
+
+		" UNION ALL "
+		" ( "
+
+		"  SELECT cn.nspname, c.relname, "
+		"         refclassid, refobjid, classid, objid, "
 		"         deptype, type, identity "
 		"    FROM unconcat "
 
@@ -2993,6 +3918,11 @@ schema_list_pg_depend(PGSQL *pgsql,
 /*
  * schema_list_partitions prepares the list of partitions that we can drive
  * from our parameters: table size, --split-tables-larger-than.
+ *
+ * The number of parts is computed from the table size that we already have
+ * in table->bytes, so that this function does not depend on the session
+ * where the pgcopydb_table_size table has been prepared, and can be used
+ * from several connections sharing the same snapshot.
  */
 bool
 schema_list_partitions(PGSQL *pgsql, SourceTable *table, uint64_t partSize)
@@ -3022,13 +3952,7 @@ schema_list_partitions(PGSQL *pgsql, SourceTable *table, uint64_t partSize)
 		" ), "
 		" t (parts) as "
 		" ( "
-		"   select ceil(bytes::float / $1) as parts "
-		"     from pgcopydb_table_size "
-		"     where oid = $2 "
-		"	union all "
-		"	select 1 as parts "
-		"	order by parts desc "
-		"	limit 1 "
+		"   select $1::bigint as parts "
 		" ), "
 		" ranges(n, parts, a, b) as "
 		" ( "
@@ -3052,12 +3976,19 @@ schema_list_partitions(PGSQL *pgsql, SourceTable *table, uint64_t partSize)
 			table->nspname, table->relname,
 			table->nspname, table->relname);
 
-	int paramCount = 2;
-	Oid paramTypes[2] = { INT8OID, OIDOID };
-	const char *paramValues[2];
+	/* ceil(bytes / partSize), and at least one part */
+	int64_t parts = (int64_t) ((table->bytes + partSize - 1) / partSize);
+
+	if (parts < 1)
+	{
+		parts = 1;
+	}
+
+	IntString partsString = intToString(parts);
 
-	paramValues[0] = intToString(partSize).strValue;
-	paramValues[1] = intToString(table->oid).strValue;
+	int paramCount = 1;
+	Oid paramTypes[1] = { INT8OID };
+	const char *paramValues[1] = { partsString.strValue };
 
 	if (!pgsql_execute_with_params(pgsql, sql,
 								   paramCount, paramTypes, paramValues,
@@ -4177,6 +5108,216 @@ getSequenceArray(void *ctx, PGresult *result)
 }
 
 
+/*
+ * getTableSizeArray loops over the OIDs returned by the table size estimates
+ * query and allocates the TableSizeArray.
+ */
+static void
+getTableSizeArray(void *ctx, PGresult *result)
+{
+	TableSizeArrayContext *context = (TableSizeArrayContext *) ctx;
+	TableSizeArray *sizeArray = context->sizeArray;
+	int nTuples = PQntuples(result);
+
+	if (PQnfields(result) != 1)
+	{
+		log_error("Query returned %d columns, expected 1", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	sizeArray->count = nTuples;
+	sizeArray->oids = (uint32_t *) calloc(nTuples + 1, sizeof(uint32_t));
+	sizeArray->bytes = (int64_t *) calloc(nTuples + 1, sizeof(int64_t));
+
+	if (sizeArray->oids == NULL || sizeArray->bytes == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		context->parsedOk = false;
+		return;
+	}
+
+	int errors = 0;
+
+	for (int rowNumber = 0; rowNumber < nTuples; rowNumber++)
+	{
+		char *value = PQgetvalue(result, rowNumber, 0);
+
+		if (!stringToUInt32(value, &(sizeArray->oids[rowNumber])))
+		{
+			log_error("Invalid OID \"%s\"", value);
+			++errors;
+		}
+	}
+
+	context->parsedOk = errors == 0;
+}
+
+
+/*
+ * getTableSizes loops over the results of the pg_table_size() query, where
+ * rows are ordered the same as the given TableSizeArray.
+ */
+static void
+getTableSizes(void *ctx, PGresult *result)
+{
+	TableSizeArrayContext *context = (TableSizeArrayContext *) ctx;
+	TableSizeArray *sizeArray = context->sizeArray;
+	int nTuples = PQntuples(result);
+
+	if (PQnfields(result) != 2)
+	{
+		log_error("Query returned %d columns, expected 2", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	if (nTuples != sizeArray->count)
+	{
+		log_error("Query returned %d rows, expected %d",
+				  nTuples,
+				  sizeArray->count);
+		context->parsedOk = false;
+		return;
+	}
+
+	int errors = 0;
+
+	for (int rowNumber = 0; rowNumber < nTuples; rowNumber++)
+	{
+		uint32_t oid = 0;
+		char *value = PQgetvalue(result, rowNumber, 0);
+
+		if (!stringToUInt32(value, &oid) || oid != sizeArray->oids[rowNumber])
+		{
+			log_error("Invalid OID \"%s\", expected %u",
+					  value,
+					  sizeArray->oids[rowNumber]);
+			++errors;
+			continue;
+		}
+
+		value = PQgetvalue(result, rowNumber, 1);
+
+		if (!stringToInt64(value, &(sizeArray->bytes[rowNumber])))
+		{
+			log_error("Invalid table size \"%s\"", value);
+			++errors;
+		}
+	}
+
+	context->parsedOk = errors == 0;
+}
+
+
+/*
+ * getSequencePrivileges loops over the results of the sequences privileges
+ * query, where rows are ordered the same as the sequence array.
+ */
+static void
+getSequencePrivileges(void *ctx, PGresult *result)
+{
+	SequencePrivilegesContext *context = (SequencePrivilegesContext *) ctx;
+	int nTuples = PQntuples(result);
+
+	if (PQnfields(result) != 2)
+	{
+		log_error("Query returned %d columns, expected 2", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	if (nTuples != context->sequenceArray->count)
+	{
+		log_error("Query returned %d rows, expected %d",
+				  nTuples,
+				  context->sequenceArray->count);
+		context->parsedOk = false;
+		return;
+	}
+
+	int errors = 0;
+
+	for (int rowNumber = 0; rowNumber < nTuples; rowNumber++)
+	{
+		int index = 0;
+		char *value = PQgetvalue(result, rowNumber, 0);
+
+		if (!stringToInt(value, &index) ||
+			index < 1 ||
+			index > context->sequenceArray->count)
+		{
+			log_error("Invalid sequence array index \"%s\"", value);
+			++errors;
+			continue;
+		}
+
+		value = PQgetvalue(result, rowNumber, 1);
+		context->granted[index - 1] = (*value) == 't';
+	}
+
+	context->parsedOk = errors == 0;
+}
+
+
+/*
+ * getSequenceValues loops over the results of the sequences values query,
+ * where the first column is the index of the sequence in the current batch.
+ */
+static void
+getSequenceValues(void *ctx, PGresult *result)
+{
+	SequenceValuesContext *context = (SequenceValuesContext *) ctx;
+	int nTuples = PQntuples(result);
+
+	if (PQnfields(result) != 3)
+	{
+		log_error("Query returned %d columns, expected 3", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	if (nTuples != context->count)
+	{
+		log_error("Query returned %d rows, expected %d",
+				  nTuples,
+				  context->count);
+		context->parsedOk = false;
+		return;
+	}
+
+	int errors = 0;
+
+	for (int rowNumber = 0; rowNumber < nTuples; rowNumber++)
+	{
+		int index = 0;
+		char *value = PQgetvalue(result, rowNumber, 0);
+
+		if (!stringToInt(value, &index) || index < 0 || index >= context->count)
+		{
+			log_error("Invalid sequence batch index \"%s\"", value);
+			++errors;
+			continue;
+		}
+
+		SourceSequence *seq = context->sequences[index];
+
+		value = PQgetvalue(result, rowNumber, 1);
+
+		if (!stringToInt64(value, &(seq->lastValue)))
+		{
+			log_error("Invalid sequence last_value \"%s\"", value);
+			++errors;
+		}
+
+		value = PQgetvalue(result, rowNumber, 2);
+		seq->isCalled = (*value) == 't';
+	}
+
+	context->parsedOk = errors == 0;
+}
+
+
 /*
  * parseCurrentSourceSequence parses a single row of the table listing query
  * result.
@@ -4500,6 +5641,239 @@ parseCurrentSourceIndex(PGresult *result, int rowNumber, SourceIndex *index)
 }
 
 
+/*
+ * getTargetIndexState parses the result of the target index state query,
+ * which returns either zero or one row.
+ */
+static void
+getTargetIndexState(void *ctx, PGresult *result)
+{
+	TargetIndexStateContext *context = (TargetIndexStateContext *) ctx;
+	TargetIndexState *state = context->state;
+	int nTuples = PQntuples(result);
+
+	if (PQnfields(result) != 4)
+	{
+		log_error("Query returned %d columns, expected 4", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	state->exists = nTuples == 1;
+
+	if (!state->exists)
+	{
+		context->parsedOk = true;
+		return;
+	}
+
+	int errors = 0;
+
+	/* 1. pg_get_indexdef */
+	char *value = PQgetvalue(result, 0, 0);
+	int length = strlen(value) + 1;
+	state->indexDef = (char *) calloc(length, sizeof(char));
+
+	if (state->indexDef == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		context->parsedOk = false;
+		return;
+	}
+
+	strlcpy(state->indexDef, value, length);
+
+	/* 2. indisvalid */
+	value = PQgetvalue(result, 0, 1);
+	state->isValid = (*value) == 't';
+
+	/* 3. indisready */
+	value = PQgetvalue(result, 0, 2);
+	state->isReady = (*value) == 't';
+
+	/* 4. pg_relation_size */
+	value = PQgetvalue(result, 0, 3);
+
+	if (!stringToInt64(value, &(state->bytes)))
+	{
+		log_error("Invalid index size \"%s\"", value);
+		++errors;
+	}
+
+	context->parsedOk = errors == 0;
+}
+
+/*
+ * getTableStats parses the result of the table statistics query, which
+ * returns a single row.
+ */
+static void
+getTableStats(void *ctx, PGresult *result)
+{
+	SourceTableStatsContext *context = (SourceTableStatsContext *) ctx;
+	SourceTableStats *stats = context->stats;
+
+	if (PQnfields(result) != 2)
+	{
+		log_error("Query returned %d columns, expected 2", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	if (PQntuples(result) != 1)
+	{
+		log_error("Query returned %d rows, expected 1", PQntuples(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	/* 1. needsAnalyze */
+	char *value = PQgetvalue(result, 0, 0);
+	stats->needsAnalyze = (*value) == 't';
+
+	/* 2. restoreSQL, NULL when the table has no statistics */
+	if (!PQgetisnull(result, 0, 1))
+	{
+		value = PQgetvalue(result, 0, 1);
+
+		int length = strlen(value) + 1;
+		stats->restoreSQL = (char *) calloc(length, sizeof(char));
+
+		if (stats->restoreSQL == NULL)
+		{
+			log_fatal(ALLOCATION_FAILED_ERROR);
+			context->parsedOk = false;
+			return;
+		}
+
+		strlcpy(stats->restoreSQL, value, length);
+	}
+
+	context->parsedOk = true;
+}
+
+/*
+ * getTargetRelationArray loops over the SQL result for the tables with extra
+ * unique indexes query and allocates an array of TargetRelation.
+ */
+static void
+getTargetRelationArray(void *ctx, PGresult *result)
+{
+	TargetRelationArrayContext *context = (TargetRelationArrayContext *) ctx;
+	int nTuples = PQntuples(result);
+
+	if (PQnfields(result) != 2)
+	{
+		log_error("Query returned %d columns, expected 2", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	context->relationArray->count = nTuples;
+	context->relationArray->array =
+		(TargetRelation *) calloc(nTuples, sizeof(TargetRelation));
+
+	if (nTuples > 0 && context->relationArray->array == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return;
+	}
+
+	int errors = 0;
+
+	for (int rowNumber = 0; rowNumber < nTuples; rowNumber++)
+	{
+		TargetRelation *relation = &(context->relationArray->array[rowNumber]);
+
+		char *value = PQgetvalue(result, rowNumber, 0);
+		int length = strlcpy(relation->nspname, value, NAMEDATALEN);
+
+		if (length >= NAMEDATALEN)
+		{
+			log_error("Schema name \"%s\" is %d bytes long, "
+					  "the maximum expected is %d (NAMEDATALEN - 1)",
+					  value, length, NAMEDATALEN - 1);
+			++errors;
+		}
+
+		value = PQgetvalue(result, rowNumber, 1);
+		length = strlcpy(relation->relname, value, NAMEDATALEN);
+
+		if (length >= NAMEDATALEN)
+		{
+			log_error("Table name \"%s\" is %d bytes long, "
+					  "the maximum expected is %d (NAMEDATALEN - 1)",
+					  value, length, NAMEDATALEN - 1);
+			++errors;
+		}
+	}
+
+	context->parsedOk = errors == 0;
+}
+
+
+/*
+ * getBlobRangeArray loops over the SQL result for the large objects ranges
+ * query and allocates an array of BlobRange.
+ */
+static void
+getBlobRangeArray(void *ctx, PGresult *result)
+{
+	BlobRangeArrayContext *context = (BlobRangeArrayContext *) ctx;
+	int nTuples = PQntuples(result);
+
+	if (PQnfields(result) != 3)
+	{
+		log_error("Query returned %d columns, expected 3", PQnfields(result));
+		context->parsedOk = false;
+		return;
+	}
+
+	context->rangeArray->count = nTuples;
+	context->rangeArray->array =
+		(BlobRange *) calloc(nTuples, sizeof(BlobRange));
+
+	if (nTuples > 0 && context->rangeArray->array == NULL)
+	{
+		log_fatal(ALLOCATION_FAILED_ERROR);
+		return;
+	}
+
+	int errors = 0;
+
+	for (int rowNumber = 0; rowNumber < nTuples; rowNumber++)
+	{
+		BlobRange *range = &(context->rangeArray->array[rowNumber]);
+
+		char *value = PQgetvalue(result, rowNumber, 0);
+
+		if (!stringToInt(value, &(range->number)))
+		{
+			log_error("Invalid large objects range number \"%s\"", value);
+			++errors;
+		}
+
+		value = PQgetvalue(result, rowNumber, 1);
+
+		if (!stringToUInt32(value, &(range->min)))
+		{
+			log_error("Invalid large object OID \"%s\"", value);
+			++errors;
+		}
+
+		value = PQgetvalue(result, rowNumber, 2);
+
+		if (!stringToUInt32(value, &(range->max)))
+		{
+			log_error("Invalid large object OID \"%s\"", value);
+			++errors;
+		}
+	}
+
+	context->parsedOk = errors == 0;
+}
+
+
 /*
  * getDependArray loops over the SQL result for the table dependencies array
  * query and allocates an array of tables then populates it with the query
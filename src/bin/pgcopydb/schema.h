@@ -172,6 +172,18 @@ typedef struct SourceTableArray
 } SourceTableArray;
 
 
+/*
+ * TableSizeArray is used to compute pg_table_size() for a list of relations,
+ * possibly in parallel, and to update the pgcopydb_table_size table.
+ */
+typedef struct TableSizeArray
+{
+	int count;
+	uint32_t *oids;             /* malloc'ed area */
+	int64_t *bytes;             /* malloc'ed area */
+} TableSizeArray;
+
+
 /*
  * SourceSequence caches the information we need about all the sequences found
  * in the source database.
@@ -235,6 +247,73 @@ typedef struct SourceIndexList
 } SourceIndexList;
 
 
+/*
+ * TargetIndexState describes an index found on the target database with the
+ * same qualified name as a SourceIndex, and allows deciding if the index build
+ * can be skipped (same definition, valid, non-empty) or must be done again.
+ */
+typedef struct TargetIndexState
+{
+	bool exists;
+	bool isValid;
+	bool isReady;
+	int64_t bytes;
+	char *indexDef;             /* malloc'ed area */
+} TargetIndexState;
+
+
+/*
+ * TargetRelation is a table on the target database that has a unique index or
+ * an exclusion constraint other than its replica identity.
+ */
+typedef struct TargetRelation
+{
+	char nspname[NAMEDATALEN];
+	char relname[NAMEDATALEN];
+} TargetRelation;
+
+
+typedef struct TargetRelationArray
+{
+	int count;
+	TargetRelation *array;      /* malloc'ed area */
+} TargetRelationArray;
+
+
+/*
+ * SourceTableStats holds the SQL script that restores the planner statistics
+ * of a source table on a target database, using pg_restore_attribute_stats().
+ * When the source table has statistics that we can't transfer that way, such
+ * as extended statistics or expression indexes statistics, or when it has not
+ * been analyzed at all, then needsAnalyze is true.
+ */
+typedef struct SourceTableStats
+{
+	bool needsAnalyze;
+	char *restoreSQL;           /* malloc'ed area */
+} SourceTableStats;
+
+
+/*
+ * BlobRange is a range of large objects OIDs on the source database, so that
+ * large objects can be copied by several processes in parallel. The ranges
+ * are contiguous and cover the whole OID space.
+ */
+typedef struct BlobRange
+{
+	int number;
+	uint32_t min;               /* WHERE oid >= min */
+	uint32_t max;               /*   AND oid <= max */
+} BlobRange;
+
+
+typedef struct BlobRangeArray
+{
+	int count;
+	BlobRange *array;           /* malloc'ed area */
+} BlobRangeArray;
+
+
 /*
  * SourceDepend caches the information about the dependency graph of
  * filtered-out objects. When filtering-out a table, we want to also filter-out
@@ -266,6 +345,8 @@ bool schema_query_privileges(PGSQL *pgsql,
 							 bool *hasDBCreatePrivilage,
 							 bool *hasDBTempPrivilege);
 
+bool schema_get_system_identifier(PGSQL *pgsql, char *sysid, size_t size);
+
 bool schema_list_catalogs(PGSQL *pgsql, SourceCatalogArray *catArray);
 
 bool schema_list_ext_schemas(PGSQL *pgsql, SourceSchemaArray *array);
@@ -279,10 +360,20 @@ bool schema_prepare_pgcopydb_table_size(PGSQL *pgsql,
 										bool hasDBCreatePrivilege,
 										bool cache,
 										bool dropCache,
-										bool *createdTableSizeTable);
+										bool estimate,
+										bool *createdTableSizeTable,
+										bool *computedTableSize);
 
 bool schema_drop_pgcopydb_table_size(PGSQL *pgsql);
 
+bool schema_list_table_size_estimates(PGSQL *pgsql,
+									  uint64_t lowBytes,
+									  uint64_t highBytes,
+									  TableSizeArray *sizeArray);
+
+bool schema_get_table_sizes(PGSQL *pgsql, TableSizeArray *sizeArray);
+bool schema_set_table_sizes(PGSQL *pgsql, TableSizeArray *sizeArray);
+
 bool schema_list_ordinary_tables(PGSQL *pgsql,
 								 SourceFilters *filters,
 								 SourceTableArray *tableArray);
@@ -300,6 +391,18 @@ bool schema_list_sequences(PGSQL *pgsql,
 bool schema_get_sequence_value(PGSQL *pgsql, SourceSequence *seq);
 bool schema_set_sequence_value(PGSQL *pgsql, SourceSequence *seq);
 
+bool schema_get_sequence_privileges(PGSQL *pgsql,
+									SourceSequenceArray *sequenceArray,
+									bool *granted);
+
+bool schema_get_sequence_values(PGSQL *pgsql,
+								SourceSequence **sequences,
+								int count);
+
+bool schema_set_sequence_values(PGSQL *pgsql,
+								SourceSequence *sequences,
+								int count);
+
 bool schema_list_all_indexes(PGSQL *pgsql,
 							 SourceFilters *filters,
 							 SourceIndexArray *indexArray);
@@ -309,6 +412,22 @@ bool schema_list_table_indexes(PGSQL *pgsql,
 							   const char *tableName,
 							   SourceIndexArray *indexArray);
 
+bool schema_get_target_index_state(PGSQL *pgsql,
+								   const char *nspname,
+								   const char *relname,
+								   TargetIndexState *state);
+
+bool schema_list_unique_relations(PGSQL *pgsql,
+								  TargetRelationArray *relationArray);
+
+bool schema_prepare_table_stats(PGSQL *pgsql,
+								uint32_t oid,
+								SourceTableStats *stats);
+
+bool schema_list_blob_ranges(PGSQL *pgsql,
+							 int rangeCount,
+							 BlobRangeArray *rangeArray);
+
 bool schema_list_pg_depend(PGSQL *pgsql,
 						   SourceFilters *filters,
 						   SourceDependArray *dependArray);
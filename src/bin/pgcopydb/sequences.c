@@ -23,7 +23,8 @@
 /*
  * sequence_prepare_specs fetches the list of sequences at pgsql connection,
  * using the filtering already prepared in the connection (as temp tables).
- * Then the function loops over the sequences to fetch their current values.
+ * Then the function fetches the sequences current values, in batches of
+ * SEQUENCE_BATCH_SIZE sequences per query.
  */
 bool
 copydb_prepare_sequence_specs(CopyDataSpec *specs, PGSQL *pgsql)
@@ -38,62 +39,156 @@ copydb_prepare_sequence_specs(CopyDataSpec *specs, PGSQL *pgsql)
 
 	log_info("Fetching information for %d sequences", sequenceArray->count);
 
+	if (sequenceArray->count == 0)
+	{
+		return true;
+	}
+
+	/*
+	 * In case of "permission denied" for SELECT on the sequence object, we
+	 * would then have a broken transaction and all the rest of the queries
+	 * would get the following:
+	 *
+	 * ERROR: current transaction is aborted, commands ignored
+	 * until end of transaction block
+	 *
+	 * To avoid that, we first see if we're granted the SELECT privilege on
+	 * all the sequences, using a single query.
+	 */
+	bool *granted = (bool *) calloc(sequenceArray->count, sizeof(bool));
+	SourceSequence **batch =
+		(SourceSequence **) calloc(SEQUENCE_BATCH_SIZE, sizeof(SourceSequence *));
+
+	if (granted == NULL || batch == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		free(granted);
+		free(batch);
+		return false;
+	}
+
+	if (!schema_get_sequence_privileges(pgsql, sequenceArray, granted))
+	{
+		/* errors have already been logged */
+		free(granted);
+		free(batch);
+		return false;
+	}
+
 	int errors = 0;
+	int batchCount = 0;
 
 	for (int seqIndex = 0; seqIndex < sequenceArray->count; seqIndex++)
 	{
 		SourceSequence *seq = &(sequenceArray->array[seqIndex]);
 
-		char qname[BUFSIZE] = { 0 };
-
-		sformat(qname, sizeof(qname), "\"%s\".\"%s\"",
-				seq->nspname,
-				seq->relname);
-
-		/*
-		 * In case of "permission denied" for SELECT on the sequence object, we
-		 * would then have a broken transaction and all the rest of the loop
-		 * would get the following:
-		 *
-		 * ERROR: current transaction is aborted, commands ignored
-		 * until end of transaction block
-		 *
-		 * To avoid that, for each sequence we first see if we're granted the
-		 * SELECT privilege.
-		 */
-		bool granted = false;
-		char lname[BUFSIZE] = { 0 };
-
-		sformat(lname, sizeof(lname), "%s.%s",
-				seq->nspname,
-				seq->relname);
-
-		if (!pgsql_has_sequence_privilege(pgsql, lname, "select", &granted))
+		if (!granted[seqIndex])
 		{
-			/* errors have been logged */
+			log_error("Failed to SELECT values for sequence \"%s\".\"%s\": "
+					  "permission denied",
+					  seq->nspname,
+					  seq->relname);
 			++errors;
-			break;
+		}
+		else
+		{
+			batch[batchCount++] = seq;
 		}
 
-		if (!granted)
+		bool lastSequence = seqIndex == (sequenceArray->count - 1);
+
+		if (batchCount == SEQUENCE_BATCH_SIZE ||
+			(lastSequence && batchCount > 0))
 		{
-			log_error("Failed to SELECT values for sequence %s: "
-					  "permission denied",
-					  qname);
-			++errors;
-			continue;
+			if (!copydb_fetch_sequence_values(pgsql, batch, batchCount, &errors))
+			{
+				/* errors have already been logged */
+				free(granted);
+				free(batch);
+				return false;
+			}
+
+			batchCount = 0;
+		}
+	}
+
+	free(granted);
+	free(batch);
+
+	return errors == 0;
+}
+
+
+/*
+ * copydb_fetch_sequence_values fetches the values of a batch of sequences in a
+ * single query, protected by a SAVEPOINT. When the batch query fails, then we
+ * fallback to fetching the values of each sequence of the batch one at a
+ * time, counting failures in the errors parameter.
+ *
+ * The function returns false only when the transaction is lost.
+ */
+bool
+copydb_fetch_sequence_values(PGSQL *pgsql,
+							 SourceSequence **batch,
+							 int count,
+							 int *errors)
+{
+	if (!pgsql_savepoint(pgsql, "sequences"))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (schema_get_sequence_values(pgsql, batch, count))
+	{
+		return pgsql_release_savepoint(pgsql, "sequences");
+	}
+
+	log_warn("Failed to fetch values for a batch of %d sequences, "
+			 "retrying one sequence at a time",
+			 count);
+
+	if (!pgsql_rollback_to_savepoint(pgsql, "sequences"))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		SourceSequence *seq = batch[i];
+
+		if (!pgsql_savepoint(pgsql, "sequences"))
+		{
+			/* errors have already been logged */
+			return false;
 		}
 
 		if (!schema_get_sequence_value(pgsql, seq))
 		{
 			/* just skip this one */
-			log_warn("Failed to get sequence values for %s", qname);
-			++errors;
+			log_warn("Failed to get sequence values for \"%s\".\"%s\"",
+					 seq->nspname,
+					 seq->relname);
+			++(*errors);
+
+			if (!pgsql_rollback_to_savepoint(pgsql, "sequences"))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
 			continue;
 		}
+
+		if (!pgsql_release_savepoint(pgsql, "sequences"))
+		{
+			/* errors have already been logged */
+			return false;
+		}
 	}
 
-	return errors == 0;
+	return true;
 }
 
 
@@ -147,10 +242,11 @@ copydb_start_seq_process(CopyDataSpec *specs)
 
 
 /*
- * copydb_copy_all_sequences fetches the list of sequences from the source
- * database and then for each of them runs a SELECT last_value, is_called FROM
- * the sequence on the source database and then calls SELECT setval(); on the
- * target database with the same values.
+ * copydb_copy_all_sequences calls SELECT setval(); on the target database for
+ * all the sequences, using the values fetched from the source database in
+ * copydb_prepare_sequence_specs. Values are set in batches of
+ * SEQUENCE_BATCH_SIZE sequences per query, and a batch that fails is retried
+ * one sequence at a time.
  */
 bool
 copydb_copy_all_sequences(CopyDataSpec *specs)
@@ -190,15 +286,15 @@ copydb_copy_all_sequences(CopyDataSpec *specs)
 
 	SourceSequenceArray *sequenceArray = &(specs->sequenceArray);
 
-	for (int seqIndex = 0; seqIndex < sequenceArray->count; seqIndex++)
+	for (int first = 0; first < sequenceArray->count; first += SEQUENCE_BATCH_SIZE)
 	{
-		SourceSequence *seq = &(sequenceArray->array[seqIndex]);
+		SourceSequence *batch = &(sequenceArray->array[first]);
+		int count = sequenceArray->count - first;
 
-		char qname[BUFSIZE] = { 0 };
-
-		sformat(qname, sizeof(qname), "\"%s\".\"%s\"",
-				seq->nspname,
-				seq->relname);
+		if (count > SEQUENCE_BATCH_SIZE)
+		{
+			count = SEQUENCE_BATCH_SIZE;
+		}
 
 		if (!pgsql_savepoint(&dst, "sequences"))
 		{
@@ -206,27 +302,28 @@ copydb_copy_all_sequences(CopyDataSpec *specs)
 			return false;
 		}
 
-		if (!schema_set_sequence_value(&dst, seq))
+		if (schema_set_sequence_values(&dst, batch, count))
 		{
-			log_error("Failed to set sequence values for %s", qname);
-
-			if (specs->failFast)
-			{
-				(void) pgsql_commit(&dst);
-				return false;
-			}
-
-			if (!pgsql_rollback_to_savepoint(&dst, "sequences"))
+			if (!pgsql_release_savepoint(&dst, "sequences"))
 			{
 				/* errors have already been logged */
 				return false;
 			}
 
-			++errors;
 			continue;
 		}
 
-		if (!pgsql_release_savepoint(&dst, "sequences"))
+		log_warn("Failed to set values for a batch of %d sequences, "
+				 "retrying one sequence at a time",
+				 count);
+
+		if (!pgsql_rollback_to_savepoint(&dst, "sequences"))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		if (!copydb_set_sequence_values(specs, &dst, batch, count, &errors))
 		{
 			/* errors have already been logged */
 			return false;
@@ -256,3 +353,62 @@ copydb_copy_all_sequences(CopyDataSpec *specs)
 
 	return true;
 }
+
+
+/*
+ * copydb_set_sequence_values calls SELECT setval(); on the target database for
+ * each of the given sequences, each within its own SAVEPOINT, counting
+ * failures in the errors parameter. This is used as a fallback when a batch of
+ * sequences fails, so that we may report about each failed sequence.
+ *
+ * The function returns false only when the transaction is lost, or when using
+ * --fail-fast and a sequence fails.
+ */
+bool
+copydb_set_sequence_values(CopyDataSpec *specs,
+						   PGSQL *dst,
+						   SourceSequence *batch,
+						   int count,
+						   int *errors)
+{
+	for (int i = 0; i < count; i++)
+	{
+		SourceSequence *seq = &(batch[i]);
+
+		if (!pgsql_savepoint(dst, "sequences"))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		if (!schema_set_sequence_value(dst, seq))
+		{
+			log_error("Failed to set sequence values for \"%s\".\"%s\"",
+					  seq->nspname,
+					  seq->relname);
+
+			if (specs->failFast)
+			{
+				(void) pgsql_commit(dst);
+				return false;
+			}
+
+			if (!pgsql_rollback_to_savepoint(dst, "sequences"))
+			{
+				/* errors have already been logged */
+				return false;
+			}
+
+			++(*errors);
+			continue;
+		}
+
+		if (!pgsql_release_savepoint(dst, "sequences"))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -680,3 +680,43 @@ pretty_print_count(char *buffer, size_t size, uint64_t number)
 		sformat(buffer, size, "%d %s", (int) count, suffixes[sIndex]);
 	}
 }
+
+
+/*
+ * string_arena_strdup copies the given string into the given arena, and
+ * returns a pointer to the copy, or NULL when out of memory. Strings
+ * allocated in an arena can not be free'd individually.
+ */
+char *
+string_arena_strdup(StringArena *arena, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	StringArenaChunk *chunk = arena->head;
+
+	if (chunk == NULL || (chunk->size - chunk->used) < len)
+	{
+		size_t size =
+			len > STRING_ARENA_CHUNK_SIZE ? len : STRING_ARENA_CHUNK_SIZE;
+
+		chunk = (StringArenaChunk *) malloc(sizeof(StringArenaChunk) + size);
+
+		if (chunk == NULL)
+		{
+			log_error(ALLOCATION_FAILED_ERROR);
+			return NULL;
+		}
+
+		chunk->next = arena->head;
+		chunk->size = size;
+		chunk->used = 0;
+
+		arena->head = chunk;
+	}
+
+	char *copy = chunk->data + chunk->used;
+
+	memcpy(copy, str, len);
+	chunk->used += len;
+
+	return copy;
+}
@@ -6,6 +6,7 @@
 #define STRING_UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #define IS_EMPTY_STRING_BUFFER(strbuf) (strbuf[0] == '\0')
 
@@ -48,4 +49,27 @@ void processBufferCallback(const char *buffer, bool error);
 void pretty_print_bytes(char *buffer, size_t size, uint64_t bytes);
 void pretty_print_count(char *buffer, size_t size, uint64_t count);
 
+/*
+ * StringArena allocates many small strings that share the lifetime of their
+ * arena in a list of large chunks, rather than one malloc() per string. This
+ * is used for per-table strings in specs arrays that may have millions of
+ * entries.
+ */
+#define STRING_ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct StringArenaChunk
+{
+	struct StringArenaChunk *next;
+	size_t size;
+	size_t used;
+	char data[];
+} StringArenaChunk;
+
+typedef struct StringArena
+{
+	StringArenaChunk *head;
+} StringArena;
+
+char * string_arena_strdup(StringArena *arena, const char *str);
+
 #endif /* STRING_UTILS_h */
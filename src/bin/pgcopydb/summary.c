@@ -11,6 +11,7 @@
 
 #include "copydb.h"
 #include "env_utils.h"
+#include "journal.h"
 #include "log.h"
 #include "pidfile.h"
 #include "schema.h"
@@ -51,8 +52,16 @@ write_table_summary(CopyTableSummary *summary, char *filename)
 		return false;
 	}
 
-	/* write the summary to the doneFile */
-	if (!write_file(contents->data, contents->len, filename))
+	/*
+	 * Write the summary to the lockFile when starting, and register it in the
+	 * progress journal as the doneFile when finished.
+	 */
+	bool success =
+		summary->doneTime > 0
+		? journal_write_file(contents->data, contents->len, filename)
+		: write_file(contents->data, contents->len, filename);
+
+	if (!success)
 	{
 		log_error("Failed to write table summary file \"%s\"", filename);
 		destroyPQExpBuffer(contents);
@@ -127,7 +136,7 @@ read_table_summary(CopyTableSummary *summary, const char *filename)
 	char *fileContents = NULL;
 	long fileSize = 0L;
 
-	if (!read_file(filename, &fileContents, &fileSize))
+	if (!journal_read_file(filename, &fileContents, &fileSize))
 	{
 		/* errors have already been logged */
 		return false;
@@ -405,8 +414,13 @@ write_index_summary(CopyIndexSummary *summary, char *filename, bool constraint)
 		return false;
 	}
 
-	/* write the summary to the doneFile */
-	if (!write_file(contents->data, contents->len, filename))
+	/* lockFile is a file, doneFile is registered in the progress journal */
+	bool success =
+		summary->doneTime > 0
+		? journal_write_file(contents->data, contents->len, filename)
+		: write_file(contents->data, contents->len, filename);
+
+	if (!success)
 	{
 		log_error("Failed to write file \"%s\"", filename);
 		destroyPQExpBuffer(contents);
@@ -426,7 +440,7 @@ read_index_summary(CopyIndexSummary *summary, const char *filename)
 	char *fileContents = NULL;
 	long fileSize = 0L;
 
-	if (!read_file(filename, &fileContents, &fileSize))
+	if (!journal_read_file(filename, &fileContents, &fileSize))
 	{
 		/* errors have already been logged */
 		return false;
@@ -1321,10 +1335,18 @@ prepare_summary_table(Summary *summary, CopyDataSpec *specs)
 		strlcpy(entry->nspname, table->nspname, sizeof(entry->nspname));
 		strlcpy(entry->relname, table->relname, sizeof(entry->relname));
 
+		TableFilePaths tablePaths = { 0 };
+
+		if (!copydb_init_table_specs_paths(tableSpecs, &tablePaths))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
 		/* the specs doesn't contain timing information */
 		CopyTableSummary tableSummary = { .table = table };
 
-		if (!read_table_summary(&tableSummary, tableSpecs->tablePaths.doneFile))
+		if (!read_table_summary(&tableSummary, tablePaths.doneFile))
 		{
 			/* errors have already been logged */
 			return false;
@@ -1350,7 +1372,7 @@ prepare_summary_table(Summary *summary, CopyDataSpec *specs)
 		if (tableSpecs->part.partNumber == 0)
 		{
 			if (!read_table_index_file(&indexArray,
-									   tableSpecs->tablePaths.idxListFile))
+									   tablePaths.idxListFile))
 			{
 				/* errors have already been logged */
 				return false;
@@ -1382,7 +1404,7 @@ prepare_summary_table(Summary *summary, CopyDataSpec *specs)
 				}
 
 				/* when a table has no indexes, the file doesn't exists */
-				if (file_exists(indexPaths.doneFile))
+				if (journal_file_exists(indexPaths.doneFile))
 				{
 					SummaryIndexEntry *indexEntry =
 						&(entry->indexArray.array[(entry->indexArray.count)++]);
@@ -1401,7 +1423,7 @@ prepare_summary_table(Summary *summary, CopyDataSpec *specs)
 					indexingDurationMs += indexEntry->durationMs;
 				}
 
-				if (file_exists(indexPaths.constraintDoneFile))
+				if (journal_file_exists(indexPaths.constraintDoneFile))
 				{
 					SummaryIndexArray *constraintArray =
 						&(entry->constraintArray);
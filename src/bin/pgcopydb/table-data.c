@@ -15,6 +15,7 @@
 
 #include "copydb.h"
 #include "env_utils.h"
+#include "journal.h"
 #include "lock_utils.h"
 #include "log.h"
 #include "pidfile.h"
@@ -92,8 +93,7 @@ copydb_process_table_data(CopyDataSpec *specs)
 
 	/*
 	 * Now create as many VACUUM ANALYZE sub-processes as needed, per
-	 * --table-jobs. Could be exposed separately as --vacuumJobs too, but
-	 * that's not been done at this time.
+	 * --vacuum-jobs.
 	 */
 	log_trace("copydb_process_table_data: \"%s\"", specs->cfPaths.tbldir);
 
@@ -503,6 +503,14 @@ copydb_table_is_being_processed(CopyDataSpec *specs,
 		return true;
 	}
 
+	TableFilePaths tablePaths = { 0 };
+
+	if (!copydb_init_table_specs_paths(tableSpecs, &tablePaths))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	/* enter the critical section */
 	(void) semaphore_lock(&(specs->tableSemaphore));
 
@@ -513,7 +521,7 @@ copydb_table_is_being_processed(CopyDataSpec *specs,
 	 * If the lockFile exists, then the table is currently being processed
 	 * by another worker process, skip it.
 	 */
-	if (file_exists(tableSpecs->tablePaths.doneFile))
+	if (journal_file_exists(tablePaths.doneFile))
 	{
 		*isDone = true;
 		*isBeingProcessed = false;
@@ -525,7 +533,7 @@ copydb_table_is_being_processed(CopyDataSpec *specs,
 	/* okay so it's not done yet */
 	*isDone = false;
 
-	if (file_exists(tableSpecs->tablePaths.lockFile))
+	if (file_exists(tablePaths.lockFile))
 	{
 		/*
 		 * Now it could be that the lockFile still exists and has been created
@@ -536,7 +544,7 @@ copydb_table_is_being_processed(CopyDataSpec *specs,
 		 */
 		CopyTableSummary tableSummary = { .table = tableSpecs->sourceTable };
 
-		if (!read_table_summary(&tableSummary, tableSpecs->tablePaths.lockFile))
+		if (!read_table_summary(&tableSummary, tablePaths.lockFile))
 		{
 			/* errors have already been logged */
 			(void) semaphore_unlock(&(specs->tableSemaphore));
@@ -560,14 +568,14 @@ copydb_table_is_being_processed(CopyDataSpec *specs,
 			log_warn("Found stale pid %d in file \"%s\", removing it "
 					 "and processing table %s",
 					 tableSummary.pid,
-					 tableSpecs->tablePaths.lockFile,
+					 tablePaths.lockFile,
 					 tableSpecs->qname);
 
 			/* stale pid, remove the old lockFile now, then process the table */
-			if (!unlink_file(tableSpecs->tablePaths.lockFile))
+			if (!unlink_file(tablePaths.lockFile))
 			{
 				log_error("Failed to remove the lockFile \"%s\"",
-						  tableSpecs->tablePaths.lockFile);
+						  tablePaths.lockFile);
 				(void) semaphore_unlock(&(specs->tableSemaphore));
 				return false;
 			}
@@ -619,11 +627,11 @@ copydb_table_is_being_processed(CopyDataSpec *specs,
 
 	sformat(summary->command, len, "COPY %s", copyDst->data);
 
-	if (!open_table_summary(summary, tableSpecs->tablePaths.lockFile))
+	if (!open_table_summary(summary, tablePaths.lockFile))
 	{
 		log_info("Failed to create the lock file for table %s at \"%s\"",
 				 tableSpecs->qname,
-				 tableSpecs->tablePaths.lockFile);
+				 tablePaths.lockFile);
 
 		/* end of the critical section */
 		(void) semaphore_unlock(&(specs->tableSemaphore));
@@ -650,30 +658,38 @@ bool
 copydb_mark_table_as_done(CopyDataSpec *specs,
 						  CopyTableDataSpec *tableSpecs)
 {
+	TableFilePaths tablePaths = { 0 };
+
+	if (!copydb_init_table_specs_paths(tableSpecs, &tablePaths))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	/* enter the critical section to communicate that we're done */
 	(void) semaphore_lock(&(specs->tableSemaphore));
 
-	if (!unlink_file(tableSpecs->tablePaths.lockFile))
+	if (!unlink_file(tablePaths.lockFile))
 	{
 		log_error("Failed to remove the lockFile \"%s\"",
-				  tableSpecs->tablePaths.lockFile);
+				  tablePaths.lockFile);
 		(void) semaphore_unlock(&(specs->tableSemaphore));
 		return false;
 	}
 
 	/* write the doneFile with the summary and timings now */
 	if (!finish_table_summary(tableSpecs->summary,
-							  tableSpecs->tablePaths.doneFile))
+							  tablePaths.doneFile))
 	{
 		log_error("Failed to create the summary file at \"%s\"",
-				  tableSpecs->tablePaths.doneFile);
+				  tablePaths.doneFile);
 		(void) semaphore_unlock(&(specs->tableSemaphore));
 		return false;
 	}
 
 	log_debug("Wrote summary for table %s at \"%s\"",
 			  tableSpecs->qname,
-			  tableSpecs->tablePaths.doneFile);
+			  tablePaths.doneFile);
 
 	/* end of the critical section */
 	(void) semaphore_unlock(&(specs->tableSemaphore));
@@ -702,11 +718,19 @@ copydb_table_parts_are_all_done(CopyDataSpec *specs,
 
 	*allPartsDone = false;
 
+	TableFilePaths tablePaths = { 0 };
+
+	if (!copydb_init_table_specs_paths(tableSpecs, &tablePaths))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
 	/* enter the critical section */
 	(void) semaphore_lock(&(specs->tableSemaphore));
 
 	/* make sure only one process created the indexes/constraints */
-	if (file_exists(tableSpecs->tablePaths.idxListFile))
+	if (file_exists(tablePaths.idxListFile))
 	{
 		*allPartsDone = true;
 		*isBeingProcessed = true;
@@ -726,7 +750,7 @@ copydb_table_parts_are_all_done(CopyDataSpec *specs,
 
 		(void) copydb_init_tablepaths_for_part(cfPaths, &partPaths, oid, i);
 
-		if (!file_exists(partPaths.doneFile))
+		if (!journal_file_exists(partPaths.doneFile))
 		{
 			allDone = false;
 			break;
@@ -736,7 +760,7 @@ copydb_table_parts_are_all_done(CopyDataSpec *specs,
 	/* create an empty index list file now, when allDone is still true */
 	if (allDone)
 	{
-		if (!write_file("", 0, tableSpecs->tablePaths.idxListFile))
+		if (!write_file("", 0, tablePaths.idxListFile))
 		{
 			/* errors have already been logged */
 			(void) semaphore_unlock(&(specs->tableSemaphore));
@@ -806,6 +830,14 @@ copydb_copy_table(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
 	 */
 	if (truncate && tableSpecs->part.partCount > 1)
 	{
+		TableFilePaths tablePaths = { 0 };
+
+		if (!copydb_init_table_specs_paths(tableSpecs, &tablePaths))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
 		/*
 		 * When partitioning for COPY we can only TRUNCATE once per table, we
 		 * avoid doing a TRUNCATE per part. So only the process that reaches
@@ -822,7 +854,7 @@ copydb_copy_table(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
 		(void) semaphore_lock(&(specs->tableSemaphore));
 
 		/* if the truncate done file already exists, it's been done already */
-		if (!file_exists(tableSpecs->tablePaths.truncateDoneFile))
+		if (!file_exists(tablePaths.truncateDoneFile))
 		{
 			if (!pgsql_truncate(&dst, tableSpecs->qname))
 			{
@@ -831,7 +863,7 @@ copydb_copy_table(CopyDataSpec *specs, CopyTableDataSpec *tableSpecs)
 				return false;
 			}
 
-			if (!write_file("", 0, tableSpecs->tablePaths.truncateDoneFile))
+			if (!write_file("", 0, tablePaths.truncateDoneFile))
 			{
 				/* errors have already been logged */
 				(void) semaphore_unlock(&(specs->tableSemaphore));
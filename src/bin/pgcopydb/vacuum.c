@@ -10,15 +10,15 @@
 
 #include "copydb.h"
 #include "env_utils.h"
+#include "journal.h"
 #include "lock_utils.h"
 #include "log.h"
 #include "signals.h"
 #include "summary.h"
 
 /*
- * vacuum_start_workers create as many sub-process as needed, per --table-jobs.
- * Could be exposed separately as --vacuumJobs too, but that's not been done at
- * this time.
+ * vacuum_start_workers create as many sub-process as needed, per
+ * --vacuum-jobs, which defaults to --table-jobs.
  */
 bool
 vacuum_start_workers(CopyDataSpec *specs)
@@ -91,10 +91,20 @@ vacuum_worker(CopyDataSpec *specs)
 	int errors = 0;
 	bool stop = false;
 
+	/* statistics are read on the source database using our snapshot */
+	if (specs->importStats)
+	{
+		if (!copydb_set_snapshot(specs))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
 	while (!stop)
 	{
 		QMessage mesg = { 0 };
-		bool recv_ok = queue_receive(&(specs->vacuumQueue), &mesg);
+		bool recv_ok = vacuum_receive_largest(specs, &mesg);
 
 		if (asked_to_stop || asked_to_stop_fast || asked_to_quit)
 		{
@@ -146,6 +156,11 @@ vacuum_worker(CopyDataSpec *specs)
 
 	bool success = (stop == true && errors == 0);
 
+	if (specs->importStats)
+	{
+		(void) copydb_close_snapshot(specs);
+	}
+
 	if (errors > 0)
 	{
 		log_error("VACUUM worker %d encountered %d errors, "
@@ -158,10 +173,96 @@ vacuum_worker(CopyDataSpec *specs)
 }
 
 
+/*
+ * vacuum_receive_largest receives the next message to process from the
+ * VACUUM queue. Tables are queued as soon as their indexes are built, so
+ * several of them might be waiting when a worker is ready. In that case we
+ * pick the largest table first, and send the other messages back to the
+ * queue in the order we received them, so that the STOP messages remain
+ * last.
+ */
+bool
+vacuum_receive_largest(CopyDataSpec *specs, QMessage *mesg)
+{
+	Queue *queue = &(specs->vacuumQueue);
+	QMessage batch[VACUUM_QUEUE_BATCH_SIZE] = { 0 };
+	int count = 0;
+
+	if (!queue_receive(queue, &(batch[count++])))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	while (count < VACUUM_QUEUE_BATCH_SIZE)
+	{
+		bool received = false;
+
+		if (!queue_receive_nowait(queue, &(batch[count]), &received))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+
+		if (!received)
+		{
+			break;
+		}
+
+		++count;
+	}
+
+	int largest = 0;
+	int64_t largestBytes = -1;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (batch[i].type != QMSG_TYPE_TABLEOID)
+		{
+			continue;
+		}
+
+		SourceTable *table = NULL;
+		uint32_t oid = batch[i].data.oid;
+
+		HASH_FIND(hh, specs->sourceTableHashByOid, &oid, sizeof(oid), table);
+
+		int64_t bytes = table != NULL ? table->bytes : 0;
+
+		if (bytes > largestBytes)
+		{
+			largest = i;
+			largestBytes = bytes;
+		}
+	}
+
+	*mesg = batch[largest];
+
+	for (int i = 0; i < count; i++)
+	{
+		if (i == largest)
+		{
+			continue;
+		}
+
+		if (!queue_send(queue, &(batch[i])))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
 /*
  * vacuum_analyze_table_by_oid reads the done file for the given table OID,
  * fetches the schemaname and relname from there, and then connects to the
  * target database to issue a VACUUM ANALYZE command.
+ *
+ * When using --import-stats, the planner statistics are imported from the
+ * source database instead, and the VACUUM command skips ANALYZE.
  */
 bool
 vacuum_analyze_table_by_oid(CopyDataSpec *specs, uint32_t oid)
@@ -178,7 +279,7 @@ vacuum_analyze_table_by_oid(CopyDataSpec *specs, uint32_t oid)
 	}
 
 	/* the source table COPY might have been partionned */
-	if (!file_exists(tablePaths.doneFile))
+	if (!journal_file_exists(tablePaths.doneFile))
 	{
 		int part = 0;
 
@@ -209,13 +310,44 @@ vacuum_analyze_table_by_oid(CopyDataSpec *specs, uint32_t oid)
 		return false;
 	}
 
+	/* VACUUM options and statistics import depend on the target version */
+	if (!pgsql_server_version(&dst))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	bool analyze = true;
+
+	if (specs->importStats)
+	{
+		if (!vacuum_import_table_stats(specs, &dst, &table, &analyze))
+		{
+			/* errors have already been logged */
+			return false;
+		}
+	}
+
 	/* finally, vacuum analyze the table and its indexes */
 	char vacuum[BUFSIZE] = { 0 };
 
-	sformat(vacuum, sizeof(vacuum),
-			"VACUUM ANALYZE \"%s\".\"%s\"",
-			table.nspname,
-			table.relname);
+	if (!vacuum_prepare_command(specs, &dst, &table, analyze,
+								vacuum, sizeof(vacuum)))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (IS_EMPTY_STRING_BUFFER(vacuum))
+	{
+		log_notice("Skipping VACUUM of empty table \"%s\".\"%s\"",
+				   table.nspname,
+				   table.relname);
+
+		(void) pgsql_finish(&dst);
+
+		return true;
+	}
 
 	log_notice("%s;", vacuum);
 
@@ -231,6 +363,162 @@ vacuum_analyze_table_by_oid(CopyDataSpec *specs, uint32_t oid)
 }
 
 
+/*
+ * vacuum_prepare_command plans the maintenance command to run on the target
+ * database for the given table, once it has been loaded with COPY and its
+ * indexes have been built.
+ *
+ * A table that we just loaded has no dead tuples, so there is nothing for
+ * VACUUM to remove in the indexes: we use INDEX_CLEANUP OFF to skip scanning
+ * them. The VACUUM pass also sets the visibility map and updates relpages
+ * and reltuples. With --vacuum-freeze we also use FREEZE, so that the target
+ * table does not need an anti-wraparound VACUUM later.
+ *
+ * A table that is empty once loaded needs no VACUUM, only an ANALYZE, and no
+ * command at all when its statistics have been imported. In that case the
+ * command buffer is left empty. The source table size might be an estimate,
+ * so we check the size of the table on the target database instead.
+ */
+bool
+vacuum_prepare_command(CopyDataSpec *specs,
+					   PGSQL *dst,
+					   SourceTable *table,
+					   bool analyze,
+					   char *command,
+					   size_t size)
+{
+	int64_t bytes = -1;
+
+	if (!pgsql_table_size(dst, table->nspname, table->relname, &bytes))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (bytes == 0)
+	{
+		if (analyze)
+		{
+			sformat(command, size, "ANALYZE \"%s\".\"%s\"",
+					table->nspname,
+					table->relname);
+		}
+
+		return true;
+	}
+
+	/* INDEX_CLEANUP has been added in Postgres 12 */
+	bool indexCleanup = dst->pgversion_num >= 120000;
+
+	PQExpBuffer options = createPQExpBuffer();
+
+	if (options == NULL)
+	{
+		log_error(ALLOCATION_FAILED_ERROR);
+		return false;
+	}
+
+	if (specs->vacuumFreeze)
+	{
+		appendPQExpBufferStr(options, "FREEZE");
+	}
+
+	if (indexCleanup)
+	{
+		appendPQExpBuffer(options, "%sINDEX_CLEANUP OFF",
+						  options->len > 0 ? ", " : "");
+	}
+
+	if (analyze)
+	{
+		appendPQExpBuffer(options, "%sANALYZE",
+						  options->len > 0 ? ", " : "");
+	}
+
+	if (options->len > 0)
+	{
+		sformat(command, size, "VACUUM (%s) \"%s\".\"%s\"",
+				options->data,
+				table->nspname,
+				table->relname);
+	}
+	else
+	{
+		sformat(command, size, "VACUUM \"%s\".\"%s\"",
+				table->nspname,
+				table->relname);
+	}
+
+	destroyPQExpBuffer(options);
+
+	return true;
+}
+
+
+/*
+ * vacuum_import_table_stats imports the planner statistics of the given table
+ * from the source database into the target database, using the function
+ * pg_restore_attribute_stats() that is available in Postgres 18 and later.
+ * The analyze parameter is set to false when the statistics have been
+ * imported, and to true when an ANALYZE is still needed.
+ */
+bool
+vacuum_import_table_stats(CopyDataSpec *specs,
+						  PGSQL *dst,
+						  SourceTable *table,
+						  bool *analyze)
+{
+	PGSQL *src = &(specs->sourceSnapshot.pgsql);
+	SourceTableStats stats = { 0 };
+
+	*analyze = true;
+
+	if (dst->pgversion_num < 180000)
+	{
+		log_notice("Target database version %s does not support importing "
+				   "statistics, using ANALYZE for table \"%s\".\"%s\"",
+				   dst->pgversion,
+				   table->nspname,
+				   table->relname);
+		return true;
+	}
+
+	if (!schema_prepare_table_stats(src, table->oid, &stats))
+	{
+		/* errors have already been logged */
+		return false;
+	}
+
+	if (stats.needsAnalyze || stats.restoreSQL == NULL)
+	{
+		log_notice("Statistics for table \"%s\".\"%s\" can't be imported "
+				   "from the source database, using ANALYZE",
+				   table->nspname,
+				   table->relname);
+
+		free(stats.restoreSQL);
+		return true;
+	}
+
+	log_notice("Importing statistics for table \"%s\".\"%s\"",
+			   table->nspname,
+			   table->relname);
+
+	if (!pgsql_execute(dst, stats.restoreSQL))
+	{
+		/* errors have already been logged */
+		free(stats.restoreSQL);
+		return false;
+	}
+
+	free(stats.restoreSQL);
+
+	*analyze = false;
+
+	return true;
+}
+
+
 /*
  * vacuum_add_table sends a message to the VACUUM process queue to process
  * given table.
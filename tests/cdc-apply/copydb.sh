@@ -0,0 +1,106 @@
+#! /bin/bash
+
+set -x
+set -e
+set -o pipefail
+
+# This script expects the following environment variables to be set:
+#
+#  - PGCOPYDB_SOURCE_PGURI
+#  - PGCOPYDB_TARGET_PGURI
+#  - PGCOPYDB_TABLE_JOBS
+#  - PGCOPYDB_INDEX_JOBS
+
+# make sure source and target databases are ready
+pgcopydb ping
+
+psql -d ${PGCOPYDB_SOURCE_PGURI} -f /usr/src/pgcopydb/ddl.sql
+
+# create the replication slot that captures all the changes
+# PGCOPYDB_OUTPUT_PLUGIN is set to test_decoding in docker-compose.yml
+coproc ( pgcopydb snapshot --follow )
+
+sleep 1
+
+# now setup the replication origin (target) and the pgcopydb.sentinel (source)
+pgcopydb stream setup
+
+# pgcopydb copy db uses the environment variables
+pgcopydb copy-db
+
+kill -TERM ${COPROC_PID}
+wait ${COPROC_PID}
+
+# compare the contents of the cdc_apply table on the source and the target
+SQL="select md5(string_agg(format('%s:%s', id, v), ',' order by id)) from public.cdc_apply"
+
+compare()
+{
+    s=`psql -At -d ${PGCOPYDB_SOURCE_PGURI} -c "${SQL}"`
+    t=`psql -At -d ${PGCOPYDB_TARGET_PGURI} -c "${SQL}"`
+
+    test "${s}" = "${t}"
+}
+
+# now that the copying is done, inject some SQL DML changes to the source
+psql -d ${PGCOPYDB_SOURCE_PGURI} -f /usr/src/pgcopydb/dml.sql
+
+# grab the current LSN, it's going to be our streaming end position
+lsn=`psql -At -d ${PGCOPYDB_SOURCE_PGURI} -c 'select pg_current_wal_lsn()'`
+
+# prefetch the changes captured in our replication slot, then apply them
+pgcopydb stream prefetch --resume --copy-inserts --endpos "${lsn}" -vv
+
+pgcopydb stream sentinel set apply
+pgcopydb stream catchup --resume --endpos "${lsn}" -vv
+
+compare
+
+# the runs of UPDATE and DELETE statements have been batched, and the bulk
+# INSERT has been transformed into a COPY command
+SHAREDIR=/var/lib/postgres/.local/share/pgcopydb
+
+grep -q 'SET "id" = CASE WHEN' ${SHAREDIR}/*.sql
+grep -q 'DELETE FROM "public"."cdc_apply" WHERE ("id") IN' ${SHAREDIR}/*.sql
+grep -q '^COPY {"nspname":"public","relname":"cdc_apply"' ${SHAREDIR}/*.sql
+
+#
+# Now inject more changes, and apply them using prepared statements. The
+# SQL file is transformed again, and the changes that have been applied
+# already are skipped.
+#
+psql -d ${PGCOPYDB_SOURCE_PGURI} -f /usr/src/pgcopydb/dml-prepared.sql
+
+lsn=`psql -At -d ${PGCOPYDB_SOURCE_PGURI} -c 'select pg_current_wal_lsn()'`
+
+pgcopydb stream prefetch --resume --prepared-statements --endpos "${lsn}" -vv
+pgcopydb stream catchup --resume --endpos "${lsn}" -vv
+
+compare
+
+# each statement is prepared once per SQL file, and executed many times
+prepare=`cat ${SHAREDIR}/*.sql | grep -c '^PREPARE '`
+execute=`cat ${SHAREDIR}/*.sql | grep -c '^EXECUTE '`
+
+test "${prepare}" -gt 0
+test "${execute}" -gt "${prepare}"
+
+#
+# Now replay a transaction that contains a KEEPALIVE and a SWITCH WAL message
+# in the middle of it, using Unix pipes between the transform and apply
+# processes. The LSNs in stream.json are way ahead of the changes above.
+#
+endpos=`jq -r .lsn /usr/src/pgcopydb/stream.json | tail -1`
+
+pgcopydb stream sentinel set endpos "${endpos}"
+
+pgcopydb stream transform --debug --endpos "${endpos}" - -   \
+  < /usr/src/pgcopydb/stream.json                            \
+ | pgcopydb stream apply --debug --resume --endpos "${endpos}" -
+
+count=`psql -At -d ${PGCOPYDB_TARGET_PGURI} -c "select count(*) from public.cdc_apply where id > 100000"`
+
+test "${count}" = "3"
+
+# cleanup
+pgcopydb stream cleanup
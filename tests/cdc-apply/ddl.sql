@@ -0,0 +1,18 @@
+---
+--- pgcopydb test/cdc-apply/ddl.sql
+---
+--- This file creates the tables used in the cdc-apply tests.
+
+begin;
+
+create table public.cdc_apply
+ (
+   id integer primary key,
+   v  text
+ );
+
+insert into public.cdc_apply(id, v)
+     select x, format('row %s', x)
+       from generate_series(1, 100) as t(x);
+
+commit;
@@ -0,0 +1,28 @@
+---
+--- pgcopydb test/cdc-apply/dml-prepared.sql
+---
+--- This file implements DML changes in the cdc_apply table that are applied
+--- using --prepared-statements. The same statements are used in several
+--- transactions, and are prepared only once per SQL file.
+
+begin;
+
+insert into public.cdc_apply(id, v) values (301, 'prepared 301');
+insert into public.cdc_apply(id, v) values (302, 'prepared 302');
+
+commit;
+
+begin;
+
+insert into public.cdc_apply(id, v) values (303, 'prepared 303');
+update public.cdc_apply set v = 'prepared update' where id = 301;
+
+commit;
+
+begin;
+
+update public.cdc_apply set v = 'prepared update' where id = 302;
+delete from public.cdc_apply where id = 303;
+delete from public.cdc_apply where id = 4;
+
+commit;
@@ -0,0 +1,66 @@
+---
+--- pgcopydb test/cdc-apply/dml.sql
+---
+--- This file implements DML changes in the cdc_apply table.
+
+begin;
+
+insert into public.cdc_apply(id, v) values (101, 'one hundred and one');
+update public.cdc_apply set v = 'updated' where id = 1;
+delete from public.cdc_apply where id = 2;
+
+commit;
+
+--
+-- A run of UPDATE statements that change the primary key, which the
+-- transform process applies as a single set-based UPDATE.
+--
+begin;
+
+update public.cdc_apply set id = id + 1000 where id between 21 and 60;
+
+commit;
+
+--
+-- A run of UPDATE statements where the new key of each row is the old key
+-- of the previous row. A set-based UPDATE would not respect the primary key
+-- here, so the run must be split.
+--
+begin;
+
+delete from public.cdc_apply where id = 61;
+
+do $$
+begin
+  for i in 62..80
+  loop
+    update public.cdc_apply set id = i - 1 where id = i;
+  end loop;
+end;
+$$;
+
+commit;
+
+--
+-- A run of DELETE statements, applied as a single set-based DELETE, then a
+-- couple of single-row DELETE statements.
+--
+begin;
+
+delete from public.cdc_apply where id between 81 and 100;
+delete from public.cdc_apply where id = 3;
+delete from public.cdc_apply where id = 1021;
+
+commit;
+
+--
+-- A bulk INSERT, which the transform process writes as a COPY command when
+-- using --copy-inserts.
+--
+begin;
+
+insert into public.cdc_apply(id, v)
+     select x, format('bulk %s', x)
+       from generate_series(201, 250) as t(x);
+
+commit;
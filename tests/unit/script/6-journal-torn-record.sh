@@ -0,0 +1,43 @@
+#! /bin/bash
+
+set -x
+set -e
+
+# This script expects the following environment variable(s) to be set:
+#
+#  - PGCOPYDB_SOURCE_PGURI
+#
+# It runs after `pgcopydb fork` in copydb.sh, and uses the progress journal
+# that the fork command left in the work directory.
+
+journal=${TMPDIR:-/tmp}/pgcopydb/run/progress.journal
+good=/tmp/progress.journal.good
+
+cp ${journal} ${good}
+
+pgcopydb list progress > /tmp/progress.before
+
+# a torn record, with fewer bytes than its header announces, is followed by
+# good records appended later: the good records must still be found
+{
+    printf '%08x %d %s\n%s\n' 0 65536 run/tables/0.done 'torn record'
+    cat ${good}
+} > ${journal}
+
+pgcopydb list progress > /tmp/progress.torn
+
+diff /tmp/progress.before /tmp/progress.torn
+echo "progress is the same with a torn journal record"
+
+# a header with a length larger than any record is skipped as well
+{
+    printf '%08x %d %s\n%s\n' 0 999999999 run/tables/0.done 'torn record'
+    cat ${good}
+} > ${journal}
+
+pgcopydb list progress > /tmp/progress.huge
+
+diff /tmp/progress.before /tmp/progress.huge
+echo "progress is the same with a corrupted journal record header"
+
+cp ${good} ${journal}